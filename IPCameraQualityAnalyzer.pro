@@ -14,7 +14,7 @@
 #-------------------------------------------------
 
 # Имя проекта
-QT += core gui widgets
+QT += core gui widgets network
 
 # Версия Qt (для совместимости)
 QT_VERSION = $$QT_VERSION
@@ -29,6 +29,10 @@ VERSION = 1.0.0
 # Определения для версии
 DEFINES += APP_VERSION=\\\"$$VERSION\\\"
 
+# Предел памяти по умолчанию для edge-устройств: qmake DEFAULT_MEMORY_LIMIT_MB=400
+isEmpty(DEFAULT_MEMORY_LIMIT_MB): DEFAULT_MEMORY_LIMIT_MB = 0
+DEFINES += DEFAULT_MEMORY_LIMIT_MB=$$DEFAULT_MEMORY_LIMIT_MB
+
 # Формы UI (Qt Designer)
 FORMS += src/mainwindow.ui
 
@@ -37,13 +41,54 @@ SOURCES += \
     src/main.cpp \
     src/mainwindow.cpp \
     src/cameraworker.cpp \
-    src/imagequalityanalyzer.cpp
+    src/imagequalityanalyzer.cpp \
+    src/framesource.cpp \
+    src/syntheticsource.cpp \
+    src/analysisscheduler.cpp \
+    src/consistenthashring.cpp \
+    src/shardprotocol.cpp \
+    src/shardcoordinator.cpp \
+    src/shardworker.cpp \
+    src/resultprotocol.cpp \
+    src/resultpublisher.cpp \
+    src/resultviewer.cpp \
+    src/sharedframering.cpp \
+    src/shmframesource.cpp \
+    src/capturepublisher.cpp \
+    src/snapshotcache.cpp \
+    src/timeseriesstore.cpp \
+    src/historywriter.cpp \
+    src/alertengine.cpp \
+    src/cameraconfig.cpp \
+    src/affinitypolicy.cpp \
+    src/memorybudget.cpp
 
 # Заголовочные файлы (HEADERS)
 HEADERS += \
     src/mainwindow.h \
     src/cameraworker.h \
-    src/imagequalityanalyzer.h
+    src/imagequalityanalyzer.h \
+    src/framesource.h \
+    src/syntheticsource.h \
+    src/analysisscheduler.h \
+    src/consistenthashring.h \
+    src/shardprotocol.h \
+    src/shardcoordinator.h \
+    src/shardworker.h \
+    src/resultprotocol.h \
+    src/resultpublisher.h \
+    src/resultviewer.h \
+    src/sharedframering.h \
+    src/shmframesource.h \
+    src/capturepublisher.h \
+    src/snapshotcache.h \
+    src/seqlockvalue.h \
+    src/timeseriesstore.h \
+    src/historywriter.h \
+    src/alertengine.h \
+    src/cameraconfig.h \
+    src/affinitypolicy.h \
+    src/memorybudget.h
 
 # Ресурсы (если есть)
 # RESOURCES += resources.qrc
@@ -68,9 +113,25 @@ packagesExist(opencv4) {
     # Ручные пути для OpenCV (настройте при необходимости)
     INCLUDEPATH += /usr/include/opencv4
     INCLUDEPATH += /usr/include/opencv
-    LIBS += -lopencv_core -lopencv_imgproc -lopencv_videoio -lopencv_highgui
+    # imgcodecs - cv::imwrite/cv::imread эталонного кадра (OpenCV 3+)
+    LIBS += -lopencv_core -lopencv_imgproc -lopencv_imgcodecs -lopencv_videoio -lopencv_highgui
+}
+
+# Необязательный бэкенд захвата на libavformat/libavcodec (--capture-backend ffmpeg)
+packagesExist(libavformat libavcodec libavutil libswscale) {
+    message("FFmpeg capture backend enabled")
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavformat libavcodec libavutil libswscale
+    DEFINES += HAVE_FFMPEG
+    SOURCES += src/ffmpegsource.cpp src/packetring.cpp src/ingestreactor.cpp src/rtspsession.cpp src/ingestsource.cpp
+    HEADERS += src/ffmpegsource.h src/packetring.h src/ingestreactor.h src/rtspsession.h src/ingestsource.h
+} else {
+    message("FFmpeg development files not found, FFmpeg capture backend disabled")
 }
 
+# shm_open/shm_unlink для кольца кадров в разделяемой памяти
+unix:LIBS += -lrt
+
 # Настройки компиляции
 CONFIG += c++17
 
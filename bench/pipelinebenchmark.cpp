@@ -0,0 +1,327 @@
+/**
+ * Нагрузочный замер конвейера захвата и анализа.
+ *
+ * Запускает N камер с синтетическими источниками через настоящие
+ * CameraWorker и ImageQualityAnalyzer (каждая камера в своём QThread,
+ * как в MainWindow) и печатает устойчивую пропускную способность и
+ * задержку обработки кадра (p50/p99).
+ *
+ * Пример:
+ *   IPCameraPipelineBenchmark --cameras 16 --duration 20 --width 1920 --height 1080 --fps 25
+ *
+ * С --batch N вместо конвейера замеряется пакетный анализ
+ * (ImageQualityAnalyzer::analyzeBatch) пакетами по N кадров от всех камер:
+ *   IPCameraPipelineBenchmark --batch 256 --cameras 16 --width 320 --height 180
+ *
+ * С --metric-cost замеряется доля времени анализа, которую занимают
+ * блочность, спектральный фокус и детектор застывания (цель - не больше 30%
+ * к остальным метрикам):
+ *   IPCameraPipelineBenchmark --metric-cost --width 1920 --height 1080
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "cameraworker.h"
+#include "imagequalityanalyzer.h"
+#include "framesource.h"
+
+Q_DECLARE_METATYPE(ImageQualityAnalyzer::QualityResult)
+
+namespace {
+
+/**
+ * @brief Потокобезопасный сборщик задержек со всех камер
+ */
+class LatencyCollector
+{
+public:
+    void setRecording(bool recording)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_recording = recording;
+    }
+
+    void record(qint64 latencyUs, bool analyzed)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_recording) {
+            return;
+        }
+        m_all.push_back(latencyUs);
+        if (analyzed) {
+            m_analyzed.push_back(latencyUs);
+        }
+    }
+
+    std::vector<qint64> all() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_all;
+    }
+
+    std::vector<qint64> analyzed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_analyzed;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    bool m_recording = false;
+    std::vector<qint64> m_all;
+    std::vector<qint64> m_analyzed;
+};
+
+double percentileMs(std::vector<qint64> samples, double fraction)
+{
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(index), samples.end());
+    return samples[index] / 1000.0;
+}
+
+/**
+ * @brief Замер пакетного анализа: кадры заранее в памяти, без захвата и сигналов
+ */
+int runBatchBenchmark(const QStringList& urls, int batchSize, int durationSec, int warmupSec)
+{
+    // Кадры камер чередуются, как при переоценке архива нескольких камер
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    for (const QString& url : urls) {
+        std::unique_ptr<FrameSource> source = FrameSource::create(url);
+        if (!source || !source->open()) {
+            std::fprintf(stderr, "Cannot open %s\n", qPrintable(url));
+            return 1;
+        }
+        sources.push_back(std::move(source));
+    }
+    std::vector<cv::Mat> frames;
+    size_t frameBytes = 0;
+    for (int i = 0; i < batchSize; ++i) {
+        cv::Mat frame;
+        if (!sources[i % sources.size()]->read(frame) || frame.empty()) {
+            std::fprintf(stderr, "Cannot read frame from %s\n", qPrintable(urls[i % urls.size()]));
+            return 1;
+        }
+        frameBytes += frame.total() * frame.elemSize();
+        frames.push_back(frame.clone());
+    }
+    std::vector<ImageQualityAnalyzer::QualityResult> results(frames.size());
+
+    std::printf("Batch of %d frames from %d cameras (%.1f MiB), %d OpenCV threads, warm-up %d s, measuring %d s\n",
+                batchSize, static_cast<int>(urls.size()), frameBytes / (1024.0 * 1024.0), cv::getNumThreads(),
+                warmupSec, durationSec);
+
+    ImageQualityAnalyzer analyzer;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < warmupSec * 1000) {
+        analyzer.analyzeBatch(frames.data(), frames.size(), results.data());
+    }
+
+    std::vector<qint64> batchUs;
+    timer.restart();
+    while (timer.elapsed() < durationSec * 1000) {
+        QElapsedTimer batchTimer;
+        batchTimer.start();
+        analyzer.analyzeBatch(frames.data(), frames.size(), results.data());
+        batchUs.push_back(batchTimer.nsecsElapsed() / 1000);
+    }
+    double elapsedSec = timer.nsecsElapsed() / 1e9;
+
+    double framesPerSec = batchUs.size() * frames.size() / elapsedSec;
+    std::printf("\nBatches:            %zu\n", batchUs.size());
+    std::printf("Throughput:         %.1f frames/s, %.1f MiB/s of frame data\n",
+                framesPerSec, batchUs.size() * frameBytes / elapsedSec / (1024.0 * 1024.0));
+    std::printf("Batch time:         p50 %.2f ms, p99 %.2f ms\n",
+                percentileMs(batchUs, 0.50), percentileMs(batchUs, 0.99));
+    std::printf("First result:       score %.1f, %s\n", results[0].overallScore, qPrintable(results[0].status));
+    return 0;
+}
+
+/**
+ * @brief Замер стоимости дополнительных метрик относительно базовых на одном потоке
+ */
+int runMetricCostBenchmark(const QString& url, int durationSec, int warmupSec)
+{
+    std::unique_ptr<FrameSource> source = FrameSource::create(url);
+    if (!source || !source->open()) {
+        std::fprintf(stderr, "Cannot open %s\n", qPrintable(url));
+        return 1;
+    }
+
+    ImageQualityAnalyzer analyzer;
+    cv::Mat frame;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < warmupSec * 1000 && source->read(frame)) {
+        analyzer.analyze(frame);
+    }
+
+    analyzer.setStageTiming(true);
+    timer.restart();
+    while (timer.elapsed() < durationSec * 1000 && source->read(frame)) {
+        analyzer.analyze(frame);
+    }
+
+    ImageQualityAnalyzer::StageTimes times = analyzer.stageTimes();
+    if (times.frames == 0 || times.baseNs == 0) {
+        std::fprintf(stderr, "No frames analyzed\n");
+        return 1;
+    }
+    double baseMs = times.baseNs / 1e6 / times.frames;
+    double extendedMs = times.extendedNs / 1e6 / times.frames;
+    double addedPercent = 100.0 * times.extendedNs / times.baseNs;
+    std::printf("Frame %dx%d, %lld frames\n", frame.cols, frame.rows, static_cast<long long>(times.frames));
+    std::printf("Base metrics:       %.3f ms/frame (gray, histogram, noise, sharpness, exposure)\n", baseMs);
+    std::printf("Extended metrics:   %.3f ms/frame (blockiness, spectral focus, freeze)\n", extendedMs);
+    std::printf("Added cost:         %.1f%% (target <= 30%%)\n", addedPercent);
+    return addedPercent <= 30.0 ? 0 : 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    qRegisterMetaType<ImageQualityAnalyzer::QualityResult>("ImageQualityAnalyzer::QualityResult");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Нагрузочный замер конвейера CameraWorker/ImageQualityAnalyzer");
+    parser.addHelpOption();
+    QCommandLineOption camerasOption("cameras", "Number of simulated cameras", "n", "8");
+    QCommandLineOption durationOption("duration", "Measured duration, seconds", "seconds", "10");
+    QCommandLineOption warmupOption("warmup", "Warm-up before measuring, seconds", "seconds", "2");
+    QCommandLineOption widthOption("width", "Frame width", "px", "1920");
+    QCommandLineOption heightOption("height", "Frame height", "px", "1080");
+    QCommandLineOption fpsOption("fps", "Per-camera frame rate (0 = unlimited)", "fps", "25");
+    QCommandLineOption sourceOption("source", "Extra synthetic:// query parameters, e.g. noise=8&blur=1.5", "query", "");
+    parser.addOption(camerasOption);
+    parser.addOption(durationOption);
+    parser.addOption(warmupOption);
+    parser.addOption(widthOption);
+    parser.addOption(heightOption);
+    parser.addOption(fpsOption);
+    parser.addOption(sourceOption);
+    QCommandLineOption batchOption("batch", "Measure ImageQualityAnalyzer::analyzeBatch with batches of n frames "
+                                   "instead of the capture pipeline", "n", "0");
+    parser.addOption(batchOption);
+    QCommandLineOption metricCostOption("metric-cost", "Measure the cost of blockiness, spectral focus and "
+                                        "freeze metrics relative to the base metrics");
+    parser.addOption(metricCostOption);
+    parser.process(app);
+
+    // Отладочный вывод CameraWorker на каждый кадр исказил бы замер
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    const int cameraCount = std::max(1, parser.value(camerasOption).toInt());
+    const int durationSec = std::max(1, parser.value(durationOption).toInt());
+    const int warmupSec = std::max(0, parser.value(warmupOption).toInt());
+    const double fps = parser.value(fpsOption).toDouble();
+    const int batchSize = parser.value(batchOption).toInt();
+
+    if (parser.isSet(metricCostOption)) {
+        QString url = QString("synthetic://cost?seed=1&width=%1&height=%2")
+            .arg(parser.value(widthOption)).arg(parser.value(heightOption));
+        if (!parser.value(sourceOption).isEmpty()) {
+            url += "&" + parser.value(sourceOption);
+        }
+        return runMetricCostBenchmark(url, durationSec, warmupSec);
+    }
+
+    if (batchSize > 0) {
+        QStringList urls;
+        for (int i = 0; i < cameraCount; ++i) {
+            QString url = QString("synthetic://bench%1?seed=%2&width=%3&height=%4")
+                .arg(i).arg(i + 1).arg(parser.value(widthOption)).arg(parser.value(heightOption));
+            if (!parser.value(sourceOption).isEmpty()) {
+                url += "&" + parser.value(sourceOption);
+            }
+            urls.append(url);
+        }
+        return runBatchBenchmark(urls, batchSize, durationSec, warmupSec);
+    }
+
+    LatencyCollector collector;
+    std::vector<QThread*> threads;
+    std::vector<CameraWorker*> workers;
+
+    for (int i = 0; i < cameraCount; ++i) {
+        QString url = QString("synthetic://bench%1?seed=%2&width=%3&height=%4&fps=%5")
+            .arg(i).arg(i + 1)
+            .arg(parser.value(widthOption)).arg(parser.value(heightOption))
+            .arg(fps);
+        if (!parser.value(sourceOption).isEmpty()) {
+            url += "&" + parser.value(sourceOption);
+        }
+
+        QThread* thread = new QThread();
+        CameraWorker* worker = new CameraWorker(url);
+        worker->setFrameInterval(fps > 0.0 ? -1 : 0);
+        worker->moveToThread(thread);
+
+        QObject::connect(thread, &QThread::started, worker, &CameraWorker::startCapture);
+        QObject::connect(worker, &CameraWorker::frameProcessed, worker,
+            [&collector](qint64 latencyUs, bool analyzed) {
+                collector.record(latencyUs, analyzed);
+            }, Qt::DirectConnection);
+
+        threads.push_back(thread);
+        workers.push_back(worker);
+        thread->start();
+    }
+
+    std::printf("Cameras: %d, frame %sx%s, target %.1f fps/camera, warm-up %d s, measuring %d s\n",
+                cameraCount, qPrintable(parser.value(widthOption)), qPrintable(parser.value(heightOption)),
+                fps, warmupSec, durationSec);
+
+    QElapsedTimer measureTimer;
+    QTimer::singleShot(warmupSec * 1000, [&]() {
+        collector.setRecording(true);
+        measureTimer.start();
+    });
+    QTimer::singleShot((warmupSec + durationSec) * 1000, [&]() {
+        collector.setRecording(false);
+        app.quit();
+    });
+
+    app.exec();
+
+    double elapsedSec = measureTimer.isValid() ? measureTimer.nsecsElapsed() / 1e9 : durationSec;
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        CameraWorker* worker = workers[i];
+        QMetaObject::invokeMethod(worker, [worker]() { worker->stopCapture(); }, Qt::BlockingQueuedConnection);
+        threads[i]->quit();
+        threads[i]->wait();
+        delete workers[i];
+        delete threads[i];
+    }
+
+    std::vector<qint64> all = collector.all();
+    std::vector<qint64> analyzed = collector.analyzed();
+
+    double totalFps = all.size() / elapsedSec;
+    std::printf("\nFrames processed:   %zu (%zu analyzed)\n", all.size(), analyzed.size());
+    std::printf("Sustained total:    %.1f fps (%.1f fps/camera)\n", totalFps, totalFps / cameraCount);
+    std::printf("Analysis rate:      %.1f analyses/s\n", analyzed.size() / elapsedSec);
+    std::printf("Latency, all:       p50 %.2f ms, p99 %.2f ms\n",
+                percentileMs(all, 0.50), percentileMs(all, 0.99));
+    std::printf("Latency, analyzed:  p50 %.2f ms, p99 %.2f ms\n",
+                percentileMs(analyzed, 0.50), percentileMs(analyzed, 0.99));
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "affinitypolicy.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Индекс узла, к которому привязан поток (bindCurrentThread)
+thread_local int t_threadNode = -1;
+
+/**
+ * @brief Разбирает список ядер sysfs вида "0-7,16-23"
+ */
+QVector<int> parseCpuList(const QString& text)
+{
+    QVector<int> cpus;
+    // Без QString::SkipEmptyParts: он устарел в Qt 5.15
+    for (const QString& range : text.trimmed().split(',')) {
+        if (range.isEmpty()) {
+            continue;
+        }
+        int dash = range.indexOf('-');
+        bool firstOk = false;
+        bool lastOk = false;
+        int first = range.left(dash < 0 ? range.length() : dash).toInt(&firstOk);
+        int last = dash < 0 ? first : range.mid(dash + 1).toInt(&lastOk);
+        if (!firstOk || (dash >= 0 && !lastOk)) {
+            continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.append(cpu);
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+AffinityPolicy& AffinityPolicy::instance()
+{
+    static AffinityPolicy policy;
+    return policy;
+}
+
+AffinityPolicy::AffinityPolicy()
+    : m_cpuCount(0)
+    , m_enabled(false)
+{
+    readTopology();
+}
+
+void AffinityPolicy::readTopology()
+{
+    // Ядра, ограниченные taskset или cgroup, не назначаются
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+
+    QDir nodeDir("/sys/devices/system/node");
+    static const QRegularExpression nodePattern("^node(\\d+)$");
+    QStringList entries = nodeDir.entryList(QStringList() << "node*", QDir::Dirs);
+    std::sort(entries.begin(), entries.end(), [](const QString& a, const QString& b) {
+        return a.mid(4).toInt() < b.mid(4).toInt();
+    });
+
+    for (const QString& entry : entries) {
+        QRegularExpressionMatch match = nodePattern.match(entry);
+        if (!match.hasMatch()) {
+            continue;
+        }
+        QFile cpuList(nodeDir.filePath(entry + "/cpulist"));
+        if (!cpuList.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        Node node;
+        node.osNode = match.captured(1).toInt();
+        node.cameras = 0;
+        for (int cpu : parseCpuList(QString::fromLatin1(cpuList.readAll()))) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                node.cpus.append(cpu);
+            }
+        }
+        // Узлы только с памятью (без ядер) потоки не принимают
+        if (!node.cpus.isEmpty()) {
+            m_cpuCount += node.cpus.size();
+            m_nodes.append(node);
+        }
+    }
+}
+
+void AffinityPolicy::configure(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_enabled = enabled;
+    if (!enabled) {
+        qInfo() << "NUMA affinity disabled";
+        return;
+    }
+    if (m_nodes.size() < 2) {
+        qInfo() << "NUMA affinity: single node, threads are not pinned";
+        return;
+    }
+
+    // Каждый parallel_for_ теперь выполняется в потоке камеры - во всём
+    // процессе, включая цветовой проход полосами и analyzeBatch
+    cv::setNumThreads(0);
+    qInfo() << "NUMA affinity: OpenCV thread pool disabled, colour pass strips and analyzeBatch run serially"
+            << "on the calling thread";
+    for (const Node& node : m_nodes) {
+        qInfo() << "NUMA affinity: node" << node.osNode << "with" << node.cpus.size() << "CPUs";
+    }
+}
+
+bool AffinityPolicy::isActive() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_enabled && m_nodes.size() > 1;
+}
+
+int AffinityPolicy::nodeCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_nodes.size();
+}
+
+int AffinityPolicy::osNode(int node) const
+{
+    QMutexLocker locker(&m_mutex);
+    return node >= 0 && node < m_nodes.size() ? m_nodes[node].osNode : -1;
+}
+
+int AffinityPolicy::acquireNode()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_enabled || m_nodes.size() < 2) {
+        return -1;
+    }
+
+    // Нагрузка - камеры на ядро: узлы могут быть неравными после taskset
+    int best = 0;
+    for (int i = 1; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].cameras * m_nodes[best].cpus.size() < m_nodes[best].cameras * m_nodes[i].cpus.size()) {
+            best = i;
+        }
+    }
+    m_nodes[best].cameras++;
+    return best;
+}
+
+void AffinityPolicy::releaseNode(int node)
+{
+    QMutexLocker locker(&m_mutex);
+    if (node >= 0 && node < m_nodes.size() && m_nodes[node].cameras > 0) {
+        m_nodes[node].cameras--;
+    }
+}
+
+double AffinityPolicy::cpuShare(int node) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (node < 0 || node >= m_nodes.size() || m_cpuCount == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(m_nodes[node].cpus.size()) / m_cpuCount;
+}
+
+bool AffinityPolicy::bindCurrentThread(int node)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int osNodeId;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (node < 0 || node >= m_nodes.size()) {
+            return false;
+        }
+        for (int cpu : m_nodes[node].cpus) {
+            CPU_SET(cpu, &cpus);
+        }
+        osNodeId = m_nodes[node].osNode;
+    }
+
+    // pid 0 - вызывающий поток, а не весь процесс
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        qWarning() << "NUMA affinity: cannot pin thread to node" << osNodeId << ":" << std::strerror(errno);
+        return false;
+    }
+
+    // Предпочтительный (не обязательный) узел: при нехватке его памяти
+    // ядро выделит на соседнем, а не завершит процесс
+    const int bitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodeMask(osNodeId / bitsPerWord + 1, 0);
+    nodeMask[osNodeId / bitsPerWord] |= 1UL << (osNodeId % bitsPerWord);
+    // Ядро читает maxnode - 1 бит маски
+    unsigned long maxNode = nodeMask.size() * bitsPerWord + 1;
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodeMask.data(), maxNode) != 0) {
+        qWarning() << "NUMA affinity: cannot set memory policy for node" << osNodeId << ":" << std::strerror(errno);
+    }
+
+    t_threadNode = node;
+    return true;
+}
+
+int AffinityPolicy::currentThreadNode()
+{
+    return t_threadNode;
+}
+
+int AffinityPolicy::pageNode(const void* address)
+{
+    int node = -1;
+    if (!address || syscall(SYS_get_mempolicy, &node, nullptr, 0UL, const_cast<void*>(address),
+                            MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+        return -1;
+    }
+    return node;
+}
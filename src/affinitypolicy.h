@@ -0,0 +1,106 @@
+#ifndef AFFINITYPOLICY_H
+#define AFFINITYPOLICY_H
+
+#include <QList>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * @class AffinityPolicy
+ * @brief Размещение потоков камер по узлам NUMA
+ *
+ * На многосокетных серверах поток камеры, которого планировщик ОС
+ * переносит между сокетами, декодирует кадр в память одного узла, а
+ * анализирует его ядрами другого. Политика закрепляет поток каждой камеры
+ * за ядрами одного узла (узлы назначаются по наименьшей загрузке) и
+ * выбирает этот узел предпочтительным для его выделений памяти. Всё, что
+ * поток камеры создаёт после привязки, наследует её: потоки декодера
+ * FFmpeg, процесс захвата --isolate-capture. Для бэкенда ingest у каждого
+ * узла свой пул декодирования.
+ *
+ * На машине с одним узлом (или если процессу доступны ядра только одного
+ * узла) политика неактивна и потоки не закрепляются.
+ *
+ * Индексы узлов - 0..nodeCount()-1, в порядке номеров узлов ОС.
+ */
+class AffinityPolicy
+{
+public:
+    /**
+     * @brief Общая политика; топология читается при первом обращении
+     */
+    static AffinityPolicy& instance();
+
+    /**
+     * @brief Включает или отключает размещение (вызывается до запуска камер)
+     *
+     * По умолчанию политика выключена. Активная политика отключает общий
+     * пул потоков OpenCV: его потоки не привязаны к узлам, и полосы кадра
+     * уходили бы на чужой сокет. Параллелизм анализа при этом дают только
+     * сами потоки камер, поэтому включать её стоит, когда камер не меньше,
+     * чем ядер: при нескольких камерах анализ кадра станет последовательным.
+     * Это касается всего процесса: цветовой проход по полосам и
+     * ImageQualityAnalyzer::analyzeBatch тоже выполняются в одном потоке.
+     */
+    void configure(bool enabled);
+
+    /**
+     * @brief Политика включена и узлов с доступными ядрами больше одного
+     */
+    bool isActive() const;
+
+    int nodeCount() const;
+
+    /**
+     * @brief Номер узла ОС по индексу
+     */
+    int osNode(int node) const;
+
+    /**
+     * @brief Выбирает наименее загруженный узел для новой камеры
+     * @return Индекс узла или -1, если политика неактивна
+     */
+    int acquireNode();
+
+    void releaseNode(int node);
+
+    /**
+     * @brief Доля ядер процесса, приходящаяся на узел (для размера пулов)
+     */
+    double cpuShare(int node) const;
+
+    /**
+     * @brief Закрепляет вызывающий поток за ядрами узла и его памятью
+     */
+    bool bindCurrentThread(int node);
+
+    /**
+     * @brief Узел, к которому привязан вызывающий поток; -1 - не привязан
+     */
+    static int currentThreadNode();
+
+    /**
+     * @brief Номер узла ОС, на котором лежит страница по адресу; -1 - неизвестно
+     */
+    static int pageNode(const void* address);
+
+private:
+    struct Node {
+        int osNode;
+        QVector<int> cpus;
+        int cameras;
+    };
+
+    AffinityPolicy();
+    AffinityPolicy(const AffinityPolicy&) = delete;
+    AffinityPolicy& operator=(const AffinityPolicy&) = delete;
+
+    void readTopology();
+
+    mutable QMutex m_mutex;
+    QList<Node> m_nodes;
+    int m_cpuCount;
+    bool m_enabled;
+};
+
+#endif // AFFINITYPOLICY_H
@@ -0,0 +1,378 @@
+#include "alertengine.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+
+namespace {
+
+struct MetricName {
+    AlertEngine::Metric metric;
+    const char* name;
+};
+
+const MetricName METRIC_NAMES[] = {
+    { AlertEngine::Metric::Overall,      "overall" },
+    { AlertEngine::Metric::Noise,        "noise" },
+    { AlertEngine::Metric::Contrast,     "contrast" },
+    { AlertEngine::Metric::Sharpness,    "sharpness" },
+    { AlertEngine::Metric::Overexposed,  "overexposed" },
+    { AlertEngine::Metric::Underexposed, "underexposed" },
+    { AlertEngine::Metric::Blockiness,   "blockiness" },
+    { AlertEngine::Metric::Focus,        "focus" },
+    { AlertEngine::Metric::ColorCast,    "color_cast" },
+    { AlertEngine::Metric::PacketLoss,   "packet_loss" },
+    { AlertEngine::Metric::Frozen,       "frozen" },
+    { AlertEngine::Metric::Stale,        "stale" },
+};
+
+} // namespace
+
+AlertEngine::AlertEngine(QObject *parent)
+    : QObject(parent)
+    , m_tickTimer(new QTimer(this))
+{
+    qRegisterMetaType<AlertEngine::Alert>("AlertEngine::Alert");
+    connect(m_tickTimer, &QTimer::timeout, this, [this]() {
+        tick(QDateTime::currentMSecsSinceEpoch());
+    });
+    m_tickTimer->start(TICK_INTERVAL_MS);
+}
+
+void AlertEngine::addRule(const Rule& rule)
+{
+    int index = m_rules.size();
+    m_rules.append(rule);
+    if (rule.cameraKey.isEmpty()) {
+        m_globalRules.append(index);
+    } else {
+        m_cameraRules[rule.cameraKey].append(index);
+    }
+}
+
+void AlertEngine::clearRules()
+{
+    // Индексы состояний ссылаются на правила - активные оповещения снимаются
+    for (auto cameraIt = m_cameras.begin(); cameraIt != m_cameras.end(); ++cameraIt) {
+        QHash<int, RuleState> states;
+        states.swap(cameraIt->rules);
+        cameraIt->activeAlerts = 0;
+        for (const RuleState& state : states) {
+            if (state.state == State::Firing || state.state == State::Clearing) {
+                emit alertCleared(state.alert);
+            }
+        }
+    }
+    m_rules.clear();
+    m_globalRules.clear();
+    m_cameraRules.clear();
+}
+
+QList<AlertEngine::Rule> AlertEngine::rules() const
+{
+    return m_rules.toList();
+}
+
+int AlertEngine::loadRules(const QString& path, QString* errorText)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorText) {
+            *errorText = QString("Не удалось открыть %1: %2").arg(path, file.errorString());
+        }
+        return 0;
+    }
+
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    int lineNumber = 0;
+    int loaded = 0;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine();
+        lineNumber++;
+
+        Rule rule;
+        QString lineError;
+        if (parseRule(line, rule, &lineError)) {
+            addRule(rule);
+            loaded++;
+        } else if (!lineError.isEmpty()) {
+            qWarning() << "Alert rules" << path << "line" << lineNumber << ":" << lineError;
+        }
+    }
+
+    // Пустой или целиком ошибочный файл оставил бы камеры без оповещений
+    if (loaded == 0) {
+        if (errorText) {
+            *errorText = QString("В %1 нет ни одного правила").arg(path);
+        }
+        return 0;
+    }
+    qInfo() << "Loaded" << loaded << "alert rules from" << path;
+    return loaded;
+}
+
+bool AlertEngine::parseRule(const QString& line, Rule& rule, QString* errorText)
+{
+    QString trimmed = line.trimmed();
+    if (trimmed.isEmpty() || trimmed.startsWith('#')) {
+        return false;
+    }
+
+    // метрика [< или > порог], затем ключ=значение или ключ="значение с пробелами"
+    static const QRegularExpression conditionPattern("^(\\w+)(?:\\s*([<>])\\s*(-?[0-9.]+))?");
+    static const QRegularExpression tokenPattern("(\\S+?)=(\"[^\"]*\"|\\S+)");
+
+    QRegularExpressionMatch condition = conditionPattern.match(trimmed);
+    if (!condition.hasMatch() || !parseMetric(condition.captured(1), rule.metric)) {
+        if (errorText) {
+            *errorText = "неизвестная метрика в правиле " + trimmed;
+        }
+        return false;
+    }
+
+    if (condition.captured(2).isEmpty()) {
+        if (rule.metric != Metric::Frozen) {
+            if (errorText) {
+                *errorText = "нет условия (< или >) в правиле " + trimmed;
+            }
+            return false;
+        }
+        rule.below = false;
+        rule.threshold = 0.5;
+    } else {
+        rule.below = condition.captured(2) == "<";
+        rule.threshold = condition.captured(3).toDouble();
+    }
+    // Для логической метрики гистерезис не нужен
+    double margin = rule.metric == Metric::Frozen ? 0.0 : HYSTERESIS_MARGIN;
+    rule.clearThreshold = rule.below ? rule.threshold + margin : rule.threshold - margin;
+    rule.clearForMs = DEFAULT_CLEAR_FOR_MS;
+    rule.name = trimmed.left(condition.capturedLength());
+
+    auto it = tokenPattern.globalMatch(trimmed.mid(condition.capturedLength()));
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        QString key = match.captured(1);
+        QString value = match.captured(2);
+        if (value.startsWith('"')) {
+            value = value.mid(1, value.length() - 2);
+        }
+
+        if (key == "for") {
+            rule.forMs = static_cast<qint64>(value.toDouble() * 1000);
+        } else if (key == "clear_for") {
+            rule.clearForMs = static_cast<qint64>(value.toDouble() * 1000);
+        } else if (key == "clear") {
+            rule.clearThreshold = value.toDouble();
+        } else if (key == "camera") {
+            rule.cameraKey = value;
+        } else if (key == "name") {
+            rule.name = value;
+        } else if (key == "severity") {
+            rule.severity = value;
+        } else {
+            qWarning() << "Alert rules: unknown option" << key << "in" << trimmed;
+        }
+    }
+
+    // Порог снятия по ту же сторону, что и срабатывание, дал бы дребезг
+    if (rule.below ? rule.clearThreshold < rule.threshold : rule.clearThreshold > rule.threshold) {
+        if (errorText) {
+            *errorText = "порог снятия не отделён от порога срабатывания в правиле " + trimmed;
+        }
+        return false;
+    }
+    return true;
+}
+
+QList<AlertEngine::Rule> AlertEngine::defaultRules()
+{
+    QList<Rule> rules;
+    const char* const lines[] = {
+        "sharpness < 30 for=60 name=\"Низкая резкость\"",
+        "overexposed > 20 for=30 name=\"Пересвет\"",
+        "frozen for=10 severity=critical name=\"Поток застыл\"",
+        "overall < 40 for=60 name=\"Низкая оценка\"",
+        "stale > 30 severity=critical name=\"Нет данных\"",
+    };
+    for (const char* line : lines) {
+        Rule rule;
+        if (parseRule(QString::fromUtf8(line), rule)) {
+            rules.append(rule);
+        }
+    }
+    return rules;
+}
+
+void AlertEngine::addCamera(const QString& cameraKey, qint64 timestampMs)
+{
+    if (!m_cameras.contains(cameraKey)) {
+        m_cameras[cameraKey].lastResultMs = timestampMs;
+    }
+}
+
+void AlertEngine::evaluate(const QString& cameraKey, qint64 timestampMs,
+                           const ImageQualityAnalyzer::QualityResult& result)
+{
+    // Невалидный результат не обновляет камеру: для правил она молчит
+    if (!result.isValid) {
+        return;
+    }
+
+    CameraState& camera = m_cameras[cameraKey];
+    camera.lastResult = result;
+    camera.hasResult = true;
+    camera.lastResultMs = timestampMs;
+    evaluateCamera(cameraKey, camera, timestampMs);
+}
+
+void AlertEngine::tick(qint64 nowMs)
+{
+    for (auto it = m_cameras.begin(); it != m_cameras.end(); ++it) {
+        evaluateCamera(it.key(), it.value(), nowMs);
+    }
+}
+
+void AlertEngine::evaluateCamera(const QString& cameraKey, CameraState& camera, qint64 timestampMs)
+{
+    for (int ruleIndex : m_globalRules) {
+        evaluateRule(ruleIndex, camera, cameraKey, timestampMs);
+    }
+    auto cameraRules = m_cameraRules.constFind(cameraKey);
+    if (cameraRules != m_cameraRules.constEnd()) {
+        for (int ruleIndex : cameraRules.value()) {
+            evaluateRule(ruleIndex, camera, cameraKey, timestampMs);
+        }
+    }
+}
+
+void AlertEngine::evaluateRule(int ruleIndex, CameraState& camera, const QString& cameraKey,
+                               qint64 timestampMs)
+{
+    const Rule& rule = m_rules[ruleIndex];
+    // До первого результата известна только его давность
+    if (!camera.hasResult && rule.metric != Metric::Stale) {
+        return;
+    }
+    RuleState& state = camera.rules[ruleIndex];
+    double value = metricValue(rule.metric, camera, timestampMs);
+    bool violated = rule.below ? value < rule.threshold : value > rule.threshold;
+    bool recovered = rule.below ? value >= rule.clearThreshold : value <= rule.clearThreshold;
+
+    switch (state.state) {
+    case State::Normal:
+        if (violated) {
+            state.state = State::Pending;
+            state.sinceMs = timestampMs;
+        }
+        break;
+    case State::Pending:
+        if (!violated) {
+            state.state = State::Normal;
+        }
+        break;
+    case State::Firing:
+        if (recovered) {
+            state.state = State::Clearing;
+            state.sinceMs = timestampMs;
+        }
+        break;
+    case State::Clearing:
+        if (!recovered) {
+            state.state = State::Firing;
+        }
+        break;
+    }
+
+    // Переходы по времени проверяются и на результате, начавшем ожидание (for=0)
+    if (state.state == State::Pending && timestampMs - state.sinceMs >= rule.forMs) {
+        state.state = State::Firing;
+        state.alert.ruleName = rule.name;
+        state.alert.cameraKey = cameraKey;
+        state.alert.severity = rule.severity;
+        state.alert.value = value;
+        state.alert.sinceMs = state.sinceMs;
+        state.alert.raisedMs = timestampMs;
+        camera.activeAlerts++;
+        qWarning() << "Alert raised:" << rule.name << "camera" << cameraKey << "value" << value;
+        emit alertRaised(state.alert);
+    } else if (state.state == State::Clearing && timestampMs - state.sinceMs >= rule.clearForMs) {
+        state.state = State::Normal;
+        state.alert.value = value;
+        camera.activeAlerts--;
+        qInfo() << "Alert cleared:" << rule.name << "camera" << cameraKey << "value" << value;
+        emit alertCleared(state.alert);
+    }
+}
+
+void AlertEngine::removeCamera(const QString& cameraKey)
+{
+    CameraState camera = m_cameras.take(cameraKey);
+    for (const RuleState& state : camera.rules) {
+        if (state.state == State::Firing || state.state == State::Clearing) {
+            emit alertCleared(state.alert);
+        }
+    }
+}
+
+QList<AlertEngine::Alert> AlertEngine::activeAlerts() const
+{
+    QList<Alert> alerts;
+    for (auto cameraIt = m_cameras.constBegin(); cameraIt != m_cameras.constEnd(); ++cameraIt) {
+        for (const RuleState& state : cameraIt->rules) {
+            if (state.state == State::Firing || state.state == State::Clearing) {
+                alerts.append(state.alert);
+            }
+        }
+    }
+    return alerts;
+}
+
+int AlertEngine::activeAlertCount(const QString& cameraKey) const
+{
+    auto it = m_cameras.constFind(cameraKey);
+    return it != m_cameras.constEnd() ? it->activeAlerts : 0;
+}
+
+double AlertEngine::metricValue(Metric metric, const CameraState& camera, qint64 timestampMs)
+{
+    const ImageQualityAnalyzer::QualityResult& result = camera.lastResult;
+    switch (metric) {
+    case Metric::Overall:      return result.overallScore;
+    case Metric::Noise:        return result.noiseScore;
+    case Metric::Contrast:     return result.contrastScore;
+    case Metric::Sharpness:    return result.sharpnessScore;
+    case Metric::Overexposed:  return result.overexposedPercent;
+    case Metric::Underexposed: return result.underexposedPercent;
+    case Metric::Blockiness:   return result.blockinessScore;
+    case Metric::Focus:        return result.frequencyBlurScore;
+    case Metric::ColorCast:    return result.colorCast;
+    case Metric::PacketLoss:   return result.packetLossPercent;
+    case Metric::Frozen:       return result.isFrozen ? 1.0 : 0.0;
+    case Metric::Stale:        return qMax<qint64>(0, timestampMs - camera.lastResultMs) / 1000.0;
+    }
+    return 0.0;
+}
+
+QString AlertEngine::metricName(Metric metric)
+{
+    for (const MetricName& entry : METRIC_NAMES) {
+        if (entry.metric == metric) {
+            return QString(entry.name);
+        }
+    }
+    return QString();
+}
+
+bool AlertEngine::parseMetric(const QString& name, Metric& metric)
+{
+    for (const MetricName& entry : METRIC_NAMES) {
+        if (name == entry.name) {
+            metric = entry.metric;
+            return true;
+        }
+    }
+    return false;
+}
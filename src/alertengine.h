@@ -0,0 +1,193 @@
+#ifndef ALERTENGINE_H
+#define ALERTENGINE_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include "imagequalityanalyzer.h"
+
+/**
+ * @class AlertEngine
+ * @brief Правила оповещений, проверяемые по потоку результатов анализа
+ *
+ * Правило - условие на метрику камеры, которое должно держаться заданное
+ * время («резкость < 30 в течение 60 с»). Состояние каждой пары
+ * правило+камера обновляется инкрементально при поступлении результата:
+ * - условие выполняется forMs подряд - оповещение поднимается один раз
+ *   (повторные результаты его не дублируют);
+ * - оповещение снимается, когда метрика clearForMs подряд находится по другую
+ *   сторону порога снятия (гистерезис: порог снятия отстоит от порога
+ *   срабатывания, поэтому колебания около порога не дают серию оповещений).
+ *
+ * Правила индексируются по камере: результат проверяет только правила своей
+ * камеры и общие правила, а не весь список.
+ *
+ * Камера, переставшая присылать результаты, иначе так и осталась бы в
+ * последнем состоянии. Поэтому раз в TICK_INTERVAL_MS правила всех камер
+ * проверяются ещё раз по последнему результату (tick()): ожидание for и
+ * clear_for истекает вовремя, а метрика stale - секунды без валидного
+ * результата - растёт и у камеры, не приславшей ни одного.
+ *
+ * Формат файла правил - одно правило на строку:
+ * @code
+ * # метрика оператор порог [параметры]
+ * sharpness < 30 for=60 clear=40 name="Расфокус"
+ * overexposed > 20 for=30 severity=critical
+ * frozen for=10
+ * overall < 40 for=120 camera=rtsp://192.168.1.10/stream
+ * @endcode
+ * Параметры: for и clear_for - секунды, clear - порог снятия (по умолчанию
+ * отстоит от порога на HYSTERESIS_MARGIN), camera - только для этой камеры,
+ * name - имя в сообщениях, severity - warning или critical.
+ *
+ * Объект не потокобезопасен: используется из потока GUI.
+ */
+class AlertEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Metric {
+        Overall,
+        Noise,
+        Contrast,
+        Sharpness,
+        Overexposed,
+        Underexposed,
+        Blockiness,
+        Focus,
+        ColorCast,
+        PacketLoss,
+        Frozen,         // 1 - поток застыл, 0 - нет
+        Stale           // Секунд без валидного результата
+    };
+
+    struct Rule {
+        QString name;
+        QString cameraKey;        // Пусто - все камеры
+        Metric metric;
+        bool below;               // true: срабатывает при значении < threshold
+        double threshold;
+        double clearThreshold;
+        qint64 forMs;             // Сколько условие должно держаться
+        qint64 clearForMs;        // Сколько должно держаться условие снятия
+        QString severity;
+
+        Rule() : metric(Metric::Overall), below(true), threshold(0), clearThreshold(0),
+                 forMs(0), clearForMs(0), severity("warning") {}
+    };
+
+    struct Alert {
+        QString ruleName;
+        QString cameraKey;
+        QString severity;
+        double value = 0;         // Значение метрики на момент события
+        qint64 sinceMs = 0;       // Начало нарушения
+        qint64 raisedMs = 0;      // Время подъёма оповещения
+    };
+
+    explicit AlertEngine(QObject *parent = nullptr);
+
+    void addRule(const Rule& rule);
+    void clearRules();
+    QList<Rule> rules() const;
+
+    /**
+     * @brief Загружает правила из файла (формат см. описание класса)
+     * @return Число загруженных правил; строки с ошибками пропускаются.
+     *         Файл без единого правила - ошибка (errorText заполняется)
+     */
+    int loadRules(const QString& path, QString* errorText = nullptr);
+
+    /**
+     * @brief Разбирает одну строку файла правил
+     * @return false для пустых строк, комментариев и строк с ошибкой
+     */
+    static bool parseRule(const QString& line, Rule& rule, QString* errorText = nullptr);
+
+    /**
+     * @brief Правила по умолчанию: расфокус, пересвет, застывший поток, низкая оценка
+     */
+    static QList<Rule> defaultRules();
+
+    /**
+     * @brief Начинает отсчёт stale для камеры, ещё не приславшей результатов
+     */
+    void addCamera(const QString& cameraKey, qint64 timestampMs);
+
+    /**
+     * @brief Обновляет состояние правил камеры по новому результату
+     * @param timestampMs Время получения результата
+     */
+    void evaluate(const QString& cameraKey, qint64 timestampMs,
+                  const ImageQualityAnalyzer::QualityResult& result);
+
+    /**
+     * @brief Проверяет правила всех камер по их последним результатам
+     *
+     * Вызывается внутренним таймером; открыт для проверок с заданным временем.
+     */
+    void tick(qint64 nowMs);
+
+    /**
+     * @brief Забывает состояние камеры; активные оповещения снимаются
+     */
+    void removeCamera(const QString& cameraKey);
+
+    QList<Alert> activeAlerts() const;
+
+    /**
+     * @brief Число активных оповещений камеры, O(1)
+     */
+    int activeAlertCount(const QString& cameraKey) const;
+
+    static QString metricName(Metric metric);
+    static bool parseMetric(const QString& name, Metric& metric);
+
+signals:
+    void alertRaised(const AlertEngine::Alert& alert);
+    void alertCleared(const AlertEngine::Alert& alert);
+
+private:
+    enum class State {
+        Normal,
+        Pending,        // Условие выполняется, ждём forMs
+        Firing,
+        Clearing        // Оповещение поднято, ждём clearForMs условия снятия
+    };
+
+    struct RuleState {
+        State state = State::Normal;
+        qint64 sinceMs = 0;       // Начало текущего состояния ожидания
+        Alert alert;
+    };
+
+    struct CameraState {
+        QHash<int, RuleState> rules;                  // Правило -> состояние
+        ImageQualityAnalyzer::QualityResult lastResult;
+        bool hasResult = false;
+        qint64 lastResultMs = 0;
+        int activeAlerts = 0;                         // Правила в Firing или Clearing
+    };
+
+    void evaluateCamera(const QString& cameraKey, CameraState& camera, qint64 timestampMs);
+    void evaluateRule(int ruleIndex, CameraState& camera, const QString& cameraKey, qint64 timestampMs);
+    static double metricValue(Metric metric, const CameraState& camera, qint64 timestampMs);
+
+    QVector<Rule> m_rules;
+    QVector<int> m_globalRules;                       // Правила для всех камер
+    QHash<QString, QVector<int>> m_cameraRules;       // Правила отдельных камер
+    QHash<QString, CameraState> m_cameras;
+    QTimer* m_tickTimer;
+
+    static constexpr double HYSTERESIS_MARGIN = 5.0;       // Для метрик в шкале 0-100
+    static constexpr qint64 DEFAULT_CLEAR_FOR_MS = 10000;
+    static constexpr int TICK_INTERVAL_MS = 1000;
+};
+
+Q_DECLARE_METATYPE(AlertEngine::Alert)
+
+#endif // ALERTENGINE_H
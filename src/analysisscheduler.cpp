@@ -0,0 +1,165 @@
+#include "analysisscheduler.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+
+AnalysisScheduler::AnalysisScheduler(double cpuBudget, QObject *parent)
+    : QObject(parent)
+    , m_cpuBudget(std::max(0.01, std::min(1.0, cpuBudget)))
+    , m_rebalanceTimer(nullptr)
+{
+    m_rebalanceTimer = new QTimer(this);
+    connect(m_rebalanceTimer, &QTimer::timeout, this, &AnalysisScheduler::rebalance);
+    m_rebalanceTimer->start(REBALANCE_INTERVAL_MS);
+}
+
+AnalysisScheduler::~AnalysisScheduler()
+{
+}
+
+std::shared_ptr<AnalysisScheduler::CameraEntry> AnalysisScheduler::registerCamera(const QString& name, double frameRate)
+{
+    auto entry = std::make_shared<CameraEntry>(name, frameRate > 0.0 ? frameRate : DEFAULT_FRAME_RATE,
+                                               INITIAL_INTERVAL);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_entries.push_back(entry);
+    }
+
+    // Новая камера получает долю бюджета, не дожидаясь очередного такта
+    QMetaObject::invokeMethod(this, "rebalance", Qt::QueuedConnection);
+    return entry;
+}
+
+void AnalysisScheduler::unregisterCamera(const std::shared_ptr<CameraEntry>& entry)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_entries.erase(std::remove(m_entries.begin(), m_entries.end(), entry), m_entries.end());
+    }
+    QMetaObject::invokeMethod(this, "rebalance", Qt::QueuedConnection);
+}
+
+void AnalysisScheduler::reportAnalysis(const std::shared_ptr<CameraEntry>& entry, double costMs, double score)
+{
+    if (!entry) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    CameraEntry& camera = *entry;
+    camera.costMs = camera.costMs > 0.0 ? (1.0 - SMOOTHING) * camera.costMs + SMOOTHING * costMs : costMs;
+
+    if (camera.lastScore >= 0.0) {
+        double delta = score - camera.lastScore;
+        camera.volatility = (1.0 - SMOOTHING) * camera.volatility + SMOOTHING * std::fabs(delta);
+        camera.trend = (1.0 - SMOOTHING) * camera.trend + SMOOTHING * delta;
+        camera.stableStreak = std::fabs(delta) < STABLE_DELTA ? camera.stableStreak + 1 : 0;
+    }
+    camera.lastScore = score;
+}
+
+QMap<QString, double> AnalysisScheduler::assignedRates() const
+{
+    QMutexLocker locker(&m_mutex);
+    QMap<QString, double> rates;
+    for (const auto& entry : m_entries) {
+        rates[entry->name] = entry->assignedRateHz;
+    }
+    return rates;
+}
+
+double AnalysisScheduler::cpuBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cpuBudget;
+}
+
+void AnalysisScheduler::setCpuBudget(double cpuBudget)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cpuBudget = std::max(0.01, std::min(1.0, cpuBudget));
+    }
+    QMetaObject::invokeMethod(this, "rebalance", Qt::QueuedConnection);
+}
+
+double AnalysisScheduler::priorityOf(const CameraEntry& entry) const
+{
+    // Ухудшение и колебания оценки повышают приоритет, длительная
+    // стабильность постепенно снижает его (до MIN_STABLE_FACTOR)
+    double stableFactor = std::max(MIN_STABLE_FACTOR,
+        1.0 / (1.0 + static_cast<double>(entry.stableStreak) / STABLE_BACKOFF_STREAK));
+    double urgency = 1.0 + VOLATILITY_WEIGHT * entry.volatility +
+                     DEGRADATION_WEIGHT * std::max(0.0, -entry.trend);
+    return urgency * stableFactor;
+}
+
+void AnalysisScheduler::rebalance()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_entries.empty()) {
+        return;
+    }
+
+    // Бюджет: миллисекунд анализа в секунду на все камеры
+    double remaining = m_cpuBudget * std::max(1, QThread::idealThreadCount()) * 1000.0;
+
+    const size_t count = m_entries.size();
+    std::vector<double> weight(count), cost(count), maxRate(count), rate(count);
+    std::vector<bool> saturated(count, false);
+
+    // Каждой камере гарантируется минимальная частота; если даже её не хватает,
+    // бюджет превышается, но ни одна камера не остаётся без анализа
+    for (size_t i = 0; i < count; ++i) {
+        const CameraEntry& entry = *m_entries[i];
+        weight[i] = priorityOf(entry);
+        cost[i] = entry.costMs > 0.0 ? entry.costMs : DEFAULT_COST_MS;
+        maxRate[i] = entry.frameRate;
+        rate[i] = std::min(MIN_ANALYSIS_RATE_HZ, maxRate[i]);
+        remaining -= rate[i] * cost[i];
+    }
+
+    // Остаток делится пропорционально приоритету. Камеры, упёршиеся в свою
+    // частоту кадров, выбывают, а их неизрасходованная доля делится заново.
+    for (size_t pass = 0; pass < count && remaining > 0.0; ++pass) {
+        double weightedCost = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!saturated[i]) {
+                weightedCost += weight[i] * cost[i];
+            }
+        }
+        if (weightedCost <= 0.0) {
+            break;
+        }
+
+        double ratePerWeight = remaining / weightedCost;
+        bool anySaturated = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (!saturated[i] && rate[i] + ratePerWeight * weight[i] >= maxRate[i]) {
+                remaining -= (maxRate[i] - rate[i]) * cost[i];
+                rate[i] = maxRate[i];
+                saturated[i] = true;
+                anySaturated = true;
+            }
+        }
+
+        if (!anySaturated) {
+            for (size_t i = 0; i < count; ++i) {
+                if (!saturated[i]) {
+                    rate[i] += ratePerWeight * weight[i];
+                }
+            }
+            remaining = 0.0;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        CameraEntry& entry = *m_entries[i];
+        int interval = std::max(1, static_cast<int>(std::ceil(maxRate[i] / rate[i] - 1e-9)));
+        entry.analysisInterval.store(interval, std::memory_order_relaxed);
+        entry.assignedRateHz = maxRate[i] / interval;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef ANALYSISSCHEDULER_H
+#define ANALYSISSCHEDULER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QMap>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @class AnalysisScheduler
+ * @brief Центральный планировщик частоты анализа качества по бюджету CPU
+ *
+ * Каждая камера регистрируется в планировщике и сообщает о стоимости и
+ * результате каждого анализа. Раз в секунду планировщик распределяет общий
+ * бюджет (доля всех ядер) между камерами пропорционально приоритету:
+ * камеры с ухудшающейся или нестабильной оценкой анализируются чаще,
+ * стабильные - реже. Результат - интервал анализа в кадрах, который
+ * CameraWorker читает без блокировок на каждом кадре.
+ *
+ * Методы потокобезопасны: регистрация и отчёты приходят из потоков камер,
+ * перераспределение выполняется в потоке планировщика.
+ */
+class AnalysisScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Состояние одной камеры в планировщике
+     */
+    struct CameraEntry {
+        QString name;
+        double frameRate;                     // Частота кадров камеры
+        std::atomic<int> analysisInterval;    // Анализировать каждый N-й кадр
+
+        // Поля ниже защищены мьютексом планировщика
+        double costMs;                        // Сглаженная стоимость анализа
+        double lastScore;                     // Последняя общая оценка (-1 = нет)
+        double volatility;                    // Сглаженный |Δ оценки|
+        double trend;                         // Сглаженный Δ оценки (<0 - ухудшение)
+        int stableStreak;                     // Подряд идущие анализы без изменений
+        double assignedRateHz;                // Назначенная частота анализа
+
+        CameraEntry(const QString& cameraName, double fps, int interval)
+            : name(cameraName), frameRate(fps), analysisInterval(interval),
+              costMs(0), lastScore(-1), volatility(0), trend(0),
+              stableStreak(0), assignedRateHz(0) {}
+    };
+
+    /**
+     * @param cpuBudget Доля всех ядер для анализа качества (0.0-1.0)
+     */
+    explicit AnalysisScheduler(double cpuBudget, QObject *parent = nullptr);
+    ~AnalysisScheduler();
+
+    /**
+     * @brief Регистрирует камеру
+     * @param name Имя для статистики (обычно URL)
+     * @param frameRate Частота кадров камеры (0 - неизвестна)
+     */
+    std::shared_ptr<CameraEntry> registerCamera(const QString& name, double frameRate);
+
+    void unregisterCamera(const std::shared_ptr<CameraEntry>& entry);
+
+    /**
+     * @brief Сообщает о выполненном анализе
+     * @param costMs Процессорное время анализа во всех потоках, мс (не длительность:
+     *        бюджет задан в ядрах, а анализ кадра может занимать несколько ядер)
+     * @param score Общая оценка качества
+     */
+    void reportAnalysis(const std::shared_ptr<CameraEntry>& entry, double costMs, double score);
+
+    /**
+     * @brief Назначенные частоты анализа по камерам, Гц
+     */
+    QMap<QString, double> assignedRates() const;
+
+    double cpuBudget() const;
+    void setCpuBudget(double cpuBudget);
+
+public slots:
+    /**
+     * @brief Перераспределяет бюджет между камерами
+     */
+    void rebalance();
+
+private:
+    double priorityOf(const CameraEntry& entry) const;
+
+    mutable QMutex m_mutex;
+    std::vector<std::shared_ptr<CameraEntry>> m_entries;
+    double m_cpuBudget;                        // Защищён m_mutex
+    QTimer* m_rebalanceTimer;
+
+    const int REBALANCE_INTERVAL_MS = 1000;
+    const int INITIAL_INTERVAL = 10;           // До первого перераспределения
+    const double DEFAULT_FRAME_RATE = 30.0;
+    const double DEFAULT_COST_MS = 10.0;       // До первого замера
+    const double MIN_ANALYSIS_RATE_HZ = 0.2;   // Не реже раза в 5 секунд
+    const double SMOOTHING = 0.2;              // Коэффициент EWMA
+    const double VOLATILITY_WEIGHT = 0.5;      // Вес нестабильности (на балл оценки)
+    const double DEGRADATION_WEIGHT = 1.0;     // Вес ухудшения (на балл оценки)
+    const double STABLE_DELTA = 1.0;           // |Δ оценки| ниже - кадр "стабилен"
+    const int STABLE_BACKOFF_STREAK = 10;      // Анализов до двукратного снижения приоритета
+    const double MIN_STABLE_FACTOR = 0.25;
+};
+
+#endif // ANALYSISSCHEDULER_H
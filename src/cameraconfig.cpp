@@ -0,0 +1,85 @@
+#include "cameraconfig.h"
+#include "framesource.h"
+#include <QDebug>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+
+QList<CameraConfig::Entry> CameraConfig::load(const QString& path, QString* errorText)
+{
+    QList<Entry> entries;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorText) {
+            *errorText = QString("Не удалось открыть %1: %2").arg(path, file.errorString());
+        }
+        return entries;
+    }
+
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine();
+        lineNumber++;
+
+        Entry entry;
+        QString lineError;
+        if (parseLine(line, entry, &lineError)) {
+            entry.line = lineNumber;
+            entries.append(entry);
+        } else if (!lineError.isEmpty()) {
+            qWarning() << "Camera config" << path << "line" << lineNumber << ":" << lineError;
+        }
+    }
+
+    qInfo() << "Loaded" << entries.size() << "cameras from" << path;
+    return entries;
+}
+
+bool CameraConfig::parseLine(const QString& line, Entry& entry, QString* errorText)
+{
+    QString trimmed = line.trimmed();
+    if (trimmed.isEmpty() || trimmed.startsWith('#')) {
+        return false;
+    }
+
+    // URL, затем ключ=значение или ключ="значение с пробелами"
+    static const QRegularExpression tokenPattern("(\\S+?)=(\"[^\"]*\"|\\S+)");
+
+    int urlEnd = trimmed.indexOf(QRegularExpression("\\s"));
+    entry.url = urlEnd < 0 ? trimmed : trimmed.left(urlEnd);
+    if (!FrameSource::isSupportedUrl(entry.url)) {
+        if (errorText) {
+            *errorText = "неподдерживаемый URL " + entry.url;
+        }
+        return false;
+    }
+
+    QString options = urlEnd < 0 ? QString() : trimmed.mid(urlEnd);
+    auto it = tokenPattern.globalMatch(options);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        QString key = match.captured(1);
+        QString value = match.captured(2);
+        if (value.startsWith('"')) {
+            value = value.mid(1, value.length() - 2);
+        }
+
+        if (key == "name") {
+            entry.name = value;
+        } else if (key == "sub") {
+            if (!FrameSource::isSupportedUrl(value)) {
+                if (errorText) {
+                    *errorText = "неподдерживаемый URL подпотока " + value;
+                }
+                return false;
+            }
+            entry.subUrl = value;
+        } else {
+            qWarning() << "Camera config: unknown option" << key << "for" << entry.url;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef CAMERACONFIG_H
+#define CAMERACONFIG_H
+
+#include <QList>
+#include <QString>
+
+/**
+ * @class CameraConfig
+ * @brief Список камер, загружаемый при запуске (--config)
+ *
+ * Формат файла - одна камера на строку:
+ * @code
+ * # Комментарий
+ * rtsp://192.168.1.10:554/stream1  name=Вход
+ * rtsp://192.168.1.11:554/stream1
+ * rtsp://192.168.1.12:554/main     sub=rtsp://192.168.1.12:554/sub name=Склад
+ * synthetic://test?noise=10        name=Тест
+ * @endcode
+ *
+ * После URL через пробел могут идти параметры вида ключ=значение;
+ * значения с пробелами заключаются в кавычки. Неизвестные ключи
+ * игнорируются с предупреждением. Параметры:
+ * - name - подпись вкладки;
+ * - sub - подпоток низкого разрешения той же камеры: анализ идёт по нему,
+ *   а основной поток открывается по требованию (см. CameraWorker::setSubStreamUrl).
+ */
+class CameraConfig
+{
+public:
+    struct Entry {
+        QString url;
+        QString name;       // Подпись вкладки; пусто - URL
+        QString subUrl;     // Подпоток для анализа; пусто - анализ по url
+        int line;           // Номер строки в файле (для сообщений)
+
+        Entry() : line(0) {}
+    };
+
+    /**
+     * @brief Читает список камер из файла
+     * @param errorText Описание ошибки, если файл не удалось прочитать
+     * @return Камеры в порядке файла; строки с ошибками пропускаются
+     */
+    static QList<Entry> load(const QString& path, QString* errorText = nullptr);
+
+    /**
+     * @brief Разбирает одну строку файла
+     * @return false для пустых строк, комментариев и строк с ошибкой
+     */
+    static bool parseLine(const QString& line, Entry& entry, QString* errorText = nullptr);
+};
+
+#endif // CAMERACONFIG_H
@@ -1,22 +1,152 @@
 #include "cameraworker.h"
+#include "affinitypolicy.h"
+#include "memorybudget.h"
 #include <QDebug>
 #include <QThread>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Копирует UTF-8 с завершающим нулём, не разрезая многобайтовый символ
+void copyUtf8(char* destination, int size, const QString& text)
+{
+    QByteArray utf8 = text.toUtf8();
+    int length = qMin(utf8.size(), size - 1);
+    // Первый не поместившийся байт - продолжение символа: символ отбрасывается целиком
+    while (length > 0 && length < utf8.size() && (static_cast<uchar>(utf8[length]) & 0xC0) == 0x80) {
+        --length;
+    }
+    std::memcpy(destination, utf8.constData(), static_cast<size_t>(length));
+    destination[length] = '\0';
+}
+
+} // namespace
 
 CameraWorker::CameraWorker(const QString& rtspUrl, QObject *parent)
     : QObject(parent)
     , m_rtspUrl(rtspUrl)
     , m_frameTimer(nullptr)
     , m_qualityAnalyzer(nullptr)
+    , m_statePublisher(std::make_shared<StatePublisher>())
+    , m_publishedState()
     , m_reconnectAttempts(0)
     , m_frameSkipCounter(0)
+    , m_referenceRequested(false)
+    , m_frameIntervalMs(-1)
+    , m_scheduler(nullptr)
+    , m_captureIsolation(false)
+    , m_captureProcess(nullptr)
+    , m_openTimeoutMs(DEFAULT_OPEN_TIMEOUT_MS)
+    , m_keyframeGopInterval(0)
+    , m_keyframeActive(false)
+    , m_snapshotCache(nullptr)
+    , m_startRetryTimer(nullptr)
+    , m_startRetryDelayMs(1000)
+    , m_affinityNode(-1)
+    , m_lowMemory(false)
+    , m_mainAnalyzer(nullptr)
+    , m_mainViewed(false)
+    , m_confirmationPending(false)
+    , m_confirmationThreshold(0.0)
+    , m_lastDropConfirmed(false)
+    , m_scoreBaseline(-1.0)
+    , m_mainIdleTimer(nullptr)
+    , m_mainFrameTimer(nullptr)
+    , m_mainIdleTimeoutMs(DEFAULT_MAIN_STREAM_IDLE_MS)
+    , m_recordingActive(false)
 {
     m_frameTimer = new QTimer(this);
     connect(m_frameTimer, &QTimer::timeout, this, &CameraWorker::processFrame, Qt::QueuedConnection);
+
+    m_startRetryTimer = new QTimer(this);
+    m_startRetryTimer->setSingleShot(true);
+    connect(m_startRetryTimer, &QTimer::timeout, this, &CameraWorker::startCapture);
+
+    m_mainIdleTimer = new QTimer(this);
+    m_mainIdleTimer->setSingleShot(true);
+    connect(m_mainIdleTimer, &QTimer::timeout, this, [this]() {
+        if (!m_mainViewed && !m_confirmationPending) {
+            closeMainStream();
+        }
+    });
+
+    m_mainFrameTimer = new QTimer(this);
+    connect(m_mainFrameTimer, &QTimer::timeout, this, &CameraWorker::processMainFrame);
+}
+
+QSemaphore CameraWorker::s_connectSlots(CameraWorker::DEFAULT_MAX_PARALLEL_CONNECTS);
+int CameraWorker::s_maxParallelConnects = CameraWorker::DEFAULT_MAX_PARALLEL_CONNECTS;
+
+void CameraWorker::setMaxParallelConnects(int count)
+{
+    count = qMax(1, count);
+    if (count > s_maxParallelConnects) {
+        s_connectSlots.release(count - s_maxParallelConnects);
+    } else if (count < s_maxParallelConnects) {
+        s_connectSlots.acquire(s_maxParallelConnects - count);
+    }
+    s_maxParallelConnects = count;
+}
+
+void CameraWorker::setOpenTimeout(int timeoutMs)
+{
+    m_openTimeoutMs = timeoutMs;
+}
+
+void CameraWorker::setKeyframeInterval(int gopInterval)
+{
+    m_keyframeGopInterval = qMax(0, gopInterval);
+}
+
+void CameraWorker::setSnapshotCache(SnapshotCache* cache)
+{
+    m_snapshotCache = cache;
+}
+
+void CameraWorker::setSubStreamUrl(const QString& url)
+{
+    m_subStreamUrl = url;
+}
+
+void CameraWorker::setMainStreamIdleTimeout(int timeoutMs)
+{
+    m_mainIdleTimeoutMs = qMax(0, timeoutMs);
+}
+
+void CameraWorker::setRecordingConfig(const RecordingConfig& config)
+{
+    m_recordingConfig = config;
 }
 
 CameraWorker::~CameraWorker()
 {
     stopCapture();
+    AffinityPolicy::instance().releaseNode(m_affinityNode);
+}
+
+void CameraWorker::setFrameInterval(int intervalMs)
+{
+    m_frameIntervalMs = intervalMs;
+}
+
+void CameraWorker::setAnalysisScheduler(AnalysisScheduler* scheduler)
+{
+    m_scheduler = scheduler;
+}
+
+void CameraWorker::setCaptureIsolation(bool enabled)
+{
+    // shm:// уже читает чужой процесс захвата
+    m_captureIsolation = enabled && !m_rtspUrl.startsWith("shm://", Qt::CaseInsensitive);
 }
 
 void CameraWorker::startCapture()
@@ -26,11 +156,33 @@ void CameraWorker::startCapture()
         return;
     }
 
+    // Поток закрепляется до открытия источника: потоки декодера FFmpeg и
+    // процесс захвата наследуют привязку к ядрам и памяти узла
+    if (m_affinityNode < 0) {
+        AffinityPolicy& policy = AffinityPolicy::instance();
+        m_affinityNode = policy.acquireNode();
+        if (m_affinityNode >= 0 && !policy.bindCurrentThread(m_affinityNode)) {
+            policy.releaseNode(m_affinityNode);
+            m_affinityNode = -1;
+        }
+        m_stats.numaNode = policy.osNode(m_affinityNode);
+    }
+
     if (!initializeCapture()) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return;
+        }
+        // Камера из списка могла быть ещё не включена: повторяем с растущим
+        // интервалом, не блокируя остальные камеры
         emit errorOccurred("Failed to initialize RTSP connection: " + m_rtspUrl);
+        emit connectionStatusChanged(false, QString("Нет подключения, повтор через %1 с")
+                                                .arg(m_startRetryDelayMs / 1000));
+        m_startRetryTimer->start(m_startRetryDelayMs);
+        m_startRetryDelayMs = qMin(m_startRetryDelayMs * 2, MAX_START_RETRY_DELAY_MS);
         return;
     }
 
+    m_startRetryDelayMs = 1000;
     m_capturing.store(true);
     m_connected.store(true);
     m_reconnectAttempts = 0;
@@ -38,48 +190,127 @@ void CameraWorker::startCapture()
     // Создаем анализатор качества при запуске
     if (!m_qualityAnalyzer) {
         m_qualityAnalyzer = new ImageQualityAnalyzer(this);
+        loadReferenceFrame();
+    }
+    m_qualityAnalyzer->setKeyframeMode(m_keyframeActive);
+    m_lowMemory = MemoryBudget::instance().isActive();
+    m_qualityAnalyzer->setLowMemoryMode(m_lowMemory);
+
+    // Файлы и синтетические источники воспроизводятся со своей частотой кадров
+    int interval = m_frameIntervalMs;
+    if (interval < 0) {
+        double fps = m_source->frameRate();
+        interval = fps > 0.0 ? static_cast<int>(std::lround(1000.0 / fps)) : FRAME_INTERVAL_MS;
     }
+    m_frameTimer->start(interval);
 
-    m_frameTimer->start(FRAME_INTERVAL_MS);
+    if (m_scheduler && !m_schedulerEntry) {
+        double frameRate = interval > 0 ? 1000.0 / interval : 0.0;
+        m_schedulerEntry = m_scheduler->registerCamera(m_rtspUrl, frameRate);
+    }
+    if (m_mainViewed) {
+        openMainStream();
+    }
+    publishState();
     emit connectionStatusChanged(true, "Подключено к " + m_rtspUrl);
     qInfo() << "Запускаю видеопоток" << m_rtspUrl;
 }
 
 void CameraWorker::stopCapture()
 {
+    m_startRetryTimer->stop();
     if (!m_capturing.load()) {
         return;
     }
 
     m_frameTimer->stop();
+    if (m_scheduler && m_schedulerEntry) {
+        m_scheduler->unregisterCamera(m_schedulerEntry);
+        m_schedulerEntry.reset();
+    }
     m_capturing.store(false);
     m_connected.store(false);
+    closeMainStream();
     cleanupCapture();
+    stopCaptureProcess();
+    publishState();
 
     emit connectionStatusChanged(false, "Отключено от " + m_rtspUrl);
     qInfo() << "Останавливаю видеопоток" << m_rtspUrl;
+    if (m_stats.numaNode >= 0) {
+        qInfo() << "NUMA node" << m_stats.numaNode << "frames local:" << m_stats.framesNodeLocal
+                << "remote:" << m_stats.framesNodeRemote << "for" << m_rtspUrl;
+    }
 }
 
 bool CameraWorker::initializeCapture()
 {
-    m_videoCapture.open(m_rtspUrl.toStdString(), cv::CAP_FFMPEG);
-    
-    if (!m_videoCapture.isOpened()) {
+    if (m_captureIsolation && !ensureCaptureProcess()) {
+        return false;
+    }
+
+    if (!m_source) {
+        m_source = FrameSource::create(m_captureIsolation ? "shm://" + sharedRingName() : analysisUrl());
+        if (!m_source) {
+            qWarning() << "Неподдерживаемый URL источника:" << m_rtspUrl;
+            return false;
+        }
+        m_source->setOpenTimeout(m_openTimeoutMs);
+
+        // При вынесенном захвате пакеты отбрасывает процесс захвата, но только
+        // если он декодирует через FFmpeg (--keyframe-interval уходит лишь туда)
+        bool keyframeSupported = m_source->setKeyframeOnly(m_keyframeGopInterval);
+        bool isolatedKeyframes = m_captureIsolation
+            && FrameSource::backendConfig().backend != FrameSource::CaptureBackend::OpenCV;
+        m_keyframeActive = m_keyframeGopInterval > 0 && (keyframeSupported || isolatedKeyframes);
+        if (m_keyframeGopInterval > 0 && !m_keyframeActive) {
+            qWarning() << "Keyframe-only mode requires the FFmpeg capture backend, decoding all frames of"
+                       << m_rtspUrl;
+        }
+
+        if (!m_recordingConfig.directory.isEmpty() && m_recordingConfig.preEventSec > 0) {
+            m_recordingActive = m_source->setPreEventBuffer(m_recordingConfig.preEventSec * 1000,
+                                                            m_recordingConfig.maxBytes);
+            if (!m_recordingActive) {
+                qWarning() << "Pre-event recording requires the FFmpeg or ingest capture backend"
+                           << "without --isolate-capture, disabled for" << m_rtspUrl;
+            }
+        }
+        if (m_stats.memoryBackoff == 0) {
+            m_source->setMemoryShedding(true);
+        }
+    }
+
+    if (!acquireConnectSlot()) {
+        return false;
+    }
+    bool opened = m_source->open();
+    s_connectSlots.release();
+
+    if (!opened) {
         qWarning() << "Не могу открыть RTSP поток:" << m_rtspUrl;
         return false;
     }
     
-    // Отключаем буферизацию для уменьшения задержки
-    m_videoCapture.set(cv::CAP_PROP_BUFFERSIZE, 1);
-    
     qInfo() << "Successfully initialized RTSP stream:" << m_rtspUrl;
     return true;
 }
 
+bool CameraWorker::acquireConnectSlot()
+{
+    // Ожидание прерывается, если камеру удаляют до подключения
+    while (!s_connectSlots.tryAcquire(1, 100)) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void CameraWorker::cleanupCapture()
 {
-    if (m_videoCapture.isOpened()) {
-        m_videoCapture.release();
+    if (m_source && m_source->isOpened()) {
+        m_source->close();
         qInfo() << "Released video capture for" << m_rtspUrl;
     }
 }
@@ -92,16 +323,22 @@ void CameraWorker::processFrame()
 
     try {
         cv::Mat frame;
-        bool success = m_videoCapture.read(frame);
+        bool success = m_source && m_source->read(frame);
 
         if (!success || frame.empty()) {
+            m_stats.readFailures++;
             qWarning() << "Failed to grab frame from" << m_rtspUrl;
             if (m_connected.load()) {
                 tryReconnect();
             }
+            publishState();
             return;
         }
 
+        QElapsedTimer latencyTimer;
+        latencyTimer.start();
+        m_stats.framesCaptured++;
+
         // Отладочная информация о кадре
         qDebug() << "[CameraWorker] Frame received from" << m_rtspUrl;
         qDebug() << "[CameraWorker] Frame size:" << frame.cols << "x" << frame.rows;
@@ -110,25 +347,122 @@ void CameraWorker::processFrame()
         
         m_reconnectAttempts = 0;
 
-        // Всегда отображаем кадр, даже если качество плохое
-        QImage image = ImageQualityAnalyzer::matToQImage(frame);
-        if (!image.isNull()) {
-            qDebug() << "[CameraWorker] QImage created successfully, size:" << image.size();
-            emit frameReady(image);
-        } else {
-            qWarning() << "[CameraWorker] Failed to convert frame to QImage";
+        if (m_referenceRequested && m_qualityAnalyzer) {
+            m_referenceRequested = false;
+            QString path = referenceFilePath();
+            QDir().mkpath(QFileInfo(path).absolutePath());
+            if (cv::imwrite(path.toStdString(), frame)) {
+                qInfo() << "Saved reference frame for" << m_rtspUrl << "to" << path;
+            } else {
+                qWarning() << "Failed to save reference frame to" << path;
+            }
+            m_qualityAnalyzer->setReferenceFrame(frame);
         }
 
-        // Анализ качества выполняется каждые N кадров для уменьшения задержки
+        // Анализ качества выполняется каждые N кадров для уменьшения задержки;
+        // N назначает планировщик по общему бюджету CPU. В режиме ключевых
+        // кадров источник уже прореживает поток, анализируется каждый кадр
+        int analysisInterval = m_keyframeActive ? 1
+            : m_schedulerEntry ? m_schedulerEntry->analysisInterval.load(std::memory_order_relaxed)
+            : QUALITY_ANALYSIS_SKIP;
+        // У предела памяти интервал растёт, а у самого предела анализ ждёт
+        if (m_lowMemory) {
+            updateMemoryBackoff();
+            analysisInterval *= qMax(1, m_stats.memoryBackoff);
+        }
+        m_stats.analysisInterval = analysisInterval;
         m_frameSkipCounter++;
-        if (m_qualityAnalyzer && m_frameSkipCounter >= QUALITY_ANALYSIS_SKIP) {
+        bool analyzeThisFrame = m_qualityAnalyzer && m_stats.memoryBackoff > 0
+            && m_frameSkipCounter >= analysisInterval;
+
+        // На кадрах анализа RGB-изображение для GUI строится в том же проходе,
+        // что и серый кадр, поэтому отдельная конвертация не нужна. В профиле
+        // низкой памяти кадров предпросмотра нет совсем
+        QImage image;
+        if (analyzeThisFrame) {
             m_frameSkipCounter = 0;
             qDebug() << "[CameraWorker] Starting quality analysis for" << m_rtspUrl;
-            m_lastQualityResult = m_qualityAnalyzer->analyze(frame);
+            QElapsedTimer analysisTimer;
+            analysisTimer.start();
+            ImageQualityAnalyzer::QualityResult result =
+                m_qualityAnalyzer->analyze(frame, m_lowMemory ? nullptr : &image, m_source->lumaPlane());
+            m_stats.lastAnalysisMs = analysisTimer.nsecsElapsed() / 1e6;
+            m_stats.lastAnalysisCpuMs = m_qualityAnalyzer->lastCpuTimeNs() / 1e6;
+            applyStreamStats(result);
+
+            // Кадр в памяти чужого узла: декодер (пул ingest, процесс захвата)
+            // работал не там, где анализ
+            if (m_stats.numaNode >= 0) {
+                int pageNode = AffinityPolicy::pageNode(frame.ptr(frame.rows / 2));
+                if (pageNode == m_stats.numaNode) {
+                    m_stats.framesNodeLocal++;
+                } else if (pageNode >= 0) {
+                    m_stats.framesNodeRemote++;
+                }
+            }
+
+            // Кадр из разделяемой памяти мог быть перезаписан процессом захвата
+            // во время анализа - такой результат недостоверен
+            if (!m_source->frameStillValid()) {
+                m_stats.framesDiscarded++;
+                analyzeThisFrame = false;
+                image = QImage();
+                qDebug() << "[CameraWorker] Frame overwritten during analysis, result discarded";
+            } else {
+                m_lastQualityResult = result;
+                m_stats.framesAnalyzed++;
+                m_publishedState.result = result;
+                copyUtf8(m_publishedState.status, STATUS_BYTES, result.status);
+            }
+        }
+
+        if (analyzeThisFrame) {
+            if (m_analysisClock.isValid()) {
+                double periodSec = m_analysisClock.nsecsElapsed() / 1e9;
+                double rate = periodSec > 0.0 ? 1.0 / periodSec : 0.0;
+                m_stats.analysisRateHz = m_stats.analysisRateHz > 0.0
+                    ? 0.8 * m_stats.analysisRateHz + 0.2 * rate : rate;
+            }
+            m_analysisClock.start();
+
+            if (m_scheduler && m_schedulerEntry) {
+                m_scheduler->reportAnalysis(m_schedulerEntry, m_stats.lastAnalysisCpuMs,
+                                            m_lastQualityResult.overallScore);
+            }
+
+            // Сжатие выполняется в пуле кэша, здесь только передача QImage
+            if (m_snapshotCache && m_lastQualityResult.isValid) {
+                m_snapshotCache->offer(m_rtspUrl, image, m_lastQualityResult.overallScore);
+            }
+
+            if ((!m_subStreamUrl.isEmpty() || m_recordingActive) && m_lastQualityResult.isValid) {
+                checkScoreDrop(m_lastQualityResult.overallScore);
+            }
+        }
+
+        // Всегда отображаем кадр, даже если качество плохое. Пока вкладка
+        // на экране, кадры полного разрешения показывает processMainFrame()
+        bool mainFrameShown = m_mainSource && m_mainViewed;
+        if (!mainFrameShown && !m_lowMemory) {
+            if (image.isNull()) {
+                image = ImageQualityAnalyzer::matToQImage(frame);
+            }
+            if (!image.isNull()) {
+                qDebug() << "[CameraWorker] QImage created successfully, size:" << image.size();
+                emit frameReady(image);
+            } else {
+                qWarning() << "[CameraWorker] Failed to convert frame to QImage";
+            }
+        }
+
+        if (analyzeThisFrame) {
             qDebug() << "[CameraWorker] Quality result - Valid:" << m_lastQualityResult.isValid 
                      << "Score:" << m_lastQualityResult.overallScore;
             emit qualityResultReady(m_lastQualityResult);
         }
+
+        publishState();
+        emit frameProcessed(latencyTimer.nsecsElapsed() / 1000, analyzeThisFrame);
     } catch (...) {
         qWarning() << "Exception in processFrame for" << m_rtspUrl;
     }
@@ -159,6 +493,376 @@ void CameraWorker::tryReconnect()
     }
 }
 
+void CameraWorker::captureReferenceFrame()
+{
+    m_referenceRequested = true;
+}
+
+void CameraWorker::clearReferenceFrame()
+{
+    m_referenceRequested = false;
+    if (m_qualityAnalyzer) {
+        m_qualityAnalyzer->clearReferenceFrame();
+    }
+    QFile::remove(referenceFilePath());
+    qInfo() << "Cleared reference frame for" << m_rtspUrl;
+}
+
+void CameraWorker::loadReferenceFrame()
+{
+    QString path = referenceFilePath();
+    if (!QFile::exists(path)) {
+        return;
+    }
+
+    cv::Mat reference = cv::imread(path.toStdString(), cv::IMREAD_COLOR);
+    if (reference.empty()) {
+        qWarning() << "Failed to load reference frame" << path;
+        return;
+    }
+
+    m_qualityAnalyzer->setReferenceFrame(reference);
+    qInfo() << "Loaded reference frame for" << m_rtspUrl << "from" << path;
+}
+
+QString CameraWorker::referenceFilePath() const
+{
+    // URL может содержать учётные данные, поэтому имя файла - хэш URL
+    QByteArray hash = QCryptographicHash::hash(m_rtspUrl.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        + "/references/" + QString::fromLatin1(hash) + ".png";
+}
+
+void CameraWorker::applyStreamStats(ImageQualityAnalyzer::QualityResult& result)
+{
+    FrameSource::StreamStats stats = m_source->streamStats();
+    if (!stats.available) {
+        return;
+    }
+
+    // После переподключения счётчики источника начинаются заново
+    if (stats.packetsReceived < m_lastStreamStats.packetsReceived
+        || stats.packetsLost < m_lastStreamStats.packetsLost) {
+        m_lastStreamStats = FrameSource::StreamStats();
+    }
+
+    quint64 received = stats.packetsReceived - m_lastStreamStats.packetsReceived;
+    quint64 lost = stats.packetsLost - m_lastStreamStats.packetsLost;
+    result.hasStreamStats = true;
+    result.packetsReceived = stats.packetsReceived;
+    result.packetsLost = stats.packetsLost;
+    result.corruptFrames = stats.corruptPackets + stats.corruptFrames;
+    result.decodeErrors = stats.decodeErrors;
+    result.packetLossPercent = received + lost > 0 ? 100.0 * lost / (received + lost) : 0.0;
+    m_lastStreamStats = stats;
+}
+
+QString CameraWorker::sharedRingName() const
+{
+    QByteArray hash = QCryptographicHash::hash(m_rtspUrl.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("iqa-%1-%2").arg(QCoreApplication::applicationPid())
+                               .arg(QString::fromLatin1(hash.left(12)));
+}
+
+bool CameraWorker::ensureCaptureProcess()
+{
+    if (!m_captureProcess) {
+        m_captureProcess = new QProcess(this);
+        m_captureProcess->setProcessChannelMode(QProcess::ForwardedChannels);
+        connect(m_captureProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+                [this](int exitCode, QProcess::ExitStatus status) {
+            if (m_capturing.load()) {
+                qWarning() << "Capture process for" << m_rtspUrl << "exited, code" << exitCode
+                           << (status == QProcess::CrashExit ? "(crash)" : "");
+            }
+        });
+    }
+
+    if (m_captureProcess->state() != QProcess::NotRunning) {
+        return true;
+    }
+
+    // Процесс захвата декодирует тем же бэкендом, что выбран в этом процессе.
+    // Общий реактор ingest при процессе на камеру ничего не даёт - вместо него FFmpeg
+    QStringList arguments;
+    arguments << "--capture-publisher" << analysisUrl() << "--shm-name" << sharedRingName();
+    FrameSource::BackendConfig backendConfig = FrameSource::backendConfig();
+    if (backendConfig.backend != FrameSource::CaptureBackend::OpenCV) {
+        arguments << "--capture-backend" << "ffmpeg"
+                  << "--decode-threads" << QString::number(backendConfig.decodeThreads);
+        if (m_keyframeGopInterval > 0) {
+            arguments << "--keyframe-interval" << QString::number(m_keyframeGopInterval);
+        }
+        for (auto it = backendConfig.demuxOptions.constBegin(); it != backendConfig.demuxOptions.constEnd(); ++it) {
+            arguments << "--demux-option" << it.key() + "=" + it.value();
+        }
+    }
+    m_captureProcess->start(QCoreApplication::applicationFilePath(), arguments);
+    if (!m_captureProcess->waitForStarted(5000)) {
+        qWarning() << "Failed to start capture process for" << m_rtspUrl
+                   << m_captureProcess->errorString();
+        return false;
+    }
+    qInfo() << "Started capture process" << m_captureProcess->processId() << "for" << m_rtspUrl;
+    return true;
+}
+
+void CameraWorker::stopCaptureProcess()
+{
+    if (!m_captureProcess || m_captureProcess->state() == QProcess::NotRunning) {
+        return;
+    }
+
+    // SIGTERM даёт процессу захвата удалить кольцо из /dev/shm
+    m_captureProcess->terminate();
+    if (!m_captureProcess->waitForFinished(3000)) {
+        m_captureProcess->kill();
+        m_captureProcess->waitForFinished(1000);
+    }
+}
+
+QString CameraWorker::analysisUrl() const
+{
+    return m_subStreamUrl.isEmpty() ? m_rtspUrl : m_subStreamUrl;
+}
+
+void CameraWorker::setMainStreamViewed(bool viewed)
+{
+    // Без предпросмотра основной поток для показа не нужен
+    if (m_subStreamUrl.isEmpty() || m_mainViewed == viewed || m_lowMemory) {
+        return;
+    }
+    m_mainViewed = viewed;
+
+    if (viewed) {
+        m_mainIdleTimer->stop();
+        if (m_capturing.load()) {
+            openMainStream();
+        }
+    } else if (m_mainSource && !m_confirmationPending) {
+        m_mainIdleTimer->start(m_mainIdleTimeoutMs);
+    }
+}
+
+bool CameraWorker::openMainStream()
+{
+    if (m_mainSource) {
+        return true;
+    }
+
+    // Основной поток открывается в этом процессе и при вынесенном захвате:
+    // он нужен ненадолго, а подпоток продолжает читаться как прежде
+    std::unique_ptr<FrameSource> source = FrameSource::create(m_rtspUrl);
+    if (!source) {
+        return false;
+    }
+    source->setOpenTimeout(m_openTimeoutMs);
+    if (!acquireConnectSlot()) {
+        return false;
+    }
+    bool opened = source->open();
+    s_connectSlots.release();
+    if (!opened) {
+        qWarning() << "Cannot open main stream" << m_rtspUrl << ", staying on sub-stream";
+        return false;
+    }
+
+    m_mainSource = std::move(source);
+    // Чтение чуть чаще частоты кадров: пока в буфере источника есть кадры,
+    // read() возвращается сразу и поток догоняет живой, а не отстаёт на
+    // столько кадров, сколько их пришло между кадрами подпотока
+    double fps = m_mainSource->frameRate();
+    m_mainFrameTimer->start(fps > 0.0 ? static_cast<int>(std::lround(1000.0 * MAIN_STREAM_READ_PACE / fps))
+                                      : FRAME_INTERVAL_MS);
+    if (!m_mainAnalyzer) {
+        m_mainAnalyzer = new ImageQualityAnalyzer(this);
+        m_mainAnalyzer->setLowMemoryMode(m_lowMemory);
+    }
+    qInfo() << "Opened main stream" << m_rtspUrl << (m_mainViewed ? "for viewing" : "for confirmation");
+    return true;
+}
+
+void CameraWorker::closeMainStream()
+{
+    m_mainIdleTimer->stop();
+    m_mainFrameTimer->stop();
+    m_confirmationPending = false;
+    if (!m_mainSource) {
+        return;
+    }
+    m_mainSource->close();
+    m_mainSource.reset();
+    qInfo() << "Closed main stream" << m_rtspUrl;
+}
+
+void CameraWorker::processMainFrame()
+{
+    if (!m_mainSource) {
+        return;
+    }
+
+    // Поток читается и без показа, пока открыт: иначе подтверждение взяло бы
+    // устаревший кадр из буфера
+    cv::Mat mainFrame;
+    if (!m_mainSource->read(mainFrame) || mainFrame.empty()) {
+        qWarning() << "Main stream read failed for" << m_rtspUrl << ", closing it";
+        bool dropPending = m_confirmationPending;
+        closeMainStream();
+        // Проверить нечем - остаётся свидетельство подпотока
+        if (dropPending) {
+            m_lastDropConfirmed = true;
+            triggerRecording("drop");
+        }
+        return;
+    }
+
+    if (m_confirmationPending) {
+        m_confirmationPending = false;
+        ImageQualityAnalyzer::QualityResult result =
+            m_mainAnalyzer->analyze(mainFrame, nullptr, m_mainSource->lumaPlane());
+        bool confirmed = result.isValid && result.overallScore < m_confirmationThreshold;
+        m_lastDropConfirmed = confirmed;
+        qInfo() << "Main stream confirmation for" << m_rtspUrl << "score" << result.overallScore
+                << "sub-stream score" << m_lastQualityResult.overallScore
+                << (confirmed ? "- drop confirmed" : "- sub-stream artifact");
+        if (confirmed) {
+            triggerRecording("drop");
+        }
+        emit confirmationResultReady(result, confirmed);
+        if (!m_mainViewed) {
+            m_mainIdleTimer->start(m_mainIdleTimeoutMs);
+        }
+    }
+
+    if (!m_mainViewed || m_lowMemory) {
+        return;
+    }
+    QImage image = ImageQualityAnalyzer::matToQImage(mainFrame);
+    if (!image.isNull()) {
+        emit frameReady(image);
+    }
+}
+
+void CameraWorker::checkScoreDrop(double score)
+{
+    double threshold = m_scoreBaseline - SCORE_DROP;
+    bool dropped = m_scoreBaseline >= 0.0 && score < threshold;
+    m_scoreBaseline = m_scoreBaseline >= 0.0 ? 0.9 * m_scoreBaseline + 0.1 * score : score;
+    if (!dropped) {
+        return;
+    }
+
+    // Без подпотока падение замечено уже в полном разрешении
+    if (m_subStreamUrl.isEmpty()) {
+        triggerRecording("drop");
+        return;
+    }
+    if (m_confirmationPending) {
+        return;
+    }
+    // Между проверками действует итог последней из них
+    if (m_confirmationClock.isValid() && m_confirmationClock.elapsed() < CONFIRMATION_COOLDOWN_MS) {
+        if (m_lastDropConfirmed) {
+            triggerRecording("drop");
+        }
+        return;
+    }
+
+    // Падение по подпотоку может быть артефактом его сжатия - запись ждёт
+    // следующего кадра основного потока
+    m_confirmationClock.start();
+    if (openMainStream()) {
+        m_mainIdleTimer->stop();
+        m_confirmationPending = true;
+        m_confirmationThreshold = threshold;
+        qInfo() << "Score drop on sub-stream of" << m_rtspUrl << "to" << score
+                << ", confirming on main stream";
+    } else {
+        m_lastDropConfirmed = true;
+        triggerRecording("drop");
+    }
+}
+
+void CameraWorker::updateMemoryBackoff()
+{
+    MemoryBudget::Pressure pressure = MemoryBudget::instance().pressure();
+    int backoff = m_stats.memoryBackoff;
+    if (pressure == MemoryBudget::Pressure::Critical) {
+        backoff = 0;
+    } else if (m_memoryBackoffClock.isValid() && m_memoryBackoffClock.elapsed() < MEMORY_BACKOFF_STEP_MS) {
+        return;
+    } else if (pressure == MemoryBudget::Pressure::High) {
+        backoff = backoff == 0 ? MAX_MEMORY_BACKOFF : qMin(MAX_MEMORY_BACKOFF, backoff * 2);
+    } else if (backoff != 1) {
+        // После паузы анализ возвращается с самой низкой частотой и ускоряется по шагам
+        backoff = backoff == 0 ? MAX_MEMORY_BACKOFF : backoff / 2;
+    }
+
+    if (backoff != m_stats.memoryBackoff) {
+        // Пауза анализа не трогает память декодера и предыстории, поэтому
+        // источник на время паузы переходит на ключевые кадры без предыстории
+        if ((backoff == 0) != (m_stats.memoryBackoff == 0) && m_source) {
+            m_source->setMemoryShedding(backoff == 0);
+        }
+        m_stats.memoryBackoff = backoff;
+        m_memoryBackoffClock.start();
+        if (backoff == 0) {
+            qWarning() << "Analysis paused, decoding keyframes only and pre-event buffer dropped"
+                       << "at memory ceiling for" << m_rtspUrl;
+        } else {
+            qInfo() << "Analysis interval multiplier" << backoff << "for" << m_rtspUrl;
+        }
+    }
+}
+
+void CameraWorker::saveRecording()
+{
+    if (writeRecording("manual")) {
+        m_recordingClock.start();
+    }
+}
+
+void CameraWorker::triggerRecording(const QString& reason)
+{
+    if (!m_recordingActive) {
+        return;
+    }
+    // Оповещение и падение оценки обычно приходят вместе - одна запись
+    if (m_recordingClock.isValid() && m_recordingClock.elapsed() < RECORDING_COOLDOWN_MS) {
+        return;
+    }
+    if (writeRecording(reason)) {
+        m_recordingClock.start();
+    }
+}
+
+bool CameraWorker::writeRecording(const QString& reason)
+{
+    if (!m_recordingActive || !m_source) {
+        return false;
+    }
+    if (!QDir().mkpath(m_recordingConfig.directory)) {
+        qWarning() << "Cannot create recording directory" << m_recordingConfig.directory;
+        return false;
+    }
+
+    // URL может содержать учётные данные, поэтому в имени файла - хэш URL
+    QByteArray hash = QCryptographicHash::hash(m_rtspUrl.toUtf8(), QCryptographicHash::Sha1).toHex().left(12);
+    QString path = QDir(m_recordingConfig.directory).filePath(QString("%1_%2_%3.%4")
+        .arg(QString::fromLatin1(hash))
+        .arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"))
+        .arg(reason)
+        .arg(m_recordingConfig.container));
+    if (!m_source->savePreEvent(path)) {
+        qWarning() << "No pre-event video to save yet for" << m_rtspUrl;
+        return false;
+    }
+
+    qInfo() << "Saving pre-event recording of" << m_rtspUrl << "to" << path << "(" << reason << ")";
+    emit recordingQueued(path);
+    return true;
+}
+
 bool CameraWorker::isConnected() const
 {
     return m_connected.load();
@@ -171,5 +875,26 @@ QString CameraWorker::getRtspUrl() const
 
 ImageQualityAnalyzer::QualityResult CameraWorker::getLastQualityResult() const
 {
-    return m_lastQualityResult;
+    PublishedState state = m_statePublisher->load();
+    ImageQualityAnalyzer::QualityResult result;
+    static_cast<ImageQualityAnalyzer::QualityValues&>(result) = state.result;
+    result.status = QString::fromUtf8(state.status);
+    return result;
+}
+
+CameraWorker::PipelineStats CameraWorker::getPipelineStats() const
+{
+    return m_statePublisher->load().stats;
+}
+
+std::shared_ptr<const CameraWorker::StatePublisher> CameraWorker::publishedState() const
+{
+    return m_statePublisher;
+}
+
+void CameraWorker::publishState()
+{
+    m_publishedState.stats = m_stats;
+    m_publishedState.connected = m_connected.load();
+    m_statePublisher->store(m_publishedState);
 }
@@ -2,11 +2,19 @@
 #define CAMERAWORKER_H
 
 #include <QObject>
+#include <QProcess>
+#include <QSemaphore>
 #include <QThread>
 #include <QTimer>
 #include <QString>
+#include <QElapsedTimer>
 #include <atomic>
+#include <memory>
 #include "imagequalityanalyzer.h"
+#include "framesource.h"
+#include "analysisscheduler.h"
+#include "snapshotcache.h"
+#include "seqlockvalue.h"
 #include <opencv2/opencv.hpp>
 
 class CameraWorker : public QObject
@@ -17,12 +25,170 @@ public:
     explicit CameraWorker(const QString& rtspUrl, QObject *parent = nullptr);
     ~CameraWorker();
 
+    /**
+     * @brief Счётчики конвейера захвата и анализа
+     */
+    struct PipelineStats {
+        quint64 framesCaptured;      // Успешно прочитанные кадры
+        quint64 framesAnalyzed;      // Кадры, прошедшие анализ качества
+        quint64 readFailures;        // Неудачные чтения кадра
+        quint64 framesDiscarded;     // Результаты анализа кадров, перезаписанных во время анализа
+        double lastAnalysisMs;       // Длительность последнего анализа, мс
+        double lastAnalysisCpuMs;    // Процессорное время последнего анализа во всех потоках, мс
+        int analysisInterval;        // Текущий интервал анализа, кадров
+        double analysisRateHz;       // Фактическая частота анализа (сглаженная), Гц
+        int numaNode;                // Узел NUMA потока камеры (номер ОС); -1 - поток не закреплён
+        quint64 framesNodeLocal;     // Проанализированные кадры в памяти своего узла
+        quint64 framesNodeRemote;    // ... в памяти другого узла (межсокетный трафик)
+        int memoryBackoff;           // Множитель интервала анализа у предела памяти; 0 - анализ приостановлен
+
+        PipelineStats() : framesCaptured(0), framesAnalyzed(0), readFailures(0), framesDiscarded(0), lastAnalysisMs(0),
+                          lastAnalysisCpuMs(0),
+                          analysisInterval(0), analysisRateHz(0), numaNode(-1), framesNodeLocal(0),
+                          framesNodeRemote(0), memoryBackoff(1) {}
+    };
+
+    static constexpr int STATUS_BYTES = 96;
+
+    /**
+     * @brief Состояние обработчика, публикуемое для чтения из любых потоков
+     */
+    struct PublishedState {
+        ImageQualityAnalyzer::QualityValues result;   // Последний принятый результат анализа
+        char status[STATUS_BYTES];                    // Его status в UTF-8 (с завершающим нулём)
+        PipelineStats stats;
+        bool connected;
+    };
+    using StatePublisher = SeqlockValue<PublishedState>;
+
+    /**
+     * @brief Запись предыстории событий (сжатые пакеты без перекодирования)
+     */
+    struct RecordingConfig {
+        QString directory;           // Куда писать файлы; пусто - запись отключена
+        int preEventSec;             // Глубина предыстории
+        qint64 maxBytes;             // Предел памяти предыстории камеры
+        QString container;           // "mp4" или "mkv"
+
+        RecordingConfig() : preEventSec(30), maxBytes(16 * 1024 * 1024), container("mp4") {}
+    };
+
+    /**
+     * @brief Задаёт интервал опроса источника
+     * @param intervalMs Интервал в мс; -1 - по частоте источника (или ~30 FPS,
+     *        если частота неизвестна); 0 - без ограничения (нагрузочные замеры)
+     *
+     * Вызывается до startCapture().
+     */
+    void setFrameInterval(int intervalMs);
+
+    /**
+     * @brief Подключает центральный планировщик частоты анализа
+     *
+     * Без планировщика анализ выполняется каждые QUALITY_ANALYSIS_SKIP кадров.
+     * Вызывается до startCapture().
+     */
+    void setAnalysisScheduler(AnalysisScheduler* scheduler);
+
+    /**
+     * @brief Выносит захват и декодирование в отдельный процесс
+     *
+     * Процесс захвата (CapturePublisher) публикует кадры в разделяемую
+     * память, а обработчик читает их через ShmFrameSource. Падение
+     * процесса захвата обрабатывается как разрыв соединения: при
+     * переподключении процесс запускается заново. Вызывается до startCapture().
+     */
+    void setCaptureIsolation(bool enabled);
+
+    /**
+     * @brief Задаёт таймаут открытия потока и чтения кадра, мс
+     *
+     * Вызывается до startCapture(). По умолчанию DEFAULT_OPEN_TIMEOUT_MS.
+     */
+    void setOpenTimeout(int timeoutMs);
+
+    /**
+     * @brief Ограничивает число одновременных подключений всех камер процесса
+     *
+     * При запуске сотни камер одновременные попытки открыть недоступные
+     * хосты иначе занимают сеть и CPU декодеров. Вызывается до запуска камер.
+     */
+    static void setMaxParallelConnects(int count);
+
+    /**
+     * @brief Режим ключевых кадров для больших парков камер
+     * @param gopInterval 0 - декодировать все кадры; N - только ключевой кадр
+     *        каждого N-го GOP, остальные пакеты отбрасываются до декодера
+     *
+     * Требует бэкенд FFmpeg; с OpenCV декодируются все кадры. Каждый
+     * декодированный кадр анализируется, анализатор переводится в режим
+     * ключевых кадров. Вызывается до startCapture().
+     */
+    void setKeyframeInterval(int gopInterval);
+
+    /**
+     * @brief Подключает кэш снимков (ключ камеры - URL)
+     *
+     * Каждый проанализированный кадр предлагается кэшу, который сам решает,
+     * сохранять ли его. Кэш должен жить дольше обработчика. Вызывается до startCapture().
+     */
+    void setSnapshotCache(SnapshotCache* cache);
+
+    /**
+     * @brief Подпоток низкого разрешения той же камеры для непрерывного анализа
+     * @param url URL подпотока; пусто - анализируется основной поток
+     *
+     * С подпотоком анализ идёт по нему, а основной поток (URL обработчика)
+     * открывается только пока вкладка камеры на экране (setMainStreamViewed)
+     * или чтобы подтвердить резкое падение оценки в полном разрешении, и
+     * закрывается после простоя. Открытый основной поток читается своим
+     * таймером чуть чаще его частоты кадров, поэтому не отстаёт от живого.
+     * Запись предыстории по падению оценки ждёт подтверждения основным
+     * потоком. Результаты, история и оповещения остаются привязаны к URL
+     * основного потока. Вызывается до startCapture().
+     */
+    void setSubStreamUrl(const QString& url);
+
+    /**
+     * @brief Через сколько мс без просмотра и подтверждений закрыть основной поток
+     */
+    void setMainStreamIdleTimeout(int timeoutMs);
+
+    /**
+     * @brief Включает кольцо предыстории источника
+     *
+     * Требует бэкенд FFmpeg или ingest без вынесенного захвата; иначе
+     * выводится предупреждение. Запись - по saveRecording(), по оповещению
+     * (triggerRecording()) и сама при падении оценки. Вызывается до startCapture().
+     */
+    void setRecordingConfig(const RecordingConfig& config);
+
     void startCapture();
     void stopCapture();
     bool isConnected() const;
     QString getRtspUrl() const;
+
+    /**
+     * @brief Последний результат анализа; безопасно вызывать из любого потока
+     */
     ImageQualityAnalyzer::QualityResult getLastQualityResult() const;
 
+    /**
+     * @brief Счётчики конвейера; безопасно вызывать из любого потока
+     */
+    PipelineStats getPipelineStats() const;
+
+    /**
+     * @brief Опубликованное состояние для чтения без блокировок и очереди событий
+     *
+     * Обновляется после каждого обработанного кадра и смены состояния
+     * подключения. Указатель можно хранить дольше самого обработчика
+     * (GUI, экспорт, оповещения), чтение не блокирует поток камеры.
+     * Чтение lock-free, но не wait-free: пересёкшись с публикацией,
+     * читатель повторяет копирование.
+     */
+    std::shared_ptr<const StatePublisher> publishedState() const;
+
 signals:
     void frameReady(const QImage& image);
     void qualityResultReady(const ImageQualityAnalyzer::QualityResult& result);
@@ -30,27 +196,144 @@ signals:
     void errorOccurred(const QString& errorText);
     void connectionLost();
 
+    /**
+     * @brief Кадр полностью обработан (отображение и, если нужно, анализ)
+     * @param latencyUs Время от получения кадра из источника до конца обработки, мкс
+     * @param analyzed Кадр прошёл анализ качества
+     */
+    void frameProcessed(qint64 latencyUs, bool analyzed);
+
+    /**
+     * @brief Анализ кадра основного потока после падения оценки по подпотоку
+     * @param confirmed Основной поток тоже ниже порога падения; только тогда
+     *        падение записывается в предысторию
+     */
+    void confirmationResultReady(const ImageQualityAnalyzer::QualityResult& result, bool confirmed);
+
+    /**
+     * @brief Предыстория передана на запись (файл появится после её окончания)
+     */
+    void recordingQueued(const QString& path);
+
 public slots:
     void processFrame();
 
+    /**
+     * @brief Сохраняет следующий кадр как эталон для сравнения (PSNR/SSIM)
+     *
+     * Эталон записывается на диск и загружается при следующем запуске камеры.
+     */
+    void captureReferenceFrame();
+
+    /**
+     * @brief Удаляет эталон камеры и отключает режим сравнения
+     */
+    void clearReferenceFrame();
+
+    /**
+     * @brief Вкладка камеры показана или скрыта
+     *
+     * Показ открывает основной поток (кадры на экране - полного разрешения),
+     * скрытие запускает таймер простоя. Без подпотока ничего не делает.
+     */
+    void setMainStreamViewed(bool viewed);
+
+    /**
+     * @brief Сохраняет предысторию по запросу пользователя
+     */
+    void saveRecording();
+
+    /**
+     * @brief Сохраняет предысторию по событию (не чаще RECORDING_COOLDOWN_MS)
+     * @param reason Причина для имени файла: alert, drop
+     */
+    void triggerRecording(const QString& reason);
+
 private:
     bool initializeCapture();
+    bool acquireConnectSlot();
     void cleanupCapture();
     void tryReconnect();
+    void loadReferenceFrame();
+    QString referenceFilePath() const;
+    void applyStreamStats(ImageQualityAnalyzer::QualityResult& result);
+    void publishState();
+    bool ensureCaptureProcess();
+    void stopCaptureProcess();
+    QString sharedRingName() const;
+    QString analysisUrl() const;
+    bool openMainStream();
+    void closeMainStream();
+    void processMainFrame();
+    void checkScoreDrop(double score);
+    bool writeRecording(const QString& reason);
+    void updateMemoryBackoff();
 
     QString m_rtspUrl;
-    cv::VideoCapture m_videoCapture;
+    std::unique_ptr<FrameSource> m_source;
     std::atomic<bool> m_capturing{false};
     std::atomic<bool> m_connected{false};
     QTimer* m_frameTimer;
     ImageQualityAnalyzer* m_qualityAnalyzer;
-    ImageQualityAnalyzer::QualityResult m_lastQualityResult;
+    ImageQualityAnalyzer::QualityResult m_lastQualityResult;   // Только поток обработчика
+    std::shared_ptr<StatePublisher> m_statePublisher;
+    PublishedState m_publishedState;   // Черновик публикации, status пересчитывается только при анализе
     int m_reconnectAttempts;
     int m_frameSkipCounter;  // Счётчик для пропуска кадров анализа
+    bool m_referenceRequested;  // Следующий кадр нужно сохранить как эталон
+    int m_frameIntervalMs;      // -1 = по частоте источника
+    AnalysisScheduler* m_scheduler;
+    std::shared_ptr<AnalysisScheduler::CameraEntry> m_schedulerEntry;
+    QElapsedTimer m_analysisClock;  // Время с предыдущего анализа
+    PipelineStats m_stats;
+    FrameSource::StreamStats m_lastStreamStats;  // Счётчики источника на момент прошлого анализа
+    bool m_captureIsolation;
+    QProcess* m_captureProcess;
+    int m_openTimeoutMs;
+    int m_keyframeGopInterval;
+    bool m_keyframeActive;       // Источник действительно отдаёт только ключевые кадры
+    SnapshotCache* m_snapshotCache;
+    QTimer* m_startRetryTimer;   // Повтор первого подключения
+    int m_startRetryDelayMs;
+    int m_affinityNode;          // Индекс узла AffinityPolicy; -1 - поток не закреплён
+    bool m_lowMemory;            // Профиль низкой памяти (MemoryBudget): без кадров предпросмотра
+    QElapsedTimer m_memoryBackoffClock;   // Время с последнего изменения memoryBackoff
+
+    // Пара основной поток / подпоток
+    QString m_subStreamUrl;
+    std::unique_ptr<FrameSource> m_mainSource;      // Открыт по требованию
+    ImageQualityAnalyzer* m_mainAnalyzer;           // Своё временное состояние для полного разрешения
+    bool m_mainViewed;
+    bool m_confirmationPending;  // Следующий кадр основного потока - подтверждение падения
+    double m_confirmationThreshold;   // Порог падения на момент, когда оно замечено
+    bool m_lastDropConfirmed;    // Итог последней проверки; действует до конца паузы между проверками
+    double m_scoreBaseline;      // Сглаженная оценка подпотока; < 0 - ещё нет
+    QElapsedTimer m_confirmationClock;
+    QTimer* m_mainIdleTimer;
+    QTimer* m_mainFrameTimer;
+    int m_mainIdleTimeoutMs;
+
+    // Предыстория событий
+    RecordingConfig m_recordingConfig;
+    bool m_recordingActive;      // Источник ведёт кольцо пакетов
+    QElapsedTimer m_recordingClock;
+
+    static QSemaphore s_connectSlots;
+    static int s_maxParallelConnects;
     
     const int MAX_RECONNECT_ATTEMPTS = 5;
     const int FRAME_INTERVAL_MS = 33;  // ~30 FPS
     const int QUALITY_ANALYSIS_SKIP = 10;  // Анализ качества каждые 10 кадров
+    const int DEFAULT_OPEN_TIMEOUT_MS = 5000;
+    const int MAX_START_RETRY_DELAY_MS = 60000;
+    const int DEFAULT_MAIN_STREAM_IDLE_MS = 30000;
+    const double SCORE_DROP = 15.0;     // Падение ниже сглаженной оценки
+    const int CONFIRMATION_COOLDOWN_MS = 60000;
+    const double MAIN_STREAM_READ_PACE = 0.9;   // Период чтения основного потока в долях его периода кадров
+    const int RECORDING_COOLDOWN_MS = 30000;   // Как предыстория: файлы не перекрываются
+    const int MAX_MEMORY_BACKOFF = 16;
+    const int MEMORY_BACKOFF_STEP_MS = 2000;   // Не чаще: замер памяти должен успеть отразить шаг
+    static constexpr int DEFAULT_MAX_PARALLEL_CONNECTS = 8;
 };
 
 #endif // CAMERAWORKER_H
@@ -0,0 +1,132 @@
+#include "capturepublisher.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<bool> g_stopRequested{false};
+
+void handleStopSignal(int)
+{
+    g_stopRequested.store(true);
+}
+
+} // namespace
+
+CapturePublisher::CapturePublisher(const QString& url, const QString& ringName, int slotCount)
+    : m_url(url)
+    , m_ringName(ringName)
+    , m_slotCount(slotCount)
+    , m_keyframeGopInterval(0)
+{
+}
+
+void CapturePublisher::setKeyframeInterval(int gopInterval)
+{
+    m_keyframeGopInterval = gopInterval;
+}
+
+bool CapturePublisher::openSource()
+{
+    if (!m_source) {
+        m_source = FrameSource::create(m_url);
+        if (!m_source) {
+            qWarning() << "Unsupported capture URL:" << m_url;
+            return false;
+        }
+        if (!m_source->setKeyframeOnly(m_keyframeGopInterval)) {
+            qWarning() << "Keyframe-only mode requires the FFmpeg capture backend, publishing all frames of" << m_url;
+        }
+    }
+    return m_source->open();
+}
+
+bool CapturePublisher::publish(const cv::Mat& frame)
+{
+    // Размер слота известен только по первому кадру; при смене разрешения
+    // кольцо пересоздаётся, и потребители переподключаются к новому
+    size_t frameBytes = frame.total() * frame.elemSize();
+    if (!m_ring || frameBytes > m_ring->slotBytes()) {
+        m_ring.reset();
+        m_ring = SharedFrameRing::create(m_ringName, m_slotCount, frameBytes);
+        if (!m_ring) {
+            return false;
+        }
+    }
+    return m_ring->publish(frame);
+}
+
+int CapturePublisher::run()
+{
+    std::signal(SIGTERM, handleStopSignal);
+    std::signal(SIGINT, handleStopSignal);
+
+    // Анализатор упал или был убит - процесс захвата ему больше не нужен.
+    // Ядро пришлёт SIGTERM, когда завершится поток, запустивший процесс
+    // (поток камеры): это совпадает со временем жизни камеры
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) != 0) {
+        qWarning() << "PR_SET_PDEATHSIG failed:" << strerror(errno);
+    }
+    // Родитель мог завершиться до prctl: тогда процесс уже передан init
+    if (getppid() == 1) {
+        qWarning() << "Parent process exited before capture started for" << m_url;
+        return 0;
+    }
+
+    qInfo() << "Capture publisher started for" << m_url << "ring" << m_ringName;
+
+    int reconnectDelayMs = 500;
+
+    while (!g_stopRequested.load()) {
+        if (!m_source || !m_source->isOpened()) {
+            if (!openSource()) {
+                // Процесс жив, хотя кадров нет: потребители не должны считать его упавшим
+                if (m_ring) {
+                    m_ring->beatHeartbeat();
+                }
+                QThread::msleep(reconnectDelayMs);
+                reconnectDelayMs = qMin(reconnectDelayMs * 2, MAX_RECONNECT_DELAY_MS);
+                continue;
+            }
+            reconnectDelayMs = 500;
+        }
+
+        QElapsedTimer frameTimer;
+        frameTimer.start();
+
+        cv::Mat frame;
+        if (!m_source->read(frame) || frame.empty()) {
+            qWarning() << "Capture read failed for" << m_url << "- reconnecting";
+            m_source->close();
+            continue;
+        }
+
+        if (!publish(frame)) {
+            qWarning() << "Failed to publish frame for" << m_url;
+        }
+
+        // Файлы и синтетические источники отдают кадры без ожидания,
+        // поэтому выдерживаем их собственную частоту
+        double fps = m_source->frameRate();
+        if (fps > 0.0) {
+            qint64 remainingMs = static_cast<qint64>(1000.0 / fps) - frameTimer.elapsed();
+            if (remainingMs > 0) {
+                QThread::msleep(static_cast<unsigned long>(remainingMs));
+            }
+        }
+    }
+
+    if (m_source) {
+        m_source->close();
+    }
+    m_ring.reset();
+    qInfo() << "Capture publisher stopped for" << m_url;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef CAPTUREPUBLISHER_H
+#define CAPTUREPUBLISHER_H
+
+#include <QString>
+#include <memory>
+#include "framesource.h"
+#include "sharedframering.h"
+
+/**
+ * @class CapturePublisher
+ * @brief Процесс захвата: декодирует поток и публикует кадры в SharedFrameRing
+ *
+ * Запускается как отдельный процесс (--capture-publisher <url> --shm-name <имя>),
+ * поэтому сбой декодера в одном потоке не роняет анализатор, а число
+ * процессов анализа, читающих кольцо через shm://<имя>, не зависит от
+ * числа процессов захвата.
+ *
+ * Процесс сам переподключается к камере, поддерживает heartbeat кольца и
+ * завершается по SIGTERM/SIGINT или при завершении родителя (PR_SET_PDEATHSIG).
+ */
+class CapturePublisher
+{
+public:
+    CapturePublisher(const QString& url, const QString& ringName,
+                     int slotCount = SharedFrameRing::DEFAULT_SLOT_COUNT);
+
+    /**
+     * @brief Цикл захвата до получения сигнала остановки
+     * @return Код завершения процесса
+     */
+    int run();
+
+    /**
+     * @brief Публиковать только ключевые кадры (см. FrameSource::setKeyframeOnly)
+     */
+    void setKeyframeInterval(int gopInterval);
+
+private:
+    bool openSource();
+    bool publish(const cv::Mat& frame);
+
+    QString m_url;
+    QString m_ringName;
+    int m_slotCount;
+    int m_keyframeGopInterval;
+    std::unique_ptr<FrameSource> m_source;
+    std::unique_ptr<SharedFrameRing> m_ring;
+
+    static constexpr int MAX_RECONNECT_DELAY_MS = 2000;  // Меньше таймаута heartbeat у ShmFrameSource
+};
+
+#endif // CAPTUREPUBLISHER_H
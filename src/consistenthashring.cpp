@@ -0,0 +1,70 @@
+#include "consistenthashring.h"
+
+void ConsistentHashRing::addNode(const QString& node)
+{
+    if (m_nodes.contains(node)) {
+        return;
+    }
+
+    m_nodes.append(node);
+    for (int replica = 0; replica < VIRTUAL_NODES; ++replica) {
+        m_ring[hash((node + "#" + QString::number(replica)).toUtf8())] = node;
+    }
+}
+
+void ConsistentHashRing::removeNode(const QString& node)
+{
+    if (!m_nodes.removeOne(node)) {
+        return;
+    }
+
+    for (auto it = m_ring.begin(); it != m_ring.end();) {
+        if (it->second == node) {
+            it = m_ring.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ConsistentHashRing::isEmpty() const
+{
+    return m_ring.empty();
+}
+
+QStringList ConsistentHashRing::nodes() const
+{
+    return m_nodes;
+}
+
+QString ConsistentHashRing::nodeFor(const QString& key) const
+{
+    if (m_ring.empty()) {
+        return QString();
+    }
+
+    // Первая точка кольца по часовой стрелке от хэша ключа
+    auto it = m_ring.lower_bound(hash(key.toUtf8()));
+    if (it == m_ring.end()) {
+        it = m_ring.begin();
+    }
+    return it->second;
+}
+
+quint64 ConsistentHashRing::hash(const QByteArray& data)
+{
+    quint64 value = 14695981039346656037ULL;
+    for (char byte : data) {
+        value ^= static_cast<quint8>(byte);
+        value *= 1099511628211ULL;
+    }
+
+    // Финальное перемешивание (fmix64 из MurmurHash3): у FNV-1a ключи,
+    // различающиеся последним символом ("node#1", "node#2"), ложатся рядом
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
@@ -0,0 +1,44 @@
+#ifndef CONSISTENTHASHRING_H
+#define CONSISTENTHASHRING_H
+
+#include <QString>
+#include <QStringList>
+#include <map>
+
+/**
+ * @class ConsistentHashRing
+ * @brief Кольцо согласованного хэширования для распределения камер по узлам
+ *
+ * Каждый узел занимает VIRTUAL_NODES точек на кольце, поэтому нагрузка
+ * распределяется равномерно, а при добавлении или удалении узла
+ * переназначается только ~1/N камер.
+ */
+class ConsistentHashRing
+{
+public:
+    void addNode(const QString& node);
+    void removeNode(const QString& node);
+    bool isEmpty() const;
+    QStringList nodes() const;
+
+    /**
+     * @brief Возвращает узел, отвечающий за ключ
+     * @return Имя узла или пустая строка, если узлов нет
+     */
+    QString nodeFor(const QString& key) const;
+
+    /**
+     * @brief 64-битный FNV-1a с финальным перемешиванием
+     *
+     * Стабилен между процессами и запусками, в отличие от qHash.
+     */
+    static quint64 hash(const QByteArray& data);
+
+private:
+    std::map<quint64, QString> m_ring;
+    QStringList m_nodes;
+
+    static constexpr int VIRTUAL_NODES = 64;
+};
+
+#endif // CONSISTENTHASHRING_H
@@ -0,0 +1,482 @@
+#include "ffmpegsource.h"
+#include "packetring.h"
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+
+// Счётчики потерь по контексту демультиплексора: FFmpeg сообщает о
+// пропущенных RTP-пакетах только через журнал
+QMutex g_lossRegistryMutex;
+QHash<void*, std::atomic<quint64>*> g_lossRegistry;
+std::once_flag g_ffmpegInitFlag;
+
+QString ffmpegErrorText(int error)
+{
+    char text[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(error, text, sizeof(text));
+    return QString::fromUtf8(text);
+}
+
+} // namespace
+
+AVFrameConverter::AVFrameConverter()
+    : m_swsContext(nullptr)
+{
+    m_lumaLut.create(1, 256, CV_8U);
+    for (int level = 0; level < 256; ++level) {
+        int expanded = ((level - 16) * 255 + 109) / 219;
+        m_lumaLut.at<uchar>(level) = static_cast<uchar>(std::min(255, std::max(0, expanded)));
+    }
+}
+
+AVFrameConverter::~AVFrameConverter()
+{
+    reset();
+}
+
+void AVFrameConverter::reset()
+{
+    m_luma = cv::Mat();
+    if (m_swsContext) {
+        sws_freeContext(m_swsContext);
+        m_swsContext = nullptr;
+    }
+}
+
+void AVFrameConverter::convert(const AVFrame* frame)
+{
+    extractLuma(frame);
+    convertToBgr(frame);
+}
+
+void AVFrameConverter::extractLuma(const AVFrame* frame)
+{
+    m_luma = cv::Mat();
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    // Плоскость Y доступна для 8-битных планарных и полупланарных YUV
+    if (!descriptor || (descriptor->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL))
+        || descriptor->comp[0].depth != 8 || descriptor->comp[0].plane != 0
+        || descriptor->comp[0].step != 1) {
+        return;
+    }
+
+    cv::Mat plane(frame->height, frame->width, CV_8UC1, frame->data[0],
+                  static_cast<size_t>(frame->linesize[0]));
+    bool fullRange = frame->color_range == AVCOL_RANGE_JPEG
+        || std::strncmp(descriptor->name, "yuvj", 4) == 0;
+    if (fullRange) {
+        m_luma = plane;
+    } else {
+        cv::LUT(plane, m_lumaLut, m_luma);
+    }
+}
+
+void AVFrameConverter::convertToBgr(const AVFrame* frame)
+{
+    m_swsContext = sws_getCachedContext(m_swsContext,
+                                        frame->width, frame->height,
+                                        static_cast<AVPixelFormat>(frame->format),
+                                        frame->width, frame->height, AV_PIX_FMT_BGR24,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        m_bgr = cv::Mat();
+        return;
+    }
+
+    m_bgr.create(frame->height, frame->width, CV_8UC3);
+    uint8_t* destination[4] = { m_bgr.data, nullptr, nullptr, nullptr };
+    int destinationStride[4] = { static_cast<int>(m_bgr.step), 0, 0, 0 };
+    sws_scale(m_swsContext, frame->data, frame->linesize, 0, frame->height,
+              destination, destinationStride);
+}
+
+FFmpegSource::FFmpegSource(const QString& location, bool loop, const BackendConfig& config)
+    : m_location(location)
+    , m_loop(loop)
+    , m_config(config)
+    , m_openTimeoutMs(0)
+    , m_formatContext(nullptr)
+    , m_codecContext(nullptr)
+    , m_frame(nullptr)
+    , m_packet(nullptr)
+    , m_videoStream(-1)
+    , m_draining(false)
+    , m_keyframeDrain(false)
+    , m_keyframeGopInterval(0)
+    , m_keyframesSeen(0)
+    , m_memoryShedding(false)
+    , m_waitKeyframe(false)
+    , m_consecutiveDecodeErrors(0)
+    , m_deadlineMs(0)
+{
+    std::call_once(g_ffmpegInitFlag, []() {
+        avformat_network_init();
+        av_log_set_callback(&FFmpegSource::logCallback);
+    });
+}
+
+FFmpegSource::~FFmpegSource()
+{
+    close();
+}
+
+void FFmpegSource::setOpenTimeout(int timeoutMs)
+{
+    m_openTimeoutMs = timeoutMs;
+}
+
+bool FFmpegSource::setKeyframeOnly(int gopInterval)
+{
+    m_keyframeGopInterval = qMax(0, gopInterval);
+    return true;
+}
+
+void FFmpegSource::armDeadline(int timeoutMs)
+{
+    m_deadlineMs = timeoutMs > 0 ? timeoutMs : DEFAULT_TIMEOUT_MS;
+    m_deadlineTimer.start();
+}
+
+int FFmpegSource::interruptCallback(void* opaque)
+{
+    // Прерывает блокирующие операции демультиплексора по таймауту
+    FFmpegSource* source = static_cast<FFmpegSource*>(opaque);
+    return source->m_deadlineTimer.isValid() && source->m_deadlineTimer.elapsed() > source->m_deadlineMs;
+}
+
+void FFmpegSource::logCallback(void* context, int level, const char* format, va_list args)
+{
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    av_log_default_callback(context, level, format, args);
+
+    // rtpdec: "RTP: missed %d packets" с контекстом демультиплексора RTSP
+    if (context && level <= AV_LOG_WARNING && std::strstr(format, "missed")) {
+        char text[256];
+        std::vsnprintf(text, sizeof(text), format, argsCopy);
+        const char* position = std::strstr(text, "missed ");
+        int missed = 0;
+        if (position && std::sscanf(position, "missed %d packets", &missed) == 1 && missed > 0) {
+            QMutexLocker locker(&g_lossRegistryMutex);
+            auto it = g_lossRegistry.find(context);
+            if (it != g_lossRegistry.end()) {
+                it.value()->fetch_add(static_cast<quint64>(missed), std::memory_order_relaxed);
+            }
+        }
+    }
+    va_end(argsCopy);
+}
+
+bool FFmpegSource::open()
+{
+    close();
+    m_stats = StreamStats();
+    m_stats.available = true;
+    m_packetsLost.store(0);
+
+    m_formatContext = avformat_alloc_context();
+    m_formatContext->interrupt_callback.callback = &FFmpegSource::interruptCallback;
+    m_formatContext->interrupt_callback.opaque = this;
+
+    // Минимальная буферизация демультиплексора: анализ нужен по свежим кадрам.
+    // Транспорт RTSP не навязывается: FFmpeg начинает с UDP, где rtpdec видит
+    // разрывы номеров и сообщает о потерях, и сам переходит на TCP, если UDP
+    // не проходит. Поверх TCP (interleaved) потерь на уровне RTP не бывает,
+    // и packetsLost остаётся нулевым
+    AVDictionary* options = nullptr;
+    av_dict_set(&options, "fflags", "nobuffer", 0);
+    av_dict_set(&options, "max_delay", "500000", 0);
+    for (auto it = m_config.demuxOptions.constBegin(); it != m_config.demuxOptions.constEnd(); ++it) {
+        av_dict_set(&options, it.key().toUtf8().constData(), it.value().toUtf8().constData(), 0);
+    }
+
+    armDeadline(m_openTimeoutMs);
+    int result = avformat_open_input(&m_formatContext, m_location.toUtf8().constData(), nullptr, &options);
+    av_dict_free(&options);
+    if (result < 0) {
+        qWarning() << "FFmpeg: cannot open" << m_location << ":" << ffmpegErrorText(result);
+        m_formatContext = nullptr;
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&g_lossRegistryMutex);
+        g_lossRegistry.insert(m_formatContext, &m_packetsLost);
+    }
+
+    result = avformat_find_stream_info(m_formatContext, nullptr);
+    if (result < 0) {
+        qWarning() << "FFmpeg: no stream info for" << m_location << ":" << ffmpegErrorText(result);
+        close();
+        return false;
+    }
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+    const AVCodec* codec = nullptr;
+#else
+    AVCodec* codec = nullptr;
+#endif
+    m_videoStream = av_find_best_stream(m_formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (m_videoStream < 0 || !codec) {
+        qWarning() << "FFmpeg: no decodable video stream in" << m_location;
+        close();
+        return false;
+    }
+
+    m_codecContext = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codecContext, m_formatContext->streams[m_videoStream]->codecpar);
+    // Только слайсовая многопоточность: кадровая задерживает выдачу на
+    // (потоков - 1) кадров, а при thread_count = 0 FFmpeg заводит по потоку
+    // на ядро в каждой камере. Потоки камер и так делят все ядра между собой
+    m_codecContext->thread_count = m_config.decodeThreads > 0 ? m_config.decodeThreads
+                                                              : DEFAULT_DECODE_THREADS;
+    m_codecContext->thread_type = FF_THREAD_SLICE;
+    if (m_keyframeGopInterval > 0) {
+        m_codecContext->skip_frame = AVDISCARD_NONKEY;
+    }
+
+    result = avcodec_open2(m_codecContext, codec, nullptr);
+    if (result < 0) {
+        qWarning() << "FFmpeg: cannot open decoder for" << m_location << ":" << ffmpegErrorText(result);
+        close();
+        return false;
+    }
+
+    if (m_packetRing) {
+        const AVStream* stream = m_formatContext->streams[m_videoStream];
+        m_packetRing->setStream(stream->codecpar, stream->time_base.num, stream->time_base.den);
+    }
+
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    m_draining = false;
+    m_keyframeDrain = false;
+    m_keyframesSeen = 0;
+    m_consecutiveDecodeErrors = 0;
+    m_deadlineTimer.invalidate();
+
+    qInfo() << "FFmpeg: opened" << m_location << "codec" << codec->name
+            << m_codecContext->width << "x" << m_codecContext->height
+            << "decode threads" << m_codecContext->thread_count;
+    return true;
+}
+
+bool FFmpegSource::rewind()
+{
+    if (av_seek_frame(m_formatContext, m_videoStream, 0, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(m_codecContext);
+    m_draining = false;
+    return true;
+}
+
+bool FFmpegSource::receiveFrame()
+{
+    while (true) {
+        int result = avcodec_receive_frame(m_codecContext, m_frame);
+        if (result == 0) {
+            m_consecutiveDecodeErrors = 0;
+            return true;
+        }
+        if (result == AVERROR_EOF) {
+            // Ключевой кадр выдан, декодер готов к следующему
+            if (m_keyframeDrain) {
+                avcodec_flush_buffers(m_codecContext);
+                m_keyframeDrain = false;
+                m_draining = false;
+                continue;
+            }
+            if (m_loop && rewind()) {
+                continue;
+            }
+            return false;
+        }
+        if (result != AVERROR(EAGAIN)) {
+            // Ошибка относится к одному кадру: поток продолжается со следующего
+            // пакета. Обрыв - только если декодер не выдаёт ничего, кроме ошибок
+            m_stats.decodeErrors++;
+            if (++m_consecutiveDecodeErrors >= MAX_CONSECUTIVE_DECODE_ERRORS) {
+                qWarning() << "FFmpeg: decoder keeps failing for" << m_location << ":" << ffmpegErrorText(result);
+                return false;
+            }
+        }
+
+        // Декодеру нужны новые пакеты
+        armDeadline(m_openTimeoutMs);
+        result = av_read_frame(m_formatContext, m_packet);
+        if (result < 0) {
+            if (result == AVERROR_EOF && !m_draining) {
+                // Забираем кадры, оставшиеся в потоках декодера
+                avcodec_send_packet(m_codecContext, nullptr);
+                m_draining = true;
+                continue;
+            }
+            if (result != AVERROR_EOF) {
+                qWarning() << "FFmpeg: read failed for" << m_location << ":" << ffmpegErrorText(result);
+            }
+            return false;
+        }
+
+        if (m_packet->stream_index != m_videoStream) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+
+        m_stats.packetsReceived++;
+        if (m_packet->flags & AV_PKT_FLAG_CORRUPT) {
+            m_stats.corruptPackets++;
+        }
+
+        // Предыстория хранит все пакеты, в том числе не идущие в декодер
+        if (m_packetRing) {
+            m_packetRing->push(m_packet);
+        }
+
+        // Режим ключевых кадров: P/B-кадры и лишние GOP не доходят до декодера.
+        // У предела памяти декодируется каждый ключевой кадр
+        bool isKey = (m_packet->flags & AV_PKT_FLAG_KEY) != 0;
+        bool keyframeOnly = m_keyframeGopInterval > 0 || m_memoryShedding;
+        bool wanted = true;
+        if (keyframeOnly) {
+            wanted = isKey && (m_keyframeGopInterval == 0 || (m_keyframesSeen++ % m_keyframeGopInterval) == 0);
+        } else if (m_waitKeyframe) {
+            // Опорные кадры после сброса нагрузки не декодировались
+            wanted = isKey;
+            m_waitKeyframe = !isKey;
+        }
+        if (!wanted) {
+            m_stats.packetsSkipped++;
+            av_packet_unref(m_packet);
+            continue;
+        }
+
+        result = avcodec_send_packet(m_codecContext, m_packet);
+        av_packet_unref(m_packet);
+        if (result < 0 && result != AVERROR(EAGAIN)) {
+            m_stats.decodeErrors++;
+        }
+
+        // Без следующих пакетов декодер держит кадр в очереди переупорядочивания,
+        // поэтому ключевой кадр выталкивается сигналом конца потока
+        if (keyframeOnly && result >= 0) {
+            avcodec_send_packet(m_codecContext, nullptr);
+            m_draining = true;
+            m_keyframeDrain = true;
+        }
+    }
+}
+
+bool FFmpegSource::read(cv::Mat& frame)
+{
+    if (!m_codecContext) {
+        return false;
+    }
+
+    if (!receiveFrame()) {
+        m_deadlineTimer.invalidate();
+        return false;
+    }
+    m_deadlineTimer.invalidate();
+
+    if (m_frame->decode_error_flags || (m_frame->flags & AV_FRAME_FLAG_CORRUPT)) {
+        m_stats.corruptFrames++;
+    }
+
+    int64_t timestamp = m_frame->best_effort_timestamp;
+    if (timestamp != AV_NOPTS_VALUE) {
+        AVRational timeBase = m_formatContext->streams[m_videoStream]->time_base;
+        m_stats.lastTimestampUs = av_rescale_q(timestamp, timeBase, AVRational{1, 1000000});
+    }
+
+    m_converter.convert(m_frame);
+    frame = m_converter.bgr();
+    return !frame.empty();
+}
+
+void FFmpegSource::close()
+{
+    if (m_formatContext) {
+        QMutexLocker locker(&g_lossRegistryMutex);
+        g_lossRegistry.remove(m_formatContext);
+    }
+
+    m_converter.reset();
+    if (m_packet) {
+        av_packet_free(&m_packet);
+    }
+    if (m_frame) {
+        av_frame_free(&m_frame);
+    }
+    if (m_codecContext) {
+        avcodec_free_context(&m_codecContext);
+    }
+    if (m_formatContext) {
+        avformat_close_input(&m_formatContext);
+    }
+    m_videoStream = -1;
+}
+
+bool FFmpegSource::isOpened() const
+{
+    return m_codecContext != nullptr;
+}
+
+double FFmpegSource::frameRate() const
+{
+    // Живые потоки задают темп сами, как и в VideoCaptureSource
+    if (!m_formatContext || m_videoStream < 0 || m_location.contains("://")) {
+        return 0.0;
+    }
+    AVRational rate = m_formatContext->streams[m_videoStream]->avg_frame_rate;
+    return rate.den > 0 ? av_q2d(rate) : 0.0;
+}
+
+bool FFmpegSource::setPreEventBuffer(int durationMs, qint64 maxBytes)
+{
+    m_packetRing.reset(durationMs > 0 ? new PacketRing(durationMs, maxBytes) : nullptr);
+    return true;
+}
+
+bool FFmpegSource::savePreEvent(const QString& path)
+{
+    return m_packetRing && m_packetRing->save(path);
+}
+
+void FFmpegSource::setMemoryShedding(bool enabled)
+{
+    if (m_memoryShedding == enabled) {
+        return;
+    }
+    m_memoryShedding = enabled;
+    m_waitKeyframe = !enabled && m_keyframeGopInterval == 0;
+    if (m_packetRing) {
+        m_packetRing->setSuspended(enabled);
+    }
+}
+
+cv::Mat FFmpegSource::lumaPlane() const
+{
+    return m_converter.luma();
+}
+
+FrameSource::StreamStats FFmpegSource::streamStats() const
+{
+    StreamStats stats = m_stats;
+    stats.packetsLost = m_packetsLost.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,128 @@
+#ifndef FFMPEGSOURCE_H
+#define FFMPEGSOURCE_H
+
+#include "framesource.h"
+#include <QElapsedTimer>
+#include <atomic>
+#include <cstdarg>
+#include <memory>
+
+class PacketRing;
+
+extern "C" {
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+}
+
+/**
+ * @class AVFrameConverter
+ * @brief Перевод кадра декодера в BGR и яркостную плоскость для анализатора
+ *
+ * Плоскость Y полного диапазона отдаётся без копирования, ограниченного
+ * растягивается до 0-255 таблицей. Результаты действительны до следующего
+ * convert() и пока жив исходный AVFrame.
+ */
+class AVFrameConverter
+{
+public:
+    AVFrameConverter();
+    ~AVFrameConverter();
+
+    void convert(const AVFrame* frame);
+    void reset();
+
+    const cv::Mat& bgr() const { return m_bgr; }
+    const cv::Mat& luma() const { return m_luma; }
+
+private:
+    void extractLuma(const AVFrame* frame);
+    void convertToBgr(const AVFrame* frame);
+
+    SwsContext* m_swsContext;
+    cv::Mat m_bgr;
+    cv::Mat m_luma;
+    cv::Mat m_lumaLut;          // Растяжение ограниченного диапазона Y (16-235) до 0-255
+};
+
+/**
+ * @class FFmpegSource
+ * @brief Источник на libavformat/libavcodec без cv::VideoCapture
+ *
+ * В отличие от cv::VideoCapture даёт:
+ * - управление буферизацией демультиплексора через опции avformat_open_input
+ *   (по умолчанию fflags=nobuffer и небольшой max_delay, транспорт RTSP
+ *   выбирает FFmpeg: UDP с переходом на TCP);
+ * - многопоточное декодирование по слайсам;
+ * - плоскость Y декодера без пересчёта из BGR (lumaPlane());
+ * - счётчики потерянных и повреждённых пакетов и ошибок декодера
+ *   (streamStats()), а также метки времени кадров. Потери RTP видны только
+ *   при транспорте UDP: поверх TCP пакеты не теряются;
+ * - режим ключевых кадров: пакеты P/B-кадров отбрасываются до декодера;
+ * - предысторию сжатых пакетов для записи без перекодирования (PacketRing).
+ *
+ * Декодирование программное, без привязки к аппаратным ускорителям.
+ * Доступен при сборке с HAVE_FFMPEG (см. CMakeLists.txt).
+ */
+class FFmpegSource : public FrameSource
+{
+public:
+    FFmpegSource(const QString& location, bool loop, const BackendConfig& config);
+    ~FFmpegSource();
+
+    bool open() override;
+    bool read(cv::Mat& frame) override;
+    void close() override;
+    bool isOpened() const override;
+    double frameRate() const override;
+    void setOpenTimeout(int timeoutMs) override;
+    bool setKeyframeOnly(int gopInterval) override;
+    bool setPreEventBuffer(int durationMs, qint64 maxBytes) override;
+    bool savePreEvent(const QString& path) override;
+    void setMemoryShedding(bool enabled) override;
+    cv::Mat lumaPlane() const override;
+    StreamStats streamStats() const override;
+
+private:
+    static int interruptCallback(void* opaque);
+    static void logCallback(void* context, int level, const char* format, va_list args);
+
+    bool receiveFrame();
+    bool rewind();
+    void armDeadline(int timeoutMs);
+
+    QString m_location;
+    bool m_loop;
+    BackendConfig m_config;
+    int m_openTimeoutMs;
+
+    AVFormatContext* m_formatContext;
+    AVCodecContext* m_codecContext;
+    AVFrame* m_frame;
+    AVPacket* m_packet;
+    int m_videoStream;
+    bool m_draining;            // Декодеру отправлен сигнал конца потока
+    bool m_keyframeDrain;       // Сброс декодера после одиночного ключевого кадра
+    int m_keyframeGopInterval;  // 0 - декодировать все кадры
+    quint64 m_keyframesSeen;
+    bool m_memoryShedding;      // У предела памяти: только ключевые кадры
+    bool m_waitKeyframe;        // После сброса нагрузки: пакеты до ключевого кадра не декодируются
+    int m_consecutiveDecodeErrors;   // Ошибки декодера подряд, без единого кадра
+
+    AVFrameConverter m_converter;
+    std::unique_ptr<PacketRing> m_packetRing;
+
+    QElapsedTimer m_deadlineTimer;
+    int m_deadlineMs;           // Таймаут текущей блокирующей операции
+
+    StreamStats m_stats;
+    std::atomic<quint64> m_packetsLost{0};   // Пишется из обработчика журнала FFmpeg
+
+    static constexpr int DEFAULT_TIMEOUT_MS = 10000;
+    static constexpr int DEFAULT_DECODE_THREADS = 2;
+    static constexpr int MAX_CONSECUTIVE_DECODE_ERRORS = 100;
+};
+
+#endif // FFMPEGSOURCE_H
@@ -0,0 +1,165 @@
+#include "framesource.h"
+#include "syntheticsource.h"
+#include "shmframesource.h"
+#ifdef HAVE_FFMPEG
+#include "ffmpegsource.h"
+#include "ingestsource.h"
+#endif
+#include <QDebug>
+#include <QUrl>
+#include <QUrlQuery>
+
+FrameSource::BackendConfig FrameSource::s_backendConfig;
+
+bool FrameSource::setBackendConfig(const BackendConfig& config)
+{
+#ifndef HAVE_FFMPEG
+    if (config.backend != CaptureBackend::OpenCV) {
+        qWarning() << "FFmpeg capture backends are not available in this build, using OpenCV";
+        s_backendConfig = config;
+        s_backendConfig.backend = CaptureBackend::OpenCV;
+        return false;
+    }
+#endif
+    s_backendConfig = config;
+    return true;
+}
+
+FrameSource::BackendConfig FrameSource::backendConfig()
+{
+    return s_backendConfig;
+}
+
+std::unique_ptr<FrameSource> FrameSource::create(const QString& url)
+{
+#ifdef HAVE_FFMPEG
+    bool useFFmpeg = s_backendConfig.backend != CaptureBackend::OpenCV;
+    bool useIngest = s_backendConfig.backend == CaptureBackend::Ingest;
+#endif
+
+    if (url.startsWith("synthetic://", Qt::CaseInsensitive)) {
+        return std::unique_ptr<FrameSource>(new SyntheticSource(url));
+    }
+
+    if (url.startsWith("shm://", Qt::CaseInsensitive)) {
+        return std::unique_ptr<FrameSource>(new ShmFrameSource(url.section("://", 1)));
+    }
+
+    if (url.startsWith("file://", Qt::CaseInsensitive)) {
+        QUrl fileUrl(url);
+        bool loop = QUrlQuery(fileUrl).queryItemValue("loop") == "1";
+#ifdef HAVE_FFMPEG
+        if (useIngest) {
+            return std::unique_ptr<FrameSource>(new IngestSource(fileUrl.toLocalFile(), loop));
+        }
+        if (useFFmpeg) {
+            return std::unique_ptr<FrameSource>(new FFmpegSource(fileUrl.toLocalFile(), loop, s_backendConfig));
+        }
+#endif
+        return std::unique_ptr<FrameSource>(new VideoCaptureSource(fileUrl.toLocalFile(), loop));
+    }
+
+    if (url.startsWith("rtsp://", Qt::CaseInsensitive) ||
+        url.startsWith("http://", Qt::CaseInsensitive) ||
+        url.startsWith("https://", Qt::CaseInsensitive)) {
+#ifdef HAVE_FFMPEG
+        // HTTP бэкенд ingest не разбирает - такие потоки остаются за FFmpegSource
+        if (useIngest && url.startsWith("rtsp://", Qt::CaseInsensitive)) {
+            return std::unique_ptr<FrameSource>(new IngestSource(url, false));
+        }
+        if (useFFmpeg) {
+            return std::unique_ptr<FrameSource>(new FFmpegSource(url, false, s_backendConfig));
+        }
+#endif
+        return std::unique_ptr<FrameSource>(new VideoCaptureSource(url));
+    }
+
+    return nullptr;
+}
+
+bool FrameSource::isSupportedUrl(const QString& url)
+{
+    static const char* const schemes[] = { "rtsp://", "http://", "https://", "file://", "synthetic://", "shm://" };
+    for (const char* scheme : schemes) {
+        if (url.startsWith(QLatin1String(scheme), Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+VideoCaptureSource::VideoCaptureSource(const QString& location, bool loop)
+    : m_location(location)
+    , m_loop(loop)
+    , m_openTimeoutMs(0)
+{
+}
+
+bool VideoCaptureSource::open()
+{
+#if (CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION) >= 40502
+    if (m_openTimeoutMs > 0) {
+        std::vector<int> params = {
+            cv::CAP_PROP_OPEN_TIMEOUT_MSEC, m_openTimeoutMs,
+            cv::CAP_PROP_READ_TIMEOUT_MSEC, m_openTimeoutMs
+        };
+        m_videoCapture.open(m_location.toStdString(), cv::CAP_FFMPEG, params);
+    } else {
+        m_videoCapture.open(m_location.toStdString(), cv::CAP_FFMPEG);
+    }
+#else
+    // Таймауты открытия появились в OpenCV 4.5.2; в старых версиях
+    // их можно задать через OPENCV_FFMPEG_CAPTURE_OPTIONS (stimeout)
+    m_videoCapture.open(m_location.toStdString(), cv::CAP_FFMPEG);
+#endif
+    
+    if (!m_videoCapture.isOpened()) {
+        qWarning() << "Не могу открыть поток:" << m_location;
+        return false;
+    }
+    
+    // Отключаем буферизацию для уменьшения задержки
+    m_videoCapture.set(cv::CAP_PROP_BUFFERSIZE, 1);
+    return true;
+}
+
+bool VideoCaptureSource::read(cv::Mat& frame)
+{
+    if (m_videoCapture.read(frame) && !frame.empty()) {
+        return true;
+    }
+
+    // Конец файла при воспроизведении по кругу - перематываем в начало
+    if (m_loop && m_videoCapture.isOpened()) {
+        m_videoCapture.set(cv::CAP_PROP_POS_FRAMES, 0);
+        return m_videoCapture.read(frame) && !frame.empty();
+    }
+    return false;
+}
+
+void VideoCaptureSource::setOpenTimeout(int timeoutMs)
+{
+    m_openTimeoutMs = timeoutMs;
+}
+
+void VideoCaptureSource::close()
+{
+    if (m_videoCapture.isOpened()) {
+        m_videoCapture.release();
+    }
+}
+
+bool VideoCaptureSource::isOpened() const
+{
+    return m_videoCapture.isOpened();
+}
+
+double VideoCaptureSource::frameRate() const
+{
+    // Для сетевых потоков FFmpeg часто сообщает заведомо неверную частоту,
+    // поэтому темп задаётся только при воспроизведении файла
+    if (!m_videoCapture.isOpened() || m_location.contains("://")) {
+        return 0.0;
+    }
+    return m_videoCapture.get(cv::CAP_PROP_FPS);
+}
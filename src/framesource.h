@@ -0,0 +1,208 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <QMap>
+#include <QString>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @class FrameSource
+ * @brief Абстрактный источник декодированных кадров для CameraWorker
+ *
+ * Скрывает от CameraWorker способ получения кадров: RTSP-поток, файл
+ * или синтетический генератор. Источник выбирается по схеме URL:
+ * - rtsp://, http://, https:// - сетевой поток через cv::VideoCapture
+ * - file:///path/video.mp4[?loop=1] - воспроизведение файла
+ * - synthetic://name?... - детерминированный генератор (см. SyntheticSource)
+ * - shm://name - кадры процесса захвата из разделяемой памяти (см. ShmFrameSource)
+ *
+ * Сетевые потоки и файлы декодируются через cv::VideoCapture либо, если
+ * выбран бэкенд FFmpeg (setBackendConfig), напрямую через libavformat/
+ * libavcodec (см. FFmpegSource). Бэкенд ingest обслуживает rtsp:// и file://
+ * общими потоками ввода-вывода и пулом декодирования (см. IngestSource).
+ *
+ * Кадр, возвращённый read(), остаётся действительным до следующего вызова
+ * read() или close() и не должен изменяться вызывающей стороной.
+ */
+class FrameSource
+{
+public:
+    /**
+     * @brief Бэкенд декодирования сетевых потоков и файлов
+     */
+    enum class CaptureBackend {
+        OpenCV,     // cv::VideoCapture
+        FFmpeg,     // libavformat/libavcodec напрямую (если собрано с HAVE_FFMPEG)
+        Ingest      // Общий реактор epoll и пул декодирования (если собрано с HAVE_FFMPEG)
+    };
+
+    struct BackendConfig {
+        CaptureBackend backend;
+        QMap<QString, QString> demuxOptions;   // Опции avformat_open_input (rtsp_transport, buffer_size, ...)
+        int decodeThreads;                     // Потоки декодера FFmpeg (0 - два), у ingest - размер пула (0 - по числу ядер)
+        int ingestThreads;                     // Потоки ввода-вывода бэкенда ingest
+
+        BackendConfig() : backend(CaptureBackend::OpenCV), decodeThreads(0), ingestThreads(2) {}
+    };
+
+    /**
+     * @brief Счётчики транспортного уровня (пакеты, ошибки декодера)
+     */
+    struct StreamStats {
+        bool available;              // Источник ведёт эти счётчики
+        quint64 packetsReceived;     // Видеопакеты, полученные демультиплексором
+        quint64 packetsLost;         // Потерянные RTP-пакеты (по разрывам номеров)
+        quint64 corruptPackets;      // Пакеты с флагом повреждения
+        quint64 corruptFrames;       // Кадры, декодированные с ошибками (маскирование)
+        quint64 decodeErrors;        // Пакеты, отвергнутые декодером
+        quint64 packetsSkipped;      // Пакеты, отброшенные без декодирования (режим ключевых кадров)
+        qint64 lastTimestampUs;      // Метка времени последнего кадра в потоке, мкс
+
+        StreamStats() : available(false), packetsReceived(0), packetsLost(0), corruptPackets(0),
+                        corruptFrames(0), decodeErrors(0), packetsSkipped(0), lastTimestampUs(0) {}
+    };
+
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief Открывает источник
+     * @return true при успешном подключении
+     */
+    virtual bool open() = 0;
+
+    /**
+     * @brief Читает следующий кадр
+     * @return false при ошибке чтения или разрыве соединения
+     */
+    virtual bool read(cv::Mat& frame) = 0;
+
+    /**
+     * @brief Закрывает источник и освобождает ресурсы
+     */
+    virtual void close() = 0;
+
+    virtual bool isOpened() const = 0;
+
+    /**
+     * @brief Номинальная частота кадров источника
+     * @return Кадров в секунду или 0, если частота неизвестна
+     */
+    virtual double frameRate() const { return 0.0; }
+
+    /**
+     * @brief Ограничивает время open() и ожидания кадра в read()
+     * @param timeoutMs Таймаут в мс; 0 - по умолчанию для источника
+     *
+     * Вызывается до open(). Без таймаута открытие потока с недоступного
+     * хоста может блокироваться на минуты.
+     */
+    virtual void setOpenTimeout(int /*timeoutMs*/) {}
+
+    /**
+     * @brief Декодировать только ключевые кадры
+     * @param gopInterval 0 - все кадры; N - ключевой кадр каждого N-го GOP
+     * @return false, если источник не умеет отбрасывать пакеты до декодирования
+     *
+     * Вызывается до open().
+     */
+    virtual bool setKeyframeOnly(int gopInterval) { return gopInterval <= 0; }
+
+    /**
+     * @brief Хранить сжатые пакеты последних секунд для записи предыстории
+     * @param durationMs Глубина предыстории; 0 - не хранить
+     * @param maxBytes Предел памяти пакетов
+     * @return false, если источник не видит сжатых пакетов (cv::VideoCapture, shm://)
+     *
+     * Вызывается до open(). Предыстория переживает переподключение к тому же потоку.
+     */
+    virtual bool setPreEventBuffer(int durationMs, qint64 /*maxBytes*/) { return durationMs <= 0; }
+
+    /**
+     * @brief Записывает предысторию в файл MP4/MKV без перекодирования (в фоне)
+     * @return false, если предыстория не ведётся или ещё пуста
+     */
+    virtual bool savePreEvent(const QString& /*path*/) { return false; }
+
+    /**
+     * @brief Сброс нагрузки у предела памяти
+     * @param enabled true - декодировать только ключевые кадры и не вести предысторию
+     *
+     * Вызывается в любой момент из потока камеры. После снятия декодирование
+     * всех кадров возобновляется с ближайшего ключевого кадра. Источники без
+     * доступа к пакетам вызов игнорируют.
+     */
+    virtual void setMemoryShedding(bool /*enabled*/) {}
+
+    /**
+     * @brief Проверяет, что последний прочитанный кадр не был изменён
+     *
+     * Источники без копирования (разделяемая память) могут перезаписать
+     * кадр во время его обработки; результат такой обработки отбрасывается.
+     */
+    virtual bool frameStillValid() const { return true; }
+
+    /**
+     * @brief Яркостная плоскость последнего кадра в полном диапазоне 0-255
+     * @return Плоскость Y декодера или пустая матрица, если источник её не даёт
+     *
+     * Позволяет анализатору взять яркость прямо из декодера вместо
+     * пересчёта из BGR. Действительна до следующего read().
+     */
+    virtual cv::Mat lumaPlane() const { return cv::Mat(); }
+
+    /**
+     * @brief Транспортные счётчики с момента open()
+     */
+    virtual StreamStats streamStats() const { return StreamStats(); }
+
+    /**
+     * @brief Создаёт источник по URL
+     * @return Источник или nullptr, если схема URL не поддерживается
+     */
+    static std::unique_ptr<FrameSource> create(const QString& url);
+
+    /**
+     * @brief Проверяет, поддерживается ли схема URL
+     */
+    static bool isSupportedUrl(const QString& url);
+
+    /**
+     * @brief Выбирает бэкенд для источников, создаваемых после вызова
+     * @return false, если бэкенд FFmpeg или ingest запрошен, но не собран
+     */
+    static bool setBackendConfig(const BackendConfig& config);
+    static BackendConfig backendConfig();
+
+private:
+    static BackendConfig s_backendConfig;
+};
+
+/**
+ * @class VideoCaptureSource
+ * @brief Источник на основе cv::VideoCapture (RTSP, HTTP, видеофайлы)
+ */
+class VideoCaptureSource : public FrameSource
+{
+public:
+    /**
+     * @param location URL потока или путь к файлу
+     * @param loop Перематывать файл в начало по достижении конца
+     */
+    explicit VideoCaptureSource(const QString& location, bool loop = false);
+
+    bool open() override;
+    bool read(cv::Mat& frame) override;
+    void close() override;
+    bool isOpened() const override;
+    double frameRate() const override;
+    void setOpenTimeout(int timeoutMs) override;
+
+private:
+    QString m_location;
+    bool m_loop;
+    int m_openTimeoutMs;
+    cv::VideoCapture m_videoCapture;
+};
+
+#endif // FRAMESOURCE_H
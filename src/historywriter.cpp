@@ -0,0 +1,102 @@
+#include "historywriter.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <functional>
+
+namespace {
+
+// QThreadPool::start(std::function) появился только в Qt 5.15
+class WriteTask : public QRunnable
+{
+public:
+    explicit WriteTask(std::function<void()> work) : m_work(std::move(work)) {}
+    void run() override { m_work(); }
+
+private:
+    std::function<void()> m_work;
+};
+
+} // namespace
+
+HistoryWriter::HistoryWriter(const QString& directory, const TimeSeriesStore::Retention& retention)
+    : m_store(directory)
+    , m_scheduled(false)
+    , m_dropped(0)
+{
+    m_store.setRetention(retention);
+    m_writerPool.setMaxThreadCount(1);
+}
+
+HistoryWriter::~HistoryWriter()
+{
+    waitForIdle();
+    m_writerPool.waitForDone();
+}
+
+void HistoryWriter::append(const QString& cameraKey, qint64 timestampMs,
+                           const ImageQualityAnalyzer::QualityResult& result)
+{
+    enqueue(Task{cameraKey, timestampMs, result, false});
+}
+
+void HistoryWriter::releaseCamera(const QString& cameraKey)
+{
+    enqueue(Task{cameraKey, 0, ImageQualityAnalyzer::QualityResult(), true});
+}
+
+void HistoryWriter::enqueue(Task&& task)
+{
+    QMutexLocker locker(&m_mutex);
+    // Освобождение камеры не отбрасывается, иначе её сегменты останутся открытыми
+    if (!task.release && static_cast<int>(m_queue.size()) >= MAX_QUEUED_RESULTS) {
+        if (m_dropped++ == 0) {
+            qWarning() << "History writer cannot keep up with the disk, dropping results";
+        }
+        return;
+    }
+    m_queue.push_back(std::move(task));
+    if (!m_scheduled) {
+        m_scheduled = true;
+        m_writerPool.start(new WriteTask([this]() { writePending(); }));
+    }
+}
+
+void HistoryWriter::writePending()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_queue.empty()) {
+        Task task = std::move(m_queue.front());
+        m_queue.pop_front();
+        locker.unlock();
+
+        if (task.release) {
+            m_store.releaseCamera(task.cameraKey);
+        } else {
+            m_store.append(task.cameraKey, task.timestampMs, task.result);
+        }
+
+        locker.relock();
+    }
+    m_scheduled = false;
+    m_idle.wakeAll();
+}
+
+void HistoryWriter::waitForIdle()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_scheduled) {
+        m_idle.wait(&m_mutex);
+    }
+}
+
+quint64 HistoryWriter::droppedResults() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_dropped;
+}
+
+QString HistoryWriter::directory() const
+{
+    return m_store.directory();
+}
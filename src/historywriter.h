@@ -0,0 +1,74 @@
+#ifndef HISTORYWRITER_H
+#define HISTORYWRITER_H
+
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <deque>
+#include "timeseriesstore.h"
+
+/**
+ * @class HistoryWriter
+ * @brief Запись истории результатов вне потока интерфейса
+ *
+ * Результаты всех камер ставятся в очередь, а в TimeSeriesStore их пишет
+ * отдельный поток (пул из одного потока, как у кодировщика SnapshotCache).
+ * Запись в отображённые сегменты, их рост и удаление старых файлов могут
+ * ждать диска; поток интерфейса при этом не блокируется.
+ *
+ * Очередь ограничена MAX_QUEUED_RESULTS: если диск не успевает, новые
+ * результаты отбрасываются и учитываются в droppedResults(). Деструктор
+ * дописывает очередь до конца.
+ *
+ * Методы потокобезопасны.
+ */
+class HistoryWriter
+{
+public:
+    HistoryWriter(const QString& directory, const TimeSeriesStore::Retention& retention);
+    ~HistoryWriter();
+
+    /**
+     * @brief Ставит результат в очередь записи
+     */
+    void append(const QString& cameraKey, qint64 timestampMs,
+                const ImageQualityAnalyzer::QualityResult& result);
+
+    /**
+     * @brief Закрывает сегменты камеры после записи её результатов из очереди
+     */
+    void releaseCamera(const QString& cameraKey);
+
+    /**
+     * @brief Ждёт, пока очередь не будет записана
+     */
+    void waitForIdle();
+
+    quint64 droppedResults() const;
+    QString directory() const;
+
+private:
+    struct Task {
+        QString cameraKey;
+        qint64 timestampMs;
+        ImageQualityAnalyzer::QualityResult result;
+        bool release;           // Закрыть сегменты камеры вместо записи
+    };
+
+    void enqueue(Task&& task);
+    void writePending();
+
+    TimeSeriesStore m_store;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_idle;
+    std::deque<Task> m_queue;
+    bool m_scheduled;           // Задача записи стоит в пуле или выполняется
+    quint64 m_dropped;
+    QThreadPool m_writerPool;
+
+    const int MAX_QUEUED_RESULTS = 4096;
+};
+
+#endif // HISTORYWRITER_H
@@ -1,9 +1,21 @@
 #include "imagequalityanalyzer.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <time.h>
 
 ImageQualityAnalyzer::ImageQualityAnalyzer(QObject *parent)
     : QObject(parent)
+    , m_frozenFrameCount(0)
+    , m_keyframeMode(false)
+    , m_lowMemoryMode(false)
+    , m_stageTiming(false)
+    , m_helperCpuNs(0)
+    , m_lastCpuNs(0)
 {
 }
 
@@ -11,7 +23,58 @@ ImageQualityAnalyzer::~ImageQualityAnalyzer()
 {
 }
 
-ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::analyze(const cv::Mat& frame)
+ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::analyze(const cv::Mat& frame, QImage* displayImage,
+                                                                  const cv::Mat& luma)
+{
+    qint64 cpuStart = threadCpuTimeNs();
+    m_helperCpuNs.store(0, std::memory_order_relaxed);
+    QualityResult result = evaluate(frame, displayImage, luma, true);
+    m_lastCpuNs = threadCpuTimeNs() - cpuStart + m_helperCpuNs.load(std::memory_order_relaxed);
+    emit analysisCompleted(result);
+    return result;
+}
+
+void ImageQualityAnalyzer::analyzeBatch(const cv::Mat* frames, size_t count, QualityResult* results)
+{
+    if (count == 0) {
+        return;
+    }
+    QMutexLocker locker(&m_batchMutex);
+
+    // Непрерывные диапазоны кадров по числу потоков OpenCV: у каждого
+    // диапазона свой набор буферов, и он один на весь диапазон. Полосы
+    // совмещённого прохода внутри кадра при этом идут последовательно
+    // (вложенный parallel_for_), что для небольших кадров и выгоднее
+    const int ranges = static_cast<int>(std::min<size_t>(count, static_cast<size_t>(std::max(1, cv::getNumThreads()))));
+    while (static_cast<int>(m_batchScratch.size()) < ranges) {
+        m_batchScratch.emplace_back(new ImageQualityAnalyzer());
+    }
+    for (int i = 0; i < ranges; ++i) {
+        m_batchScratch[i]->setKeyframeMode(m_keyframeMode);
+        m_batchScratch[i]->setLowMemoryMode(m_lowMemoryMode);
+    }
+
+    cv::parallel_for_(cv::Range(0, ranges), [&](const cv::Range& range) {
+        for (int part = range.start; part < range.end; ++part) {
+            ImageQualityAnalyzer& scratch = *m_batchScratch[part];
+            size_t begin = count * part / ranges;
+            size_t end = count * (part + 1) / ranges;
+            for (size_t i = begin; i < end; ++i) {
+                results[i] = scratch.evaluate(frames[i], nullptr, cv::Mat(), false);
+            }
+        }
+    }, ranges);
+}
+
+std::vector<ImageQualityAnalyzer::QualityResult> ImageQualityAnalyzer::analyzeBatch(const std::vector<cv::Mat>& frames)
+{
+    std::vector<QualityResult> results(frames.size());
+    analyzeBatch(frames.data(), frames.size(), results.data());
+    return results;
+}
+
+ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::evaluate(const cv::Mat& frame, QImage* displayImage,
+                                                                   const cv::Mat& luma, bool trackState)
 {
     QualityResult result;
     result.isValid = false;
@@ -22,18 +85,70 @@ ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::analyze(const cv::Mat&
         return result;
     }
 
+    // Яркость декодера подходит, только если описывает тот же кадр
+    bool useLuma = !luma.empty() && luma.type() == CV_8UC1 && luma.size() == frame.size();
+
+    QElapsedTimer stageTimer;
+    if (m_stageTiming) {
+        stageTimer.start();
+    }
+
     try {
-        cv::Mat grayFrame;
-        if (frame.channels() == 3) {
-            cv::cvtColor(frame, grayFrame, cv::COLOR_BGR2GRAY);
+        // Серый кадр пишется в переиспользуемый буфер; после анализа он
+        // становится предыдущим кадром для детектора застывания.
+        // Для BGR-кадра серый план, гистограмма, цветовая статистика и
+        // RGB-буфер для GUI получаются за одно чтение кадра.
+        ColorStats colorStats = {};
+        bool hasColorStats = false;
+        if (frame.channels() == 3 && frame.depth() == CV_8U) {
+            uchar* rgbData = nullptr;
+            size_t rgbStep = 0;
+            if (displayImage) {
+                *displayImage = QImage(frame.cols, frame.rows, QImage::Format_RGB888);
+                rgbData = displayImage->bits();
+                rgbStep = static_cast<size_t>(displayImage->bytesPerLine());
+            }
+            computeColorPass(frame, useLuma ? luma : cv::Mat(), rgbData, rgbStep, m_histogram, colorStats);
+            hasColorStats = true;
         } else {
-            grayFrame = frame.clone();
+            if (useLuma) {
+                luma.copyTo(m_buffers.gray);
+            } else if (frame.channels() == 4) {
+                cv::cvtColor(frame, m_buffers.gray, cv::COLOR_BGRA2GRAY);
+            } else if (frame.channels() == 3) {
+                // BGR с глубиной не CV_8U совмещённый проход не поддерживает
+                cv::cvtColor(frame, m_buffers.gray, cv::COLOR_BGR2GRAY);
+            } else {
+                frame.copyTo(m_buffers.gray);
+            }
+            computeLuminanceHistogram(m_buffers.gray, m_histogram);
+            if (displayImage) {
+                *displayImage = matToQImage(frame);
+            }
         }
+        const cv::Mat& grayFrame = m_buffers.gray;
 
         double noiseScore = calculateNoiseScore(grayFrame);
-        double contrastScore = calculateContrastScore(grayFrame);
+        double contrastScore = calculateContrastScore(m_histogram);
         double sharpnessScore = calculateSharpnessScore(grayFrame);
-        double overexposedPercent = calculateOverexposedPercentage(grayFrame);
+        double overexposedPercent = calculateOverexposedPercentage(m_histogram);
+        double underexposedPercent = calculateUnderexposedPercentage(m_histogram);
+        double dynamicRange = calculateDynamicRange(m_histogram);
+        qint64 baseNs = m_stageTiming ? stageTimer.nsecsElapsed() : 0;
+        double blockinessScore = calculateBlockinessScore(grayFrame);
+        double frequencyBlurScore = calculateFrequencyBlurScore(grayFrame);
+        // Кадры пакета независимы: застывание по ним не оценивается
+        bool frozen = trackState && detectFrozenFrame(grayFrame);
+        int frozenFrameCount = 0;
+        if (trackState) {
+            m_frozenFrameCount = frozen ? m_frozenFrameCount + 1 : 0;
+            frozenFrameCount = m_frozenFrameCount;
+        }
+        if (m_stageTiming) {
+            ++m_stageTimes.frames;
+            m_stageTimes.baseNs += baseNs;
+            m_stageTimes.extendedNs += stageTimer.nsecsElapsed() - baseNs;
+        }
 
         double overallScore = 
             noiseScore * NOISE_WEIGHT +
@@ -44,14 +159,45 @@ ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::analyze(const cv::Mat&
         if (overallScore > 100.0) overallScore = 100.0;
         if (overallScore < 0.0) overallScore = 0.0;
 
+        // Застывший поток не несёт полезного изображения
+        bool streamFrozen = frozenFrameCount >= (m_keyframeMode ? FREEZE_MIN_KEYFRAMES : FREEZE_MIN_FRAMES);
+        if (streamFrozen) {
+            overallScore = 0.0;
+        }
+
         result.noiseScore = noiseScore;
         result.contrastScore = contrastScore;
         result.sharpnessScore = sharpnessScore;
         result.overexposedPercent = overexposedPercent;
+        result.underexposedPercent = underexposedPercent;
+        result.dynamicRange = dynamicRange;
+        result.blockinessScore = blockinessScore;
+        result.frequencyBlurScore = frequencyBlurScore;
+        result.isFrozen = frozen;
+        result.frozenFrameCount = frozenFrameCount;
+        result.keyframeMode = m_keyframeMode;
+        if (hasColorStats) {
+            applyColorStats(colorStats, result);
+        }
+        if (trackState && hasReferenceFrame()) {
+            if (m_reference.gray.size() != grayFrame.size()) {
+                prepareReference(grayFrame.size());
+            }
+            result.psnr = calculatePsnr(grayFrame);
+            result.ssim = calculateSsim(grayFrame);
+            result.hasReference = true;
+        }
         result.overallScore = overallScore;
         result.isValid = true;
 
-        if (result.overallScore >= 80) {
+        // Текущий серый кадр становится предыдущим для детектора застывания
+        if (trackState) {
+            cv::swap(m_buffers.gray, m_buffers.prevGray);
+        }
+
+        if (streamFrozen) {
+            result.status = "Видеопоток застыл";
+        } else if (result.overallScore >= 80) {
             result.status = "Отличное качество";
         } else if (result.overallScore >= 60) {
             result.status = "Хорошее качество";
@@ -67,44 +213,235 @@ ImageQualityAnalyzer::QualityResult ImageQualityAnalyzer::analyze(const cv::Mat&
         result.overallScore = 0.0;
     }
 
-    emit analysisCompleted(result);
     return result;
 }
 
 double ImageQualityAnalyzer::calculateNoiseScore(const cv::Mat& frame)
 {
-    // Отладочная информация для диагностики
-    qDebug() << "[Noise] Frame channels:" << frame.channels();
-    qDebug() << "[Noise] Frame size:" << frame.cols << "x" << frame.rows;
-    qDebug() << "[Noise] Frame type:" << frame.type();
-    
-    cv::Mat blurred;
-    cv::GaussianBlur(frame, blurred, cv::Size(5, 5), 0);
-    
-    cv::Mat diff;
-    cv::absdiff(frame, blurred, diff);
-    
-    cv::Scalar meanDiff = cv::mean(diff);
-    double noiseLevel = meanDiff[0];
-    
-    qDebug() << "[Noise] Raw noise level:" << noiseLevel;
-    qDebug() << "[Noise] MAX_NOISE_VARIANCE:" << MAX_NOISE_VARIANCE;
+    double noiseLevel = 0.0;
+    if (m_lowMemoryMode) {
+        // Буферы на одну полосу; последняя, неполная, пишется в их начало
+        m_buffers.blurred.create(LOW_MEMORY_STRIP_ROWS, frame.cols, CV_8UC1);
+        m_buffers.diff.create(LOW_MEMORY_STRIP_ROWS, frame.cols, CV_8UC1);
+        double diffSum = 0.0;
+        for (int y = 0; y < frame.rows; y += LOW_MEMORY_STRIP_ROWS) {
+            cv::Rect strip(0, y, frame.cols, std::min(LOW_MEMORY_STRIP_ROWS, frame.rows - y));
+            cv::Rect target(0, 0, strip.width, strip.height);
+            cv::Mat blurred = m_buffers.blurred(target);
+            cv::Mat diff = m_buffers.diff(target);
+            cv::GaussianBlur(frame(strip), blurred, cv::Size(5, 5), 0);
+            cv::absdiff(frame(strip), blurred, diff);
+            diffSum += cv::sum(diff)[0];
+        }
+        noiseLevel = diffSum / static_cast<double>(frame.total());
+    } else {
+        cv::GaussianBlur(frame, m_buffers.blurred, cv::Size(5, 5), 0);
+        cv::absdiff(frame, m_buffers.blurred, m_buffers.diff);
+        noiseLevel = cv::mean(m_buffers.diff)[0];
+    }
     
     double noiseScore = 100.0 - (noiseLevel / MAX_NOISE_VARIANCE) * 100.0;
     if (noiseScore < 0.0) noiseScore = 0.0;
     if (noiseScore > 100.0) noiseScore = 100.0;
     
-    qDebug() << "[Noise] Calculated score:" << noiseScore;
-    
     return noiseScore;
 }
 
-double ImageQualityAnalyzer::calculateContrastScore(const cv::Mat& frame)
+void ImageQualityAnalyzer::computeColorPass(const cv::Mat& frame, const cv::Mat& luma,
+                                            uchar* rgbData, size_t rgbStep,
+                                            LuminanceHistogram& histogram, ColorStats& stats)
 {
-    double minVal, maxVal;
-    cv::minMaxLoc(frame, &minVal, &maxVal);
+    m_buffers.gray.create(frame.rows, frame.cols, CV_8UC1);
+    cv::Mat& gray = m_buffers.gray;
+
+    const int stripRows = COLOR_STRIP_ROWS;
+    const int clipLevel = COLOR_CLIP_LEVEL;
+    const int stripCount = (frame.rows + stripRows - 1) / stripRows;
+    std::vector<ColorStripAccumulator>& strips = m_buffers.colorStrips;
+    strips.resize(stripCount);
+
+    // Каждая полоса пишет только в свой накопитель, синхронизация не нужна.
+    // Время полос в потоках пула учитывается в стоимости анализа отдельно:
+    // время вызывающего потока и так измеряется целиком
+    const std::thread::id caller = std::this_thread::get_id();
+    cv::parallel_for_(cv::Range(0, stripCount), [&](const cv::Range& range) {
+        const bool helper = std::this_thread::get_id() != caller;
+        const qint64 cpuStart = helper ? threadCpuTimeNs() : 0;
+        for (int strip = range.start; strip < range.end; ++strip) {
+            ColorStripAccumulator& accumulator = strips[strip];
+            std::memset(&accumulator, 0, sizeof(accumulator));
+
+            int yBegin = strip * stripRows;
+            int yEnd = std::min(frame.rows, yBegin + stripRows);
+            for (int y = yBegin; y < yEnd; ++y) {
+                const uchar* src = frame.ptr<uchar>(y);
+                const uchar* srcLuma = luma.empty() ? nullptr : luma.ptr<uchar>(y);
+                uchar* dstGray = gray.ptr<uchar>(y);
+                uint64_t sumBlue = 0, sumGreen = 0, sumRed = 0, sumChroma = 0, clipped = 0;
+
+                for (int x = 0; x < frame.cols; ++x) {
+                    int b = src[3 * x];
+                    int g = src[3 * x + 1];
+                    int r = src[3 * x + 2];
+
+                    // Целочисленные коэффициенты BT.601, как в cv::COLOR_BGR2GRAY;
+                    // яркость декодера берётся как есть
+                    int level = srcLuma ? srcLuma[x] : (r * 4899 + g * 9617 + b * 1868 + 8192) >> 14;
+                    dstGray[x] = static_cast<uchar>(level);
+                    ++accumulator.bins[level];
+
+                    int maxChannel = std::max(r, std::max(g, b));
+                    int minChannel = std::min(r, std::min(g, b));
+                    sumBlue += b;
+                    sumGreen += g;
+                    sumRed += r;
+                    sumChroma += maxChannel - minChannel;
+                    // Клиппинг части каналов искажает оттенок; полностью белый пиксель
+                    // учитывается пересветом
+                    clipped += (maxChannel >= clipLevel && minChannel < clipLevel) ? 1 : 0;
+                }
+
+                // Строка уже в кэше: перестановка каналов для GUI почти бесплатна
+                if (rgbData) {
+                    uchar* dstRgb = rgbData + static_cast<size_t>(y) * rgbStep;
+                    for (int x = 0; x < frame.cols; ++x) {
+                        dstRgb[3 * x] = src[3 * x + 2];
+                        dstRgb[3 * x + 1] = src[3 * x + 1];
+                        dstRgb[3 * x + 2] = src[3 * x];
+                    }
+                }
+
+                accumulator.stats.sumBlue += sumBlue;
+                accumulator.stats.sumGreen += sumGreen;
+                accumulator.stats.sumRed += sumRed;
+                accumulator.stats.sumChroma += sumChroma;
+                accumulator.stats.clippedPixels += clipped;
+            }
+            accumulator.stats.total = static_cast<uint64_t>(yEnd - yBegin) * static_cast<uint64_t>(frame.cols);
+        }
+        if (helper) {
+            m_helperCpuNs.fetch_add(threadCpuTimeNs() - cpuStart, std::memory_order_relaxed);
+        }
+    });
+
+    std::memset(&histogram, 0, sizeof(histogram));
+    std::memset(&stats, 0, sizeof(stats));
+    for (const ColorStripAccumulator& accumulator : strips) {
+        for (int level = 0; level < 256; ++level) {
+            histogram.bins[level] += accumulator.bins[level];
+        }
+        stats.sumBlue += accumulator.stats.sumBlue;
+        stats.sumGreen += accumulator.stats.sumGreen;
+        stats.sumRed += accumulator.stats.sumRed;
+        stats.sumChroma += accumulator.stats.sumChroma;
+        stats.clippedPixels += accumulator.stats.clippedPixels;
+        stats.total += accumulator.stats.total;
+    }
+    histogram.total = stats.total;
+}
+
+void ImageQualityAnalyzer::applyColorStats(const ColorStats& stats, QualityResult& result)
+{
+    if (stats.total == 0) {
+        return;
+    }
+
+    double pixels = static_cast<double>(stats.total);
+    double meanBlue = stats.sumBlue / pixels;
+    double meanGreen = stats.sumGreen / pixels;
+    double meanRed = stats.sumRed / pixels;
+
+    result.meanChroma = (stats.sumChroma / pixels) / 255.0 * 100.0;
+    result.saturationClippedPercent = (stats.clippedPixels / pixels) * 100.0;
+
+    // Gray-world: в среднем сцена нейтральна, отклонение хроматичности
+    // средних каналов от (1/3, 1/3, 1/3) считается цветовым сдвигом
+    double channelSum = meanBlue + meanGreen + meanRed;
+    if (channelSum > 0.0) {
+        double third = 1.0 / 3.0;
+        double blue = meanBlue / channelSum - third;
+        double green = meanGreen / channelSum - third;
+        double red = meanRed / channelSum - third;
+        double deviation = std::sqrt(blue * blue + green * green + red * red);
+        result.colorCast = std::min(100.0, (deviation / MAX_COLOR_CAST) * 100.0);
+    }
+
+    if (meanGreen > 0.0) {
+        result.whiteBalanceRed = meanRed / meanGreen;
+        result.whiteBalanceBlue = meanBlue / meanGreen;
+    }
+}
+
+void ImageQualityAnalyzer::computeLuminanceHistogram(const cv::Mat& frame, LuminanceHistogram& histogram)
+{
+    // Гистограмма не векторизуется напрямую: в SIMD нет разброса инкрементов
+    // без конфликтов по одинаковым корзинам. Вместо этого пиксели читаются
+    // по 8 одним 64-битным словом, а четыре независимые подгистограммы
+    // убирают зависимость соседних инкрементов по одной и той же корзине и
+    // позволяют процессору выполнять их параллельно; в конце они сводятся в одну.
+    uint32_t partial[4][256];
+    std::memset(partial, 0, sizeof(partial));
+
+    for (int y = 0; y < frame.rows; ++y) {
+        const uchar* row = frame.ptr<uchar>(y);
+        int x = 0;
+        for (; x + 8 <= frame.cols; x += 8) {
+            uint64_t pixels;
+            std::memcpy(&pixels, row + x, sizeof(pixels));
+            ++partial[0][pixels & 0xFF];
+            ++partial[1][(pixels >> 8) & 0xFF];
+            ++partial[2][(pixels >> 16) & 0xFF];
+            ++partial[3][(pixels >> 24) & 0xFF];
+            ++partial[0][(pixels >> 32) & 0xFF];
+            ++partial[1][(pixels >> 40) & 0xFF];
+            ++partial[2][(pixels >> 48) & 0xFF];
+            ++partial[3][pixels >> 56];
+        }
+        for (; x < frame.cols; ++x) {
+            ++partial[0][row[x]];
+        }
+    }
+
+    for (int level = 0; level < 256; ++level) {
+        histogram.bins[level] = partial[0][level] + partial[1][level] +
+                                partial[2][level] + partial[3][level];
+    }
+    histogram.total = static_cast<uint64_t>(frame.rows) * static_cast<uint64_t>(frame.cols);
+}
+
+int ImageQualityAnalyzer::LuminanceHistogram::percentile(double fraction) const
+{
+    uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(total));
+    uint64_t accumulated = 0;
+    for (int level = 0; level < 256; ++level) {
+        accumulated += bins[level];
+        if (accumulated > target) {
+            return level;
+        }
+    }
+    return 255;
+}
+
+double ImageQualityAnalyzer::LuminanceHistogram::percentInRange(int from, int to) const
+{
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t count = 0;
+    for (int level = std::max(0, from); level <= std::min(255, to); ++level) {
+        count += bins[level];
+    }
+    return (static_cast<double>(count) / static_cast<double>(total)) * 100.0;
+}
+
+double ImageQualityAnalyzer::calculateContrastScore(const LuminanceHistogram& histogram)
+{
+    // Перцентили вместо min/max: единичный битый или горячий пиксель
+    // не должен давать полный диапазон яркости
+    int low = histogram.percentile(CONTRAST_PERCENTILE);
+    int high = histogram.percentile(1.0 - CONTRAST_PERCENTILE);
     
-    double contrastRange = maxVal - minVal;
+    double contrastRange = high - low;
     double contrastScore = (contrastRange / IDEAL_CONTRAST) * 100.0;
     
     if (contrastScore > 100.0) contrastScore = 100.0;
@@ -119,13 +456,31 @@ double ImageQualityAnalyzer::calculateContrastScore(const cv::Mat& frame)
 
 double ImageQualityAnalyzer::calculateSharpnessScore(const cv::Mat& frame)
 {
-    cv::Mat laplacian;
-    cv::Laplacian(frame, laplacian, CV_64F, 3);
-    
-    cv::Scalar mean, stdDev;
-    cv::meanStdDev(laplacian, mean, stdDev);
-    
-    double laplacianVariance = stdDev[0] * stdDev[0];
+    double laplacianVariance = 0.0;
+    if (m_lowMemoryMode) {
+        // Лапласиан 3x3 кадра 8 бит не выходит за ±2040 - хватает CV_16S;
+        // дисперсия собирается из сумм по полосам
+        m_buffers.laplacian.create(LOW_MEMORY_STRIP_ROWS, frame.cols, CV_16SC1);
+        double sum = 0.0, squareSum = 0.0;
+        for (int y = 0; y < frame.rows; y += LOW_MEMORY_STRIP_ROWS) {
+            cv::Rect strip(0, y, frame.cols, std::min(LOW_MEMORY_STRIP_ROWS, frame.rows - y));
+            cv::Mat laplacian = m_buffers.laplacian(cv::Rect(0, 0, strip.width, strip.height));
+            cv::Laplacian(frame(strip), laplacian, CV_16S, 3);
+            cv::Scalar mean, stdDev;
+            cv::meanStdDev(laplacian, mean, stdDev);
+            double pixels = static_cast<double>(laplacian.total());
+            sum += mean[0] * pixels;
+            squareSum += (stdDev[0] * stdDev[0] + mean[0] * mean[0]) * pixels;
+        }
+        double pixels = static_cast<double>(frame.total());
+        double mean = sum / pixels;
+        laplacianVariance = std::max(0.0, squareSum / pixels - mean * mean);
+    } else {
+        cv::Laplacian(frame, m_buffers.laplacian, CV_64F, 3);
+        cv::Scalar mean, stdDev;
+        cv::meanStdDev(m_buffers.laplacian, mean, stdDev);
+        laplacianVariance = stdDev[0] * stdDev[0];
+    }
     double sharpnessScore = (laplacianVariance / IDEAL_SHARPNESS) * 100.0;
     
     if (sharpnessScore > 100.0) sharpnessScore = 100.0;
@@ -134,14 +489,9 @@ double ImageQualityAnalyzer::calculateSharpnessScore(const cv::Mat& frame)
     return sharpnessScore;
 }
 
-double ImageQualityAnalyzer::calculateOverexposedPercentage(const cv::Mat& frame)
+double ImageQualityAnalyzer::calculateOverexposedPercentage(const LuminanceHistogram& histogram)
 {
-    cv::Mat overexposedMask;
-    cv::threshold(frame, overexposedMask, OVEREXPOSED_THRESHOLD, 255, cv::THRESH_BINARY);
-    
-    int overexposedCount = cv::countNonZero(overexposedMask);
-    double totalPixels = frame.rows * frame.cols;
-    double overexposedPercent = (overexposedCount / totalPixels) * 100.0;
+    double overexposedPercent = histogram.percentInRange(OVEREXPOSED_THRESHOLD + 1, 255);
     
     if (overexposedPercent > 100.0) overexposedPercent = 100.0;
     if (overexposedPercent < 0.0) overexposedPercent = 0.0;
@@ -149,21 +499,331 @@ double ImageQualityAnalyzer::calculateOverexposedPercentage(const cv::Mat& frame
     return overexposedPercent;
 }
 
+double ImageQualityAnalyzer::calculateUnderexposedPercentage(const LuminanceHistogram& histogram)
+{
+    double underexposedPercent = histogram.percentInRange(0, UNDEREXPOSED_THRESHOLD - 1);
+    
+    if (underexposedPercent > 100.0) underexposedPercent = 100.0;
+    if (underexposedPercent < 0.0) underexposedPercent = 0.0;
+    
+    return underexposedPercent;
+}
+
+double ImageQualityAnalyzer::calculateDynamicRange(const LuminanceHistogram& histogram)
+{
+    // Отношение светлого и тёмного перцентилей в ступенях экспозиции;
+    // +1 исключает деление на ноль для чёрного уровня
+    int low = histogram.percentile(DYNAMIC_RANGE_PERCENTILE);
+    int high = histogram.percentile(1.0 - DYNAMIC_RANGE_PERCENTILE);
+    
+    return std::log2((high + 1.0) / (low + 1.0));
+}
+
+double ImageQualityAnalyzer::calculateBlockinessScore(const cv::Mat& frame)
+{
+    // Сравниваем средние перепады яркости на границах блоков 8x8 и внутри блоков.
+    // Для экономии берутся только строки у границы блока и в его середине:
+    // около четверти кадра вместо полного прохода.
+    const int mask = BLOCK_SIZE - 1;
+    double horizontalBoundary = 0.0, horizontalInner = 0.0;
+    double verticalBoundary = 0.0, verticalInner = 0.0;
+    int64_t horizontalBoundaryCount = 0, horizontalInnerCount = 0;
+    int64_t verticalBoundaryCount = 0, verticalInnerCount = 0;
+
+    for (int blockY = 0; blockY + BLOCK_SIZE < frame.rows; blockY += BLOCK_SIZE) {
+        // Горизонтальные перепады в строке в середине блока
+        const uchar* row = frame.ptr<uchar>(blockY + BLOCK_SIZE / 2);
+        int64_t phaseSum[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (int x = 0; x + 1 < frame.cols; ++x) {
+            phaseSum[(x + 1) & mask] += std::abs(row[x + 1] - row[x]);
+        }
+        int64_t perPhase = (frame.cols - 1) / BLOCK_SIZE;
+        horizontalBoundary += static_cast<double>(phaseSum[0]);
+        horizontalBoundaryCount += perPhase;
+        for (int phase = 1; phase < BLOCK_SIZE; ++phase) {
+            horizontalInner += static_cast<double>(phaseSum[phase]);
+        }
+        horizontalInnerCount += (frame.cols - 1) - perPhase;
+
+        // Вертикальные перепады: пара строк на границе блока и пара в середине
+        const uchar* lastRow = frame.ptr<uchar>(blockY + BLOCK_SIZE - 1);
+        const uchar* nextRow = frame.ptr<uchar>(blockY + BLOCK_SIZE);
+        const uchar* midRow = frame.ptr<uchar>(blockY + BLOCK_SIZE / 2 - 1);
+        int64_t boundarySum = 0, innerSum = 0;
+        for (int x = 0; x < frame.cols; ++x) {
+            boundarySum += std::abs(nextRow[x] - lastRow[x]);
+            innerSum += std::abs(row[x] - midRow[x]);
+        }
+        verticalBoundary += static_cast<double>(boundarySum);
+        verticalInner += static_cast<double>(innerSum);
+        verticalBoundaryCount += frame.cols;
+        verticalInnerCount += frame.cols;
+    }
+
+    if (horizontalBoundaryCount == 0 || horizontalInnerCount == 0 || verticalBoundaryCount == 0) {
+        return 100.0;
+    }
+
+    // +1 стабилизирует отношение на плоских участках без деталей
+    double horizontalRatio = (horizontalBoundary / horizontalBoundaryCount + 1.0) /
+                             (horizontalInner / horizontalInnerCount + 1.0);
+    double verticalRatio = (verticalBoundary / verticalBoundaryCount + 1.0) /
+                           (verticalInner / verticalInnerCount + 1.0);
+    double excess = (horizontalRatio + verticalRatio) / 2.0 - 1.0;
+
+    double maxExcess = m_keyframeMode ? KEYFRAME_BLOCKINESS_EXCESS : MAX_BLOCKINESS_EXCESS;
+    double blockinessScore = 100.0 - (excess / maxExcess) * 100.0;
+    if (blockinessScore > 100.0) blockinessScore = 100.0;
+    if (blockinessScore < 0.0) blockinessScore = 0.0;
+
+    return blockinessScore;
+}
+
+double ImageQualityAnalyzer::calculateFrequencyBlurScore(const cv::Mat& frame)
+{
+    // DCT считается по нескольким блокам кадра в полном разрешении (без
+    // масштабирования, которое само срезало бы высокие частоты). Берётся лучший
+    // блок, чтобы однотонные участки (небо, стена) не занижали оценку.
+    int tileSize = std::min(SPECTRUM_TILE_SIZE, std::min(frame.cols, frame.rows)) & ~1;
+    if (tileSize < 8) {
+        return 0.0;
+    }
+
+    const cv::Point centers[] = {
+        cv::Point(frame.cols / 2, frame.rows / 2),
+        cv::Point(frame.cols / 4, frame.rows / 4),
+        cv::Point(frame.cols * 3 / 4, frame.rows / 4),
+        cv::Point(frame.cols / 4, frame.rows * 3 / 4),
+        cv::Point(frame.cols * 3 / 4, frame.rows * 3 / 4)
+    };
+
+    double bestRatio = 0.0;
+    for (const cv::Point& center : centers) {
+        int x = std::max(0, std::min(center.x - tileSize / 2, frame.cols - tileSize));
+        int y = std::max(0, std::min(center.y - tileSize / 2, frame.rows - tileSize));
+        frame(cv::Rect(x, y, tileSize, tileSize)).convertTo(m_buffers.tile, CV_32F);
+        cv::dct(m_buffers.tile, m_buffers.spectrum);
+
+        // Высокие частоты: u + v >= N/2. DC-коэффициент исключается.
+        double highEnergy = 0.0, totalEnergy = 0.0;
+        for (int v = 0; v < tileSize; ++v) {
+            const float* coeffs = m_buffers.spectrum.ptr<float>(v);
+            for (int u = (v == 0) ? 1 : 0; u < tileSize; ++u) {
+                double magnitude = std::fabs(coeffs[u]);
+                totalEnergy += magnitude;
+                if (u + v >= tileSize / 2) {
+                    highEnergy += magnitude;
+                }
+            }
+        }
+
+        if (totalEnergy > 0.0) {
+            bestRatio = std::max(bestRatio, highEnergy / totalEnergy);
+        }
+    }
+
+    double frequencyBlurScore = (bestRatio / IDEAL_HIGH_FREQUENCY_RATIO) * 100.0;
+    if (frequencyBlurScore > 100.0) frequencyBlurScore = 100.0;
+    if (frequencyBlurScore < 0.0) frequencyBlurScore = 0.0;
+
+    return frequencyBlurScore;
+}
+
+bool ImageQualityAnalyzer::detectFrozenFrame(const cv::Mat& frame)
+{
+    const cv::Mat& previous = m_buffers.prevGray;
+    if (previous.empty() || previous.size() != frame.size() || previous.type() != frame.type()) {
+        return false;
+    }
+
+    // Застывший поток повторяет декодированный кадр побайтно, поэтому
+    // достаточно сравнить каждую 4-ю строку: шаг строки увеличивается без копирования
+    const int rowStep = 4;
+    int sampledRows = frame.rows / rowStep;
+    cv::Mat current(sampledRows, frame.cols, CV_8UC1,
+                    const_cast<uchar*>(frame.ptr<uchar>()), frame.step * rowStep);
+    cv::Mat before(sampledRows, previous.cols, CV_8UC1,
+                   const_cast<uchar*>(previous.ptr<uchar>()), previous.step * rowStep);
+
+    double meanDiff = cv::norm(current, before, cv::NORM_L1) / static_cast<double>(current.total());
+    return meanDiff < FREEZE_DIFF_THRESHOLD;
+}
+
+void ImageQualityAnalyzer::setReferenceFrame(const cv::Mat& frame)
+{
+    clearReferenceFrame();
+    if (frame.empty()) {
+        return;
+    }
+
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, m_reference.original, cv::COLOR_BGR2GRAY);
+    } else if (frame.channels() == 4) {
+        cv::cvtColor(frame, m_reference.original, cv::COLOR_BGRA2GRAY);
+    } else {
+        frame.copyTo(m_reference.original);
+    }
+
+    prepareReference(m_reference.original.size());
+}
+
+void ImageQualityAnalyzer::clearReferenceFrame()
+{
+    m_reference = ReferenceData();
+}
+
+bool ImageQualityAnalyzer::hasReferenceFrame() const
+{
+    return !m_reference.original.empty();
+}
+
+void ImageQualityAnalyzer::setKeyframeMode(bool enabled)
+{
+    m_keyframeMode = enabled;
+    m_frozenFrameCount = 0;
+}
+
+bool ImageQualityAnalyzer::keyframeMode() const
+{
+    return m_keyframeMode;
+}
+
+void ImageQualityAnalyzer::setLowMemoryMode(bool enabled)
+{
+    if (m_lowMemoryMode == enabled) {
+        return;
+    }
+    m_lowMemoryMode = enabled;
+    // Буферы другого режима пересоздаются под новый размер при следующем анализе
+    m_buffers.blurred.release();
+    m_buffers.diff.release();
+    m_buffers.laplacian.release();
+}
+
+bool ImageQualityAnalyzer::lowMemoryMode() const
+{
+    return m_lowMemoryMode;
+}
+
+void ImageQualityAnalyzer::setStageTiming(bool enabled)
+{
+    m_stageTiming = enabled;
+    m_stageTimes = StageTimes();
+}
+
+ImageQualityAnalyzer::StageTimes ImageQualityAnalyzer::stageTimes() const
+{
+    return m_stageTimes;
+}
+
+qint64 ImageQualityAnalyzer::lastCpuTimeNs() const
+{
+    return m_lastCpuNs;
+}
+
+qint64 ImageQualityAnalyzer::threadCpuTimeNs()
+{
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+        return 0;
+    }
+    return static_cast<qint64>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+void ImageQualityAnalyzer::prepareReference(const cv::Size& frameSize)
+{
+    // Если разрешение потока изменилось (например, после обновления прошивки),
+    // эталон приводится к новому разрешению, а его статистики пересчитываются
+    if (m_reference.original.size() == frameSize) {
+        m_reference.gray = m_reference.original;
+    } else {
+        cv::resize(m_reference.original, m_reference.gray, frameSize, 0, 0, cv::INTER_AREA);
+    }
+
+    int scale = std::max(1, static_cast<int>(std::lround(
+        std::min(frameSize.width, frameSize.height) / SSIM_TARGET_SIZE)));
+    cv::Size smallSize(std::max(1, frameSize.width / scale), std::max(1, frameSize.height / scale));
+
+    cv::Mat resized;
+    cv::resize(m_reference.gray, resized, smallSize, 0, 0, cv::INTER_AREA);
+    resized.convertTo(m_reference.small, CV_32F);
+
+    const cv::Size window(SSIM_WINDOW, SSIM_WINDOW);
+    cv::boxFilter(m_reference.small, m_reference.mean, CV_32F, window);
+    cv::Mat square;
+    cv::multiply(m_reference.small, m_reference.small, square);
+    cv::boxFilter(square, m_reference.variance, CV_32F, window);
+    m_reference.variance -= m_reference.mean.mul(m_reference.mean);
+}
+
+double ImageQualityAnalyzer::calculatePsnr(const cv::Mat& frame)
+{
+    double squaredError = cv::norm(frame, m_reference.gray, cv::NORM_L2SQR);
+    double mse = squaredError / static_cast<double>(frame.total());
+    if (mse <= 1e-10) {
+        return MAX_PSNR;
+    }
+
+    double psnr = 10.0 * std::log10((255.0 * 255.0) / mse);
+    return std::min(psnr, MAX_PSNR);
+}
+
+double ImageQualityAnalyzer::calculateSsim(const cv::Mat& frame)
+{
+    // Box-фильтр OpenCV считает скользящие суммы по строкам и столбцам,
+    // поэтому стоимость не зависит от размера окна
+    cv::Mat& x = m_buffers.ssimInput;
+    cv::Mat resized;
+    cv::resize(frame, resized, m_reference.small.size(), 0, 0, cv::INTER_AREA);
+    resized.convertTo(x, CV_32F);
+
+    const cv::Size window(SSIM_WINDOW, SSIM_WINDOW);
+    cv::boxFilter(x, m_buffers.ssimMean, CV_32F, window);
+    cv::multiply(x, x, m_buffers.ssimProduct);
+    cv::boxFilter(m_buffers.ssimProduct, m_buffers.ssimSquare, CV_32F, window);
+    cv::multiply(x, m_reference.small, m_buffers.ssimProduct);
+    cv::boxFilter(m_buffers.ssimProduct, m_buffers.ssimCross, CV_32F, window);
+
+    const cv::Mat& muX = m_buffers.ssimMean;
+    const cv::Mat& muY = m_reference.mean;
+    const cv::Mat& sigmaY = m_reference.variance;
+    const float c1 = static_cast<float>(SSIM_C1);
+    const float c2 = static_cast<float>(SSIM_C2);
+
+    double ssimSum = 0.0;
+    for (int y = 0; y < x.rows; ++y) {
+        const float* meanX = muX.ptr<float>(y);
+        const float* meanY = muY.ptr<float>(y);
+        const float* squareX = m_buffers.ssimSquare.ptr<float>(y);
+        const float* varianceY = sigmaY.ptr<float>(y);
+        const float* cross = m_buffers.ssimCross.ptr<float>(y);
+        double rowSum = 0.0;
+        for (int col = 0; col < x.cols; ++col) {
+            float mx = meanX[col];
+            float my = meanY[col];
+            float varianceX = squareX[col] - mx * mx;
+            float covariance = cross[col] - mx * my;
+            float numerator = (2.0f * mx * my + c1) * (2.0f * covariance + c2);
+            float denominator = (mx * mx + my * my + c1) * (varianceX + varianceY[col] + c2);
+            rowSum += numerator / denominator;
+        }
+        ssimSum += rowSum;
+    }
+
+    return ssimSum / static_cast<double>(x.total());
+}
+
 QImage ImageQualityAnalyzer::matToQImage(const cv::Mat& mat)
 {
     try {
-        cv::Mat rgbMat;
         QImage qImage;
         
         if (mat.channels() == 3) {
-            cv::cvtColor(mat, rgbMat, cv::COLOR_BGR2RGB);
-            qImage = QImage(
-                rgbMat.data,
-                rgbMat.cols,
-                rgbMat.rows,
-                static_cast<int>(rgbMat.step),
-                QImage::Format_RGB888
-            ).copy();
+            // Конвертация пишет прямо в буфер QImage, без промежуточной матрицы и копии
+            qImage = QImage(mat.cols, mat.rows, QImage::Format_RGB888);
+            cv::Mat rgbView(mat.rows, mat.cols, CV_8UC3, qImage.bits(),
+                            static_cast<size_t>(qImage.bytesPerLine()));
+            cv::cvtColor(mat, rgbView, cv::COLOR_BGR2RGB);
         } else if (mat.channels() == 1) {
             qImage = QImage(
                 mat.data,
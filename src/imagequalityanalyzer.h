@@ -5,6 +5,10 @@
 #include <QObject>
 #include <QImage>
 #include <QDebug>
+#include <QMutex>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 /**
  * @class ImageQualityAnalyzer
@@ -12,11 +16,28 @@
  * 
  * Данный класс выполняет комплексный анализ качества видеокадра по следующим параметрам:
  * 1. Шумность (Noise) - измеряется через отклонение от размытого изображения
- * 2. Контрастность (Contrast) - измеряется через разницу между max и min яркостью
+ * 2. Контрастность (Contrast) - измеряется через разницу между 99-м и 1-м перцентилями яркости
  * 3. Резкость (Sharpness) - измеряется через анализ градиентов и краев
  * 4. Пересвеченные пиксели (Overexposed) - процент пикселей выше порога яркости
+ * 5. Блочность (Blockiness) - артефакты сжатия на границах блоков 8x8
+ * 6. Фокус (Frequency blur) - доля высокочастотной энергии в DCT-спектре
+ * 7. Застывание (Freeze) - совпадение соседних анализируемых кадров
+ * 8. Экспозиция (Exposure) - недосвет и динамический диапазон
+ * 9. Цвет (Color) - насыщенность, цветовой сдвиг, баланс белого и клиппинг каналов
+ *
+ * Контраст, пересвет, недосвет и динамический диапазон выводятся из одной
+ * 256-корзинной гистограммы яркости, которая строится за один проход по кадру.
+ * Для цветного кадра тот же проход формирует серый кадр, RGB-буфер для
+ * отображения и цветовую статистику.
  * 
- * Итоговая оценка вычисляется как взвешенная сумма всех параметров (0-100 баллов)
+ * Если задан эталонный кадр, дополнительно вычисляются полнореференсные
+ * метрики PSNR и SSIM (режим сравнения с эталоном).
+ *
+ * Итоговая оценка вычисляется как взвешенная сумма первых четырёх параметров (0-100 баллов).
+ * Застывший поток обнуляет итоговую оценку.
+ *
+ * Экземпляр хранит состояние между вызовами (предыдущий кадр для детектора
+ * застывания и промежуточные буферы), поэтому на каждую камеру нужен свой анализатор.
  */
 class ImageQualityAnalyzer : public QObject
 {
@@ -26,28 +47,150 @@ public:
     explicit ImageQualityAnalyzer(QObject *parent = nullptr);
     ~ImageQualityAnalyzer();
 
+    /**
+     * @brief Числовые поля результата анализа
+     *
+     * Тривиально копируемая часть QualityResult: её можно публиковать между
+     * потоками без блокировок (см. CameraWorker::publishedState()).
+     */
+    struct QualityValues {
+        double noiseScore = 0;        // Оценка шумности (0-100), выше = лучше
+        double contrastScore = 0;     // Оценка контрастности (0-100), выше = лучше
+        double sharpnessScore = 0;    // Оценка резкости (0-100), выше = лучше
+        double overexposedPercent = 0; // Процент пересвеченных пикселей (0-100), ниже = лучше
+        double underexposedPercent = 0; // Процент недосвеченных пикселей (0-100), ниже = лучше
+        double dynamicRange = 0;      // Динамический диапазон между перцентилями, ступени EV
+        double blockinessScore = 0;   // Оценка блочности (0-100), выше = меньше артефактов
+        double frequencyBlurScore = 0; // Оценка фокуса по спектру (0-100), выше = резче
+        double meanChroma = 0;        // Средняя насыщенность (max-min каналов, 0-100)
+        double colorCast = 0;         // Величина цветового сдвига по gray-world (0-100), ниже = лучше
+        double whiteBalanceRed = 1.0; // Отношение средних R/G (1.0 = нейтрально)
+        double whiteBalanceBlue = 1.0; // Отношение средних B/G (1.0 = нейтрально)
+        double saturationClippedPercent = 0; // Процент пикселей с клиппингом части каналов (0-100)
+        bool hasReference = false;    // Результат содержит сравнение с эталоном
+        double psnr = 0;              // PSNR относительно эталона, дБ (100 = кадры совпадают)
+        double ssim = 0;              // SSIM относительно эталона (0-1), выше = ближе к эталону
+        bool isFrozen = false;        // Кадр совпадает с предыдущим анализируемым
+        int frozenFrameCount = 0;     // Число подряд идущих застывших кадров анализа
+        bool hasStreamStats = false;  // Источник ведёт транспортные счётчики (FFmpeg)
+        quint64 packetsReceived = 0;  // Видеопакетов получено с подключения
+        quint64 packetsLost = 0;      // Потеряно RTP-пакетов с подключения
+        quint64 corruptFrames = 0;    // Повреждённых пакетов и кадров с ошибками декодирования
+        quint64 decodeErrors = 0;     // Пакетов, отвергнутых декодером
+        double packetLossPercent = 0; // Доля потерянных пакетов с предыдущего анализа (0-100)
+        bool keyframeMode = false;    // Источник отдаёт только ключевые кадры (пороги анализа смягчены)
+        double overallScore = 0;      // Общая оценка качества (0-100), выше = лучше
+        bool isValid = false;         // Флаг валидности результата
+    };
+
     /**
      * @brief Структура для хранения результатов анализа качества изображения
      */
-    struct QualityResult {
-        double noiseScore;           // Оценка шумности (0-100), выше = лучше
-        double contrastScore;        // Оценка контрастности (0-100), выше = лучше
-        double sharpnessScore;       // Оценка резкости (0-100), выше = лучше
-        double overexposedPercent;   // Процент пересвеченных пикселей (0-100), ниже = лучше
-        double overallScore;         // Общая оценка качества (0-100), выше = лучше
-        QString status;              // Текстовое описание статуса
-        bool isValid;                // Флаг валидности результата
-        
-        QualityResult() : noiseScore(0), contrastScore(0), sharpnessScore(0),
-                          overexposedPercent(0), overallScore(0), status(""), isValid(false) {}
+    struct QualityResult : QualityValues {
+        QString status;               // Текстовое описание статуса
     };
 
     /**
      * @brief Анализирует качество изображения и возвращает оценку
      * @param frame Кадр изображения в формате OpenCV (cv::Mat)
+     * @param displayImage Если задан и кадр BGR, сюда записывается RGB-изображение
+     *        для GUI, полученное в том же проходе, что и серый кадр
+     * @param luma Яркость того же кадра от декодера (CV_8UC1, 0-255); если задана,
+     *        используется вместо пересчёта яркости из BGR
      * @return QualityResult Результат анализа качества
      */
-    QualityResult analyze(const cv::Mat& frame);
+    QualityResult analyze(const cv::Mat& frame, QImage* displayImage = nullptr,
+                          const cv::Mat& luma = cv::Mat());
+
+    /**
+     * @brief Пакетный анализ независимых кадров (переоценка архивов, миниатюры)
+     * @param frames Массив из count кадров; могут быть от разных камер и разного размера
+     * @param results Массив из count результатов, заполняется в порядке кадров
+     *
+     * Кадры анализируются параллельно в потоках OpenCV. Промежуточные
+     * буферы у каждого потока свои и сохраняются между вызовами, поэтому
+     * пакеты кадров одного размера не выделяют память. Сигнал
+     * analysisCompleted не испускается. Кадры считаются независимыми:
+     * застывание и сравнение с эталоном не оцениваются, а состояние
+     * анализатора для analyze() не меняется. Режимы ключевых кадров и низкой
+     * памяти берутся у этого анализатора.
+     *
+     * Можно вызывать из нескольких потоков: буферы потоков у анализатора
+     * одни, поэтому одновременные вызовы выполняются по очереди. Вызов
+     * параллельно с analyze() допустим - у них разные буферы.
+     */
+    void analyzeBatch(const cv::Mat* frames, size_t count, QualityResult* results);
+    std::vector<QualityResult> analyzeBatch(const std::vector<cv::Mat>& frames);
+
+    /**
+     * @brief Задаёт эталонный кадр для режима сравнения (PSNR/SSIM)
+     *
+     * Статистики эталона для SSIM вычисляются один раз здесь и затем
+     * переиспользуются для каждого анализируемого кадра.
+     * @param frame Эталонный кадр (BGR или градации серого)
+     */
+    void setReferenceFrame(const cv::Mat& frame);
+
+    /**
+     * @brief Отключает режим сравнения с эталоном
+     */
+    void clearReferenceFrame();
+
+    /**
+     * @brief Проверяет, задан ли эталонный кадр
+     */
+    bool hasReferenceFrame() const;
+
+    /**
+     * @brief Режим анализа только ключевых кадров
+     *
+     * I-кадры получают больше бит, чем P/B-кадры, поэтому блочность на них
+     * ниже средней по потоку - в этом режиме она оценивается строже.
+     * Соседние анализируемые кадры разделены целыми GOP, поэтому поток
+     * признаётся застывшим после меньшего числа совпадающих кадров.
+     */
+    void setKeyframeMode(bool enabled);
+    bool keyframeMode() const;
+
+    /**
+     * @brief Профиль низкой памяти (см. MemoryBudget)
+     *
+     * Шумность и резкость считаются полосами по LOW_MEMORY_STRIP_ROWS строк
+     * с 16-битным лапласианом вместо буферов во весь кадр (лапласиан CV_64F
+     * кадра 1080p - 16 МБ). Фильтр по полосе читает соседние строки кадра,
+     * поэтому оценки совпадают с обычным режимом.
+     */
+    void setLowMemoryMode(bool enabled);
+    bool lowMemoryMode() const;
+
+    /**
+     * @brief Накопленное время этапов analyze() (замер стоимости метрик)
+     */
+    struct StageTimes {
+        qint64 frames = 0;        // Кадров с замером
+        qint64 baseNs = 0;        // Серый план, гистограмма, шумность, резкость, экспозиция
+        qint64 extendedNs = 0;    // Блочность, спектральный фокус, застывание
+    };
+
+    /**
+     * @brief Включает замер времени этапов; включение сбрасывает накопленное
+     */
+    void setStageTiming(bool enabled);
+    StageTimes stageTimes() const;
+
+    /**
+     * @brief Процессорное время последнего analyze() во всех потоках, нс
+     *
+     * Время вызывающего потока плюс время полос совмещённого прохода,
+     * выполненных в потоках пула OpenCV. Длительность по часам занижала бы
+     * стоимость анализа, распараллеленного по нескольким ядрам.
+     */
+    qint64 lastCpuTimeNs() const;
+
+    /**
+     * @brief Процессорное время вызывающего потока, нс
+     */
+    static qint64 threadCpuTimeNs();
 
     /**
      * @brief Конвертирует cv::Mat в QImage для отображения в GUI
@@ -60,15 +203,81 @@ signals:
     void analysisCompleted(const QualityResult& result);
 
 private:
+    /**
+     * @brief Анализ кадра без сигнала
+     * @param trackState Учитывать и обновлять состояние камеры (застывание, эталон)
+     */
+    QualityResult evaluate(const cv::Mat& frame, QImage* displayImage, const cv::Mat& luma, bool trackState);
+
     /**
      * @brief Вычисляет оценку шумности изображения
      */
     double calculateNoiseScore(const cv::Mat& frame);
 
     /**
-     * @brief Вычисляет оценку контрастности изображения
+     * @brief Гистограмма яркости кадра (256 корзин)
      */
-    double calculateContrastScore(const cv::Mat& frame);
+    struct LuminanceHistogram {
+        uint32_t bins[256];
+        uint64_t total;
+
+        /**
+         * @brief Возвращает уровень яркости, ниже которого лежит заданная доля пикселей
+         * @param fraction Доля пикселей (0.0-1.0)
+         */
+        int percentile(double fraction) const;
+
+        /**
+         * @brief Процент пикселей в диапазоне уровней [from, to]
+         */
+        double percentInRange(int from, int to) const;
+    };
+
+    /**
+     * @brief Цветовая статистика кадра, накапливаемая в совмещённом проходе
+     */
+    struct ColorStats {
+        uint64_t sumBlue;
+        uint64_t sumGreen;
+        uint64_t sumRed;
+        uint64_t sumChroma;
+        uint64_t clippedPixels;
+        uint64_t total;
+    };
+
+    /**
+     * @brief Накопитель одной полосы строк совмещённого прохода
+     */
+    struct ColorStripAccumulator {
+        uint32_t bins[256];
+        ColorStats stats;
+    };
+
+    /**
+     * @brief Совмещённый проход по BGR-кадру
+     *
+     * За одно чтение каждого пикселя формирует серый кадр, гистограмму яркости,
+     * цветовую статистику и (если задан rgbData) RGB-буфер для отображения.
+     * Если задана яркость декодера luma, серый кадр копируется из неё.
+     * Полосы строк обрабатываются параллельно.
+     */
+    void computeColorPass(const cv::Mat& frame, const cv::Mat& luma, uchar* rgbData, size_t rgbStep,
+                          LuminanceHistogram& histogram, ColorStats& stats);
+
+    /**
+     * @brief Заполняет цветовые поля результата по накопленной статистике
+     */
+    void applyColorStats(const ColorStats& stats, QualityResult& result);
+
+    /**
+     * @brief Строит гистограмму яркости за один проход по кадру
+     */
+    static void computeLuminanceHistogram(const cv::Mat& frame, LuminanceHistogram& histogram);
+
+    /**
+     * @brief Вычисляет оценку контрастности по перцентилям гистограммы
+     */
+    double calculateContrastScore(const LuminanceHistogram& histogram);
 
     /**
      * @brief Вычисляет оценку резкости изображения
@@ -78,7 +287,97 @@ private:
     /**
      * @brief Вычисляет процент пересвеченных пикселей
      */
-    double calculateOverexposedPercentage(const cv::Mat& frame);
+    double calculateOverexposedPercentage(const LuminanceHistogram& histogram);
+
+    /**
+     * @brief Вычисляет процент недосвеченных пикселей
+     */
+    double calculateUnderexposedPercentage(const LuminanceHistogram& histogram);
+
+    /**
+     * @brief Вычисляет динамический диапазон в ступенях EV
+     */
+    double calculateDynamicRange(const LuminanceHistogram& histogram);
+
+    /**
+     * @brief Вычисляет оценку блочности по границам блоков 8x8
+     */
+    double calculateBlockinessScore(const cv::Mat& frame);
+
+    /**
+     * @brief Вычисляет оценку фокуса по доле высоких частот DCT-спектра
+     */
+    double calculateFrequencyBlurScore(const cv::Mat& frame);
+
+    /**
+     * @brief Сравнивает кадр с предыдущим анализируемым кадром
+     * @return true, если кадры практически совпадают
+     */
+    bool detectFrozenFrame(const cv::Mat& frame);
+
+    /**
+     * @brief Подготавливает эталон под разрешение текущего потока
+     */
+    void prepareReference(const cv::Size& frameSize);
+
+    /**
+     * @brief Вычисляет PSNR серого кадра относительно эталона
+     */
+    double calculatePsnr(const cv::Mat& frame);
+
+    /**
+     * @brief Вычисляет SSIM серого кадра относительно эталона
+     *
+     * Кадр уменьшается до ~256 пикселей по меньшей стороне (как в эталонной
+     * реализации SSIM), локальные средние считаются box-фильтром с окном 8x8.
+     */
+    double calculateSsim(const cv::Mat& frame);
+
+    /**
+     * @brief Кэш эталонного кадра и его статистик для SSIM
+     */
+    struct ReferenceData {
+        cv::Mat original;    // Эталон в градациях серого в исходном разрешении
+        cv::Mat gray;        // Эталон в разрешении текущего потока (PSNR)
+        cv::Mat small;       // Эталон в масштабе SSIM, float
+        cv::Mat mean;        // Локальное среднее эталона
+        cv::Mat variance;    // Локальная дисперсия эталона
+    };
+
+    /**
+     * @brief Промежуточные буферы, переиспользуемые между кадрами
+     *
+     * Все проходы анализа пишут в заранее выделенные матрицы, поэтому
+     * при неизменном разрешении потока анализ не выделяет память.
+     */
+    struct AnalysisBuffers {
+        cv::Mat gray;        // Кадр в градациях серого
+        cv::Mat prevGray;    // Предыдущий анализируемый кадр (детектор застывания)
+        cv::Mat blurred;     // Размытый кадр (шумность); в профиле низкой памяти - полоса
+        cv::Mat diff;        // |gray - blurred| (шумность); в профиле низкой памяти - полоса
+        cv::Mat laplacian;   // Лапласиан (резкость): CV_64F кадра или CV_16S полосы
+        cv::Mat tile;        // Блок кадра в float (спектральный фокус)
+        cv::Mat spectrum;    // DCT блока (спектральный фокус)
+        std::vector<ColorStripAccumulator> colorStrips;  // Полосы совмещённого прохода
+        cv::Mat ssimInput;   // Кадр в масштабе SSIM, float
+        cv::Mat ssimMean;    // Локальное среднее кадра
+        cv::Mat ssimSquare;  // Локальный второй момент кадра
+        cv::Mat ssimCross;   // Локальный смешанный момент кадра и эталона
+        cv::Mat ssimProduct; // Поэлементное произведение перед box-фильтром
+    };
+
+    AnalysisBuffers m_buffers;
+    LuminanceHistogram m_histogram;
+    ReferenceData m_reference;
+    int m_frozenFrameCount;
+    bool m_keyframeMode;
+    bool m_lowMemoryMode;
+    bool m_stageTiming;
+    StageTimes m_stageTimes;
+    std::atomic<qint64> m_helperCpuNs;    // Полосы прохода в чужих потоках за текущий кадр
+    qint64 m_lastCpuNs;
+    std::vector<std::unique_ptr<ImageQualityAnalyzer>> m_batchScratch;   // Буферы потоков analyzeBatch
+    QMutex m_batchMutex;                  // Один analyzeBatch за раз: m_batchScratch общий
 
     // Константы для весовых коэффициентов
     const double NOISE_WEIGHT = 0.25;
@@ -88,9 +387,39 @@ private:
 
     // Пороговые значения
     const int OVEREXPOSED_THRESHOLD = 245;
+    const int UNDEREXPOSED_THRESHOLD = 10;
+    const double CONTRAST_PERCENTILE = 0.01;      // Отсечение 1% самых тёмных и светлых пикселей
+    const double DYNAMIC_RANGE_PERCENTILE = 0.005;
+
+    // Цвет: уровень клиппинга канала и масштаб цветового сдвига
+    const int COLOR_CLIP_LEVEL = 254;
+    const double MAX_COLOR_CAST = 0.15;   // Отклонение хроматичности 0.15 = сдвиг 100
+    const int COLOR_STRIP_ROWS = 64;
+    const int LOW_MEMORY_STRIP_ROWS = 64;
+
+    // Сравнение с эталоном
+    const int SSIM_WINDOW = 8;
+    const double SSIM_TARGET_SIZE = 256.0;     // Меньшая сторона кадра в масштабе SSIM
+    const double SSIM_C1 = 6.5025;             // (0.01 * 255)^2
+    const double SSIM_C2 = 58.5225;            // (0.03 * 255)^2
+    const double MAX_PSNR = 100.0;
     const double IDEAL_CONTRAST = 160.0;
     const double IDEAL_SHARPNESS = 400.0;
     const double MAX_NOISE_VARIANCE = 50.0;
+
+    // Блочность: отношение перепадов на границах блоков к перепадам внутри блоков
+    const int BLOCK_SIZE = 8;
+    const double MAX_BLOCKINESS_EXCESS = 1.0;  // Отношение 2.0 и выше = оценка 0
+    const double KEYFRAME_BLOCKINESS_EXCESS = 0.6;  // То же для I-кадров
+
+    // Спектральный фокус: блоки DCT и доля высокочастотной энергии
+    const int SPECTRUM_TILE_SIZE = 128;
+    const double IDEAL_HIGH_FREQUENCY_RATIO = 0.25;
+
+    // Застывание: средняя абсолютная разница кадров ниже порога
+    const double FREEZE_DIFF_THRESHOLD = 0.5;
+    const int FREEZE_MIN_FRAMES = 3;
+    const int FREEZE_MIN_KEYFRAMES = 2;
 };
 
 #endif // IMAGEQUALITYANALYZER_H
@@ -0,0 +1,751 @@
+#include "ingestreactor.h"
+#include "affinitypolicy.h"
+#include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+
+qint64 monotonicMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+// Задача пула держит поток живым, пока декодирует его пакеты
+class IngestStream::DecodeTask : public QRunnable
+{
+public:
+    explicit DecodeTask(std::shared_ptr<IngestStream> stream) : m_stream(std::move(stream)) {}
+
+    void run() override
+    {
+        // Потоки пула узла обслуживают только его камеры и закрепляются один раз
+        if (m_stream->m_node >= 0 && AffinityPolicy::currentThreadNode() != m_stream->m_node) {
+            AffinityPolicy::instance().bindCurrentThread(m_stream->m_node);
+        }
+        m_stream->decodePending();
+    }
+
+private:
+    std::shared_ptr<IngestStream> m_stream;
+};
+
+IngestStream::IngestStream(QThreadPool* decodePool, int maxQueuedPackets, int node)
+    : m_decodePool(decodePool)
+    , m_node(node)
+    , MAX_QUEUED_PACKETS(maxQueuedPackets)
+    , m_scheduled(false)
+    , m_waitKeyframe(true)
+    , m_closed(false)
+    , m_failed(false)
+    , m_keyframeGopInterval(0)
+    , m_keyframesSeen(0)
+    , m_memoryShedding(false)
+    , m_codecId(AV_CODEC_ID_NONE)
+    , m_codecContext(nullptr)
+    , m_decodedFrame(nullptr)
+    , m_decoderFailed(false)
+    , m_latestFrame(av_frame_alloc())
+    , m_hasFrame(false)
+{
+    m_stats.available = true;
+}
+
+IngestStream::~IngestStream()
+{
+    if (m_codecContext) {
+        avcodec_free_context(&m_codecContext);
+    }
+    av_frame_free(&m_decodedFrame);
+    av_frame_free(&m_latestFrame);
+}
+
+void IngestStream::setCodec(int codecId, const QByteArray& extradata)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_codecId = codecId;
+    m_extradata = extradata;
+    if (m_packetRing) {
+        m_packetRing->setStream(codecId, extradata, 1, 1000000);
+    }
+}
+
+void IngestStream::setPacketRing(std::shared_ptr<PacketRing> ring)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_packetRing = std::move(ring);
+}
+
+void IngestStream::setKeyframeOnly(int gopInterval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_keyframeGopInterval = qMax(0, gopInterval);
+}
+
+void IngestStream::setMemoryShedding(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_memoryShedding && !enabled) {
+        // Опорные кадры пропущены: P-кадры до ключевого не декодируются
+        m_waitKeyframe = true;
+    }
+    m_memoryShedding = enabled;
+}
+
+void IngestStream::pushPacket(const QByteArray& data, qint64 timestampUs, bool keyframe)
+{
+    // Кольцо задаётся до запуска сессии, дальше указатель не меняется.
+    // Предыстория получает и кадры, отброшенные до декодера
+    if (m_packetRing) {
+        m_packetRing->push(data, timestampUs, keyframe);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed || m_failed) {
+            return;
+        }
+        m_stats.packetsReceived++;
+
+        // Режим ключевых кадров: остальное отбрасывается до очереди декодера.
+        // У предела памяти декодируется каждый ключевой кадр
+        bool keyframeOnly = m_keyframeGopInterval > 0 || m_memoryShedding;
+        if (keyframeOnly
+            && (!keyframe || (m_keyframeGopInterval > 0
+                              && m_keyframesSeen++ % static_cast<quint64>(m_keyframeGopInterval) != 0))) {
+            m_stats.packetsSkipped++;
+            return;
+        }
+
+        if (static_cast<int>(m_queue.size()) >= MAX_QUEUED_PACKETS) {
+            qWarning() << "Ingest: decoder queue overflow, dropping" << m_queue.size()
+                       << "packets until next keyframe";
+            m_stats.packetsSkipped += m_queue.size();
+            m_queue.clear();
+            m_waitKeyframe = true;
+        }
+        if (m_waitKeyframe) {
+            if (!keyframe) {
+                m_stats.packetsSkipped++;
+                return;
+            }
+            m_waitKeyframe = false;
+        }
+
+        m_queue.push_back(Packet{ data, timestampUs, keyframe, keyframeOnly });
+        if (m_scheduled) {
+            return;
+        }
+        m_scheduled = true;
+    }
+    m_decodePool->start(new DecodeTask(shared_from_this()));
+}
+
+void IngestStream::addPacketsLost(quint64 count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.packetsLost += count;
+}
+
+void IngestStream::fail(const QString& reason)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_failed) {
+            return;
+        }
+        m_failed = true;
+        m_errorText = reason;
+    }
+    m_frameReady.notify_all();
+}
+
+void IngestStream::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_queue.clear();
+        av_frame_unref(m_latestFrame);
+        m_hasFrame = false;
+    }
+    m_frameReady.notify_all();
+}
+
+IngestStream::WaitResult IngestStream::waitFrame(AVFrame* frame, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frameReady.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                          [this]() { return m_hasFrame || m_failed || m_closed; });
+    if (m_hasFrame) {
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, m_latestFrame);
+        m_hasFrame = false;
+        return WaitResult::Frame;
+    }
+    return m_failed || m_closed ? WaitResult::Failed : WaitResult::Timeout;
+}
+
+FrameSource::StreamStats IngestStream::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+QString IngestStream::errorText() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_errorText;
+}
+
+void IngestStream::decodePending()
+{
+    for (int processed = 0; processed < MAX_PACKETS_PER_TASK; ++processed) {
+        Packet packet;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed || m_queue.empty()) {
+                m_scheduled = false;
+                return;
+            }
+            packet = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        decodePacket(packet);
+    }
+
+    // Пакеты остались: задача встаёт в конец очереди пула, чтобы одна камера
+    // с большим потоком не занимала поток пула целиком
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closed || m_queue.empty()) {
+            m_scheduled = false;
+            return;
+        }
+    }
+    m_decodePool->start(new DecodeTask(shared_from_this()));
+}
+
+bool IngestStream::ensureDecoder()
+{
+    if (m_codecContext) {
+        return true;
+    }
+    if (m_decoderFailed) {
+        return false;
+    }
+
+    int codecId;
+    QByteArray extradata;
+    bool keyframeOnly;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        codecId = m_codecId;
+        extradata = m_extradata;
+        keyframeOnly = m_keyframeGopInterval > 0;
+    }
+
+    const AVCodec* codec = avcodec_find_decoder(static_cast<AVCodecID>(codecId));
+    if (!codec) {
+        m_decoderFailed = true;
+        fail(QString("no decoder for codec %1").arg(codecId));
+        return false;
+    }
+
+    m_codecContext = avcodec_alloc_context3(codec);
+    if (!extradata.isEmpty()) {
+        m_codecContext->extradata = static_cast<uint8_t*>(
+            av_mallocz(static_cast<size_t>(extradata.size()) + AV_INPUT_BUFFER_PADDING_SIZE));
+        std::memcpy(m_codecContext->extradata, extradata.constData(), static_cast<size_t>(extradata.size()));
+        m_codecContext->extradata_size = extradata.size();
+    }
+    // Параллелизм - по камерам в пуле, а не внутри декодера одной камеры
+    m_codecContext->thread_count = 1;
+    m_codecContext->pkt_timebase = AVRational{ 1, 1000000 };
+    if (keyframeOnly) {
+        m_codecContext->skip_frame = AVDISCARD_NONKEY;
+    }
+
+    if (avcodec_open2(m_codecContext, codec, nullptr) < 0) {
+        avcodec_free_context(&m_codecContext);
+        m_decoderFailed = true;
+        fail(QString("cannot open decoder %1").arg(codec->name));
+        return false;
+    }
+    m_decodedFrame = av_frame_alloc();
+    return true;
+}
+
+void IngestStream::decodePacket(const Packet& packet)
+{
+    if (!ensureDecoder()) {
+        return;
+    }
+
+    AVPacket* avPacket = av_packet_alloc();
+    if (av_new_packet(avPacket, packet.data.size()) < 0) {
+        av_packet_free(&avPacket);
+        return;
+    }
+    std::memcpy(avPacket->data, packet.data.constData(), static_cast<size_t>(packet.data.size()));
+    avPacket->pts = packet.timestampUs;
+    avPacket->dts = packet.timestampUs;
+    if (packet.keyframe) {
+        avPacket->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    int result = avcodec_send_packet(m_codecContext, avPacket);
+    av_packet_free(&avPacket);
+    if (result < 0 && result != AVERROR(EAGAIN)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.decodeErrors++;
+        return;
+    }
+    while (avcodec_receive_frame(m_codecContext, m_decodedFrame) == 0) {
+        storeFrame();
+    }
+
+    // Одиночный ключевой кадр: декодер сбрасывается, чтобы выдать его сразу,
+    // не дожидаясь следующих кадров (как в FFmpegSource)
+    if (packet.isolated) {
+        avcodec_send_packet(m_codecContext, nullptr);
+        while (avcodec_receive_frame(m_codecContext, m_decodedFrame) == 0) {
+            storeFrame();
+        }
+        avcodec_flush_buffers(m_codecContext);
+    }
+}
+
+void IngestStream::storeFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_decodedFrame->decode_error_flags || (m_decodedFrame->flags & AV_FRAME_FLAG_CORRUPT)) {
+            m_stats.corruptFrames++;
+        }
+        if (m_closed) {
+            av_frame_unref(m_decodedFrame);
+            return;
+        }
+        // Непрочитанный кадр заменяется более свежим
+        av_frame_unref(m_latestFrame);
+        av_frame_move_ref(m_latestFrame, m_decodedFrame);
+        m_hasFrame = true;
+    }
+    m_frameReady.notify_one();
+}
+
+struct IngestReactor::IoThread {
+    struct Command {
+        quint64 sessionId;
+        std::unique_ptr<IngestSession> session;   // nullptr - удалить сессию
+    };
+
+    struct Entry {
+        std::unique_ptr<IngestSession> session;
+        int fd = -1;                // Сокет, зарегистрированный этой сессией
+        bool registered = false;
+        bool writeInterest = false;
+        qint64 timerMs = -1;        // Срок, стоящий в куче; -1 - не стоит
+        bool dirty = false;         // Сессия вызывалась и ещё не пересмотрена
+    };
+
+    // Срок таймера сессии. Устаревшие записи (сессия удалена или срок
+    // сдвинулся) из кучи не удаляются, а пропускаются при извлечении
+    struct Deadline {
+        qint64 timerMs;
+        quint64 sessionId;
+        bool operator>(const Deadline& other) const { return timerMs > other.timerMs; }
+    };
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::thread thread;
+    std::atomic<bool> running{true};
+    std::atomic<int> load{0};
+
+    std::mutex commandMutex;
+    std::vector<Command> commands;
+
+    // Только в потоке ввода-вывода
+    std::unordered_map<quint64, Entry> sessions;
+    std::unordered_map<int, quint64> fdOwners;    // Номер дескриптора -> сессия
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
+    std::vector<quint64> dirty;                   // Сессии, вызванные с прошлого пересмотра
+
+    static constexpr size_t MAX_STALE_DEADLINES = 256;
+
+    void post(Command command)
+    {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            commands.push_back(std::move(command));
+        }
+        uint64_t one = 1;
+        ssize_t written = ::write(wakeFd, &one, sizeof(one));
+        Q_UNUSED(written);
+    }
+
+    // Регистрация принадлежит сессии, а не номеру дескриптора: закрытый сокет
+    // ядро снимает с epoll само, и тот же номер может достаться новому сокету
+    // этой или другой сессии. Поэтому снимается только своя регистрация,
+    // а MOD для исчезнувшей превращается в ADD
+    void syncRegistration(quint64 sessionId, Entry& entry)
+    {
+        int fd = entry.session->fd();
+        bool wantsWrite = fd >= 0 && entry.session->wantsWrite();
+        if (entry.registered && fd == entry.fd && wantsWrite == entry.writeInterest) {
+            return;
+        }
+        if (entry.registered && fd != entry.fd) {
+            unregister(sessionId, entry);
+        }
+        if (fd < 0) {
+            return;
+        }
+
+        // Прежний владелец номера закрыл свой сокет - его регистрации уже нет
+        auto owner = fdOwners.find(fd);
+        if (owner != fdOwners.end() && owner->second != sessionId) {
+            auto previous = sessions.find(owner->second);
+            if (previous != sessions.end()) {
+                previous->second.registered = false;
+                previous->second.fd = -1;
+            }
+        }
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | (wantsWrite ? EPOLLOUT : 0);
+        event.data.u64 = sessionId;
+        int result = epoll_ctl(epollFd, entry.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+        if (result < 0 && errno == ENOENT) {
+            result = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        } else if (result < 0 && errno == EEXIST) {
+            result = epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        }
+        if (result < 0) {
+            qWarning() << "Ingest: cannot register socket of session" << sessionId << ":"
+                       << std::strerror(errno);
+            entry.registered = false;
+            entry.fd = -1;
+            return;
+        }
+        fdOwners[fd] = sessionId;
+        entry.fd = fd;
+        entry.registered = true;
+        entry.writeInterest = wantsWrite;
+    }
+
+    void unregister(quint64 sessionId, Entry& entry)
+    {
+        auto owner = fdOwners.find(entry.fd);
+        if (owner != fdOwners.end() && owner->second == sessionId) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, entry.fd, nullptr);
+            fdOwners.erase(owner);
+        }
+        entry.fd = -1;
+        entry.registered = false;
+        entry.writeInterest = false;
+    }
+
+    // Состояние сессии меняется только в её вызовах, поэтому пересматривать
+    // после пробуждения нужно лишь вызванные сессии, а не все сессии потока
+    void touch(quint64 sessionId, Entry& entry)
+    {
+        if (!entry.dirty) {
+            entry.dirty = true;
+            dirty.push_back(sessionId);
+        }
+    }
+
+    // Завершённые сессии удаляются, у остальных обновляются интерес к записи и срок таймера
+    void refreshDirty()
+    {
+        for (quint64 sessionId : dirty) {
+            auto it = sessions.find(sessionId);
+            if (it == sessions.end()) {
+                continue;
+            }
+            Entry& entry = it->second;
+            entry.dirty = false;
+            if (entry.session->finished()) {
+                erase(it);
+                continue;
+            }
+            syncRegistration(sessionId, entry);
+            qint64 timerMs = entry.session->nextTimerMs();
+            if (timerMs != entry.timerMs) {
+                entry.timerMs = timerMs;
+                if (timerMs >= 0) {
+                    deadlines.push(Deadline{ timerMs, sessionId });
+                }
+            }
+        }
+        dirty.clear();
+
+        // Сроки, сдвигаемые каждым пакетом, копят устаревшие записи - куча пересобирается
+        if (deadlines.size() > 2 * sessions.size() + MAX_STALE_DEADLINES) {
+            std::vector<Deadline> live;
+            live.reserve(sessions.size());
+            for (const auto& item : sessions) {
+                if (item.second.timerMs >= 0) {
+                    live.push_back(Deadline{ item.second.timerMs, item.first });
+                }
+            }
+            deadlines = decltype(deadlines)(std::greater<Deadline>(), std::move(live));
+        }
+    }
+
+    bool isLive(const Deadline& deadline) const
+    {
+        auto it = sessions.find(deadline.sessionId);
+        return it != sessions.end() && it->second.timerMs == deadline.timerMs;
+    }
+
+    /**
+     * @brief Ближайший срок таймера или -1
+     */
+    qint64 nextDeadlineMs()
+    {
+        while (!deadlines.empty() && !isLive(deadlines.top())) {
+            deadlines.pop();
+        }
+        return deadlines.empty() ? -1 : deadlines.top().timerMs;
+    }
+
+    void fireTimers(qint64 nowMs)
+    {
+        while (!deadlines.empty() && deadlines.top().timerMs <= nowMs) {
+            Deadline due = deadlines.top();
+            deadlines.pop();
+            auto it = sessions.find(due.sessionId);
+            if (it == sessions.end() || it->second.timerMs != due.timerMs) {
+                continue;
+            }
+            // Срок снят с кучи: после вызова он ставится заново, даже если не изменился
+            it->second.timerMs = -1;
+            if (!it->second.session->finished()) {
+                it->second.session->onTimer(nowMs);
+            }
+            touch(it->first, it->second);
+        }
+    }
+
+    void erase(std::unordered_map<quint64, Entry>::iterator it)
+    {
+        if (it->second.registered) {
+            unregister(it->first, it->second);
+        }
+        sessions.erase(it);
+        load.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+IngestReactor& IngestReactor::instance()
+{
+    static IngestReactor reactor(FrameSource::backendConfig().ingestThreads,
+                                 FrameSource::backendConfig().decodeThreads);
+    return reactor;
+}
+
+IngestReactor::IngestReactor(int ioThreads, int decodeThreads)
+    : m_nextSessionId(1)
+{
+    int threadCount = qMax(1, ioThreads);
+    m_decodePool.setMaxThreadCount(decodeThreads > 0 ? decodeThreads : QThread::idealThreadCount());
+
+    AffinityPolicy& policy = AffinityPolicy::instance();
+    if (policy.isActive()) {
+        for (int node = 0; node < policy.nodeCount(); ++node) {
+            std::unique_ptr<QThreadPool> pool(new QThreadPool);
+            pool->setMaxThreadCount(qMax(1, qRound(m_decodePool.maxThreadCount() * policy.cpuShare(node))));
+            m_nodePools.push_back(std::move(pool));
+        }
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        std::unique_ptr<IoThread> thread(new IoThread);
+        thread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        thread->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (thread->epollFd < 0 || thread->wakeFd < 0) {
+            qCritical() << "Ingest: cannot create epoll instance:" << std::strerror(errno);
+        }
+
+        // Идентификатор 0 зарезервирован за eventfd пробуждения
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = 0;
+        epoll_ctl(thread->epollFd, EPOLL_CTL_ADD, thread->wakeFd, &event);
+
+        thread->thread = std::thread(&IngestReactor::runIoThread, thread.get());
+        m_threads.push_back(std::move(thread));
+    }
+
+    qInfo() << "Ingest reactor:" << threadCount << "I/O threads," << decodeThreadCount()
+            << "decode threads in" << qMax<size_t>(1, m_nodePools.size()) << "pools";
+}
+
+IngestReactor::~IngestReactor()
+{
+    for (const std::unique_ptr<IoThread>& thread : m_threads) {
+        thread->running = false;
+        uint64_t one = 1;
+        ssize_t written = ::write(thread->wakeFd, &one, sizeof(one));
+        Q_UNUSED(written);
+        thread->thread.join();
+        ::close(thread->wakeFd);
+        ::close(thread->epollFd);
+    }
+    for (const std::unique_ptr<QThreadPool>& pool : m_nodePools) {
+        pool->waitForDone();
+    }
+    m_decodePool.waitForDone();
+}
+
+std::shared_ptr<IngestStream> IngestReactor::createStream()
+{
+    int node = AffinityPolicy::currentThreadNode();
+    if (node >= 0 && node < static_cast<int>(m_nodePools.size())) {
+        return std::make_shared<IngestStream>(m_nodePools[node].get(), MAX_QUEUED_PACKETS, node);
+    }
+    return std::make_shared<IngestStream>(&m_decodePool, MAX_QUEUED_PACKETS);
+}
+
+quint64 IngestReactor::addSession(std::unique_ptr<IngestSession> session)
+{
+    quint64 sessionId = m_nextSessionId.fetch_add(1);
+
+    // Наименее загруженный поток; сессия остаётся в нём до удаления
+    IoThread* target = m_threads.front().get();
+    for (const std::unique_ptr<IoThread>& thread : m_threads) {
+        if (thread->load.load(std::memory_order_relaxed) < target->load.load(std::memory_order_relaxed)) {
+            target = thread.get();
+        }
+    }
+    target->load.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sessionThreads.insert(sessionId, target);
+    }
+    target->post(IoThread::Command{ sessionId, std::move(session) });
+    return sessionId;
+}
+
+void IngestReactor::removeSession(quint64 sessionId)
+{
+    IoThread* thread;
+    {
+        QMutexLocker locker(&m_mutex);
+        thread = m_sessionThreads.take(sessionId);
+    }
+    if (thread) {
+        thread->post(IoThread::Command{ sessionId, nullptr });
+    }
+}
+
+int IngestReactor::ioThreadCount() const
+{
+    return static_cast<int>(m_threads.size());
+}
+
+int IngestReactor::decodeThreadCount() const
+{
+    if (m_nodePools.empty()) {
+        return m_decodePool.maxThreadCount();
+    }
+    int count = 0;
+    for (const std::unique_ptr<QThreadPool>& pool : m_nodePools) {
+        count += pool->maxThreadCount();
+    }
+    return count;
+}
+
+void IngestReactor::runIoThread(IoThread* thread)
+{
+    epoll_event events[MAX_EPOLL_EVENTS];
+
+    while (thread->running.load()) {
+        std::vector<IoThread::Command> commands;
+        {
+            std::lock_guard<std::mutex> lock(thread->commandMutex);
+            commands.swap(thread->commands);
+        }
+
+        qint64 nowMs = monotonicMs();
+        for (IoThread::Command& command : commands) {
+            if (command.session) {
+                IoThread::Entry entry;
+                entry.session = std::move(command.session);
+                // Ошибка старта видна через finished() и обрабатывается при пересмотре
+                entry.session->start(nowMs);
+                auto inserted = thread->sessions.emplace(command.sessionId, std::move(entry));
+                thread->touch(command.sessionId, inserted.first->second);
+            } else {
+                auto it = thread->sessions.find(command.sessionId);
+                if (it != thread->sessions.end()) {
+                    it->second.session->stop();
+                    thread->erase(it);
+                }
+            }
+        }
+
+        thread->refreshDirty();
+        qint64 nextTimerMs = thread->nextDeadlineMs();
+        int timeoutMs = nextTimerMs < 0 ? -1 : static_cast<int>(qMax<qint64>(0, nextTimerMs - nowMs));
+        int count = epoll_wait(thread->epollFd, events, MAX_EPOLL_EVENTS, timeoutMs);
+        if (count < 0 && errno != EINTR) {
+            qWarning() << "Ingest: epoll_wait failed:" << std::strerror(errno);
+        }
+
+        nowMs = monotonicMs();
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.u64 == 0) {
+                uint64_t value;
+                ssize_t bytesRead = ::read(thread->wakeFd, &value, sizeof(value));
+                Q_UNUSED(bytesRead);
+                continue;
+            }
+            auto it = thread->sessions.find(events[i].data.u64);
+            if (it == thread->sessions.end()) {
+                continue;
+            }
+            IngestSession* session = it->second.session.get();
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                session->onWritable(nowMs);
+            }
+            if (!session->finished() && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+                session->onReadable(nowMs);
+            }
+            thread->touch(it->first, it->second);
+        }
+
+        // Ввод-вывод мог сдвинуть сроки: таймеры сверяются с обновлённой кучей
+        thread->refreshDirty();
+        thread->fireTimers(nowMs);
+    }
+
+    for (auto& item : thread->sessions) {
+        item.second.session->stop();
+    }
+    thread->sessions.clear();
+}
@@ -0,0 +1,275 @@
+#ifndef INGESTREACTOR_H
+#define INGESTREACTOR_H
+
+#include "framesource.h"
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include "packetring.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+struct AVCodecContext;
+struct AVFrame;
+}
+
+/**
+ * @class IngestStream
+ * @brief Очередь сжатых кадров одной камеры между потоком ввода-вывода,
+ *        пулом декодирования и потоком камеры
+ *
+ * Поток ввода-вывода (сессия) кладёт собранные кадры Annex-B/пакеты
+ * демультиплексора в ограниченную очередь. Декодирование выполняется в общем
+ * пуле, но для одного потока - строго последовательно: задача ставится в пул,
+ * только если ещё не стоит. Декодер однопоточный - параллелизм даёт число
+ * камер, а не потоки внутри одного декодера.
+ *
+ * Декодированный кадр не копируется: последний кадр лежит в «почтовом ящике»,
+ * поток камеры забирает ссылку на него (waitFrame). Кадры, которые камера не
+ * успела забрать, заменяются более свежими.
+ *
+ * При переполнении очереди (декодер не успевает) очередь сбрасывается и пакеты
+ * отбрасываются до следующего ключевого кадра - иначе декодер получил бы
+ * кадры без опорных.
+ */
+class IngestStream : public std::enable_shared_from_this<IngestStream>
+{
+public:
+    enum class WaitResult {
+        Frame,
+        Timeout,
+        Failed
+    };
+
+    /**
+     * @param node Индекс узла AffinityPolicy, к которому привязываются потоки
+     *        пула при декодировании; -1 - без привязки
+     */
+    IngestStream(QThreadPool* decodePool, int maxQueuedPackets, int node = -1);
+    ~IngestStream();
+
+    // --- Поток ввода-вывода ---
+
+    /**
+     * @brief Параметры декодера; вызывается до первого пакета
+     * @param codecId AVCodecID
+     * @param extradata Наборы параметров (Annex-B или avcC/hvcC)
+     */
+    void setCodec(int codecId, const QByteArray& extradata);
+
+    /**
+     * @brief Кладёт сжатый кадр в очередь и ставит декодирование в пул
+     */
+    void pushPacket(const QByteArray& data, qint64 timestampUs, bool keyframe);
+
+    void addPacketsLost(quint64 count);
+
+    /**
+     * @brief Сессия завершилась с ошибкой; ожидающий поток камеры просыпается
+     */
+    void fail(const QString& reason);
+
+    // --- Поток камеры ---
+
+    /**
+     * @brief Декодировать только ключевые кадры каждого N-го GOP (0 - все)
+     */
+    void setKeyframeOnly(int gopInterval);
+
+    /**
+     * @brief У предела памяти декодировать только ключевые кадры; после
+     *        снятия - все кадры с ближайшего ключевого
+     */
+    void setMemoryShedding(bool enabled);
+
+    /**
+     * @brief Копировать принятые кадры в кольцо предыстории; вызывается до сессии
+     */
+    void setPacketRing(std::shared_ptr<PacketRing> ring);
+
+    /**
+     * @brief Ждёт новый декодированный кадр и передаёт ссылку на него в frame
+     */
+    WaitResult waitFrame(AVFrame* frame, int timeoutMs);
+
+    /**
+     * @brief Отключает поток от пула; пакеты и кадры дальше не принимаются
+     */
+    void close();
+
+    FrameSource::StreamStats stats() const;
+    QString errorText() const;
+
+private:
+    class DecodeTask;
+
+    struct Packet {
+        QByteArray data;
+        qint64 timestampUs;
+        bool keyframe;
+        bool isolated;              // Одиночный ключевой кадр: после него декодер сбрасывается
+    };
+
+    void decodePending();
+    bool ensureDecoder();
+    void decodePacket(const Packet& packet);
+    void storeFrame();
+
+    QThreadPool* m_decodePool;
+    const int m_node;
+    const int MAX_QUEUED_PACKETS;
+    const int MAX_PACKETS_PER_TASK = 8;     // Затем задача уступает пул другим камерам
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_frameReady;
+    std::deque<Packet> m_queue;
+    bool m_scheduled;               // Задача декодирования стоит в пуле или выполняется
+    bool m_waitKeyframe;            // Отбрасывать пакеты до ключевого кадра
+    bool m_closed;
+    bool m_failed;
+    QString m_errorText;
+    int m_keyframeGopInterval;
+    quint64 m_keyframesSeen;
+    bool m_memoryShedding;
+    int m_codecId;
+    QByteArray m_extradata;
+    FrameSource::StreamStats m_stats;
+    std::shared_ptr<PacketRing> m_packetRing;
+
+    // Только в задаче декодирования (последовательно)
+    AVCodecContext* m_codecContext;
+    AVFrame* m_decodedFrame;
+    bool m_decoderFailed;
+
+    // Почтовый ящик: последний декодированный кадр (под m_mutex)
+    AVFrame* m_latestFrame;
+    bool m_hasFrame;
+};
+
+/**
+ * @class IngestSession
+ * @brief Неблокирующая сессия получения потока, обслуживаемая IngestReactor
+ *
+ * Все методы вызываются только из потока ввода-вывода реактора. Сессия не
+ * блокируется: читает и пишет столько, сколько отдаёт неблокирующий сокет,
+ * а ожидания выражает через таймер (nextTimerMs).
+ */
+class IngestSession
+{
+public:
+    virtual ~IngestSession() = default;
+
+    /**
+     * @brief Начинает работу (неблокирующее подключение)
+     * @return false при немедленной ошибке
+     */
+    virtual bool start(qint64 nowMs) = 0;
+
+    /**
+     * @brief Сокет сессии или -1, если сессия работает только по таймеру
+     */
+    virtual int fd() const = 0;
+
+    /**
+     * @brief Есть данные для отправки (нужен EPOLLOUT)
+     */
+    virtual bool wantsWrite() const = 0;
+
+    virtual void onReadable(qint64 nowMs) = 0;
+    virtual void onWritable(qint64 nowMs) = 0;
+    virtual void onTimer(qint64 nowMs) = 0;
+
+    /**
+     * @brief Время следующего срабатывания таймера (монотонные мс) или -1
+     */
+    virtual qint64 nextTimerMs() const = 0;
+
+    /**
+     * @brief Сессия завершена (ошибка или конец потока) и будет удалена
+     */
+    virtual bool finished() const = 0;
+
+    /**
+     * @brief Корректное завершение перед удалением (без ожидания ответа)
+     */
+    virtual void stop() = 0;
+};
+
+/**
+ * @class IngestReactor
+ * @brief Несколько потоков epoll, обслуживающих сессии всех камер, и общий
+ *        пул декодирования
+ *
+ * Вместо потока, заблокированного в чтении сокета на каждую камеру, сетевой
+ * ввод-вывод сотен камер выполняют несколько потоков (--ingest-threads):
+ * каждый ждёт в epoll_wait события своих сокетов и таймеры своих сессий.
+ * Сессии распределяются по потокам по наименьшей загрузке. Собранные сжатые
+ * кадры уходят в пул декодирования (--decode-threads).
+ *
+ * Добавление и удаление сессий - команды в очереди потока с пробуждением
+ * через eventfd, поэтому сессия всегда используется только своим потоком.
+ *
+ * При активной AffinityPolicy пул декодирования делится по узлам NUMA
+ * пропорционально их ядрам: кадры камеры декодируются потоками её узла
+ * в его память.
+ */
+class IngestReactor
+{
+public:
+    /**
+     * @brief Общий реактор; размеры пулов берутся из FrameSource::backendConfig()
+     */
+    static IngestReactor& instance();
+
+    /**
+     * @brief Новый поток данных, привязанный к пулу декодирования
+     *
+     * Пул выбирается по узлу вызывающего потока камеры.
+     */
+    std::shared_ptr<IngestStream> createStream();
+
+    /**
+     * @brief Передаёт сессию потоку ввода-вывода
+     * @return Идентификатор для removeSession()
+     */
+    quint64 addSession(std::unique_ptr<IngestSession> session);
+
+    /**
+     * @brief Останавливает и удаляет сессию (асинхронно)
+     */
+    void removeSession(quint64 sessionId);
+
+    int ioThreadCount() const;
+    int decodeThreadCount() const;
+
+    ~IngestReactor();
+
+private:
+    struct IoThread;
+
+    IngestReactor(int ioThreads, int decodeThreads);
+    IngestReactor(const IngestReactor&) = delete;
+    IngestReactor& operator=(const IngestReactor&) = delete;
+
+    static void runIoThread(IoThread* thread);
+
+    std::vector<std::unique_ptr<IoThread>> m_threads;
+    QThreadPool m_decodePool;
+    std::vector<std::unique_ptr<QThreadPool>> m_nodePools;   // По индексам AffinityPolicy
+    std::atomic<quint64> m_nextSessionId;
+
+    QMutex m_mutex;
+    QHash<quint64, IoThread*> m_sessionThreads;
+
+    static constexpr int MAX_QUEUED_PACKETS = 60;   // ~2 с видео при 30 кадр/с
+    static constexpr int MAX_EPOLL_EVENTS = 64;
+};
+
+#endif // INGESTREACTOR_H
@@ -0,0 +1,313 @@
+#include "ingestsource.h"
+#include "rtspsession.h"
+#include <QDebug>
+#include <QUrl>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+
+/**
+ * @brief Сессия реактора, воспроизводящая файл в темпе реального времени
+ *
+ * Работает только по таймеру (без сокета): на каждом срабатывании выдаёт
+ * пакеты, время которых наступило, и взводит таймер на следующий.
+ */
+class FileIngestSession : public IngestSession
+{
+public:
+    FileIngestSession(const QString& path, bool loop, std::shared_ptr<IngestStream> stream)
+        : m_path(path)
+        , m_loop(loop)
+        , m_stream(std::move(stream))
+        , m_formatContext(nullptr)
+        , m_packet(av_packet_alloc())
+        , m_videoStream(-1)
+        , m_havePacket(false)
+        , m_rebase(true)
+        , m_startMs(0)
+        , m_nextMs(-1)
+        , m_finished(false)
+    {
+    }
+
+    ~FileIngestSession()
+    {
+        av_packet_free(&m_packet);
+        if (m_formatContext) {
+            avformat_close_input(&m_formatContext);
+        }
+    }
+
+    /**
+     * @brief Открывает файл (в потоке камеры; локальный файл - миллисекунды)
+     */
+    bool open()
+    {
+        if (avformat_open_input(&m_formatContext, m_path.toUtf8().constData(), nullptr, nullptr) < 0) {
+            m_formatContext = nullptr;
+            return false;
+        }
+        if (avformat_find_stream_info(m_formatContext, nullptr) < 0) {
+            return false;
+        }
+        m_videoStream = av_find_best_stream(m_formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (m_videoStream < 0) {
+            return false;
+        }
+        const AVCodecParameters* parameters = m_formatContext->streams[m_videoStream]->codecpar;
+        m_stream->setCodec(parameters->codec_id,
+                           QByteArray(reinterpret_cast<const char*>(parameters->extradata),
+                                      parameters->extradata_size));
+        return true;
+    }
+
+    bool start(qint64 nowMs) override
+    {
+        m_nextMs = nowMs;
+        return true;
+    }
+
+    int fd() const override { return -1; }
+    bool wantsWrite() const override { return false; }
+    void onReadable(qint64) override {}
+    void onWritable(qint64) override {}
+    qint64 nextTimerMs() const override { return m_finished ? -1 : m_nextMs; }
+    bool finished() const override { return m_finished; }
+    void stop() override { m_finished = true; }
+
+    void onTimer(qint64 nowMs) override
+    {
+        for (int i = 0; i < MAX_PACKETS_PER_TICK; ++i) {
+            if (!m_havePacket && !readPacket(nowMs)) {
+                return;
+            }
+            qint64 dueMs = m_startMs + m_packetMs;
+            if (dueMs > nowMs) {
+                m_nextMs = dueMs;
+                return;
+            }
+            m_stream->pushPacket(QByteArray(reinterpret_cast<const char*>(m_packet->data), m_packet->size),
+                                 m_packetUs, (m_packet->flags & AV_PKT_FLAG_KEY) != 0);
+            av_packet_unref(m_packet);
+            m_havePacket = false;
+        }
+        m_nextMs = nowMs;
+    }
+
+private:
+    bool readPacket(qint64 nowMs)
+    {
+        while (true) {
+            int result = av_read_frame(m_formatContext, m_packet);
+            if (result == AVERROR_EOF && m_loop
+                && av_seek_frame(m_formatContext, m_videoStream, 0, AVSEEK_FLAG_BACKWARD) >= 0) {
+                m_rebase = true;
+                continue;
+            }
+            if (result < 0) {
+                m_finished = true;
+                m_stream->fail(result == AVERROR_EOF ? "end of file" : "file read error");
+                return false;
+            }
+            if (m_packet->stream_index != m_videoStream) {
+                av_packet_unref(m_packet);
+                continue;
+            }
+            break;
+        }
+
+        AVStream* stream = m_formatContext->streams[m_videoStream];
+        // Темп задаётся порядком декодирования
+        int64_t timestamp = m_packet->dts != AV_NOPTS_VALUE ? m_packet->dts : m_packet->pts;
+        if (timestamp == AV_NOPTS_VALUE) {
+            timestamp = 0;
+        }
+        m_packetUs = av_rescale_q(timestamp, stream->time_base, AVRational{ 1, 1000000 });
+        m_packetMs = m_packetUs / 1000;
+        // Начало файла и каждый повтор привязываются к текущему моменту
+        if (m_rebase) {
+            m_startMs = nowMs - m_packetMs;
+            m_rebase = false;
+        }
+        m_havePacket = true;
+        return true;
+    }
+
+    QString m_path;
+    bool m_loop;
+    std::shared_ptr<IngestStream> m_stream;
+    AVFormatContext* m_formatContext;
+    AVPacket* m_packet;
+    int m_videoStream;
+    bool m_havePacket;
+    bool m_rebase;
+    qint64 m_startMs;
+    qint64 m_nextMs;
+    qint64 m_packetUs = 0;
+    qint64 m_packetMs = 0;
+    bool m_finished;
+
+    static constexpr int MAX_PACKETS_PER_TICK = 16;
+};
+
+} // namespace
+
+IngestSource::IngestSource(const QString& location, bool loop)
+    : m_location(location)
+    , m_loop(loop)
+    , m_openTimeoutMs(0)
+    , m_keyframeGopInterval(0)
+    , m_memoryShedding(false)
+    , m_sessionId(0)
+    , m_frame(av_frame_alloc())
+    , m_framePending(false)
+    , m_lastTimestampUs(0)
+{
+}
+
+IngestSource::~IngestSource()
+{
+    close();
+    av_frame_free(&m_frame);
+}
+
+void IngestSource::setOpenTimeout(int timeoutMs)
+{
+    m_openTimeoutMs = timeoutMs;
+}
+
+bool IngestSource::setKeyframeOnly(int gopInterval)
+{
+    m_keyframeGopInterval = qMax(0, gopInterval);
+    return true;
+}
+
+bool IngestSource::setPreEventBuffer(int durationMs, qint64 maxBytes)
+{
+    m_packetRing = durationMs > 0 ? std::make_shared<PacketRing>(durationMs, maxBytes) : nullptr;
+    return true;
+}
+
+bool IngestSource::savePreEvent(const QString& path)
+{
+    return m_packetRing && m_packetRing->save(path);
+}
+
+void IngestSource::setMemoryShedding(bool enabled)
+{
+    m_memoryShedding = enabled;
+    if (m_packetRing) {
+        m_packetRing->setSuspended(enabled);
+    }
+    if (m_stream) {
+        m_stream->setMemoryShedding(enabled);
+    }
+}
+
+bool IngestSource::open()
+{
+    close();
+
+    IngestReactor& reactor = IngestReactor::instance();
+    int timeoutMs = m_openTimeoutMs > 0 ? m_openTimeoutMs : DEFAULT_TIMEOUT_MS;
+    m_stream = reactor.createStream();
+    m_stream->setKeyframeOnly(m_keyframeGopInterval);
+    m_stream->setMemoryShedding(m_memoryShedding);
+    m_stream->setPacketRing(m_packetRing);
+
+    std::unique_ptr<IngestSession> session;
+    if (m_location.startsWith("rtsp://", Qt::CaseInsensitive)) {
+        QUrl url(m_location);
+        sockaddr_storage address;
+        socklen_t addressLength = 0;
+        // Разрешение имени блокирующее, поэтому выполняется здесь, а не в реакторе
+        if (!RtspSession::resolve(url.host(), url.port(554), address, addressLength)) {
+            qWarning() << "Ingest: cannot resolve" << url.host();
+            close();
+            return false;
+        }
+        session.reset(new RtspSession(url, address, addressLength, m_stream, timeoutMs));
+    } else {
+        std::unique_ptr<FileIngestSession> file(new FileIngestSession(m_location, m_loop, m_stream));
+        if (!file->open()) {
+            qWarning() << "Ingest: cannot open" << m_location;
+            close();
+            return false;
+        }
+        session = std::move(file);
+    }
+    m_sessionId = reactor.addSession(std::move(session));
+
+    // Как и VideoCapture::open, открытие подтверждается первым кадром
+    if (m_stream->waitFrame(m_frame, timeoutMs) != IngestStream::WaitResult::Frame) {
+        QString reason = m_stream->errorText();
+        qWarning() << "Ingest: no frames from" << QUrl(m_location).toString(QUrl::RemovePassword)
+                   << (reason.isEmpty() ? QString("timeout") : reason);
+        close();
+        return false;
+    }
+    m_framePending = true;
+    if (m_packetRing) {
+        m_packetRing->setFrameSize(m_frame->width, m_frame->height);
+    }
+
+    qInfo() << "Ingest: opened" << QUrl(m_location).toString(QUrl::RemovePassword)
+            << m_frame->width << "x" << m_frame->height;
+    return true;
+}
+
+bool IngestSource::read(cv::Mat& frame)
+{
+    if (!m_stream) {
+        return false;
+    }
+
+    if (!m_framePending) {
+        int timeoutMs = m_openTimeoutMs > 0 ? m_openTimeoutMs : DEFAULT_TIMEOUT_MS;
+        if (m_stream->waitFrame(m_frame, timeoutMs) != IngestStream::WaitResult::Frame) {
+            return false;
+        }
+    }
+    m_framePending = false;
+
+    if (m_frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+        m_lastTimestampUs = m_frame->best_effort_timestamp;
+    }
+    m_converter.convert(m_frame);
+    frame = m_converter.bgr();
+    return !frame.empty();
+}
+
+void IngestSource::close()
+{
+    if (m_stream) {
+        IngestReactor::instance().removeSession(m_sessionId);
+        m_stream->close();
+        m_stream.reset();
+    }
+    m_sessionId = 0;
+    m_framePending = false;
+    m_converter.reset();
+    av_frame_unref(m_frame);
+}
+
+bool IngestSource::isOpened() const
+{
+    return m_stream != nullptr;
+}
+
+cv::Mat IngestSource::lumaPlane() const
+{
+    return m_converter.luma();
+}
+
+FrameSource::StreamStats IngestSource::streamStats() const
+{
+    StreamStats stats = m_stream ? m_stream->stats() : StreamStats();
+    stats.lastTimestampUs = m_lastTimestampUs;
+    return stats;
+}
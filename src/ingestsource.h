@@ -0,0 +1,57 @@
+#ifndef INGESTSOURCE_H
+#define INGESTSOURCE_H
+
+#include "ffmpegsource.h"
+#include "ingestreactor.h"
+#include <memory>
+
+/**
+ * @class IngestSource
+ * @brief Источник камеры поверх общего IngestReactor (--capture-backend ingest)
+ *
+ * Сокет камеры обслуживает поток ввода-вывода реактора, декодирование -
+ * общий пул; поток камеры только ждёт готовый кадр (без сетевого ввода-вывода)
+ * и переводит его в BGR и плоскость Y.
+ *
+ * rtsp:// открывается собственным клиентом RtspSession (TCP interleaved,
+ * H.264/H.265). file:// - замена камеры для проверки без RTSP-сервера:
+ * пакеты файла читаются через libavformat и выдаются в темпе реального
+ * времени теми же потоками реактора и пула.
+ */
+class IngestSource : public FrameSource
+{
+public:
+    IngestSource(const QString& location, bool loop);
+    ~IngestSource();
+
+    bool open() override;
+    bool read(cv::Mat& frame) override;
+    void close() override;
+    bool isOpened() const override;
+    void setOpenTimeout(int timeoutMs) override;
+    bool setKeyframeOnly(int gopInterval) override;
+    bool setPreEventBuffer(int durationMs, qint64 maxBytes) override;
+    bool savePreEvent(const QString& path) override;
+    void setMemoryShedding(bool enabled) override;
+    cv::Mat lumaPlane() const override;
+    StreamStats streamStats() const override;
+
+private:
+    QString m_location;
+    bool m_loop;
+    int m_openTimeoutMs;
+    int m_keyframeGopInterval;
+    bool m_memoryShedding;
+
+    std::shared_ptr<IngestStream> m_stream;
+    std::shared_ptr<PacketRing> m_packetRing;   // Общее с потоком ввода-вывода
+    quint64 m_sessionId;
+    AVFrame* m_frame;
+    bool m_framePending;        // Первый кадр получен в open() и ещё не отдан
+    qint64 m_lastTimestampUs;
+    AVFrameConverter m_converter;
+
+    static constexpr int DEFAULT_TIMEOUT_MS = 10000;
+};
+
+#endif // INGESTSOURCE_H
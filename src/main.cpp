@@ -3,26 +3,86 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QHostInfo>
 #include <QMetaType>
+#include <QDateTime>
+#include <QStandardPaths>
 #include <iostream>
+#include <memory>
 
 #include "mainwindow.h"
 #include "imagequalityanalyzer.h"
+#include "shardcoordinator.h"
+#include "shardprotocol.h"
+#include "shardworker.h"
+#include "capturepublisher.h"
+#include "cameraworker.h"
+#include "timeseriesstore.h"
+#include "affinitypolicy.h"
+#include "memorybudget.h"
+#include "resultprotocol.h"
+#include "resultpublisher.h"
+#include "resultviewer.h"
 
 // Регистрация метатипа для передачи между потоками
 Q_DECLARE_METATYPE(ImageQualityAnalyzer::QualityResult)
 
+// Сборка для edge-устройств задаёт предел памяти по умолчанию (см. CMakeLists.txt)
+#ifndef DEFAULT_MEMORY_LIMIT_MB
+#define DEFAULT_MEMORY_LIMIT_MB 0
+#endif
+
+/**
+ * @brief Адрес прослушивания из host части host:port
+ *
+ * Принимает IP-адрес, * (все интерфейсы) или имя хоста, которое разрешается
+ * в первый его адрес. Неразрешимое имя - ошибка: молча слушать все
+ * интерфейсы вместо указанного нельзя.
+ */
+static bool resolveListenAddress(const QString& host, QHostAddress& address)
+{
+    if (host == "*") {
+        address = QHostAddress::Any;
+        return true;
+    }
+    address = QHostAddress(host);
+    if (!address.isNull()) {
+        return true;
+    }
+    QHostInfo info = QHostInfo::fromName(host);
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+        std::cerr << "Cannot resolve " << host.toStdString() << ": " << info.errorString().toStdString() << std::endl;
+        return false;
+    }
+    address = info.addresses().first();
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    // Обработчик шардирования, процесс захвата, просмотрщик и запросы истории работают без GUI
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        QString argument(argv[i]);
+        if (argument.startsWith("--shard-worker") || argument.startsWith("--capture-publisher")
+            || argument.startsWith("--history-list") || argument.startsWith("--history-query")
+            || argument.startsWith("--viewer")) {
+            headless = true;
+        }
+    }
+    std::unique_ptr<QCoreApplication> app(headless
+        ? new QCoreApplication(argc, argv)
+        : new QApplication(argc, argv));
     
     QCoreApplication::setApplicationName("IP Camera Video Quality Analyzer");
     QCoreApplication::setApplicationVersion("0.0.1");
     QCoreApplication::setOrganizationName("Danila Ivlev");
     QCoreApplication::setOrganizationDomain("danila-ivlev");
     
-    QApplication::setApplicationDisplayName("Анализатор качества видеопотока с IP камер");
-    QApplication::setWindowIcon(QIcon::fromTheme("camera-video"));
+    if (!headless) {
+        QApplication::setApplicationDisplayName("Анализатор качества видеопотока с IP камер");
+        QApplication::setWindowIcon(QIcon::fromTheme("camera-video"));
+    }
     
     QCommandLineParser parser;
     parser.setApplicationDescription(
@@ -35,7 +95,7 @@ int main(int argc, char *argv[])
     
     QCommandLineOption cameraOption(
         QStringList() << "c" << "camera",
-        "Add camera with specified RTSP URL",
+        "Add camera with specified RTSP URL (may be repeated)",
         "rtsp_url"
     );
     parser.addOption(cameraOption);
@@ -46,27 +106,538 @@ int main(int argc, char *argv[])
     );
     parser.addOption(debugOption);
     
-    parser.process(app);
+    QCommandLineOption cpuBudgetOption(
+        "cpu-budget",
+        "CPU budget for quality analysis, percent of all cores (0 = fixed analysis interval)",
+        "percent",
+        "50"
+    );
+    parser.addOption(cpuBudgetOption);
+    
+    QCommandLineOption coordinatorOption(
+        "coordinator",
+        "Distribute cameras across shard workers connecting to this address",
+        "host:port"
+    );
+    parser.addOption(coordinatorOption);
+    
+    QCommandLineOption shardWorkerOption(
+        "shard-worker",
+        "Run headless, processing cameras assigned by the coordinator at this address",
+        "host:port"
+    );
+    parser.addOption(shardWorkerOption);
+    
+    QCommandLineOption workerNameOption(
+        "worker-name",
+        "Unique shard worker name (default: hostname-pid)",
+        "name"
+    );
+    parser.addOption(workerNameOption);
+    
+    QCommandLineOption isolateCaptureOption(
+        "isolate-capture",
+        "Decode each camera in a separate capture process sharing frames via shared memory"
+    );
+    parser.addOption(isolateCaptureOption);
+    
+    QCommandLineOption captureBackendOption(
+        "capture-backend",
+        "Stream decoding backend: opencv (cv::VideoCapture), ffmpeg (libavformat/libavcodec) "
+        "or ingest (shared epoll I/O threads and decode pool)",
+        "backend",
+        "opencv"
+    );
+    parser.addOption(captureBackendOption);
+    
+    QCommandLineOption demuxOptionOption(
+        "demux-option",
+        "FFmpeg demuxer option, e.g. rtsp_transport=udp or buffer_size=1048576 (may be repeated)",
+        "key=value"
+    );
+    parser.addOption(demuxOptionOption);
+    
+    QCommandLineOption decodeThreadsOption(
+        "decode-threads",
+        "FFmpeg slice threads per camera (0 = 2), or decode pool size for the ingest backend (0 = number of cores)",
+        "count",
+        "0"
+    );
+    parser.addOption(decodeThreadsOption);
+    
+    QCommandLineOption ingestThreadsOption(
+        "ingest-threads",
+        "Network I/O threads shared by all cameras (ingest backend)",
+        "count",
+        "2"
+    );
+    parser.addOption(ingestThreadsOption);
+    
+    QCommandLineOption numaAffinityOption(
+        "numa-affinity",
+        "Pin each camera's capture, decode and analysis to one NUMA node: auto (multi-node machines only) or off. "
+        "Disables OpenCV's thread pool for the whole process: the strip-parallel colour pass and batch "
+        "analysis then run serially, so use it only when cameras outnumber cores",
+        "mode",
+        "off"
+    );
+    parser.addOption(numaAffinityOption);
+    
+    QCommandLineOption memoryLimitOption(
+        "memory-limit",
+        "Resident memory ceiling in MiB: low-memory analysis without previews, analysis slows down "
+        "and pauses near the ceiling (0 = no ceiling)",
+        "mb",
+        QString::number(DEFAULT_MEMORY_LIMIT_MB)
+    );
+    parser.addOption(memoryLimitOption);
+    
+    QCommandLineOption keyframeIntervalOption(
+        "keyframe-interval",
+        "Decode and analyze only keyframes: 1 = every GOP, N = every Nth GOP, 0 = all frames (FFmpeg backend)",
+        "gops",
+        "0"
+    );
+    parser.addOption(keyframeIntervalOption);
+    
+    QCommandLineOption capturePublisherOption(
+        "capture-publisher",
+        "Run as a headless capture process publishing decoded frames of this URL",
+        "url"
+    );
+    parser.addOption(capturePublisherOption);
+    
+    QCommandLineOption shmNameOption(
+        "shm-name",
+        "Shared memory frame ring name for --capture-publisher (read it with shm://<name>)",
+        "name"
+    );
+    parser.addOption(shmNameOption);
+    
+    QCommandLineOption configOption(
+        "config",
+        "Load camera list from file (one URL per line, optional name=...)",
+        "file"
+    );
+    parser.addOption(configOption);
+    
+    QCommandLineOption parallelConnectsOption(
+        "parallel-connects",
+        "Maximum number of cameras connecting at the same time",
+        "count",
+        "8"
+    );
+    parser.addOption(parallelConnectsOption);
+    
+    QCommandLineOption openTimeoutOption(
+        "open-timeout",
+        "Per-camera stream open/read timeout in milliseconds",
+        "ms",
+        "5000"
+    );
+    parser.addOption(openTimeoutOption);
+    
+    QCommandLineOption mainStreamIdleOption(
+        "main-stream-idle",
+        "Seconds before an on-demand main stream of a camera with a sub-stream (sub= in --config) is closed",
+        "seconds",
+        "30"
+    );
+    parser.addOption(mainStreamIdleOption);
+    
+    QCommandLineOption snapshotCacheOption(
+        "snapshot-cache-mb",
+        "Memory limit of the worst/best/score-drop snapshot cache in MiB (0 = disabled)",
+        "mb",
+        "64"
+    );
+    parser.addOption(snapshotCacheOption);
+    
+    QCommandLineOption snapshotFormatOption(
+        "snapshot-format",
+        "Snapshot compression format: jpg or webp",
+        "format",
+        "jpg"
+    );
+    parser.addOption(snapshotFormatOption);
+    
+    QCommandLineOption preEventOption(
+        "pre-event",
+        "Seconds of compressed video kept per camera for alert/score-drop recordings (0 = disabled; FFmpeg or ingest backend)",
+        "seconds",
+        "30"
+    );
+    parser.addOption(preEventOption);
+    
+    QCommandLineOption preEventMemoryOption(
+        "pre-event-mb",
+        "Memory limit of the pre-event video of one camera in MiB",
+        "mb",
+        "16"
+    );
+    parser.addOption(preEventMemoryOption);
+    
+    QCommandLineOption recordingDirOption(
+        "recording-dir",
+        "Directory for pre-event recordings (default: application data directory)",
+        "dir"
+    );
+    parser.addOption(recordingDirOption);
+    
+    QCommandLineOption recordingFormatOption(
+        "recording-format",
+        "Pre-event recording container: mp4 or mkv",
+        "format",
+        "mp4"
+    );
+    parser.addOption(recordingFormatOption);
+    
+    QCommandLineOption historyDirOption(
+        "history-dir",
+        "Quality history directory (default: application data directory)",
+        "dir"
+    );
+    parser.addOption(historyDirOption);
+    
+    QCommandLineOption noHistoryOption(
+        "no-history",
+        "Do not record quality history"
+    );
+    parser.addOption(noHistoryOption);
+    
+    QCommandLineOption historyRetentionOption(
+        "history-retention",
+        "Retention of history series, e.g. raw=24h,1m=31d,1h=400d,1d=0 (0 = forever; omitted series keep defaults)",
+        "spec"
+    );
+    parser.addOption(historyRetentionOption);
+    
+    QCommandLineOption historyListOption(
+        "history-list",
+        "List cameras with recorded history and exit"
+    );
+    parser.addOption(historyListOption);
+    
+    QCommandLineOption historyQueryOption(
+        "history-query",
+        "Print quality history of a camera (URL or id from --history-list) as CSV and exit",
+        "camera"
+    );
+    parser.addOption(historyQueryOption);
+    
+    QCommandLineOption historyFromOption(
+        "history-from",
+        "Start of --history-query range, ISO 8601 (default: 24 hours before the end)",
+        "time"
+    );
+    parser.addOption(historyFromOption);
+    
+    QCommandLineOption historyToOption(
+        "history-to",
+        "End of --history-query range, ISO 8601 (default: now)",
+        "time"
+    );
+    parser.addOption(historyToOption);
+    
+    QCommandLineOption historyResolutionOption(
+        "history-resolution",
+        "Resolution of --history-query: auto, raw, 1m, 1h or 1d",
+        "resolution",
+        "auto"
+    );
+    parser.addOption(historyResolutionOption);
+    
+    QCommandLineOption alertRulesOption(
+        "alert-rules",
+        "Load alert rules from file instead of the built-in defaults",
+        "file"
+    );
+    parser.addOption(alertRulesOption);
+    
+    QCommandLineOption publishResultsOption(
+        "publish-results",
+        "Stream results and thumbnails to remote viewers connecting to this TCP address "
+        "(IP, host name or * for all interfaces)",
+        "host:port"
+    );
+    parser.addOption(publishResultsOption);
+    
+    QCommandLineOption publishLocalOption(
+        "publish-local",
+        "Stream results and thumbnails to viewers connecting to this local socket",
+        "name"
+    );
+    parser.addOption(publishLocalOption);
+    
+    QCommandLineOption viewerOption(
+        "viewer",
+        "Run as a headless viewer of a result publisher (host:port or local:name), printing updates",
+        "endpoint"
+    );
+    parser.addOption(viewerOption);
+    
+    QCommandLineOption viewerFilterOption(
+        "viewer-filter",
+        "Subscribe only to cameras whose URL or name matches this wildcard (may be repeated)",
+        "pattern"
+    );
+    parser.addOption(viewerFilterOption);
+    
+    QCommandLineOption viewerThumbnailsOption(
+        "viewer-thumbnails",
+        "Request camera thumbnails and save them to this directory",
+        "dir"
+    );
+    parser.addOption(viewerThumbnailsOption);
+    
+    QCommandLineOption viewerIntervalOption(
+        "viewer-interval",
+        "Minimum interval between updates of one camera sent to the viewer",
+        "ms",
+        "0"
+    );
+    parser.addOption(viewerIntervalOption);
+    
+    parser.process(*app);
     
     bool debugMode = parser.isSet(debugOption);
     if (debugMode) {
         qDebug() << "Debug mode enabled";
     }
     
+    double cpuBudget = parser.value(cpuBudgetOption).toDouble() / 100.0;
+    
+    FrameSource::BackendConfig backendConfig;
+    QString backendName = parser.value(captureBackendOption).toLower();
+    if (backendName == "ffmpeg") {
+        backendConfig.backend = FrameSource::CaptureBackend::FFmpeg;
+    } else if (backendName == "ingest") {
+        backendConfig.backend = FrameSource::CaptureBackend::Ingest;
+    } else if (backendName != "opencv") {
+        std::cerr << "Unknown capture backend: " << backendName.toStdString() << std::endl;
+        return 1;
+    }
+    for (const QString& option : parser.values(demuxOptionOption)) {
+        int separator = option.indexOf('=');
+        if (separator <= 0) {
+            std::cerr << "Invalid --demux-option, expected key=value: " << option.toStdString() << std::endl;
+            return 1;
+        }
+        backendConfig.demuxOptions.insert(option.left(separator), option.mid(separator + 1));
+    }
+    backendConfig.decodeThreads = parser.value(decodeThreadsOption).toInt();
+    backendConfig.ingestThreads = qMax(1, parser.value(ingestThreadsOption).toInt());
+    FrameSource::setBackendConfig(backendConfig);
+    QString numaAffinity = parser.value(numaAffinityOption).toLower();
+    if (numaAffinity != "auto" && numaAffinity != "off") {
+        std::cerr << "Unknown NUMA affinity mode: " << numaAffinity.toStdString() << std::endl;
+        return 1;
+    }
+    CameraWorker::setMaxParallelConnects(parser.value(parallelConnectsOption).toInt());
+    
+    QString historyDir = parser.value(historyDirOption);
+    if (historyDir.isEmpty()) {
+        historyDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history";
+    }
+    
+    TimeSeriesStore::Retention historyRetention;
+    if (!TimeSeriesStore::parseRetention(parser.value(historyRetentionOption), historyRetention)) {
+        std::cerr << "Invalid --history-retention, expected e.g. raw=24h,1m=31d" << std::endl;
+        return 1;
+    }
+    
+    if (parser.isSet(historyListOption) || parser.isSet(historyQueryOption)) {
+        TimeSeriesStore store(historyDir);
+        store.setRetention(historyRetention);
+        if (parser.isSet(historyListOption)) {
+            for (const TimeSeriesStore::CameraInfo& camera : store.cameras()) {
+                std::cout << camera.id.toStdString() << "\t" << camera.displayName.toStdString() << std::endl;
+            }
+            return 0;
+        }
+        
+        QDateTime to = parser.isSet(historyToOption)
+            ? QDateTime::fromString(parser.value(historyToOption), Qt::ISODate)
+            : QDateTime::currentDateTime();
+        QDateTime from = parser.isSet(historyFromOption)
+            ? QDateTime::fromString(parser.value(historyFromOption), Qt::ISODate)
+            : to.addSecs(-24 * 3600);
+        if (!from.isValid() || !to.isValid()) {
+            std::cerr << "Invalid --history-from/--history-to, expected ISO 8601 time" << std::endl;
+            return 1;
+        }
+        
+        TimeSeriesStore::Resolution resolution;
+        QString resolutionName = parser.value(historyResolutionOption);
+        if (resolutionName == "auto") {
+            resolution = store.resolutionFor(from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch(), 2000);
+        } else if (!TimeSeriesStore::parseResolution(resolutionName, resolution)) {
+            std::cerr << "Unknown history resolution: " << resolutionName.toStdString() << std::endl;
+            return 1;
+        }
+        
+        QVector<TimeSeriesStore::Point> points = store.query(parser.value(historyQueryOption), resolution,
+                                                             from.toMSecsSinceEpoch(), to.toMSecsSinceEpoch());
+        std::cout << "time,count";
+        for (int metric = 0; metric < TimeSeriesStore::METRIC_COUNT; ++metric) {
+            QString name = TimeSeriesStore::metricName(metric);
+            std::cout << "," << name.toStdString() << "_min," << name.toStdString() << "_mean,"
+                      << name.toStdString() << "_max";
+        }
+        std::cout << std::endl;
+        for (const TimeSeriesStore::Point& point : points) {
+            std::cout << QDateTime::fromMSecsSinceEpoch(point.timestampMs).toString(Qt::ISODateWithMs).toStdString()
+                      << "," << point.count;
+            for (int metric = 0; metric < TimeSeriesStore::METRIC_COUNT; ++metric) {
+                std::cout << "," << point.min[metric] << "," << point.mean[metric] << "," << point.max[metric];
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+    
+    if (parser.isSet(capturePublisherOption)) {
+        if (!parser.isSet(shmNameOption)) {
+            std::cerr << "--capture-publisher requires --shm-name" << std::endl;
+            return 1;
+        }
+        CapturePublisher publisher(parser.value(capturePublisherOption), parser.value(shmNameOption));
+        publisher.setKeyframeInterval(parser.value(keyframeIntervalOption).toInt());
+        return publisher.run();
+    }
+    
+    if (parser.isSet(viewerOption)) {
+        ResultProtocol::Subscription subscription;
+        subscription.patterns = parser.values(viewerFilterOption);
+        subscription.minIntervalMs = qMax(0, parser.value(viewerIntervalOption).toInt());
+        ResultViewer viewer(parser.value(viewerOption), subscription, parser.value(viewerThumbnailsOption));
+        if (!viewer.start()) {
+            std::cerr << "Invalid --viewer address, expected host:port or local:name" << std::endl;
+            return 1;
+        }
+        return app->exec();
+    }
+    
+    // Процесс захвата наследует привязку потока камеры, запустившего его
+    AffinityPolicy::instance().configure(numaAffinity == "auto");
+    MemoryBudget::instance().configure(parser.value(memoryLimitOption).toLongLong() * 1024 * 1024);
+    
+    if (headless) {
+        QString host;
+        quint16 port = 0;
+        if (!ShardProtocol::parseEndpoint(parser.value(shardWorkerOption), host, port)) {
+            std::cerr << "Invalid --shard-worker address, expected host:port" << std::endl;
+            return 1;
+        }
+        QString workerName = parser.value(workerNameOption);
+        if (workerName.isEmpty()) {
+            workerName = QString("%1-%2").arg(QHostInfo::localHostName())
+                                         .arg(QCoreApplication::applicationPid());
+        }
+        
+        qRegisterMetaType<ImageQualityAnalyzer::QualityResult>("ImageQualityAnalyzer::QualityResult");
+        ShardWorker worker(host, port, workerName, cpuBudget);
+        worker.start();
+        return app->exec();
+    }
+    
     MainWindow mainWindow;
-    mainWindow.show();
+    mainWindow.setAnalysisCpuBudget(cpuBudget);
+    mainWindow.setCaptureIsolation(parser.isSet(isolateCaptureOption));
+    mainWindow.setOpenTimeout(parser.value(openTimeoutOption).toInt());
+    mainWindow.setKeyframeInterval(parser.value(keyframeIntervalOption).toInt());
+    mainWindow.setMainStreamIdleTimeout(parser.value(mainStreamIdleOption).toInt() * 1000);
+    // Снимки строятся из кадров предпросмотра, которых в профиле низкой памяти нет
+    mainWindow.setSnapshotCache(MemoryBudget::instance().isActive()
+                                    ? 0 : parser.value(snapshotCacheOption).toLongLong() * 1024 * 1024,
+                                parser.value(snapshotFormatOption).toLatin1());
+    
+    CameraWorker::RecordingConfig recordingConfig;
+    recordingConfig.preEventSec = parser.value(preEventOption).toInt();
+    recordingConfig.maxBytes = parser.value(preEventMemoryOption).toLongLong() * 1024 * 1024;
+    recordingConfig.container = parser.value(recordingFormatOption).toLower();
+    if (recordingConfig.container != "mp4" && recordingConfig.container != "mkv") {
+        std::cerr << "Unknown recording format: " << recordingConfig.container.toStdString() << std::endl;
+        return 1;
+    }
+    // cv::VideoCapture не отдаёт сжатые пакеты: по умолчанию предыстория
+    // ведётся только с FFmpeg и ingest, явный --pre-event выводит предупреждение
+    bool preEventSupported = backendConfig.backend != FrameSource::CaptureBackend::OpenCV;
+    if (recordingConfig.preEventSec > 0 && (preEventSupported || parser.isSet(preEventOption))) {
+        recordingConfig.directory = parser.value(recordingDirOption);
+        if (recordingConfig.directory.isEmpty()) {
+            recordingConfig.directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/recordings";
+        }
+    }
+    mainWindow.setRecordingConfig(recordingConfig);
+    if (!parser.isSet(noHistoryOption)) {
+        mainWindow.setHistoryDirectory(historyDir, historyRetention);
+    }
+    if (parser.isSet(alertRulesOption) && !mainWindow.loadAlertRules(parser.value(alertRulesOption))) {
+        std::cerr << "Cannot load alert rules from " << parser.value(alertRulesOption).toStdString() << std::endl;
+        return 1;
+    }
     
-    if (parser.isSet(cameraOption)) {
-        QString rtspUrl = parser.value(cameraOption);
-        if (debugMode) {
-            qDebug() << "Adding camera from command line:" << rtspUrl;
+    ShardCoordinator coordinator;
+    if (parser.isSet(coordinatorOption)) {
+        QString host;
+        quint16 port = 0;
+        QHostAddress address;
+        bool ok = ShardProtocol::parseEndpoint(parser.value(coordinatorOption), host, port)
+            && resolveListenAddress(host, address);
+        if (!ok || !coordinator.listen(address, port)) {
+            std::cerr << "Cannot start coordinator on " << parser.value(coordinatorOption).toStdString() << std::endl;
+            return 1;
         }
-        QTimer::singleShot(100, [ &mainWindow, rtspUrl ]() {
-            mainWindow.setRtspInput(rtspUrl);
+        mainWindow.setShardCoordinator(&coordinator);
+    }
+    
+    ResultPublisher resultPublisher;
+    if (parser.isSet(publishResultsOption) || parser.isSet(publishLocalOption)) {
+        if (parser.isSet(publishResultsOption)) {
+            QString host;
+            quint16 port = 0;
+            QHostAddress address;
+            bool ok = ShardProtocol::parseEndpoint(parser.value(publishResultsOption), host, port,
+                                                   ResultProtocol::DEFAULT_PORT)
+                && resolveListenAddress(host, address);
+            if (!ok || !resultPublisher.listenTcp(address, port)) {
+                std::cerr << "Cannot publish results on " << parser.value(publishResultsOption).toStdString() << std::endl;
+                return 1;
+            }
+        }
+        if (parser.isSet(publishLocalOption) && !resultPublisher.listenLocal(parser.value(publishLocalOption))) {
+            std::cerr << "Cannot publish results on local socket " << parser.value(publishLocalOption).toStdString() << std::endl;
+            return 1;
+        }
+        mainWindow.setResultPublisher(&resultPublisher);
+    }
+    
+    mainWindow.show();
+    
+    // Камеры добавляются после появления окна: вкладки видны сразу,
+    // а подключения идут в фоне
+    QStringList cameraUrls = parser.values(cameraOption);
+    QString configPath = parser.value(configOption);
+    if (!cameraUrls.isEmpty() || !configPath.isEmpty()) {
+        QTimer::singleShot(0, [ &mainWindow, cameraUrls, configPath, debugMode ]() {
+            if (!configPath.isEmpty()) {
+                mainWindow.loadCameraList(configPath);
+            }
+            for (const QString& rtspUrl : cameraUrls) {
+                if (debugMode) {
+                    qDebug() << "Adding camera from command line:" << rtspUrl;
+                }
+                if (FrameSource::isSupportedUrl(rtspUrl)) {
+                    mainWindow.addCameraUrl(rtspUrl);
+                } else {
+                    mainWindow.setRtspInput(rtspUrl);
+                }
+            }
         });
     }
     
-    int result = app.exec();
+    int result = app->exec();
     
     return result;
 }
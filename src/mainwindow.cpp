@@ -3,8 +3,18 @@
 #include <QThread>
 #include <QTime>
 #include <QMetaType>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileDialog>
+#include <QTabBar>
 
 #include "imagequalityanalyzer.h"
+#include "framesource.h"
+#include "shardcoordinator.h"
+#include "resultpublisher.h"
+#include "cameraconfig.h"
+#include "memorybudget.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -20,6 +30,17 @@ MainWindow::MainWindow(QWidget *parent)
     , m_cameraCountLabel(nullptr)
     , m_timeLabel(nullptr)
     , m_activityTimer(nullptr)
+    , m_analysisScheduler(nullptr)
+    , m_analysisSchedulingEnabled(false)
+    , m_shardCoordinator(nullptr)
+    , m_resultPublisher(nullptr)
+    , m_captureIsolation(false)
+    , m_openTimeoutMs(0)
+    , m_keyframeGopInterval(0)
+    , m_mainStreamIdleMs(0)
+    , m_viewedCameraTimer(nullptr)
+    , m_viewedCameraId(0)
+    , m_alertEngine(nullptr)
     , m_nextCameraId(1)
 {
     // Регистрируем метатип для передачи между потоками
@@ -29,6 +50,26 @@ MainWindow::MainWindow(QWidget *parent)
     resize(1200, 800);
     setupUi();
 
+    m_alertEngine = new AlertEngine(this);
+    for (const AlertEngine::Rule& rule : AlertEngine::defaultRules()) {
+        m_alertEngine->addRule(rule);
+    }
+    connect(m_alertEngine, &AlertEngine::alertRaised, this, [this](const AlertEngine::Alert& alert) {
+        handleAlert(alert, true);
+    });
+    connect(m_alertEngine, &AlertEngine::alertCleared, this, [this](const AlertEngine::Alert& alert) {
+        handleAlert(alert, false);
+    });
+
+    // Основной поток открывается для вкладки, задержавшейся на экране,
+    // а не для каждой, через которую пролистали (в том числе при загрузке списка)
+    m_viewedCameraTimer = new QTimer(this);
+    m_viewedCameraTimer->setSingleShot(true);
+    connect(m_viewedCameraTimer, &QTimer::timeout, this, &MainWindow::updateViewedCamera);
+    connect(m_cameraTabs, &QTabWidget::currentChanged, this, [this]() {
+        m_viewedCameraTimer->start(VIEWED_CAMERA_DELAY_MS);
+    });
+
     m_activityTimer = new QTimer(this);
     connect(m_activityTimer, &QTimer::timeout, this, &MainWindow::updateActivityTimer);
     m_activityTimer->start(1000);
@@ -113,23 +154,57 @@ void MainWindow::setupUi()
 
 void MainWindow::addCamera()
 {
-    QString rtspUrl = m_rtspInput->text().trimmed();
+    QString input = m_rtspInput->text().trimmed();
     
-    if (rtspUrl.isEmpty()) {
+    if (input.isEmpty()) {
         m_statusLabel->setText("Ошибка: Введите RTSP URL");
         m_rtspInput->setFocus();
         return;
     }
     
-    if (!rtspUrl.startsWith("rtsp://", Qt::CaseInsensitive)) {
-        m_statusLabel->setText("Ошибка: URL должен начинаться с rtsp://");
+    // Строка в формате файла списка: URL [sub=URL подпотока] [name=подпись]
+    CameraConfig::Entry entry;
+    QString errorText;
+    if (!CameraConfig::parseLine(input, entry, &errorText)) {
+        m_statusLabel->setText(FrameSource::isSupportedUrl(entry.url)
+            ? "Ошибка: " + errorText
+            : "Ошибка: URL должен начинаться с rtsp://, file:// или synthetic://");
         m_rtspInput->setFocus();
         return;
     }
     
+    if (addCameraUrl(entry.url, entry.name, entry.subUrl)) {
+        m_rtspInput->clear();
+    }
+}
+
+int MainWindow::loadCameraList(const QString& path)
+{
+    QString errorText;
+    QList<CameraConfig::Entry> entries = CameraConfig::load(path, &errorText);
+    if (!errorText.isEmpty()) {
+        m_statusLabel->setText("Ошибка: " + errorText);
+        return 0;
+    }
+    
+    // Вкладки создаются сразу, подключения идут в фоне не более
+    // CameraWorker::setMaxParallelConnects() одновременно
+    int added = 0;
+    for (const CameraConfig::Entry& entry : entries) {
+        if (addCameraUrl(entry.url, entry.name, entry.subUrl)) {
+            added++;
+        }
+    }
+    m_statusLabel->setText(QString("Загружено камер: %1 из %2").arg(added).arg(path));
+    return added;
+}
+
+bool MainWindow::addCameraUrl(const QString& rtspUrl, const QString& displayName,
+                              const QString& subStreamUrl)
+{
     if (m_cameraUrls.values().contains(rtspUrl)) {
         m_statusLabel->setText("Ошибка: Эта камера уже добавлена");
-        return;
+        return false;
     }
     
     int cameraId = generateCameraId();
@@ -142,13 +217,41 @@ void MainWindow::addCamera()
         }
     }
     
+    m_cameraUrls[cameraId] = rtspUrl;
+    m_alertEngine->addCamera(rtspUrl, QDateTime::currentMSecsSinceEpoch());
+    if (m_resultPublisher) {
+        m_resultPublisher->addCamera(rtspUrl, displayName);
+    }
+    
+    // В режиме координатора камера обрабатывается удалённым процессом
+    if (m_shardCoordinator) {
+        addCameraTab(cameraId, rtspUrl, displayName);
+        m_shardCoordinator->addCamera(rtspUrl);
+        m_statusLabel->setText("Камера передана обработчикам: " + rtspUrl);
+        m_removeButton->setEnabled(true);
+        qInfo() << "Added sharded camera with ID:" << cameraId << "URL:" << rtspUrl;
+        return true;
+    }
+    
     // Create thread and worker
     QThread* workerThread = new QThread(this);
     m_cameraThreads[cameraId] = workerThread;
     
     CameraWorker* worker = new CameraWorker(rtspUrl);
+    worker->setAnalysisScheduler(m_analysisSchedulingEnabled ? m_analysisScheduler : nullptr);
+    worker->setCaptureIsolation(m_captureIsolation);
+    if (m_openTimeoutMs > 0) {
+        worker->setOpenTimeout(m_openTimeoutMs);
+    }
+    worker->setKeyframeInterval(m_keyframeGopInterval);
+    worker->setSnapshotCache(m_snapshotCache.get());
+    worker->setSubStreamUrl(subStreamUrl);
+    worker->setRecordingConfig(m_recordingConfig);
+    if (m_mainStreamIdleMs > 0) {
+        worker->setMainStreamIdleTimeout(m_mainStreamIdleMs);
+    }
     m_cameraWorkers[cameraId] = worker;
-    m_cameraUrls[cameraId] = rtspUrl;
+    m_workerStates[cameraId] = worker->publishedState();
     
     worker->moveToThread(workerThread);
     
@@ -169,15 +272,21 @@ void MainWindow::addCamera()
     connect(worker, &CameraWorker::connectionLost, this, [this, cameraId]() {
         handleConnectionLost(cameraId);
     }, Qt::QueuedConnection);
+    connect(worker, &CameraWorker::confirmationResultReady, this, [this, cameraId](const ImageQualityAnalyzer::QualityResult& result, bool confirmed) {
+        handleConfirmation(cameraId, result, confirmed);
+    }, Qt::QueuedConnection);
+    connect(worker, &CameraWorker::recordingQueued, this, [this](const QString& path) {
+        m_statusLabel->setText("Сохраняется предыстория: " + path);
+    }, Qt::QueuedConnection);
     
-    addCameraTab(cameraId, rtspUrl);
+    addCameraTab(cameraId, rtspUrl, displayName, !subStreamUrl.isEmpty());
     
     workerThread->start();
-    m_rtspInput->clear();
     m_statusLabel->setText("Добавление камеры: " + rtspUrl);
     m_removeButton->setEnabled(true);
     
     qInfo() << "Added camera with ID:" << cameraId << "URL:" << rtspUrl;
+    return true;
 }
 
 void MainWindow::removeCamera()
@@ -188,18 +297,26 @@ void MainWindow::removeCamera()
         return;
     }
     
-    QList<int> cameraIds = m_cameraWorkers.keys();
-    if (currentIndex >= cameraIds.size()) {
+    QVariant cameraIdProperty = m_cameraTabs->widget(currentIndex)->property("cameraId");
+    if (!cameraIdProperty.isValid()) {
         m_statusLabel->setText("Неверный выбор камеры");
         return;
     }
     
-    int cameraId = cameraIds[currentIndex];
+    int cameraId = cameraIdProperty.toInt();
     QString url = m_cameraUrls[cameraId];
     
+    if (m_shardCoordinator) {
+        m_shardCoordinator->removeCamera(url);
+    }
+    if (m_resultPublisher) {
+        m_resultPublisher->removeCamera(url);
+    }
+    
     // Stop thread
     if (m_cameraThreads.contains(cameraId)) {
         QThread* thread = m_cameraThreads[cameraId];
+        thread->requestInterruption();
         thread->quit();
         if (!thread->wait(5000)) {
             thread->terminate();
@@ -213,23 +330,36 @@ void MainWindow::removeCamera()
     
     // Clean up maps
     m_cameraWorkers.remove(cameraId);
+    m_workerStates.remove(cameraId);
     m_cameraUrls.remove(cameraId);
+    if (m_viewedCameraId == cameraId) {
+        m_viewedCameraId = 0;
+    }
+    if (m_snapshotCache) {
+        m_snapshotCache->removeCamera(url);
+    }
+    if (m_historyWriter) {
+        m_historyWriter->releaseCamera(url);
+    }
+    m_alertEngine->removeCamera(url);
     m_frameLabels.remove(cameraId);
     m_scoreLabels.remove(cameraId);
+    m_rateLabels.remove(cameraId);
     
-    if (m_cameraWorkers.isEmpty()) {
+    if (m_cameraUrls.isEmpty()) {
         m_removeButton->setEnabled(false);
         m_statusLabel->setText("Все камеры удалены");
     } else {
         m_statusLabel->setText("Камера удалена: " + url);
     }
     
-    m_cameraCountLabel->setText(QString("Камер: %1").arg(m_cameraWorkers.size()));
+    m_cameraCountLabel->setText(QString("Камер: %1").arg(m_cameraUrls.size()));
     
     qInfo() << "Removed camera ID:" << cameraId << "URL:" << url;
 }
 
-void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl)
+void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl, const QString& displayName,
+                              bool hasSubStream)
 {
     QVBoxLayout* tabLayout = new QVBoxLayout();
     tabLayout->setSpacing(5);
@@ -239,7 +369,8 @@ void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl)
     frameLabel->setAlignment(Qt::AlignCenter);
     frameLabel->setMinimumSize(640, 480);
     frameLabel->setStyleSheet("background-color: #1a1a1a; border: 1px solid #333;");
-    frameLabel->setText("Подключение...");
+    frameLabel->setText(MemoryBudget::instance().isActive() && !m_shardCoordinator
+        ? "Предпросмотр отключён: профиль низкой памяти" : "Подключение...");
     frameLabel->setObjectName(QString("frameLabel_%1").arg(cameraId));
     m_frameLabels[cameraId] = frameLabel;
     tabLayout->addWidget(frameLabel, 1);
@@ -273,6 +404,24 @@ void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl)
     overexposedBar->setValue(0);
     overexposedBar->setObjectName(QString("overexposedBar_%1").arg(cameraId));
     
+    QLabel* underexposedLabel = new QLabel("Недосвет:", this);
+    QProgressBar* underexposedBar = new QProgressBar(this);
+    underexposedBar->setRange(0, 100);
+    underexposedBar->setValue(0);
+    underexposedBar->setObjectName(QString("underexposedBar_%1").arg(cameraId));
+    
+    QLabel* blockinessLabel = new QLabel("Блочность:", this);
+    QProgressBar* blockinessBar = new QProgressBar(this);
+    blockinessBar->setRange(0, 100);
+    blockinessBar->setValue(0);
+    blockinessBar->setObjectName(QString("blockinessBar_%1").arg(cameraId));
+    
+    QLabel* focusLabel = new QLabel("Фокус:", this);
+    QProgressBar* focusBar = new QProgressBar(this);
+    focusBar->setRange(0, 100);
+    focusBar->setValue(0);
+    focusBar->setObjectName(QString("focusBar_%1").arg(cameraId));
+    
     metricsLayout->addWidget(noiseLabel, row, 0);
     metricsLayout->addWidget(noiseBar, row++, 1);
     metricsLayout->addWidget(contrastLabel, row, 0);
@@ -281,6 +430,74 @@ void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl)
     metricsLayout->addWidget(sharpnessBar, row++, 1);
     metricsLayout->addWidget(overexposedLabel, row, 0);
     metricsLayout->addWidget(overexposedBar, row++, 1);
+    metricsLayout->addWidget(underexposedLabel, row, 0);
+    metricsLayout->addWidget(underexposedBar, row++, 1);
+    metricsLayout->addWidget(blockinessLabel, row, 0);
+    metricsLayout->addWidget(blockinessBar, row++, 1);
+    metricsLayout->addWidget(focusLabel, row, 0);
+    metricsLayout->addWidget(focusBar, row++, 1);
+    
+    QLabel* dynamicRangeLabel = new QLabel("Динамический диапазон: --", this);
+    dynamicRangeLabel->setObjectName(QString("dynamicRangeLabel_%1").arg(cameraId));
+    metricsLayout->addWidget(dynamicRangeLabel, row++, 0, 1, 2);
+    
+    QLabel* colorLabel = new QLabel("Цвет: --", this);
+    colorLabel->setObjectName(QString("colorLabel_%1").arg(cameraId));
+    metricsLayout->addWidget(colorLabel, row++, 0, 1, 2);
+    
+    // Транспортные счётчики есть только у источника FFmpeg
+    QLabel* streamLabel = new QLabel("Поток: --", this);
+    streamLabel->setObjectName(QString("streamLabel_%1").arg(cameraId));
+    metricsLayout->addWidget(streamLabel, row++, 0, 1, 2);
+    
+    // Анализ идёт по подпотоку; основной поток проверяет падения оценки
+    if (hasSubStream) {
+        QLabel* mainStreamLabel = new QLabel("Основной поток: открывается при просмотре и падении оценки", this);
+        mainStreamLabel->setObjectName(QString("mainStreamLabel_%1").arg(cameraId));
+        metricsLayout->addWidget(mainStreamLabel, row++, 0, 1, 2);
+    }
+    
+    // Сравнение с эталоном
+    QLabel* referenceLabel = new QLabel("Эталон: не задан", this);
+    referenceLabel->setObjectName(QString("referenceLabel_%1").arg(cameraId));
+    QPushButton* saveReferenceButton = new QPushButton("Сохранить эталон", this);
+    QPushButton* clearReferenceButton = new QPushButton("Сбросить эталон", this);
+    connect(saveReferenceButton, &QPushButton::clicked, this, [this, cameraId]() {
+        CameraWorker* worker = m_cameraWorkers.value(cameraId, nullptr);
+        if (worker) {
+            QMetaObject::invokeMethod(worker, "captureReferenceFrame", Qt::QueuedConnection);
+            m_statusLabel->setText("Следующий кадр будет сохранён как эталон");
+        }
+    });
+    connect(clearReferenceButton, &QPushButton::clicked, this, [this, cameraId, referenceLabel]() {
+        CameraWorker* worker = m_cameraWorkers.value(cameraId, nullptr);
+        if (worker) {
+            QMetaObject::invokeMethod(worker, "clearReferenceFrame", Qt::QueuedConnection);
+            referenceLabel->setText("Эталон: не задан");
+        }
+    });
+    QHBoxLayout* referenceLayout = new QHBoxLayout();
+    referenceLayout->addWidget(referenceLabel, 1);
+    referenceLayout->addWidget(saveReferenceButton);
+    referenceLayout->addWidget(clearReferenceButton);
+    if (m_snapshotCache && !m_shardCoordinator) {
+        QPushButton* saveSnapshotsButton = new QPushButton("Сохранить снимки", this);
+        connect(saveSnapshotsButton, &QPushButton::clicked, this, [this, cameraId]() {
+            saveSnapshots(cameraId);
+        });
+        referenceLayout->addWidget(saveSnapshotsButton);
+    }
+    if (!m_recordingConfig.directory.isEmpty() && !m_shardCoordinator) {
+        QPushButton* saveRecordingButton = new QPushButton("Сохранить запись", this);
+        connect(saveRecordingButton, &QPushButton::clicked, this, [this, cameraId]() {
+            CameraWorker* worker = m_cameraWorkers.value(cameraId, nullptr);
+            if (worker) {
+                QMetaObject::invokeMethod(worker, "saveRecording", Qt::QueuedConnection);
+            }
+        });
+        referenceLayout->addWidget(saveRecordingButton);
+    }
+    metricsLayout->addLayout(referenceLayout, row++, 0, 1, 2);
     
     metricsGroup->setLayout(metricsLayout);
     tabLayout->addWidget(metricsGroup);
@@ -297,29 +514,38 @@ void MainWindow::addCameraTab(int cameraId, const QString& rtspUrl)
     tabLayout->addWidget(scoreLabel);
     
     // Status label
-    QLabel* statusLabel = new QLabel("Статус: Подключение...", this);
+    QLabel* statusLabel = new QLabel("Статус: Ожидание подключения...", this);
     statusLabel->setAlignment(Qt::AlignCenter);
     statusLabel->setObjectName(QString("statusLabel_%1").arg(cameraId));
     tabLayout->addWidget(statusLabel);
     
+    // Частота анализа: назначенная планировщиком и фактическая
+    QLabel* analysisRateLabel = new QLabel("Частота анализа: --", this);
+    analysisRateLabel->setAlignment(Qt::AlignCenter);
+    analysisRateLabel->setObjectName(QString("analysisRateLabel_%1").arg(cameraId));
+    tabLayout->addWidget(analysisRateLabel);
+    m_rateLabels[cameraId] = analysisRateLabel;
+    
     // Tab widget
     QWidget* tabWidget = new QWidget(this);
     tabWidget->setLayout(tabLayout);
     
-    QString cameraName = rtspUrl;
+    QString cameraName = displayName.isEmpty() ? rtspUrl : displayName;
     if (cameraName.length() > 30) {
         cameraName = cameraName.left(27) + "...";
     }
     
+    tabWidget->setProperty("cameraId", cameraId);
     m_cameraTabs->addTab(tabWidget, cameraName);
     m_cameraTabs->setCurrentIndex(m_cameraTabs->count() - 1);
-    m_cameraCountLabel->setText(QString("Камер: %1").arg(m_cameraWorkers.size()));
-    
-    tabWidget->setProperty("cameraId", cameraId);
+    m_cameraCountLabel->setText(QString("Камер: %1").arg(m_cameraUrls.size()));
 }
 
 void MainWindow::updateFrame(int cameraId, const QImage& image)
 {
+    if (m_resultPublisher) {
+        m_resultPublisher->offerFrame(m_cameraUrls.value(cameraId), image);
+    }
     if (!m_frameLabels.contains(cameraId)) return;
     
     QLabel* frameLabel = m_frameLabels[cameraId];
@@ -336,17 +562,29 @@ void MainWindow::updateFrame(int cameraId, const QImage& image)
 
 void MainWindow::updateQualityResult(int cameraId, const ImageQualityAnalyzer::QualityResult& result)
 {
-    QList<int> cameraIds = m_cameraWorkers.keys();
-    int tabIndex = cameraIds.indexOf(cameraId);
-    if (tabIndex < 0) return;
+    qint64 receivedMs = QDateTime::currentMSecsSinceEpoch();
+    if (m_historyWriter && result.isValid) {
+        m_historyWriter->append(m_cameraUrls.value(cameraId), receivedMs, result);
+    }
+    m_alertEngine->evaluate(m_cameraUrls.value(cameraId), receivedMs, result);
+    if (m_resultPublisher) {
+        m_resultPublisher->publishResult(m_cameraUrls.value(cameraId), result);
+    }
     
-    QWidget* tabWidget = m_cameraTabs->widget(tabIndex);
+    QWidget* tabWidget = findCameraTab(cameraId);
     if (!tabWidget) return;
     
     QProgressBar* noiseBar = tabWidget->findChild<QProgressBar*>(QString("noiseBar_%1").arg(cameraId));
     QProgressBar* contrastBar = tabWidget->findChild<QProgressBar*>(QString("contrastBar_%1").arg(cameraId));
     QProgressBar* sharpnessBar = tabWidget->findChild<QProgressBar*>(QString("sharpnessBar_%1").arg(cameraId));
     QProgressBar* overexposedBar = tabWidget->findChild<QProgressBar*>(QString("overexposedBar_%1").arg(cameraId));
+    QProgressBar* underexposedBar = tabWidget->findChild<QProgressBar*>(QString("underexposedBar_%1").arg(cameraId));
+    QProgressBar* blockinessBar = tabWidget->findChild<QProgressBar*>(QString("blockinessBar_%1").arg(cameraId));
+    QProgressBar* focusBar = tabWidget->findChild<QProgressBar*>(QString("focusBar_%1").arg(cameraId));
+    QLabel* dynamicRangeLabel = tabWidget->findChild<QLabel*>(QString("dynamicRangeLabel_%1").arg(cameraId));
+    QLabel* colorLabel = tabWidget->findChild<QLabel*>(QString("colorLabel_%1").arg(cameraId));
+    QLabel* referenceLabel = tabWidget->findChild<QLabel*>(QString("referenceLabel_%1").arg(cameraId));
+    QLabel* streamLabel = tabWidget->findChild<QLabel*>(QString("streamLabel_%1").arg(cameraId));
     QLabel* scoreLabel = tabWidget->findChild<QLabel*>(QString("scoreLabel_%1").arg(cameraId));
     
     // Шум: инвертируем отображение (больше шума = больший процент = плохо)
@@ -381,19 +619,107 @@ void MainWindow::updateQualityResult(int cameraId, const ImageQualityAnalyzer::Q
             .arg(getQualityColor(100 - overexposedDisplay).name()));
     }
     
+    // Недосвет: как и пересвет, больше = хуже
+    int underexposedDisplay = static_cast<int>(result.underexposedPercent);
+    if (underexposedBar) {
+        underexposedBar->setValue(underexposedDisplay);
+        underexposedBar->setStyleSheet(QString("QProgressBar::chunk { background-color: %1; }")
+            .arg(getQualityColor(100 - underexposedDisplay).name()));
+    }
+    
+    if (dynamicRangeLabel) {
+        dynamicRangeLabel->setText(QString("Динамический диапазон: %1 EV").arg(result.dynamicRange, 0, 'f', 1));
+    }
+    
+    if (colorLabel) {
+        colorLabel->setText(QString("Цвет: насыщенность %1%, сдвиг %2, R/G %3, B/G %4, клиппинг %5%")
+            .arg(result.meanChroma, 0, 'f', 0)
+            .arg(result.colorCast, 0, 'f', 0)
+            .arg(result.whiteBalanceRed, 0, 'f', 2)
+            .arg(result.whiteBalanceBlue, 0, 'f', 2)
+            .arg(result.saturationClippedPercent, 0, 'f', 1));
+    }
+    
+    if (streamLabel && result.hasStreamStats) {
+        streamLabel->setText(QString("Поток: потери %1%, потеряно пакетов %2, повреждено %3, ошибок декодера %4")
+            .arg(result.packetLossPercent, 0, 'f', 2)
+            .arg(result.packetsLost)
+            .arg(result.corruptFrames)
+            .arg(result.decodeErrors));
+    }
+    
+    if (referenceLabel && result.hasReference) {
+        referenceLabel->setText(QString("Эталон: PSNR %1 дБ, SSIM %2")
+            .arg(result.psnr, 0, 'f', 1)
+            .arg(result.ssim, 0, 'f', 3));
+    }
+    
+    // Блочность: выше = меньше артефактов сжатия
+    if (blockinessBar) {
+        blockinessBar->setValue(static_cast<int>(result.blockinessScore));
+        blockinessBar->setStyleSheet(QString("QProgressBar::chunk { background-color: %1; }")
+            .arg(getQualityColor(result.blockinessScore).name()));
+    }
+    
+    // Фокус по спектру: выше = резче
+    if (focusBar) {
+        focusBar->setValue(static_cast<int>(result.frequencyBlurScore));
+        focusBar->setStyleSheet(QString("QProgressBar::chunk { background-color: %1; }")
+            .arg(getQualityColor(result.frequencyBlurScore).name()));
+    }
+    
     if (scoreLabel) {
-        scoreLabel->setText(QString("Оценка: %1").arg(static_cast<int>(result.overallScore)));
+        QString scoreText = QString("Оценка: %1").arg(static_cast<int>(result.overallScore));
+        if (result.isFrozen && result.overallScore <= 0.0) {
+            scoreText += " (" + result.status + ")";
+        }
+        if (result.keyframeMode) {
+            scoreText += " [ключевые кадры]";
+        }
+        scoreLabel->setText(scoreText);
         scoreLabel->setStyleSheet(QString("color: %1;").arg(getQualityColor(result.overallScore).name()));
     }
 }
 
-void MainWindow::handleConnectionStatus(int cameraId, bool connected, const QString& message)
+void MainWindow::handleConfirmation(int cameraId, const ImageQualityAnalyzer::QualityResult& result, bool confirmed)
 {
-    QList<int> cameraIds = m_cameraWorkers.keys();
-    int tabIndex = cameraIds.indexOf(cameraId);
-    if (tabIndex < 0) return;
+    QWidget* tabWidget = findCameraTab(cameraId);
+    if (!tabWidget) return;
     
-    QWidget* tabWidget = m_cameraTabs->widget(tabIndex);
+    QLabel* mainStreamLabel = tabWidget->findChild<QLabel*>(QString("mainStreamLabel_%1").arg(cameraId));
+    if (mainStreamLabel) {
+        mainStreamLabel->setText(QString("Основной поток: оценка %1 в %2 (%3), %4")
+            .arg(static_cast<int>(result.overallScore))
+            .arg(QTime::currentTime().toString("HH:mm:ss"))
+            .arg(result.status)
+            .arg(confirmed ? "падение подтверждено" : "падение только в подпотоке"));
+        mainStreamLabel->setStyleSheet(QString("color: %1;").arg(getQualityColor(result.overallScore).name()));
+    }
+}
+
+void MainWindow::updateViewedCamera()
+{
+    QWidget* current = m_cameraTabs->currentWidget();
+    int cameraId = current ? current->property("cameraId").toInt() : 0;
+    if (cameraId == m_viewedCameraId) {
+        return;
+    }
+    
+    // Камеры без подпотока игнорируют вызов
+    CameraWorker* previous = m_cameraWorkers.value(m_viewedCameraId, nullptr);
+    if (previous) {
+        QMetaObject::invokeMethod(previous, "setMainStreamViewed", Qt::QueuedConnection, Q_ARG(bool, false));
+    }
+    CameraWorker* worker = m_cameraWorkers.value(cameraId, nullptr);
+    if (worker) {
+        QMetaObject::invokeMethod(worker, "setMainStreamViewed", Qt::QueuedConnection, Q_ARG(bool, true));
+    }
+    m_viewedCameraId = cameraId;
+}
+
+void MainWindow::handleConnectionStatus(int cameraId, bool connected, const QString& message)
+{
+    QWidget* tabWidget = findCameraTab(cameraId);
     if (!tabWidget) return;
     
     QLabel* statusLabel = tabWidget->findChild<QLabel*>(QString("statusLabel_%1").arg(cameraId));
@@ -415,25 +741,250 @@ void MainWindow::handleConnectionLost(int cameraId)
 {
     qWarning() << "Connection lost for camera" << cameraId;
     
-    QList<int> cameraIds = m_cameraWorkers.keys();
-    int tabIndex = cameraIds.indexOf(cameraId);
-    if (tabIndex >= 0) {
-        QWidget* tabWidget = m_cameraTabs->widget(tabIndex);
-        if (tabWidget) {
-            QLabel* statusLabel = tabWidget->findChild<QLabel*>(QString("statusLabel_%1").arg(cameraId));
-            if (statusLabel) {
-                statusLabel->setText("Статус: Переподключение...");
-                statusLabel->setStyleSheet("color: #ffaa00;");
-            }
+    QWidget* tabWidget = findCameraTab(cameraId);
+    if (tabWidget) {
+        QLabel* statusLabel = tabWidget->findChild<QLabel*>(QString("statusLabel_%1").arg(cameraId));
+        if (statusLabel) {
+            statusLabel->setText("Статус: Переподключение...");
+            statusLabel->setStyleSheet("color: #ffaa00;");
         }
     }
 }
 
+QWidget* MainWindow::findCameraTab(int cameraId) const
+{
+    // Порядок вкладок не совпадает с порядком ключей m_cameraWorkers
+    // (удалённые камеры в режиме координатора не имеют локального обработчика)
+    for (int i = 0; i < m_cameraTabs->count(); ++i) {
+        QWidget* tabWidget = m_cameraTabs->widget(i);
+        if (tabWidget && tabWidget->property("cameraId").toInt() == cameraId) {
+            return tabWidget;
+        }
+    }
+    return nullptr;
+}
+
+void MainWindow::setCaptureIsolation(bool enabled)
+{
+    m_captureIsolation = enabled;
+}
+
+void MainWindow::setOpenTimeout(int timeoutMs)
+{
+    m_openTimeoutMs = timeoutMs;
+}
+
+void MainWindow::setKeyframeInterval(int gopInterval)
+{
+    m_keyframeGopInterval = gopInterval;
+}
+
+void MainWindow::setMainStreamIdleTimeout(int timeoutMs)
+{
+    m_mainStreamIdleMs = timeoutMs;
+}
+
+void MainWindow::setRecordingConfig(const CameraWorker::RecordingConfig& config)
+{
+    m_recordingConfig = config;
+    if (!config.directory.isEmpty() && config.preEventSec > 0) {
+        qInfo() << "Pre-event recording:" << config.preEventSec << "s per camera, up to"
+                << config.maxBytes / (1024 * 1024) << "MiB, to" << config.directory;
+    }
+}
+
+void MainWindow::setSnapshotCache(qint64 memoryLimitBytes, const QByteArray& format)
+{
+    if (memoryLimitBytes <= 0) {
+        // Уже запущенные камеры продолжают ссылаться на существующий кэш
+        return;
+    }
+    if (!m_snapshotCache) {
+        m_snapshotCache.reset(new SnapshotCache(memoryLimitBytes));
+    } else {
+        m_snapshotCache->setMemoryLimit(memoryLimitBytes);
+    }
+    m_snapshotCache->setFormat(format);
+}
+
+void MainWindow::setHistoryDirectory(const QString& directory, const TimeSeriesStore::Retention& retention)
+{
+    m_historyWriter.reset(new HistoryWriter(directory, retention));
+    qInfo() << "Writing quality history to" << directory;
+}
+
+bool MainWindow::loadAlertRules(const QString& path)
+{
+    QString errorText;
+    m_alertEngine->clearRules();
+    m_alertEngine->loadRules(path, &errorText);
+    if (!errorText.isEmpty()) {
+        qWarning() << errorText;
+        return false;
+    }
+    return true;
+}
+
+void MainWindow::handleAlert(const AlertEngine::Alert& alert, bool raised)
+{
+    int cameraId = m_cameraUrls.key(alert.cameraKey, -1);
+    QWidget* tabWidget = cameraId >= 0 ? findCameraTab(cameraId) : nullptr;
+    if (!tabWidget) {
+        return;  // Камера уже удалена
+    }
+
+    // Вкладка остаётся красной, пока у камеры есть хотя бы одно оповещение
+    bool cameraAlerting = m_alertEngine->activeAlertCount(alert.cameraKey) > 0;
+    int tabIndex = m_cameraTabs->indexOf(tabWidget);
+    m_cameraTabs->tabBar()->setTabTextColor(tabIndex, cameraAlerting ? QColor("#ff0000") : QColor());
+
+    QString cameraName = m_cameraTabs->tabText(tabIndex);
+    CameraWorker* worker = m_cameraWorkers.value(cameraId, nullptr);
+    if (raised && worker) {
+        QMetaObject::invokeMethod(worker, "triggerRecording", Qt::QueuedConnection, Q_ARG(QString, "alert"));
+    }
+    if (raised) {
+        m_statusLabel->setText(QString("Оповещение [%1]: %2 — %3 (%4)")
+            .arg(alert.severity, alert.ruleName, cameraName)
+            .arg(alert.value, 0, 'f', 1));
+    } else {
+        m_statusLabel->setText(QString("Оповещение снято: %1 — %2").arg(alert.ruleName, cameraName));
+    }
+}
+
+void MainWindow::saveSnapshots(int cameraId)
+{
+    QString url = m_cameraUrls.value(cameraId);
+    QList<SnapshotCache::SnapshotInfo> snapshots = m_snapshotCache->snapshots(url);
+    if (snapshots.isEmpty()) {
+        m_statusLabel->setText("Снимков камеры пока нет");
+        return;
+    }
+
+    QString directory = QFileDialog::getExistingDirectory(this, "Папка для снимков");
+    if (directory.isEmpty()) {
+        return;
+    }
+
+    int saved = 0;
+    for (const SnapshotCache::SnapshotInfo& info : snapshots) {
+        QByteArray data = m_snapshotCache->snapshotData(info.id);
+        if (data.isEmpty()) {
+            continue;  // Вытеснен, пока сохранялись предыдущие
+        }
+        QString fileName = QString("camera%1_%2_%3_%4.%5")
+            .arg(cameraId)
+            .arg(QDateTime::fromMSecsSinceEpoch(info.timestampMs).toString("yyyyMMdd-HHmmss-zzz"))
+            .arg(SnapshotCache::reasonName(info.reason))
+            .arg(static_cast<int>(info.score))
+            .arg(QString::fromLatin1(info.format));
+        QFile file(QDir(directory).filePath(fileName));
+        if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size()) {
+            saved++;
+        } else {
+            qWarning() << "Failed to write snapshot" << file.fileName() << ":" << file.errorString();
+        }
+    }
+    m_statusLabel->setText(QString("Сохранено снимков: %1 в %2").arg(saved).arg(directory));
+}
+
+void MainWindow::setShardCoordinator(ShardCoordinator* coordinator)
+{
+    m_shardCoordinator = coordinator;
+    if (!m_shardCoordinator) {
+        return;
+    }
+
+    connect(m_shardCoordinator, &ShardCoordinator::resultReceived, this,
+            [this](const QString& url, const ImageQualityAnalyzer::QualityResult& result) {
+        int cameraId = m_cameraUrls.key(url, -1);
+        if (cameraId >= 0) {
+            updateQualityResult(cameraId, result);
+        }
+    });
+    connect(m_shardCoordinator, &ShardCoordinator::assignmentChanged, this,
+            [this](const QString& url, const QString& workerName) {
+        int cameraId = m_cameraUrls.key(url, -1);
+        if (cameraId < 0) {
+            return;
+        }
+        if (workerName.isEmpty()) {
+            handleConnectionStatus(cameraId, false, "Нет доступных обработчиков");
+        } else {
+            handleConnectionStatus(cameraId, true, QString("Обработчик: %1").arg(workerName));
+        }
+    });
+    connect(m_shardCoordinator, &ShardCoordinator::workerJoined, this, [this](const QString& workerName) {
+        m_statusLabel->setText(QString("Подключён обработчик: %1").arg(workerName));
+    });
+    connect(m_shardCoordinator, &ShardCoordinator::workerLeft, this, [this](const QString& workerName) {
+        m_statusLabel->setText(QString("Обработчик отключён: %1").arg(workerName));
+    });
+}
+
+void MainWindow::setResultPublisher(ResultPublisher* publisher)
+{
+    m_resultPublisher = publisher;
+}
+
 void MainWindow::updateActivityTimer()
 {
     QTime currentTime = QTime::currentTime();
     QString timeString = currentTime.toString("HH:mm:ss");
     m_timeLabel->setText(QString("Текущее время: %1").arg(timeString));
+    updateAnalysisRates();
+}
+
+void MainWindow::updateAnalysisRates()
+{
+    QMap<QString, double> rates;
+    if (m_analysisScheduler) {
+        rates = m_analysisScheduler->assignedRates();
+    }
+    for (auto it = m_cameraUrls.begin(); it != m_cameraUrls.end(); ++it) {
+        QLabel* rateLabel = m_rateLabels.value(it.key());
+        if (!rateLabel) {
+            continue;
+        }
+        QString text = rates.contains(it.value())
+            ? QString("Частота анализа: %1 Гц").arg(rates.value(it.value()), 0, 'f', 1)
+            : QString("Частота анализа: --");
+        // Счётчики читаются из опубликованного состояния без обращения к потоку камеры
+        auto state = m_workerStates.value(it.key());
+        if (state) {
+            CameraWorker::PipelineStats stats = state->load().stats;
+            text += QString(" (факт. %1 Гц, кадров %2)").arg(stats.analysisRateHz, 0, 'f', 1).arg(stats.framesCaptured);
+            if (stats.numaNode >= 0) {
+                quint64 sampled = stats.framesNodeLocal + stats.framesNodeRemote;
+                text += QString(", узел NUMA %1, кадров в чужой памяти %2%")
+                    .arg(stats.numaNode)
+                    .arg(sampled > 0 ? 100.0 * stats.framesNodeRemote / sampled : 0.0, 0, 'f', 1);
+            }
+            if (stats.memoryBackoff == 0) {
+                text += ", анализ приостановлен: предел памяти";
+            } else if (stats.memoryBackoff > 1) {
+                text += QString(", анализ реже в %1 раз: предел памяти").arg(stats.memoryBackoff);
+            }
+        }
+        rateLabel->setText(text);
+    }
+}
+
+void MainWindow::setAnalysisCpuBudget(double fraction)
+{
+    // Планировщик не удаляется: уже запущенные камеры продолжают им пользоваться
+    m_analysisSchedulingEnabled = fraction > 0.0;
+    if (!m_analysisSchedulingEnabled) {
+        qInfo() << "Analysis scheduler disabled for new cameras, fixed analysis interval";
+        return;
+    }
+
+    if (!m_analysisScheduler) {
+        m_analysisScheduler = new AnalysisScheduler(fraction, this);
+    } else {
+        m_analysisScheduler->setCpuBudget(fraction);
+    }
+    qInfo() << "Analysis CPU budget:" << fraction * 100.0 << "% of all cores";
 }
 
 int MainWindow::generateCameraId()
@@ -443,6 +994,11 @@ int MainWindow::generateCameraId()
 
 void MainWindow::stopAllCameras()
 {
+    // Камеры, ожидающие очереди на подключение, выходят из ожидания сразу
+    for (QThread* thread : m_cameraThreads) {
+        thread->requestInterruption();
+    }
+    
     for (auto it = m_cameraWorkers.begin(); it != m_cameraWorkers.end(); ++it) {
         CameraWorker* worker = it.value();
         if (worker) {
@@ -462,10 +1018,12 @@ void MainWindow::stopAllCameras()
     }
     
     m_cameraWorkers.clear();
+    m_workerStates.clear();
     m_cameraThreads.clear();
     m_cameraUrls.clear();
     m_frameLabels.clear();
     m_scoreLabels.clear();
+    m_rateLabels.clear();
 }
 
 QColor MainWindow::getQualityColor(double score)
@@ -502,6 +1060,9 @@ void MainWindow::showAbout()
         "<li>Контраст - диапазон яркости</li>"
         "<li>Резкость - четкость границ</li>"
         "<li>Пересвет - процент переэкспонированных областей</li>"
+        "<li>Блочность - артефакты сжатия на границах блоков 8x8</li>"
+        "<li>Фокус - доля высоких частот в спектре кадра</li>"
+        "<li>Застывание - повтор одного и того же кадра</li>"
         "</ul>"
         "<p><b>Итоговая оценка:</b> 0-100 (100 = отличное качество)</p>"
         "<hr>"
@@ -22,9 +22,17 @@
 #include <QColor>
 #include <QMessageBox>
 #include <QTime>
+#include <memory>
 
 #include "cameraworker.h"
 #include "imagequalityanalyzer.h"
+#include "analysisscheduler.h"
+#include "snapshotcache.h"
+#include "historywriter.h"
+#include "alertengine.h"
+
+class ShardCoordinator;
+class ResultPublisher;
 
 class MainWindow : public QMainWindow
 {
@@ -35,6 +43,100 @@ public:
     ~MainWindow();
 
     void setRtspInput(const QString& url);
+
+    /**
+     * @brief Задаёт бюджет CPU для анализа качества
+     * @param fraction Доля всех ядер (0.0-1.0); 0 - фиксированный интервал анализа
+     *
+     * Действует для камер, добавленных после вызова. Без вызова камеры
+     * анализируются с фиксированным интервалом; бюджет по умолчанию (--cpu-budget)
+     * задаёт main.
+     */
+    void setAnalysisCpuBudget(double fraction);
+
+    /**
+     * @brief Включает режим координатора: камеры обрабатываются процессами ShardWorker
+     *
+     * Вызывается до добавления камер. Окно не владеет координатором.
+     */
+    void setShardCoordinator(ShardCoordinator* coordinator);
+
+    /**
+     * @brief Публикует результаты и кадры камер удалённым просмотрщикам
+     *
+     * Вызывается до добавления камер. Окно не владеет издателем.
+     */
+    void setResultPublisher(ResultPublisher* publisher);
+
+    /**
+     * @brief Запускать захват каждой новой камеры в отдельном процессе
+     * @see CameraWorker::setCaptureIsolation
+     */
+    void setCaptureIsolation(bool enabled);
+
+    /**
+     * @brief Добавляет камеры из файла списка (см. CameraConfig)
+     * @return Число добавленных камер
+     */
+    int loadCameraList(const QString& path);
+
+    /**
+     * @brief Таймаут открытия потока для новых камер, мс
+     */
+    void setOpenTimeout(int timeoutMs);
+
+    /**
+     * @brief Режим ключевых кадров для новых камер
+     * @see CameraWorker::setKeyframeInterval
+     */
+    void setKeyframeInterval(int gopInterval);
+
+    /**
+     * @brief Простой основного потока камер с подпотоком до закрытия, мс
+     * @see CameraWorker::setSubStreamUrl
+     */
+    void setMainStreamIdleTimeout(int timeoutMs);
+
+    /**
+     * @brief Включает кэш снимков худших и лучших моментов камер
+     * @param memoryLimitBytes Общий лимит памяти; 0 - кэш отключён
+     * @param format "jpg" или "webp"
+     *
+     * Действует для камер, добавленных после вызова.
+     */
+    void setSnapshotCache(qint64 memoryLimitBytes, const QByteArray& format);
+
+    /**
+     * @brief Включает запись предыстории событий камер
+     *
+     * Действует для камер, добавленных после вызова; запись сохраняется
+     * кнопкой вкладки, при оповещении и при падении оценки.
+     */
+    void setRecordingConfig(const CameraWorker::RecordingConfig& config);
+
+    /**
+     * @brief Включает запись истории результатов в каталог (см. TimeSeriesStore)
+     *
+     * Пишутся результаты и локальных, и распределённых камер; запись идёт
+     * в отдельном потоке (HistoryWriter).
+     */
+    void setHistoryDirectory(const QString& directory, const TimeSeriesStore::Retention& retention);
+
+    /**
+     * @brief Заменяет правила оповещений по умолчанию правилами из файла
+     * @return false, если файл не удалось прочитать
+     * @see AlertEngine
+     */
+    bool loadAlertRules(const QString& path);
+
+    /**
+     * @brief Добавляет камеру и сразу начинает подключение в фоне
+     * @param displayName Подпись вкладки; пусто - URL
+     * @param subStreamUrl Подпоток для анализа; пусто - анализ по rtspUrl
+     * @return false, если камера уже добавлена
+     */
+    bool addCameraUrl(const QString& rtspUrl, const QString& displayName = QString(),
+                      const QString& subStreamUrl = QString());
     void showAbout();
 
 protected:
@@ -48,15 +150,22 @@ private slots:
     void handleConnectionStatus(int cameraId, bool connected, const QString& message);
     void handleError(int cameraId, const QString& errorText);
     void handleConnectionLost(int cameraId);
+    void handleAlert(const AlertEngine::Alert& alert, bool raised);
+    void handleConfirmation(int cameraId, const ImageQualityAnalyzer::QualityResult& result, bool confirmed);
+    void updateViewedCamera();
     void updateActivityTimer();
 
 private:
     void setupUi();
-    void addCameraTab(int cameraId, const QString& rtspUrl);
+    void addCameraTab(int cameraId, const QString& rtspUrl, const QString& displayName = QString(),
+                      bool hasSubStream = false);
     void removeCameraTab(int cameraId);
     int generateCameraId();
     void stopAllCameras();
     QColor getQualityColor(double score);
+    void updateAnalysisRates();
+    void saveSnapshots(int cameraId);
+    QWidget* findCameraTab(int cameraId) const;
 
     QWidget* m_centralWidget;
     QVBoxLayout* m_mainLayout;
@@ -70,14 +179,32 @@ private:
     QLabel* m_cameraCountLabel;
     QLabel* m_timeLabel;
     QTimer* m_activityTimer;
+    AnalysisScheduler* m_analysisScheduler;
+    bool m_analysisSchedulingEnabled;
+    ShardCoordinator* m_shardCoordinator;
+    ResultPublisher* m_resultPublisher;
+    bool m_captureIsolation;
+    int m_openTimeoutMs;
+    int m_keyframeGopInterval;
+    int m_mainStreamIdleMs;
+    CameraWorker::RecordingConfig m_recordingConfig;
+    QTimer* m_viewedCameraTimer;     // Откладывает открытие основного потока при листании вкладок
+    int m_viewedCameraId;            // Камера, чей основной поток открыт для просмотра; 0 - нет
+    std::unique_ptr<SnapshotCache> m_snapshotCache;   // Уничтожается после остановки камер
+    std::unique_ptr<HistoryWriter> m_historyWriter;
+    AlertEngine* m_alertEngine;
 
     QMap<int, CameraWorker*> m_cameraWorkers;
+    QMap<int, std::shared_ptr<const CameraWorker::StatePublisher>> m_workerStates;
     QMap<int, QThread*> m_cameraThreads;
     QMap<int, QString> m_cameraUrls;
     QMap<int, QLabel*> m_frameLabels;
     QMap<int, QLabel*> m_scoreLabels;
+    QMap<int, QLabel*> m_rateLabels;
 
     int m_nextCameraId;
+
+    const int VIEWED_CAMERA_DELAY_MS = 500;
 };
 
 #endif // MAINWINDOW_H
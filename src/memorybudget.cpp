@@ -0,0 +1,110 @@
+#include "memorybudget.h"
+#include <QDebug>
+#include <QFile>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+MemoryBudget& MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+MemoryBudget::MemoryBudget()
+    : m_limit(0)
+    , m_resident(0)
+    , m_nextSampleMs(0)
+    , m_pressure(static_cast<int>(Pressure::Normal))
+{
+    m_clock.start();
+}
+
+void MemoryBudget::configure(qint64 limitBytes)
+{
+    m_limit.store(qMax<qint64>(0, limitBytes));
+    if (limitBytes <= 0) {
+        return;
+    }
+
+#ifdef __GLIBC__
+    mallopt(M_ARENA_MAX, MALLOC_ARENAS);
+#endif
+    qInfo() << "Memory ceiling:" << limitBytes / (1024 * 1024) << "MiB, low-memory analysis profile";
+}
+
+bool MemoryBudget::isActive() const
+{
+    return m_limit.load() > 0;
+}
+
+qint64 MemoryBudget::limit() const
+{
+    return m_limit.load();
+}
+
+qint64 MemoryBudget::residentBytes() const
+{
+    return m_resident.load();
+}
+
+MemoryBudget::Pressure MemoryBudget::pressure()
+{
+    if (!isActive()) {
+        return Pressure::Normal;
+    }
+
+    // Замер делает один поток - тот, что первым застал устаревшее значение
+    qint64 now = m_clock.elapsed();
+    qint64 next = m_nextSampleMs.load(std::memory_order_relaxed);
+    if (now >= next && m_nextSampleMs.compare_exchange_strong(next, now + SAMPLE_INTERVAL_MS)) {
+        sample();
+    }
+    return static_cast<Pressure>(m_pressure.load(std::memory_order_relaxed));
+}
+
+void MemoryBudget::sample()
+{
+    qint64 resident = readResidentBytes();
+    if (resident < 0) {
+        return;
+    }
+    m_resident.store(resident);
+
+    double fraction = static_cast<double>(resident) / m_limit.load();
+    Pressure pressure = fraction >= CRITICAL_FRACTION ? Pressure::Critical
+        : fraction >= HIGH_FRACTION ? Pressure::High
+        : Pressure::Normal;
+    Pressure previous = static_cast<Pressure>(m_pressure.exchange(static_cast<int>(pressure)));
+    if (pressure == previous) {
+        return;
+    }
+
+    if (pressure > previous) {
+        qWarning() << "Memory pressure" << (pressure == Pressure::Critical ? "critical" : "high") << ":"
+                   << resident / (1024 * 1024) << "of" << m_limit.load() / (1024 * 1024) << "MiB resident";
+#ifdef __GLIBC__
+        // Освобождённые кадры могли остаться в куче: возвращаем их ОС
+        malloc_trim(0);
+#endif
+    } else {
+        qInfo() << "Memory pressure eased:" << resident / (1024 * 1024) << "MiB resident";
+    }
+}
+
+qint64 MemoryBudget::readResidentBytes()
+{
+    // statm: размер, резидентные страницы, ...
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    bool ok = false;
+    qint64 pages = fields.size() > 1 ? fields[1].toLongLong(&ok) : 0;
+    if (!ok) {
+        return -1;
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
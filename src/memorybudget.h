@@ -0,0 +1,80 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QElapsedTimer>
+#include <atomic>
+
+/**
+ * @class MemoryBudget
+ * @brief Предел резидентной памяти процесса (профиль для edge-устройств)
+ *
+ * На шлюзах с 512 МБ памяти несколько камер 1080p с полными буферами
+ * анализа и предпросмотра доводят процесс до OOM killer. При заданном
+ * пределе камеры работают в профиле низкой памяти: анализ идёт полосами
+ * с 16-битными промежуточными буферами, кадры предпросмотра не строятся.
+ * Обработчики камер опрашивают pressure() и при приближении к пределу
+ * сами снижают частоту анализа, а у самого предела приостанавливают его,
+ * пока память не освободится.
+ *
+ * Размер резидентной памяти читается из /proc/self/statm не чаще раза в
+ * SAMPLE_INTERVAL_MS; pressure() можно вызывать из любых потоков на каждом кадре.
+ */
+class MemoryBudget
+{
+public:
+    enum class Pressure {
+        Normal,      // Ниже HIGH_FRACTION предела
+        High,        // Частота анализа снижается
+        Critical     // Анализ приостановлен
+    };
+
+    static MemoryBudget& instance();
+
+    /**
+     * @brief Задаёт предел (вызывается до запуска камер)
+     * @param limitBytes Предел резидентной памяти; 0 - без предела
+     *
+     * Активный предел ограничивает число арен malloc: на каждый поток
+     * камеры glibc иначе заводит свою арену, и освобождённые буферы
+     * кадров остаются в резидентной памяти.
+     */
+    void configure(qint64 limitBytes);
+
+    bool isActive() const;
+    qint64 limit() const;
+
+    /**
+     * @brief Уровень давления по последнему замеру (замер обновляется по мере надобности)
+     */
+    Pressure pressure();
+
+    /**
+     * @brief Последний замер резидентной памяти, байт
+     */
+    qint64 residentBytes() const;
+
+    /**
+     * @brief Текущий размер резидентной памяти процесса; -1 - недоступно
+     */
+    static qint64 readResidentBytes();
+
+private:
+    MemoryBudget();
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    void sample();
+
+    std::atomic<qint64> m_limit;
+    std::atomic<qint64> m_resident;
+    std::atomic<qint64> m_nextSampleMs;
+    std::atomic<int> m_pressure;
+    QElapsedTimer m_clock;
+
+    static constexpr int SAMPLE_INTERVAL_MS = 250;
+    static constexpr double HIGH_FRACTION = 0.85;
+    static constexpr double CRITICAL_FRACTION = 0.95;
+    static constexpr int MALLOC_ARENAS = 2;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,337 @@
+#include "packetring.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+
+class WriteTask : public QRunnable
+{
+public:
+    explicit WriteTask(std::function<void()> work) : m_work(std::move(work)) {}
+    void run() override { m_work(); }
+
+private:
+    std::function<void()> m_work;
+};
+
+// Кадры без демультиплексора (ingest) несут только время показа, а с
+// B-кадрами оно идёт не по порядку декодирования. Метки декодирования -
+// те же времена по возрастанию, сдвинутые так, чтобы ни один кадр не
+// декодировался позже показа: возрастают и не превышают pts
+void assignDecodeTimestamps(std::vector<AVPacket*>& packets)
+{
+    std::vector<int64_t> sorted;
+    sorted.reserve(packets.size());
+    for (const AVPacket* packet : packets) {
+        if (packet->dts != AV_NOPTS_VALUE || packet->pts == AV_NOPTS_VALUE) {
+            return;
+        }
+        sorted.push_back(packet->pts);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    int64_t shift = 0;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        shift = std::max(shift, sorted[i] - packets[i]->pts);
+    }
+    for (size_t i = 0; i < packets.size(); ++i) {
+        packets[i]->dts = sorted[i] - shift;
+        // Совпавшие метки (повтор кадра камерой) муксер не примет
+        if (i > 0 && packets[i]->dts <= packets[i - 1]->dts) {
+            packets[i]->dts = packets[i - 1]->dts + 1;
+        }
+    }
+}
+
+} // namespace
+
+PacketRing::PacketRing(int durationMs, qint64 maxBytes)
+    : DURATION_MS(durationMs)
+    , MAX_BYTES(maxBytes)
+    , m_parameters(nullptr)
+    , m_timeBaseNum(1)
+    , m_timeBaseDen(1000000)
+    , m_bytes(0)
+    , m_lastMs(0)
+    , m_suspended(false)
+{
+}
+
+PacketRing::~PacketRing()
+{
+    clearLocked();
+    avcodec_parameters_free(&m_parameters);
+}
+
+void PacketRing::setStream(const AVCodecParameters* parameters, int timeBaseNum, int timeBaseDen)
+{
+    QMutexLocker locker(&m_mutex);
+    // Переподключение к той же камере сохраняет накопленную предысторию
+    bool sameStream = m_parameters && m_parameters->codec_id == parameters->codec_id
+        && m_parameters->extradata_size == parameters->extradata_size
+        && (parameters->extradata_size == 0
+            || std::memcmp(m_parameters->extradata, parameters->extradata, parameters->extradata_size) == 0)
+        && m_timeBaseNum == timeBaseNum && m_timeBaseDen == timeBaseDen;
+    if (sameStream) {
+        return;
+    }
+
+    clearLocked();
+    if (!m_parameters) {
+        m_parameters = avcodec_parameters_alloc();
+    }
+    avcodec_parameters_copy(m_parameters, parameters);
+    m_timeBaseNum = timeBaseNum;
+    m_timeBaseDen = timeBaseDen;
+}
+
+void PacketRing::setStream(int codecId, const QByteArray& extradata, int timeBaseNum, int timeBaseDen)
+{
+    AVCodecParameters* parameters = avcodec_parameters_alloc();
+    parameters->codec_type = AVMEDIA_TYPE_VIDEO;
+    parameters->codec_id = static_cast<AVCodecID>(codecId);
+    if (!extradata.isEmpty()) {
+        parameters->extradata = static_cast<uint8_t*>(
+            av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        std::memcpy(parameters->extradata, extradata.constData(), extradata.size());
+        parameters->extradata_size = extradata.size();
+    }
+    setStream(parameters, timeBaseNum, timeBaseDen);
+    avcodec_parameters_free(&parameters);
+}
+
+void PacketRing::setFrameSize(int width, int height)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_parameters && m_parameters->width <= 0) {
+        m_parameters->width = width;
+        m_parameters->height = height;
+    }
+}
+
+void PacketRing::push(const AVPacket* packet)
+{
+    if (m_suspended.load(std::memory_order_relaxed)) {
+        return;
+    }
+    AVPacket* reference = av_packet_clone(packet);
+    if (!reference) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    append(reference);
+}
+
+void PacketRing::push(const QByteArray& data, qint64 timestamp, bool keyframe)
+{
+    // Проверка до копирования: у предела памяти не выделять то, что будет выброшено
+    if (m_suspended.load(std::memory_order_relaxed)) {
+        return;
+    }
+    AVPacket* packet = av_packet_alloc();
+    if (av_new_packet(packet, data.size()) < 0) {
+        av_packet_free(&packet);
+        return;
+    }
+    std::memcpy(packet->data, data.constData(), data.size());
+    // dts восстанавливается при записи (assignDecodeTimestamps)
+    packet->pts = timestamp;
+    packet->dts = AV_NOPTS_VALUE;
+    if (keyframe) {
+        packet->flags |= AV_PKT_FLAG_KEY;
+    }
+    QMutexLocker locker(&m_mutex);
+    append(packet);
+}
+
+void PacketRing::append(AVPacket* packet)
+{
+    int64_t timestamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    qint64 ms = timestamp != AV_NOPTS_VALUE
+        ? av_rescale_q(timestamp, AVRational{ m_timeBaseNum, m_timeBaseDen }, AVRational{ 1, 1000 })
+        : m_lastMs;
+    bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+    // Без dts время - время показа, и B-кадры идут назад в пределах GOP.
+    // Новый отсчёт - это ключевой кадр раньше предыдущего ключевого или
+    // скачок больше DISCONTINUITY_MS в любую сторону
+    if (!m_gops.empty()
+        && ((keyframe && ms < m_gops.back().startMs)
+            || ms - m_lastMs > DISCONTINUITY_MS || m_lastMs - ms > DISCONTINUITY_MS)) {
+        clearLocked();
+    }
+
+    // Кольцо начинается с ключевого кадра: без него GOP не декодируется.
+    // Пакет, прошедший проверку в push() до паузы, тоже не сохраняется
+    if (!m_parameters || (m_gops.empty() && !keyframe) || m_suspended.load(std::memory_order_relaxed)) {
+        av_packet_free(&packet);
+        return;
+    }
+    if (keyframe) {
+        m_gops.push_back(Gop{ {}, ms });
+    }
+    m_gops.back().packets.push_back(packet);
+    m_bytes += packet->size;
+    m_lastMs = m_gops.size() == 1 && keyframe ? ms : qMax(m_lastMs, ms);
+
+    // Старейший GOP не нужен, если остальные уже покрывают окно; предел
+    // памяти важнее окна, но текущий GOP остаётся всегда: иначе GOP больше
+    // предела опустошал бы кольцо при каждом ключевом кадре
+    while (m_gops.size() > 1 && m_lastMs - m_gops[1].startMs >= DURATION_MS) {
+        dropOldestGop();
+    }
+    while (m_bytes > MAX_BYTES && m_gops.size() > 1) {
+        dropOldestGop();
+    }
+}
+
+void PacketRing::dropOldestGop()
+{
+    for (AVPacket* packet : m_gops.front().packets) {
+        m_bytes -= packet->size;
+        av_packet_free(&packet);
+    }
+    m_gops.pop_front();
+}
+
+void PacketRing::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    clearLocked();
+}
+
+void PacketRing::setSuspended(bool suspended)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_suspended.exchange(suspended) == suspended) {
+        return;
+    }
+    if (suspended) {
+        qInfo() << "Pre-event buffer dropped at memory ceiling," << m_bytes << "bytes freed";
+        clearLocked();
+    }
+}
+
+void PacketRing::clearLocked()
+{
+    while (!m_gops.empty()) {
+        dropOldestGop();
+    }
+    m_bytes = 0;
+}
+
+qint64 PacketRing::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+bool PacketRing::save(const QString& path)
+{
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix != "mp4" && suffix != "mkv") {
+        qWarning() << "Pre-event recording: unsupported container" << suffix;
+        return false;
+    }
+
+    // Ссылки на пакеты: запись не мешает кольцу принимать новые
+    std::vector<AVPacket*> packets;
+    AVCodecParameters* parameters = avcodec_parameters_alloc();
+    int timeBaseNum;
+    int timeBaseDen;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_gops.empty()) {
+            avcodec_parameters_free(&parameters);
+            return false;
+        }
+        for (const Gop& gop : m_gops) {
+            for (const AVPacket* packet : gop.packets) {
+                packets.push_back(av_packet_clone(packet));
+            }
+        }
+        avcodec_parameters_copy(parameters, m_parameters);
+        timeBaseNum = m_timeBaseNum;
+        timeBaseDen = m_timeBaseDen;
+    }
+
+    QThreadPool::globalInstance()->start(new WriteTask([path, parameters, timeBaseNum, timeBaseDen, packets]() {
+        writeFile(path, parameters, timeBaseNum, timeBaseDen, packets);
+    }));
+    return true;
+}
+
+void PacketRing::writeFile(const QString& path, AVCodecParameters* parameters, int timeBaseNum,
+                           int timeBaseDen, std::vector<AVPacket*> packets)
+{
+    // Файл появляется под своим именем только целиком
+    QString partPath = path + ".part";
+    QByteArray partName = QFile::encodeName(partPath);
+    const char* formatName = QFileInfo(path).suffix().toLower() == "mkv" ? "matroska" : "mp4";
+    AVRational sourceTimeBase{ timeBaseNum, timeBaseDen };
+
+    AVFormatContext* output = nullptr;
+    bool written = false;
+    int64_t offset = AV_NOPTS_VALUE;
+    assignDecodeTimestamps(packets);
+    if (avformat_alloc_output_context2(&output, nullptr, formatName, partName.constData()) >= 0) {
+        AVStream* stream = avformat_new_stream(output, nullptr);
+        written = stream && avcodec_parameters_copy(stream->codecpar, parameters) >= 0;
+        if (written) {
+            stream->codecpar->codec_tag = 0;
+            stream->time_base = sourceTimeBase;
+            written = avio_open(&output->pb, partName.constData(), AVIO_FLAG_WRITE) >= 0
+                && avformat_write_header(output, nullptr) >= 0;
+        }
+
+        for (AVPacket* packet : packets) {
+            if (!written) {
+                break;
+            }
+            // Файл начинается с нулевой метки декодирования
+            if (offset == AV_NOPTS_VALUE) {
+                offset = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            }
+            if (offset != AV_NOPTS_VALUE) {
+                if (packet->pts != AV_NOPTS_VALUE) packet->pts -= offset;
+                if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+            }
+            av_packet_rescale_ts(packet, sourceTimeBase, stream->time_base);
+            packet->stream_index = stream->index;
+            packet->pos = -1;
+            written = av_interleaved_write_frame(output, packet) >= 0;
+        }
+
+        if (written) {
+            written = av_write_trailer(output) >= 0;
+        }
+        if (output->pb) {
+            avio_closep(&output->pb);
+        }
+        avformat_free_context(output);
+    }
+
+    for (AVPacket* packet : packets) {
+        av_packet_free(&packet);
+    }
+    avcodec_parameters_free(&parameters);
+
+    if (written && (!QFile::exists(path) || QFile::remove(path)) && QFile::rename(partPath, path)) {
+        qInfo() << "Saved pre-event recording" << path;
+    } else {
+        QFile::remove(partPath);
+        qWarning() << "Failed to write pre-event recording" << path;
+    }
+}
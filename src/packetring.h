@@ -0,0 +1,118 @@
+#ifndef PACKETRING_H
+#define PACKETRING_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+extern "C" {
+struct AVCodecParameters;
+struct AVPacket;
+}
+
+/**
+ * @class PacketRing
+ * @brief Кольцо сжатых пакетов видео для записи предыстории события
+ *
+ * Хранит пакеты последних секунд потока до декодирования, целыми GOP:
+ * кольцо всегда начинается с ключевого кадра, старейший GOP удаляется,
+ * когда остальные уже покрывают окно или превышен предел памяти. Текущий
+ * GOP остаётся, даже если один превышает предел. Пакеты демультиплексора
+ * хранятся по ссылке (без копирования данных).
+ *
+ * save() переупаковывает кольцо в MP4 или MKV без декодирования и
+ * перекодирования; запись файла идёт в фоновом потоке.
+ *
+ * Методы потокобезопасны: пакеты может добавлять поток ввода-вывода,
+ * а сохранять - поток камеры.
+ */
+class PacketRing
+{
+public:
+    /**
+     * @param durationMs Глубина предыстории
+     * @param maxBytes Предел памяти сжатых пакетов
+     */
+    PacketRing(int durationMs, qint64 maxBytes);
+    ~PacketRing();
+
+    /**
+     * @brief Параметры видеодорожки; при смене кодека кольцо очищается
+     * @param timeBaseNum, timeBaseDen Единица меток времени пакетов
+     */
+    void setStream(const AVCodecParameters* parameters, int timeBaseNum, int timeBaseDen);
+
+    /**
+     * @brief Параметры по кодеку и наборам параметров (источники без демультиплексора)
+     */
+    void setStream(int codecId, const QByteArray& extradata, int timeBaseNum, int timeBaseDen);
+
+    /**
+     * @brief Размер кадра, если параметры дорожки его не содержали
+     *
+     * Размер нужен контейнеру MP4, а RTP-сессия узнаёт его только от декодера.
+     */
+    void setFrameSize(int width, int height);
+
+    void push(const AVPacket* packet);
+
+    /**
+     * @brief Добавляет кадр, собранный без демультиплексора (данные копируются)
+     * @param timestamp Время показа; с B-кадрами оно не монотонно, метки
+     *        декодирования восстанавливаются при записи
+     */
+    void push(const QByteArray& data, qint64 timestamp, bool keyframe);
+
+    /**
+     * @brief Записывает содержимое кольца в файл (в фоне)
+     * @param path Файл .mp4 или .mkv; контейнер выбирается по расширению
+     * @return false, если кольцо пусто или контейнер не поддерживается
+     *
+     * Кольцо не очищается: следующая запись может перекрывать предыдущую.
+     */
+    bool save(const QString& path);
+
+    void clear();
+
+    /**
+     * @brief Приостанавливает предысторию у предела памяти
+     *
+     * Кольцо очищается и до снятия паузы не принимает пакеты; после неё
+     * снова начинается с ключевого кадра.
+     */
+    void setSuspended(bool suspended);
+
+    qint64 memoryUsage() const;
+
+private:
+    struct Gop {
+        std::vector<AVPacket*> packets;
+        qint64 startMs;
+    };
+
+    void append(AVPacket* packet);
+    void dropOldestGop();
+    void clearLocked();
+    static void writeFile(const QString& path, AVCodecParameters* parameters, int timeBaseNum,
+                          int timeBaseDen, std::vector<AVPacket*> packets);
+
+    const int DURATION_MS;
+    const qint64 MAX_BYTES;
+
+    mutable QMutex m_mutex;
+    AVCodecParameters* m_parameters;
+    int m_timeBaseNum;
+    int m_timeBaseDen;
+    std::deque<Gop> m_gops;
+    qint64 m_bytes;
+    qint64 m_lastMs;
+    std::atomic<bool> m_suspended;
+
+    // Скачок меток времени назад или дальше этого - новый отсчёт (переподключение, повтор файла)
+    static constexpr qint64 DISCONTINUITY_MS = 10000;
+};
+
+#endif // PACKETRING_H
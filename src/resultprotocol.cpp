@@ -0,0 +1,449 @@
+#include "resultprotocol.h"
+#include <QtEndian>
+#include <cmath>
+
+namespace ResultProtocol {
+
+namespace {
+
+// Единиц на единицу поля: 10 - точность 0,1
+const double FIELD_SCALE[FIELD_COUNT] = {
+    10,     // OverallScore
+    10,     // NoiseScore
+    10,     // ContrastScore
+    10,     // SharpnessScore
+    100,    // OverexposedPercent
+    100,    // UnderexposedPercent
+    100,    // DynamicRange
+    10,     // BlockinessScore
+    10,     // FrequencyBlurScore
+    10,     // MeanChroma
+    10,     // ColorCast
+    1000,   // WhiteBalanceRed
+    1000,   // WhiteBalanceBlue
+    100,    // SaturationClippedPercent
+    100,    // Psnr
+    10000,  // Ssim
+    100,    // PacketLossPercent
+    1,      // Flags
+    1,      // FrozenFrameCount
+    1,      // PacketsReceived
+    1,      // PacketsLost
+    1,      // CorruptFrames
+    1       // DecodeErrors
+};
+
+enum FlagBit {
+    FlagValid = 1,
+    FlagFrozen = 2,
+    FlagReference = 4,
+    FlagStreamStats = 8,
+    FlagKeyframeMode = 16
+};
+
+const quint8 UPDATE_FULL = 1;
+
+QByteArray frameMessage(MessageType type, const QByteArray& body)
+{
+    QByteArray message;
+    message.reserve(5 + body.size());
+    quint32 length = static_cast<quint32>(1 + body.size());
+    uchar header[4];
+    qToBigEndian(length, header);
+    message.append(reinterpret_cast<const char*>(header), 4);
+    message.append(static_cast<char>(type));
+    message.append(body);
+    return message;
+}
+
+void writeVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void writeSigned(QByteArray& out, qint64 value)
+{
+    writeVarint(out, (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+}
+
+void writeString(QByteArray& out, const QString& text)
+{
+    QByteArray utf8 = text.toUtf8();
+    writeVarint(out, static_cast<quint64>(utf8.size()));
+    out.append(utf8);
+}
+
+/**
+ * @brief Последовательное чтение тела с проверкой границ
+ */
+class BodyReader
+{
+public:
+    explicit BodyReader(const QByteArray& body)
+        : m_data(reinterpret_cast<const uchar*>(body.constData())), m_end(m_data + body.size()) {}
+
+    bool varint(quint64& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && m_data < m_end; shift += 7) {
+            uchar byte = *m_data++;
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return m_ok = false;
+    }
+
+    bool signedVarint(qint64& value)
+    {
+        quint64 raw = 0;
+        if (!varint(raw)) {
+            return false;
+        }
+        value = static_cast<qint64>(raw >> 1) ^ -static_cast<qint64>(raw & 1);
+        return true;
+    }
+
+    bool byte(quint8& value)
+    {
+        if (m_data >= m_end) {
+            return m_ok = false;
+        }
+        value = *m_data++;
+        return true;
+    }
+
+    bool string(QString& text)
+    {
+        quint64 size = 0;
+        if (!varint(size) || size > static_cast<quint64>(m_end - m_data)) {
+            return m_ok = false;
+        }
+        text = QString::fromUtf8(reinterpret_cast<const char*>(m_data), static_cast<int>(size));
+        m_data += size;
+        return true;
+    }
+
+    QByteArray rest()
+    {
+        QByteArray data(reinterpret_cast<const char*>(m_data), static_cast<int>(m_end - m_data));
+        m_data = m_end;
+        return data;
+    }
+
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_data == m_end; }
+
+private:
+    const uchar* m_data;
+    const uchar* m_end;
+    bool m_ok = true;
+};
+
+} // namespace
+
+Values quantize(const ImageQualityAnalyzer::QualityValues& values)
+{
+    double raw[FIELD_COUNT] = {
+        values.overallScore, values.noiseScore, values.contrastScore, values.sharpnessScore,
+        values.overexposedPercent, values.underexposedPercent, values.dynamicRange,
+        values.blockinessScore, values.frequencyBlurScore, values.meanChroma, values.colorCast,
+        values.whiteBalanceRed, values.whiteBalanceBlue, values.saturationClippedPercent,
+        values.psnr, values.ssim, values.packetLossPercent, 0, 0, 0, 0, 0, 0
+    };
+
+    Values quantized{};
+    for (int field = 0; field < Flags; ++field) {
+        quantized[field] = std::isfinite(raw[field]) ? std::llround(raw[field] * FIELD_SCALE[field]) : 0;
+    }
+    quantized[Flags] = (values.isValid ? FlagValid : 0) | (values.isFrozen ? FlagFrozen : 0)
+        | (values.hasReference ? FlagReference : 0) | (values.hasStreamStats ? FlagStreamStats : 0)
+        | (values.keyframeMode ? FlagKeyframeMode : 0);
+    quantized[FrozenFrameCount] = values.frozenFrameCount;
+    quantized[PacketsReceived] = static_cast<qint64>(values.packetsReceived);
+    quantized[PacketsLost] = static_cast<qint64>(values.packetsLost);
+    quantized[CorruptFrames] = static_cast<qint64>(values.corruptFrames);
+    quantized[DecodeErrors] = static_cast<qint64>(values.decodeErrors);
+    return quantized;
+}
+
+void restore(const Values& quantized, ImageQualityAnalyzer::QualityValues& values)
+{
+    auto real = [&quantized](Field field) { return quantized[field] / FIELD_SCALE[field]; };
+    values.overallScore = real(OverallScore);
+    values.noiseScore = real(NoiseScore);
+    values.contrastScore = real(ContrastScore);
+    values.sharpnessScore = real(SharpnessScore);
+    values.overexposedPercent = real(OverexposedPercent);
+    values.underexposedPercent = real(UnderexposedPercent);
+    values.dynamicRange = real(DynamicRange);
+    values.blockinessScore = real(BlockinessScore);
+    values.frequencyBlurScore = real(FrequencyBlurScore);
+    values.meanChroma = real(MeanChroma);
+    values.colorCast = real(ColorCast);
+    values.whiteBalanceRed = real(WhiteBalanceRed);
+    values.whiteBalanceBlue = real(WhiteBalanceBlue);
+    values.saturationClippedPercent = real(SaturationClippedPercent);
+    values.psnr = real(Psnr);
+    values.ssim = real(Ssim);
+    values.packetLossPercent = real(PacketLossPercent);
+
+    qint64 flags = quantized[Flags];
+    values.isValid = flags & FlagValid;
+    values.isFrozen = flags & FlagFrozen;
+    values.hasReference = flags & FlagReference;
+    values.hasStreamStats = flags & FlagStreamStats;
+    values.keyframeMode = flags & FlagKeyframeMode;
+    values.frozenFrameCount = static_cast<int>(quantized[FrozenFrameCount]);
+    values.packetsReceived = static_cast<quint64>(quantized[PacketsReceived]);
+    values.packetsLost = static_cast<quint64>(quantized[PacketsLost]);
+    values.corruptFrames = static_cast<quint64>(quantized[CorruptFrames]);
+    values.decodeErrors = static_cast<quint64>(quantized[DecodeErrors]);
+}
+
+void Subscription::compile()
+{
+    // QRegExp, а не QRegularExpression::wildcardToRegularExpression: тот появился лишь в Qt 5.12
+    expressions.clear();
+    for (const QString& pattern : patterns) {
+        expressions.append(QRegExp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard));
+    }
+}
+
+bool Subscription::matches(const QString& key, const QString& name) const
+{
+    if (patterns.isEmpty()) {
+        return true;
+    }
+    for (const QRegExp& expression : expressions) {
+        if (expression.exactMatch(key) || (!name.isEmpty() && expression.exactMatch(name))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QByteArray encodeHello()
+{
+    QByteArray body;
+    body.append(static_cast<char>(VERSION));
+    return frameMessage(Hello, body);
+}
+
+QByteArray encodeSubscribe(const Subscription& subscription)
+{
+    QByteArray body;
+    body.append(static_cast<char>(subscription.thumbnails ? 1 : 0));
+    writeVarint(body, static_cast<quint64>(qMax(0, subscription.minIntervalMs)));
+    writeVarint(body, static_cast<quint64>(subscription.patterns.size()));
+    for (const QString& pattern : subscription.patterns) {
+        writeString(body, pattern);
+    }
+    return frameMessage(Subscribe, body);
+}
+
+QByteArray encodeCamera(quint32 index, const QString& key, const QString& name)
+{
+    QByteArray body;
+    writeVarint(body, index);
+    writeString(body, key);
+    writeString(body, name);
+    return frameMessage(Camera, body);
+}
+
+QByteArray encodeCameraRemoved(quint32 index)
+{
+    QByteArray body;
+    writeVarint(body, index);
+    return frameMessage(CameraRemoved, body);
+}
+
+QByteArray encodeUpdate(quint32 index, quint64 sequence, bool full, const Values& values, const QString& status,
+                        quint64 baseSequence, const Values& previous, const QString& previousStatus)
+{
+    Q_ASSERT(full || (baseSequence > 0 && baseSequence < sequence));
+
+    // Полное обновление - разность с нулевым состоянием: нулевые поля не передаются
+    quint32 mask = 0;
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        if (values[field] != (full ? 0 : previous[field])) {
+            mask |= 1u << field;
+        }
+    }
+    if (status != (full ? QString() : previousStatus)) {
+        mask |= 1u << STATUS_BIT;
+    }
+
+    QByteArray body;
+    writeVarint(body, index);
+    writeVarint(body, sequence);
+    body.append(static_cast<char>(full ? UPDATE_FULL : 0));
+    if (!full) {
+        writeVarint(body, sequence - baseSequence);
+    }
+    writeVarint(body, mask);
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        if (mask & (1u << field)) {
+            writeSigned(body, values[field] - (full ? 0 : previous[field]));
+        }
+    }
+    if (mask & (1u << STATUS_BIT)) {
+        writeString(body, status);
+    }
+    return frameMessage(Update, body);
+}
+
+QByteArray encodeThumbnail(quint32 index, const QByteArray& jpeg)
+{
+    QByteArray body;
+    writeVarint(body, index);
+    body.append(jpeg);
+    return frameMessage(Thumbnail, body);
+}
+
+void MessageReader::append(const QByteArray& data)
+{
+    m_buffer.append(data);
+}
+
+bool MessageReader::next(Message& message)
+{
+    if (m_error || m_buffer.size() < 4) {
+        return false;
+    }
+
+    quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(m_buffer.constData()));
+    if (length == 0 || length > MAX_MESSAGE_SIZE) {
+        m_error = true;
+        return false;
+    }
+    if (static_cast<quint32>(m_buffer.size()) < 4 + length) {
+        return false;
+    }
+
+    QByteArray body = m_buffer.mid(5, static_cast<int>(length) - 1);
+    message = Message();
+    message.type = static_cast<MessageType>(static_cast<quint8>(m_buffer.at(4)));
+    m_buffer.remove(0, static_cast<int>(4 + length));
+
+    BodyReader reader(body);
+    quint64 value = 0;
+    switch (message.type) {
+    case Hello:
+        reader.byte(message.version);
+        break;
+    case Subscribe: {
+        quint8 flags = 0;
+        quint64 count = 0;
+        if (reader.byte(flags) && reader.varint(value) && reader.varint(count)) {
+            message.subscription.thumbnails = flags & 1;
+            message.subscription.minIntervalMs = static_cast<int>(qMin<quint64>(value, 3600 * 1000));
+            for (quint64 i = 0; i < count && reader.ok(); ++i) {
+                QString pattern;
+                if (reader.string(pattern)) {
+                    message.subscription.patterns.append(pattern);
+                }
+            }
+            message.subscription.compile();
+        }
+        break;
+    }
+    case Camera:
+        if (reader.varint(value)) {
+            message.cameraIndex = static_cast<quint32>(value);
+            if (reader.string(message.key)) {
+                reader.string(message.name);
+            }
+        }
+        break;
+    case CameraRemoved:
+        if (reader.varint(value)) {
+            message.cameraIndex = static_cast<quint32>(value);
+        }
+        break;
+    case Update: {
+        quint8 flags = 0;
+        quint64 mask = 0;
+        quint64 distance = 0;
+        if (reader.varint(value) && reader.varint(message.sequence) && reader.byte(flags)
+            && ((flags & UPDATE_FULL) || reader.varint(distance)) && reader.varint(mask)) {
+            message.cameraIndex = static_cast<quint32>(value);
+            message.full = flags & UPDATE_FULL;
+            if (!message.full) {
+                // Отступ 0 или дальше начала нумерации - повреждённое сообщение
+                if (distance == 0 || distance >= message.sequence) {
+                    m_error = true;
+                    return false;
+                }
+                message.baseSequence = message.sequence - distance;
+            }
+            message.fieldMask = static_cast<quint32>(mask);
+            for (int field = 0; field < FIELD_COUNT && reader.ok(); ++field) {
+                if (mask & (1u << field)) {
+                    reader.signedVarint(message.deltas[field]);
+                }
+            }
+            if (reader.ok() && (mask & (1u << STATUS_BIT))) {
+                reader.string(message.status);
+            }
+        }
+        break;
+    }
+    case Thumbnail:
+        if (reader.varint(value)) {
+            message.cameraIndex = static_cast<quint32>(value);
+            message.thumbnail = reader.rest();
+        }
+        break;
+    default:
+        m_error = true;
+        return false;
+    }
+
+    if (!reader.ok()) {
+        m_error = true;
+        return false;
+    }
+    return true;
+}
+
+bool MessageReader::hasError() const
+{
+    return m_error;
+}
+
+bool UpdateDecoder::apply(const Message& update, ImageQualityAnalyzer::QualityResult& result)
+{
+    auto it = m_cameras.find(update.cameraIndex);
+    if (update.full) {
+        it = m_cameras.insert(update.cameraIndex, State());
+    } else if (it == m_cameras.end() || update.baseSequence != it->sequence) {
+        return false;
+    }
+
+    for (int field = 0; field < FIELD_COUNT; ++field) {
+        if (update.fieldMask & (1u << field)) {
+            it->values[field] += update.deltas[field];
+        }
+    }
+    if (update.fieldMask & (1u << STATUS_BIT)) {
+        it->status = update.status;
+    }
+    it->sequence = update.sequence;
+
+    restore(it->values, result);
+    result.status = it->status;
+    return true;
+}
+
+void UpdateDecoder::removeCamera(quint32 index)
+{
+    m_cameras.remove(index);
+}
+
+} // namespace ResultProtocol
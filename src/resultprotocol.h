@@ -0,0 +1,191 @@
+#ifndef RESULTPROTOCOL_H
+#define RESULTPROTOCOL_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QRegExp>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+#include <array>
+#include "imagequalityanalyzer.h"
+
+/**
+ * @brief Протокол потоковой передачи результатов лёгким удалённым просмотрщикам
+ *
+ * Сообщение: [quint32 длина][quint8 тип][тело]. Тело - компактная двоичная
+ * запись: целые - varint (LEB128), строки - varint длины и UTF-8.
+ *
+ * | Тип           | Направление           | Тело                                   |
+ * |---------------|-----------------------|----------------------------------------|
+ * | Hello         | издатель → просмотр.  | версия протокола                       |
+ * | Subscribe     | просмотр. → издатель  | флаги, мин. интервал, шаблоны камер    |
+ * | Camera        | издатель → просмотр.  | индекс, ключ (URL без уч. данных), имя |
+ * | CameraRemoved | издатель → просмотр.  | индекс                                 |
+ * | Update        | издатель → просмотр.  | индекс, номер, база, маска, разности   |
+ * | Thumbnail     | издатель → просмотр.  | индекс, JPEG                           |
+ *
+ * Числовые поля QualityResult квантуются в целые (оценки - до 0,1, доли и
+ * дБ - до 0,01). Update несёт только изменившиеся поля как zigzag-varint
+ * разности с базовым обновлением камеры, номер которого передаётся как
+ * отступ от своего; полное обновление (флаг Full) - разности с нулевым
+ * состоянием, без базы. Обычно база - предыдущее обновление камеры, но
+ * подписчику с пропусками (минимальный интервал, медленная сеть) издатель
+ * шлёт разность с последним отправленным ему. Разностное обновление
+ * применимо, только если его база - последнее принятое; иначе просмотрщик
+ * ждёт полного, которое издатель шлёт новым подписчикам.
+ */
+namespace ResultProtocol {
+
+enum MessageType : quint8 {
+    Hello = 1,
+    Subscribe = 2,
+    Camera = 3,
+    CameraRemoved = 4,
+    Update = 5,
+    Thumbnail = 6
+};
+
+const quint8 VERSION = 2;
+const quint16 DEFAULT_PORT = 7710;
+
+/**
+ * @brief Квантуемые поля результата; номер - бит в маске Update
+ */
+enum Field {
+    OverallScore,
+    NoiseScore,
+    ContrastScore,
+    SharpnessScore,
+    OverexposedPercent,
+    UnderexposedPercent,
+    DynamicRange,
+    BlockinessScore,
+    FrequencyBlurScore,
+    MeanChroma,
+    ColorCast,
+    WhiteBalanceRed,
+    WhiteBalanceBlue,
+    SaturationClippedPercent,
+    Psnr,
+    Ssim,
+    PacketLossPercent,
+    Flags,              // isValid, isFrozen, hasReference, hasStreamStats, keyframeMode
+    FrozenFrameCount,
+    PacketsReceived,
+    PacketsLost,
+    CorruptFrames,
+    DecodeErrors,
+    FIELD_COUNT
+};
+
+const int STATUS_BIT = FIELD_COUNT;     // Бит маски: изменился текст статуса
+
+using Values = std::array<qint64, FIELD_COUNT>;
+
+Values quantize(const ImageQualityAnalyzer::QualityValues& values);
+void restore(const Values& quantized, ImageQualityAnalyzer::QualityValues& values);
+
+struct Subscription {
+    QStringList patterns;       // Шаблоны * и ? по ключу или имени камеры; пусто - все
+    bool thumbnails = false;    // Присылать миниатюры кадров
+    int minIntervalMs = 0;      // Не чаще одного обновления камеры за интервал
+    QVector<QRegExp> expressions;   // Разобранные patterns; заполняет compile()
+
+    /**
+     * @brief Разбирает шаблоны один раз; MessageReader вызывает его для Subscribe
+     */
+    void compile();
+
+    /**
+     * @brief Проходит ли камера фильтр подписки (после compile())
+     */
+    bool matches(const QString& key, const QString& name) const;
+};
+
+/**
+ * @brief Разобранное сообщение протокола
+ */
+struct Message {
+    MessageType type = Hello;
+    quint8 version = 0;                 // Hello
+    Subscription subscription;          // Subscribe
+    quint32 cameraIndex = 0;            // Camera, CameraRemoved, Update, Thumbnail
+    QString key;                        // Camera
+    QString name;                       // Camera
+    quint64 sequence = 0;               // Update
+    quint64 baseSequence = 0;           // Update: номер базы разностей; у полного 0
+    bool full = false;                  // Update
+    quint32 fieldMask = 0;              // Update
+    Values deltas{};                    // Update: разности полей из маски
+    QString status;                     // Update (если бит STATUS_BIT)
+    QByteArray thumbnail;               // Thumbnail
+};
+
+QByteArray encodeHello();
+QByteArray encodeSubscribe(const Subscription& subscription);
+QByteArray encodeCamera(quint32 index, const QString& key, const QString& name);
+QByteArray encodeCameraRemoved(quint32 index);
+
+/**
+ * @brief Кодирует обновление относительно базового состояния камеры
+ * @param baseSequence, previous, previousStatus Номер и состояние базы (меньший номер);
+ *        для полного не используются
+ */
+QByteArray encodeUpdate(quint32 index, quint64 sequence, bool full, const Values& values, const QString& status,
+                        quint64 baseSequence, const Values& previous, const QString& previousStatus);
+QByteArray encodeThumbnail(quint32 index, const QByteArray& jpeg);
+
+/**
+ * @brief Собирает сообщения из потока байт соединения
+ */
+class MessageReader
+{
+public:
+    void append(const QByteArray& data);
+
+    /**
+     * @brief Извлекает следующее полное сообщение
+     * @return false, если полного сообщения пока нет
+     */
+    bool next(Message& message);
+
+    /**
+     * @brief Поток содержит некорректные данные; соединение следует закрыть
+     */
+    bool hasError() const;
+
+private:
+    QByteArray m_buffer;
+    bool m_error = false;
+
+    static constexpr quint32 MAX_MESSAGE_SIZE = 4 * 1024 * 1024;
+};
+
+/**
+ * @brief Восстанавливает результаты камер на стороне просмотрщика
+ */
+class UpdateDecoder
+{
+public:
+    /**
+     * @brief Применяет Update к состоянию камеры
+     * @return false, если база разностного обновления не совпала с последним принятым
+     */
+    bool apply(const Message& update, ImageQualityAnalyzer::QualityResult& result);
+
+    void removeCamera(quint32 index);
+
+private:
+    struct State {
+        quint64 sequence = 0;
+        Values values{};
+        QString status;
+    };
+
+    QHash<quint32, State> m_cameras;
+};
+
+} // namespace ResultProtocol
+
+#endif // RESULTPROTOCOL_H
@@ -0,0 +1,415 @@
+#include "resultpublisher.h"
+#include <QBuffer>
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRunnable>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QUrlQuery>
+#include <functional>
+
+namespace {
+
+// Параметры запроса, в которых камеры и VMS передают учётные данные
+const char* const CREDENTIAL_QUERY_KEYS[] = {
+    "user", "username", "login", "password", "pass", "pwd", "passwd",
+    "token", "access_token", "auth", "authorization", "key", "apikey", "api_key",
+    "secret", "signature", "sig"
+};
+
+class ThumbnailTask : public QRunnable
+{
+public:
+    explicit ThumbnailTask(std::function<void()> work) : m_work(std::move(work)) {}
+    void run() override { m_work(); }
+
+private:
+    std::function<void()> m_work;
+};
+
+} // namespace
+
+ResultPublisher::ResultPublisher(QObject *parent)
+    : QObject(parent)
+    , m_tcpServer(nullptr)
+    , m_localServer(nullptr)
+    , m_flushTimer(nullptr)
+    , m_nextIndex(1)
+{
+    m_flushTimer = new QTimer(this);
+    connect(m_flushTimer, &QTimer::timeout, this, &ResultPublisher::flushPending);
+    m_flushTimer->start(FLUSH_INTERVAL_MS);
+
+    // Сжатие миниатюр не должно занимать пул анализа и записи
+    m_thumbnailPool.setMaxThreadCount(1);
+    m_clock.start();
+}
+
+ResultPublisher::~ResultPublisher()
+{
+    m_thumbnailPool.waitForDone();
+    for (QIODevice* device : m_subscribers.keys()) {
+        device->disconnect(this);
+        device->close();
+    }
+}
+
+bool ResultPublisher::listenTcp(const QHostAddress& address, quint16 port)
+{
+    if (!m_tcpServer) {
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, &QTcpServer::newConnection, this, &ResultPublisher::onNewTcpConnection);
+    }
+    if (!m_tcpServer->listen(address, port)) {
+        qWarning() << "Result publisher cannot listen on" << address.toString() << port
+                   << m_tcpServer->errorString();
+        return false;
+    }
+    qInfo() << "Result publisher listening on" << address.toString() << port;
+    return true;
+}
+
+bool ResultPublisher::listenLocal(const QString& name)
+{
+    if (!m_localServer) {
+        m_localServer = new QLocalServer(this);
+        connect(m_localServer, &QLocalServer::newConnection, this, &ResultPublisher::onNewLocalConnection);
+    }
+    // Сокет, оставшийся от аварийно завершённого процесса, мешает listen()
+    QLocalServer::removeServer(name);
+    if (!m_localServer->listen(name)) {
+        qWarning() << "Result publisher cannot listen on local socket" << name << m_localServer->errorString();
+        return false;
+    }
+    qInfo() << "Result publisher listening on local socket" << m_localServer->fullServerName();
+    return true;
+}
+
+QString ResultPublisher::cameraKey(const QString& url)
+{
+    // Ключ уходит всем подписчикам: учётные данные из него убираются целиком.
+    // Остальные параметры запроса (channel, subtype) различают потоки одной камеры
+    QUrl key(url);
+    if (key.hasQuery()) {
+        QUrlQuery query(key);
+        for (const auto& item : query.queryItems()) {
+            for (const char* credentialKey : CREDENTIAL_QUERY_KEYS) {
+                if (item.first.compare(QLatin1String(credentialKey), Qt::CaseInsensitive) == 0) {
+                    query.removeAllQueryItems(item.first);
+                    break;
+                }
+            }
+        }
+        key.setQuery(query.isEmpty() ? QString() : query.query());
+    }
+    return key.toString(QUrl::RemoveUserInfo);
+}
+
+void ResultPublisher::addCamera(const QString& url, const QString& name)
+{
+    if (m_indexByUrl.contains(url)) {
+        return;
+    }
+
+    CameraState camera;
+    camera.index = m_nextIndex++;
+    camera.key = cameraKey(url);
+    camera.name = name;
+    m_indexByUrl.insert(url, camera.index);
+    m_cameras.insert(camera.index, camera);
+
+    QByteArray message = ResultProtocol::encodeCamera(camera.index, camera.key, camera.name);
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        if (it->subscribed && it->subscription.matches(camera.key, camera.name)) {
+            it->cameras.insert(camera.index);
+            it.key()->write(message);
+        }
+    }
+}
+
+void ResultPublisher::removeCamera(const QString& url)
+{
+    auto indexIt = m_indexByUrl.find(url);
+    if (indexIt == m_indexByUrl.end()) {
+        return;
+    }
+    quint32 index = indexIt.value();
+    m_indexByUrl.erase(indexIt);
+    m_cameras.remove(index);
+
+    QByteArray message = ResultProtocol::encodeCameraRemoved(index);
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        if (it->cameras.remove(index)) {
+            it->sent.remove(index);
+            it->pending.remove(index);
+            it.key()->write(message);
+        }
+    }
+}
+
+void ResultPublisher::publishResult(const QString& url, const ImageQualityAnalyzer::QualityResult& result)
+{
+    auto cameraIt = m_cameras.find(m_indexByUrl.value(url));
+    if (cameraIt == m_cameras.end()) {
+        return;
+    }
+    CameraState& camera = cameraIt.value();
+
+    // Кадры, не изменившие квантованных значений, не порождают трафика
+    ResultProtocol::Values values = ResultProtocol::quantize(result);
+    if (camera.sequence > 0 && values == camera.values && result.status == camera.status) {
+        return;
+    }
+
+    camera.delta = camera.sequence > 0
+        ? ResultProtocol::encodeUpdate(camera.index, camera.sequence + 1, false, values, result.status,
+                                       camera.sequence, camera.values, camera.status)
+        : QByteArray();
+    camera.full.clear();
+    camera.sequence++;
+    camera.values = values;
+    camera.status = result.status;
+
+    qint64 now = m_clock.elapsed();
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        if (it->cameras.contains(camera.index)) {
+            sendUpdate(it.key(), it.value(), camera, now);
+        }
+    }
+}
+
+void ResultPublisher::offerFrame(const QString& url, const QImage& image)
+{
+    auto cameraIt = m_cameras.find(m_indexByUrl.value(url));
+    if (cameraIt == m_cameras.end() || image.isNull()) {
+        return;
+    }
+    CameraState& camera = cameraIt.value();
+    qint64 now = m_clock.elapsed();
+    if (camera.thumbnailPending || (camera.lastThumbnailMs > 0 && now - camera.lastThumbnailMs < THUMBNAIL_INTERVAL_MS)
+        || !wantsThumbnail(camera.index)) {
+        return;
+    }
+    camera.thumbnailPending = true;
+    camera.lastThumbnailMs = now;
+
+    // QImage разделяется неявно: копия в задаче не копирует пиксели
+    quint32 index = camera.index;
+    m_thumbnailPool.start(new ThumbnailTask([this, index, image]() {
+        QImage thumbnail = image.width() > THUMBNAIL_WIDTH
+            ? image.scaledToWidth(THUMBNAIL_WIDTH, Qt::SmoothTransformation)
+            : image;
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+        if (!thumbnail.save(&buffer, "JPG", THUMBNAIL_QUALITY)) {
+            jpeg.clear();
+        }
+        QMetaObject::invokeMethod(this, "thumbnailEncoded", Qt::QueuedConnection,
+                                  Q_ARG(quint32, index), Q_ARG(QByteArray, jpeg));
+    }));
+}
+
+void ResultPublisher::thumbnailEncoded(quint32 index, const QByteArray& jpeg)
+{
+    auto cameraIt = m_cameras.find(index);
+    if (cameraIt == m_cameras.end()) {
+        return;
+    }
+    cameraIt->thumbnailPending = false;
+    if (jpeg.isEmpty()) {
+        return;
+    }
+
+    // Миниатюра устаревает к следующей: подписчику с полным буфером она не нужна
+    QByteArray message = ResultProtocol::encodeThumbnail(index, jpeg);
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        if (it->subscription.thumbnails && it->cameras.contains(index)
+            && it.key()->bytesToWrite() < MAX_PENDING_BYTES) {
+            it.key()->write(message);
+        }
+    }
+}
+
+bool ResultPublisher::wantsThumbnail(quint32 index) const
+{
+    for (const Subscriber& subscriber : m_subscribers) {
+        if (subscriber.subscription.thumbnails && subscriber.cameras.contains(index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResultPublisher::onNewTcpConnection()
+{
+    while (QTcpSocket* socket = m_tcpServer->nextPendingConnection()) {
+        // Обновления мелкие: без задержки Нейгла они не копятся в ядре
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            dropSubscriber(socket);
+        });
+        acceptConnection(socket);
+    }
+}
+
+void ResultPublisher::onNewLocalConnection()
+{
+    while (QLocalSocket* socket = m_localServer->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            dropSubscriber(socket);
+        });
+        acceptConnection(socket);
+    }
+}
+
+void ResultPublisher::acceptConnection(QIODevice* device)
+{
+    m_subscribers.insert(device, Subscriber());
+    connect(device, &QIODevice::readyRead, this, [this, device]() {
+        auto it = m_subscribers.find(device);
+        if (it == m_subscribers.end()) {
+            return;
+        }
+        it->reader.append(device->readAll());
+
+        ResultProtocol::Message message;
+        while (m_subscribers.contains(device) && m_subscribers[device].reader.next(message)) {
+            handleMessage(device, message);
+        }
+        if (m_subscribers.contains(device) && m_subscribers[device].reader.hasError()) {
+            qWarning() << "Malformed data from result viewer";
+            dropSubscriber(device);
+        }
+    });
+    device->write(ResultProtocol::encodeHello());
+    qInfo() << "Result viewer connected, total:" << m_subscribers.size();
+}
+
+void ResultPublisher::handleMessage(QIODevice* device, const ResultProtocol::Message& message)
+{
+    switch (message.type) {
+    case ResultProtocol::Hello:
+        if (message.version != ResultProtocol::VERSION) {
+            qWarning() << "Result viewer uses protocol version" << static_cast<int>(message.version);
+            dropSubscriber(device);
+        }
+        break;
+    case ResultProtocol::Subscribe:
+        subscribe(device, m_subscribers[device], message.subscription);
+        break;
+    default:
+        break;
+    }
+}
+
+void ResultPublisher::subscribe(QIODevice* device, Subscriber& subscriber,
+                                const ResultProtocol::Subscription& subscription)
+{
+    subscriber.subscription = subscription;
+    subscriber.subscribed = true;
+
+    // Повторная подписка меняет фильтр: лишние камеры снимаются, новые объявляются
+    QSet<quint32> cameras;
+    for (const CameraState& camera : m_cameras) {
+        if (subscription.matches(camera.key, camera.name)) {
+            cameras.insert(camera.index);
+        }
+    }
+    for (quint32 index : subscriber.cameras) {
+        if (!cameras.contains(index)) {
+            subscriber.sent.remove(index);
+            subscriber.pending.remove(index);
+            device->write(ResultProtocol::encodeCameraRemoved(index));
+        }
+    }
+
+    qint64 now = m_clock.elapsed();
+    for (quint32 index : cameras) {
+        CameraState& camera = m_cameras[index];
+        if (!subscriber.cameras.contains(index)) {
+            device->write(ResultProtocol::encodeCamera(index, camera.key, camera.name));
+        }
+        if (camera.sequence > 0) {
+            sendUpdate(device, subscriber, camera, now);
+        }
+    }
+    subscriber.cameras = cameras;
+
+    qInfo() << "Result viewer subscribed to" << cameras.size() << "cameras"
+            << (subscription.thumbnails ? "with thumbnails" : "");
+}
+
+void ResultPublisher::sendUpdate(QIODevice* device, Subscriber& subscriber, CameraState& camera, qint64 now)
+{
+    quint32 index = camera.index;
+    auto sentIt = subscriber.sent.find(index);
+    if (device->bytesToWrite() > MAX_PENDING_BYTES
+        || (subscriber.subscription.minIntervalMs > 0 && sentIt != subscriber.sent.end()
+            && now - sentIt->ms < subscriber.subscription.minIntervalMs)) {
+        subscriber.pending.insert(index);
+        return;
+    }
+    subscriber.pending.remove(index);
+
+    if (sentIt == subscriber.sent.end()) {
+        device->write(fullUpdate(camera));
+        sentIt = subscriber.sent.insert(index, SentState());
+    } else if (sentIt->sequence == camera.sequence) {
+        return;
+    } else if (sentIt->sequence + 1 == camera.sequence && !camera.delta.isEmpty()) {
+        device->write(camera.delta);
+    } else {
+        // Пропустивший обновления получает разность со своей базой: она кодируется
+        // только для него, зато несёт лишь поля, изменившиеся с его последнего обновления
+        device->write(ResultProtocol::encodeUpdate(index, camera.sequence, false, camera.values, camera.status,
+                                                   sentIt->sequence, sentIt->values, sentIt->status));
+    }
+    sentIt->sequence = camera.sequence;
+    sentIt->ms = now;
+    sentIt->values = camera.values;
+    sentIt->status = camera.status;
+}
+
+const QByteArray& ResultPublisher::fullUpdate(CameraState& camera)
+{
+    if (camera.full.isEmpty()) {
+        camera.full = ResultProtocol::encodeUpdate(camera.index, camera.sequence, true, camera.values,
+                                                   camera.status, 0, ResultProtocol::Values{}, QString());
+    }
+    return camera.full;
+}
+
+void ResultPublisher::flushPending()
+{
+    qint64 now = m_clock.elapsed();
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        if (it->pending.isEmpty() || it.key()->bytesToWrite() > MAX_PENDING_BYTES) {
+            continue;
+        }
+        const QList<quint32> pending = it->pending.values();
+        for (quint32 index : pending) {
+            auto cameraIt = m_cameras.find(index);
+            if (cameraIt == m_cameras.end()) {
+                it->pending.remove(index);
+                continue;
+            }
+            sendUpdate(it.key(), it.value(), cameraIt.value(), now);
+        }
+    }
+}
+
+void ResultPublisher::dropSubscriber(QIODevice* device)
+{
+    auto it = m_subscribers.find(device);
+    if (it == m_subscribers.end()) {
+        return;
+    }
+    m_subscribers.erase(it);
+    device->disconnect(this);
+    device->close();
+    device->deleteLater();
+    qInfo() << "Result viewer disconnected, remaining:" << m_subscribers.size();
+}
@@ -0,0 +1,141 @@
+#ifndef RESULTPUBLISHER_H
+#define RESULTPUBLISHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QImage>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "imagequalityanalyzer.h"
+#include "resultprotocol.h"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+/**
+ * @class ResultPublisher
+ * @brief Издатель результатов анализа для удалённых просмотрщиков
+ *
+ * Принимает подключения по TCP и локальному сокету (см. ResultProtocol).
+ * Обновление камеры кодируется один раз и одними и теми же байтами
+ * уходит всем подписчикам, получившим предыдущее обновление; новому
+ * подписчику отправляется полное обновление, тоже общее.
+ *
+ * Подписчик с переполненным буфером отправки (медленная сеть) не
+ * получает промежуточных обновлений: камера помечается, и после
+ * освобождения буфера он получает одно обновление последнего состояния -
+ * разность с тем, что было отправлено ему последним. Так же соблюдается
+ * минимальный интервал подписки.
+ *
+ * Миниатюра кадра сжимается в JPEG не чаще раза в THUMBNAIL_INTERVAL_MS
+ * на камеру и только если её запросил хотя бы один подписчик; сжатие
+ * идёт в собственном пуле потоков, результат рассылается всем.
+ *
+ * Объект живёт в потоке GUI; все методы вызываются из него.
+ */
+class ResultPublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ResultPublisher(QObject *parent = nullptr);
+    ~ResultPublisher();
+
+    bool listenTcp(const QHostAddress& address, quint16 port);
+
+    /**
+     * @brief Слушает локальный сокет (Unix-сокет или именованный канал)
+     */
+    bool listenLocal(const QString& name);
+
+    /**
+     * @param name Отображаемое имя камеры; пусто - только ключ
+     */
+    void addCamera(const QString& url, const QString& name);
+    void removeCamera(const QString& url);
+
+    void publishResult(const QString& url, const ImageQualityAnalyzer::QualityResult& result);
+
+    /**
+     * @brief Предлагает кадр для миниатюры; дешёвый отказ, если она сейчас не нужна
+     */
+    void offerFrame(const QString& url, const QImage& image);
+
+    /**
+     * @brief Ключ камеры в протоколе: URL без имени пользователя, пароля
+     *        и параметров запроса с учётными данными (token, password и т.п.)
+     */
+    static QString cameraKey(const QString& url);
+
+private slots:
+    void onNewTcpConnection();
+    void onNewLocalConnection();
+    void flushPending();
+    void thumbnailEncoded(quint32 index, const QByteArray& jpeg);
+
+private:
+    struct CameraState {
+        quint32 index;
+        QString key;
+        QString name;
+        quint64 sequence = 0;            // 0 - результатов ещё не было
+        ResultProtocol::Values values{};
+        QString status;
+        QByteArray delta;                // Обновление sequence - 1 -> sequence
+        QByteArray full;                 // Полное обновление; строится по требованию
+        qint64 lastThumbnailMs = 0;
+        bool thumbnailPending = false;
+    };
+
+    /**
+     * @brief Последнее обновление камеры, отправленное подписчику - база его разностей
+     */
+    struct SentState {
+        quint64 sequence = 0;
+        qint64 ms = 0;
+        ResultProtocol::Values values{};
+        QString status;
+    };
+
+    struct Subscriber {
+        ResultProtocol::MessageReader reader;
+        ResultProtocol::Subscription subscription;
+        bool subscribed = false;
+        QSet<quint32> cameras;            // Камеры, проходящие фильтр
+        QHash<quint32, SentState> sent;
+        QSet<quint32> pending;            // Пропущенные обновления: догнать разностью с отправленным
+    };
+
+    void acceptConnection(QIODevice* device);
+    void handleMessage(QIODevice* device, const ResultProtocol::Message& message);
+    void subscribe(QIODevice* device, Subscriber& subscriber, const ResultProtocol::Subscription& subscription);
+    void dropSubscriber(QIODevice* device);
+    void sendUpdate(QIODevice* device, Subscriber& subscriber, CameraState& camera, qint64 now);
+    const QByteArray& fullUpdate(CameraState& camera);
+    bool wantsThumbnail(quint32 index) const;
+
+    QTcpServer* m_tcpServer;
+    QLocalServer* m_localServer;
+    QTimer* m_flushTimer;
+    QElapsedTimer m_clock;
+    QThreadPool m_thumbnailPool;
+    QMap<QIODevice*, Subscriber> m_subscribers;
+    QHash<QString, quint32> m_indexByUrl;
+    QMap<quint32, CameraState> m_cameras;
+    quint32 m_nextIndex;
+
+    static constexpr qint64 MAX_PENDING_BYTES = 256 * 1024;  // Буфер отправки, после которого обновления копятся
+    static constexpr int FLUSH_INTERVAL_MS = 200;
+    static constexpr int THUMBNAIL_INTERVAL_MS = 1000;
+    static constexpr int THUMBNAIL_WIDTH = 160;
+    static constexpr int THUMBNAIL_QUALITY = 60;
+};
+
+#endif // RESULTPUBLISHER_H
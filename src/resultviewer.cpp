@@ -0,0 +1,165 @@
+#include "resultviewer.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <iostream>
+
+#include "shardprotocol.h"
+
+ResultViewer::ResultViewer(const QString& endpoint, const ResultProtocol::Subscription& subscription,
+                           const QString& thumbnailDirectory, QObject *parent)
+    : QObject(parent)
+    , m_endpoint(endpoint)
+    , m_port(0)
+    , m_subscription(subscription)
+    , m_thumbnailDirectory(thumbnailDirectory)
+    , m_tcpSocket(nullptr)
+    , m_localSocket(nullptr)
+    , m_device(nullptr)
+    , m_reconnectTimer(nullptr)
+{
+    m_subscription.thumbnails = !m_thumbnailDirectory.isEmpty();
+
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &ResultViewer::connectToPublisher);
+}
+
+bool ResultViewer::start()
+{
+    if (m_endpoint.startsWith("local:")) {
+        m_localName = m_endpoint.mid(6);
+        if (m_localName.isEmpty()) {
+            return false;
+        }
+        m_localSocket = new QLocalSocket(this);
+        connect(m_localSocket, &QLocalSocket::connected, this, &ResultViewer::onConnected);
+        connect(m_localSocket, &QLocalSocket::readyRead, this, &ResultViewer::onReadyRead);
+        connect(m_localSocket, &QLocalSocket::disconnected, this, &ResultViewer::onDisconnected);
+        m_device = m_localSocket;
+    } else {
+        if (!ShardProtocol::parseEndpoint(m_endpoint, m_host, m_port, ResultProtocol::DEFAULT_PORT)) {
+            return false;
+        }
+        m_tcpSocket = new QTcpSocket(this);
+        connect(m_tcpSocket, &QTcpSocket::connected, this, &ResultViewer::onConnected);
+        connect(m_tcpSocket, &QTcpSocket::readyRead, this, &ResultViewer::onReadyRead);
+        connect(m_tcpSocket, &QTcpSocket::disconnected, this, &ResultViewer::onDisconnected);
+        m_device = m_tcpSocket;
+    }
+
+    if (!m_thumbnailDirectory.isEmpty() && !QDir().mkpath(m_thumbnailDirectory)) {
+        qWarning() << "Cannot create thumbnail directory" << m_thumbnailDirectory;
+    }
+    qInfo() << "Result viewer connecting to" << m_endpoint;
+    connectToPublisher();
+    return true;
+}
+
+void ResultViewer::connectToPublisher()
+{
+    // Как в ShardWorker: таймер останавливается только при подключении
+    m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+    if (m_tcpSocket && m_tcpSocket->state() == QAbstractSocket::UnconnectedState) {
+        m_reader = ResultProtocol::MessageReader();
+        m_tcpSocket->connectToHost(m_host, m_port);
+    } else if (m_localSocket && m_localSocket->state() == QLocalSocket::UnconnectedState) {
+        m_reader = ResultProtocol::MessageReader();
+        m_localSocket->connectToServer(m_localName);
+    }
+}
+
+void ResultViewer::onConnected()
+{
+    m_reconnectTimer->stop();
+    m_device->write(ResultProtocol::encodeHello());
+    m_device->write(ResultProtocol::encodeSubscribe(m_subscription));
+    qInfo() << "Connected to result publisher" << m_endpoint;
+}
+
+void ResultViewer::onDisconnected()
+{
+    m_cameras.clear();
+    m_decoder = ResultProtocol::UpdateDecoder();
+    qWarning() << "Lost result publisher connection; retrying";
+    m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+}
+
+void ResultViewer::onReadyRead()
+{
+    m_reader.append(m_device->readAll());
+
+    ResultProtocol::Message message;
+    while (m_reader.next(message)) {
+        handleMessage(message);
+    }
+
+    if (m_reader.hasError()) {
+        qWarning() << "Malformed data from result publisher, reconnecting";
+        if (m_tcpSocket) {
+            m_tcpSocket->abort();
+        } else {
+            m_localSocket->abort();
+        }
+        m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+    }
+}
+
+void ResultViewer::handleMessage(const ResultProtocol::Message& message)
+{
+    switch (message.type) {
+    case ResultProtocol::Hello:
+        if (message.version != ResultProtocol::VERSION) {
+            qWarning() << "Result publisher uses protocol version" << static_cast<int>(message.version);
+        }
+        break;
+    case ResultProtocol::Camera:
+        m_cameras.insert(message.cameraIndex, CameraInfo{ message.key, message.name });
+        break;
+    case ResultProtocol::CameraRemoved:
+        m_cameras.remove(message.cameraIndex);
+        m_decoder.removeCamera(message.cameraIndex);
+        break;
+    case ResultProtocol::Update: {
+        ImageQualityAnalyzer::QualityResult result;
+        // Разностное обновление без базы пропускается до ближайшего полного
+        if (!m_decoder.apply(message, result)) {
+            break;
+        }
+        CameraInfo camera = m_cameras.value(message.cameraIndex);
+        QString name = camera.name.isEmpty() ? camera.key : camera.name;
+        QString line = QString("%1\t%2\t%3\t%4\tnoise=%5 contrast=%6 sharpness=%7 overexposed=%8%")
+            .arg(QDateTime::currentDateTime().toString("HH:mm:ss"))
+            .arg(name)
+            .arg(result.isValid ? QString::number(result.overallScore, 'f', 1) : QString("-"))
+            .arg(result.status)
+            .arg(result.noiseScore, 0, 'f', 1)
+            .arg(result.contrastScore, 0, 'f', 1)
+            .arg(result.sharpnessScore, 0, 'f', 1)
+            .arg(result.overexposedPercent, 0, 'f', 1);
+        if (result.hasStreamStats) {
+            line += QString(" loss=%1%").arg(result.packetLossPercent, 0, 'f', 2);
+        }
+        if (result.isFrozen) {
+            line += QString(" frozen=%1").arg(result.frozenFrameCount);
+        }
+        std::cout << line.toStdString() << std::endl;
+        break;
+    }
+    case ResultProtocol::Thumbnail: {
+        if (m_thumbnailDirectory.isEmpty()) {
+            break;
+        }
+        QFile file(QDir(m_thumbnailDirectory).filePath(QString("camera%1.jpg").arg(message.cameraIndex)));
+        if (!file.open(QIODevice::WriteOnly) || file.write(message.thumbnail) != message.thumbnail.size()) {
+            qWarning() << "Failed to write thumbnail" << file.fileName() << ":" << file.errorString();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef RESULTVIEWER_H
+#define RESULTVIEWER_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QTimer>
+
+#include "resultprotocol.h"
+
+class QIODevice;
+class QLocalSocket;
+class QTcpSocket;
+
+/**
+ * @class ResultViewer
+ * @brief Лёгкий консольный просмотрщик результатов ResultPublisher
+ *
+ * Подключается к издателю, подписывается на камеры по шаблонам и
+ * печатает строку на каждое обновление. Миниатюры, если запрошены,
+ * сохраняются в каталог как camera<индекс>.jpg (файл перезаписывается).
+ * При потере соединения подключение повторяется, а состояние камер
+ * восстанавливается из полных обновлений новой подписки.
+ */
+class ResultViewer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param endpoint host[:port] или local:имя локального сокета
+     * @param thumbnailDirectory Каталог миниатюр; пусто - миниатюры не запрашиваются
+     */
+    ResultViewer(const QString& endpoint, const ResultProtocol::Subscription& subscription,
+                 const QString& thumbnailDirectory, QObject *parent = nullptr);
+
+    /**
+     * @return false, если адрес издателя некорректен
+     */
+    bool start();
+
+private slots:
+    void connectToPublisher();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    struct CameraInfo {
+        QString key;
+        QString name;
+    };
+
+    void handleMessage(const ResultProtocol::Message& message);
+
+    QString m_endpoint;
+    QString m_host;
+    quint16 m_port;
+    QString m_localName;
+    ResultProtocol::Subscription m_subscription;
+    QString m_thumbnailDirectory;
+    QTcpSocket* m_tcpSocket;
+    QLocalSocket* m_localSocket;
+    QIODevice* m_device;
+    QTimer* m_reconnectTimer;
+    ResultProtocol::MessageReader m_reader;
+    ResultProtocol::UpdateDecoder m_decoder;
+    QHash<quint32, CameraInfo> m_cameras;
+
+    const int RECONNECT_INTERVAL_MS = 2000;
+};
+
+#endif // RESULTVIEWER_H
@@ -0,0 +1,892 @@
+#include "rtspsession.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QList>
+#include <QRandomGenerator>
+#include <cmath>
+#include <cstring>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace {
+
+const char START_CODE[] = { 0, 0, 0, 1 };
+
+QByteArray md5Hex(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+}
+
+// Значение параметра вызова авторизации: realm="...", nonce="..."
+QByteArray challengeParameter(const QByteArray& challenge, const QByteArray& name)
+{
+    int position = challenge.indexOf(name + "=");
+    while (position > 0 && challenge[position - 1] != ' ' && challenge[position - 1] != ',') {
+        position = challenge.indexOf(name + "=", position + 1);
+    }
+    if (position < 0) {
+        return QByteArray();
+    }
+    position += name.size() + 1;
+    if (position < challenge.size() && challenge[position] == '"') {
+        int end = challenge.indexOf('"', position + 1);
+        return challenge.mid(position + 1, end < 0 ? -1 : end - position - 1);
+    }
+    int end = challenge.indexOf(',', position);
+    return challenge.mid(position, end < 0 ? -1 : end - position).trimmed();
+}
+
+// Наборы параметров из SDP (base64 через запятую) в Annex-B
+void appendParameterSets(QByteArray& extradata, const QByteArray& value)
+{
+    for (const QByteArray& item : value.split(',')) {
+        QByteArray nal = QByteArray::fromBase64(item.trimmed());
+        if (!nal.isEmpty()) {
+            extradata.append(START_CODE, sizeof(START_CODE));
+            extradata.append(nal);
+        }
+    }
+}
+
+// SEI H.264 с сообщением recovery point (payloadType 6): декодирование можно
+// начать с этого кадра. Байты предотвращения эмуляции не убираются - они
+// встречаются только в теле сообщений, а recovery point обычно идёт первым
+bool hasRecoveryPoint(const uchar* data, int size)
+{
+    int position = 1;
+    while (position < size && data[position] != 0x80) {
+        int payloadType = 0;
+        while (position < size && data[position] == 0xFF) {
+            payloadType += 255;
+            ++position;
+        }
+        if (position >= size) {
+            return false;
+        }
+        payloadType += data[position++];
+
+        int payloadSize = 0;
+        while (position < size && data[position] == 0xFF) {
+            payloadSize += 255;
+            ++position;
+        }
+        if (position >= size) {
+            return false;
+        }
+        payloadSize += data[position++];
+
+        if (payloadType == 6) {
+            return true;
+        }
+        position += payloadSize;
+    }
+    return false;
+}
+
+void appendUint32(QByteArray& buffer, quint32 value)
+{
+    buffer.append(static_cast<char>(value >> 24));
+    buffer.append(static_cast<char>(value >> 16));
+    buffer.append(static_cast<char>(value >> 8));
+    buffer.append(static_cast<char>(value));
+}
+
+quint32 readUint32(const uchar* data)
+{
+    return (static_cast<quint32>(data[0]) << 24) | (static_cast<quint32>(data[1]) << 16)
+        | (static_cast<quint32>(data[2]) << 8) | data[3];
+}
+
+} // namespace
+
+RtspSession::RtspSession(const QUrl& url, const sockaddr_storage& address, socklen_t addressLength,
+                         std::shared_ptr<IngestStream> stream, int timeoutMs)
+    : m_url(url)
+    , m_requestUrl(url.toString(QUrl::RemoveUserInfo))
+    , m_displayUrl(url.toString(QUrl::RemovePassword))
+    , m_address(address)
+    , m_addressLength(addressLength)
+    , m_stream(std::move(stream))
+    , TIMEOUT_MS(timeoutMs)
+    , m_socket(-1)
+    , m_state(State::Connecting)
+    , m_cseq(0)
+    , m_sessionTimeoutSec(DEFAULT_SESSION_TIMEOUT_SEC)
+    , m_useGetParameter(false)
+    , m_authRetried(false)
+    , m_digestAuth(false)
+    , m_payloadType(-1)
+    , m_clockRate(90000)
+    , m_codec(Codec::H264)
+    , m_deadlineMs(-1)
+    , m_keepaliveMs(-1)
+    , m_reportMs(-1)
+    , m_localSsrc(QRandomGenerator::global()->generate())
+    , m_remoteSsrc(0)
+    , m_baseSequence(0)
+    , m_sequenceCycles(0)
+    , m_packetsReceived(0)
+    , m_expectedPrior(0)
+    , m_receivedPrior(0)
+    , m_jitter(0.0)
+    , m_haveTransit(false)
+    , m_lastTransit(0)
+    , m_lastSenderReport(0)
+    , m_lastSenderReportMs(-1)
+    , m_haveSequence(false)
+    , m_lastSequence(0)
+    , m_haveTimestamp(false)
+    , m_lastRtpTimestamp(0)
+    , m_extendedTimestamp(0)
+    , m_accessUnitKeyframe(false)
+    , m_fragmentActive(false)
+{
+}
+
+RtspSession::~RtspSession()
+{
+    if (m_socket >= 0) {
+        ::close(m_socket);
+    }
+}
+
+bool RtspSession::resolve(const QString& host, int port, sockaddr_storage& address,
+                          socklen_t& addressLength)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    QByteArray service = QByteArray::number(port);
+    if (getaddrinfo(host.toUtf8().constData(), service.constData(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+    addressLength = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+bool RtspSession::start(qint64 nowMs)
+{
+    m_deadlineMs = nowMs + TIMEOUT_MS;
+    m_socket = ::socket(m_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_socket < 0) {
+        failSession(QString("socket: %1").arg(std::strerror(errno)));
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    if (::connect(m_socket, reinterpret_cast<const sockaddr*>(&m_address), m_addressLength) < 0
+        && errno != EINPROGRESS) {
+        failSession(QString("connect: %1").arg(std::strerror(errno)));
+        return false;
+    }
+    // Завершение подключения придёт событием готовности к записи
+    return true;
+}
+
+int RtspSession::fd() const
+{
+    return m_socket;
+}
+
+bool RtspSession::wantsWrite() const
+{
+    return m_state == State::Connecting || !m_output.isEmpty();
+}
+
+bool RtspSession::finished() const
+{
+    return m_state == State::Failed;
+}
+
+qint64 RtspSession::nextTimerMs() const
+{
+    if (m_state == State::Failed) {
+        return -1;
+    }
+    if (m_state == State::Playing) {
+        return qMin(m_deadlineMs, qMin(m_keepaliveMs, m_reportMs));
+    }
+    return m_deadlineMs;
+}
+
+void RtspSession::onTimer(qint64 nowMs)
+{
+    if (nowMs >= m_deadlineMs) {
+        failSession(m_state == State::Playing ? "no data from camera" : "handshake timeout");
+        return;
+    }
+    if (m_state == State::Playing && nowMs >= m_keepaliveMs) {
+        sendRequest(m_useGetParameter ? "GET_PARAMETER" : "OPTIONS",
+                    m_sessionControl.isEmpty() ? m_contentBase : m_sessionControl);
+        m_keepaliveMs = nowMs + m_sessionTimeoutSec * 1000 / 2;
+    }
+    if (m_state == State::Playing && nowMs >= m_reportMs) {
+        sendReceiverReport(nowMs);
+        m_reportMs = nowMs + RTCP_REPORT_INTERVAL_MS;
+    }
+}
+
+void RtspSession::onWritable(qint64 nowMs)
+{
+    Q_UNUSED(nowMs);
+    if (m_state == State::Connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            failSession(QString("connect: %1").arg(std::strerror(error)));
+            return;
+        }
+        m_state = State::Options;
+        sendRequest("OPTIONS", m_requestUrl);
+        return;
+    }
+    flushOutput();
+}
+
+void RtspSession::onReadable(qint64 nowMs)
+{
+    if (m_state == State::Connecting) {
+        // Ошибка подключения приходит как EPOLLERR; разберёт onWritable
+        onWritable(nowMs);
+        return;
+    }
+
+    char buffer[64 * 1024];
+    int totalRead = 0;
+    while (totalRead < MAX_READ_PER_EVENT) {
+        ssize_t received = ::recv(m_socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            m_input.append(buffer, static_cast<int>(received));
+            totalRead += static_cast<int>(received);
+            continue;
+        }
+        if (received == 0) {
+            failSession("connection closed by camera");
+            return;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        if (errno != EINTR) {
+            failSession(QString("recv: %1").arg(std::strerror(errno)));
+            return;
+        }
+    }
+    processInput(nowMs);
+}
+
+void RtspSession::stop()
+{
+    // TEARDOWN без ожидания ответа: сокет закрывается сразу после отправки
+    if (m_socket >= 0 && !m_sessionId.isEmpty() && m_state != State::Failed) {
+        m_output.clear();
+        sendRequest("TEARDOWN", m_sessionControl.isEmpty() ? m_contentBase : m_sessionControl);
+    }
+    m_state = State::Failed;
+}
+
+void RtspSession::failSession(const QString& reason)
+{
+    if (m_state == State::Failed) {
+        return;
+    }
+    m_state = State::Failed;
+    qWarning() << "RTSP ingest:" << m_displayUrl << reason;
+    m_stream->fail(reason);
+}
+
+void RtspSession::sendRequest(const QByteArray& method, const QString& uri,
+                              const QByteArray& extraHeaders)
+{
+    m_pendingMethod = method;
+    m_pendingUri = uri;
+    m_pendingHeaders = extraHeaders;
+
+    QByteArray request = method + ' ' + uri.toUtf8() + " RTSP/1.0\r\n";
+    request += "CSeq: " + QByteArray::number(++m_cseq) + "\r\n";
+    request += "User-Agent: IPCameraQualityAnalyzer\r\n";
+    if (!m_sessionId.isEmpty()) {
+        request += "Session: " + m_sessionId + "\r\n";
+    }
+    QByteArray authorization = authorizationHeader(method, uri);
+    if (!authorization.isEmpty()) {
+        request += "Authorization: " + authorization + "\r\n";
+    }
+    request += extraHeaders;
+    request += "\r\n";
+
+    m_output += request;
+    flushOutput();
+}
+
+QByteArray RtspSession::authorizationHeader(const QByteArray& method, const QString& uri) const
+{
+    if (m_url.userName().isEmpty() || (m_realm.isEmpty() && !m_authRetried)) {
+        return QByteArray();
+    }
+    QByteArray user = m_url.userName().toUtf8();
+    QByteArray password = m_url.password().toUtf8();
+    if (!m_digestAuth) {
+        return "Basic " + (user + ':' + password).toBase64();
+    }
+
+    QByteArray ha1 = md5Hex(user + ':' + m_realm + ':' + password);
+    QByteArray ha2 = md5Hex(method + ':' + uri.toUtf8());
+    QByteArray header = "Digest username=\"" + user + "\", realm=\"" + m_realm
+        + "\", nonce=\"" + m_nonce + "\", uri=\"" + uri.toUtf8() + "\"";
+    if (m_qop.split(',').contains("auth")) {
+        const QByteArray nonceCount = "00000001";
+        QByteArray clientNonce = md5Hex(m_nonce + QByteArray::number(m_cseq)).left(16);
+        QByteArray response = md5Hex(ha1 + ':' + m_nonce + ':' + nonceCount + ':' + clientNonce
+                                     + ":auth:" + ha2);
+        header += ", qop=auth, nc=" + nonceCount + ", cnonce=\"" + clientNonce
+            + "\", response=\"" + response + "\"";
+    } else {
+        header += ", response=\"" + md5Hex(ha1 + ':' + m_nonce + ':' + ha2) + "\"";
+    }
+    return header;
+}
+
+void RtspSession::flushOutput()
+{
+    while (!m_output.isEmpty() && m_socket >= 0) {
+        ssize_t sent = ::send(m_socket, m_output.constData(), static_cast<size_t>(m_output.size()),
+                              MSG_NOSIGNAL);
+        if (sent > 0) {
+            m_output.remove(0, static_cast<int>(sent));
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        failSession(QString("send: %1").arg(std::strerror(errno)));
+        return;
+    }
+}
+
+void RtspSession::processInput(qint64 nowMs)
+{
+    // Кадры interleaved разбираются по смещению, буфер сдвигается один раз
+    int offset = 0;
+    bool receivedMedia = false;
+    while (offset < m_input.size() && m_state != State::Failed) {
+        const uchar* data = reinterpret_cast<const uchar*>(m_input.constData()) + offset;
+        int available = m_input.size() - offset;
+
+        if (data[0] == '$') {
+            if (available < 4) {
+                break;
+            }
+            int channel = data[1];
+            int length = (data[2] << 8) | data[3];
+            if (available < 4 + length) {
+                break;
+            }
+            if (channel == 0) {
+                handleRtp(data + 4, length, nowMs);
+                receivedMedia = true;
+            } else if (channel == 1) {
+                handleRtcp(data + 4, length, nowMs);
+            }
+            offset += 4 + length;
+            continue;
+        }
+
+        m_input.remove(0, offset);
+        offset = 0;
+        if (!parseResponse(nowMs)) {
+            break;
+        }
+    }
+    m_input.remove(0, offset);
+
+    if (receivedMedia && m_state == State::Playing) {
+        m_deadlineMs = nowMs + TIMEOUT_MS;
+    }
+}
+
+bool RtspSession::parseResponse(qint64 nowMs)
+{
+    int headerEnd = m_input.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (m_input.size() > MAX_HEADER_BYTES) {
+            failSession("malformed RTSP response");
+        }
+        return false;
+    }
+
+    QList<QByteArray> lines = m_input.left(headerEnd).split('\n');
+    QList<QByteArray> statusLine = lines.takeFirst().trimmed().split(' ');
+    if (statusLine.size() < 2 || !statusLine[0].startsWith("RTSP/")) {
+        failSession("malformed RTSP response");
+        return false;
+    }
+    int status = statusLine[1].toInt();
+
+    QMap<QByteArray, QByteArray> headers;
+    for (const QByteArray& line : lines) {
+        int colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        QByteArray name = line.left(colon).trimmed().toLower();
+        QByteArray value = line.mid(colon + 1).trimmed();
+        // Из нескольких вызовов авторизации предпочитается Digest
+        if (name == "www-authenticate" && headers.value(name).startsWith("Digest")) {
+            continue;
+        }
+        headers.insert(name, value);
+    }
+
+    int contentLength = headers.value("content-length").toInt();
+    int messageLength = headerEnd + 4 + contentLength;
+    if (m_input.size() < messageLength) {
+        return false;
+    }
+    QByteArray body = m_input.mid(headerEnd + 4, contentLength);
+    m_input.remove(0, messageLength);
+
+    handleResponse(status, headers, body, nowMs);
+    return true;
+}
+
+void RtspSession::handleResponse(int status, const QMap<QByteArray, QByteArray>& headers,
+                                 const QByteArray& body, qint64 nowMs)
+{
+    // Ответы на поддержание сессии не важны: часть камер отвечает 405 на GET_PARAMETER
+    if (m_state == State::Playing) {
+        return;
+    }
+
+    if (status == 401 && !m_authRetried && !m_url.userName().isEmpty()) {
+        QByteArray challenge = headers.value("www-authenticate");
+        m_digestAuth = challenge.startsWith("Digest");
+        m_realm = challengeParameter(challenge, "realm");
+        m_nonce = challengeParameter(challenge, "nonce");
+        m_qop = challengeParameter(challenge, "qop");
+        m_authRetried = true;
+        sendRequest(m_pendingMethod, m_pendingUri, m_pendingHeaders);
+        return;
+    }
+    if (status != 200) {
+        failSession(QString("%1 failed with status %2")
+                        .arg(QString::fromLatin1(m_pendingMethod)).arg(status));
+        return;
+    }
+    m_authRetried = false;
+
+    switch (m_state) {
+    case State::Options:
+        m_useGetParameter = headers.value("public").contains("GET_PARAMETER");
+        m_state = State::Describe;
+        sendRequest("DESCRIBE", m_requestUrl, "Accept: application/sdp\r\n");
+        break;
+
+    case State::Describe: {
+        QByteArray base = headers.value("content-base", headers.value("content-location"));
+        m_contentBase = base.isEmpty() ? m_requestUrl : QString::fromUtf8(base);
+        if (!parseSdp(body)) {
+            return;
+        }
+        m_state = State::Setup;
+        sendRequest("SETUP", resolveControl(m_mediaControl),
+                    "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+        break;
+    }
+
+    case State::Setup: {
+        // Session: <id>[;timeout=<секунды>]
+        QList<QByteArray> parts = headers.value("session").split(';');
+        m_sessionId = parts.takeFirst().trimmed();
+        for (const QByteArray& part : parts) {
+            QByteArray trimmed = part.trimmed();
+            if (trimmed.startsWith("timeout=")) {
+                int timeout = trimmed.mid(8).toInt();
+                if (timeout > 0) {
+                    m_sessionTimeoutSec = timeout;
+                }
+            }
+        }
+        m_state = State::Play;
+        sendRequest("PLAY", m_sessionControl.isEmpty() ? m_contentBase : m_sessionControl,
+                    "Range: npt=0.000-\r\n");
+        break;
+    }
+
+    case State::Play:
+        m_state = State::Playing;
+        m_keepaliveMs = nowMs + m_sessionTimeoutSec * 1000 / 2;
+        m_reportMs = nowMs + RTCP_REPORT_INTERVAL_MS;
+        qInfo() << "RTSP ingest: playing" << m_displayUrl
+                << (m_codec == Codec::H264 ? "H.264" : "H.265");
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool RtspSession::parseSdp(const QByteArray& sdp)
+{
+    bool inVideo = false;
+    bool videoFound = false;
+    QByteArray codecName;
+    QMap<QByteArray, QByteArray> format;
+
+    for (QByteArray line : sdp.split('\n')) {
+        line = line.trimmed();
+        if (line.startsWith("m=")) {
+            // Берётся первая видеодорожка: m=video 0 RTP/AVP 96
+            inVideo = !videoFound && line.startsWith("m=video");
+            if (inVideo) {
+                videoFound = true;
+                QList<QByteArray> fields = line.split(' ');
+                m_payloadType = fields.size() > 3 ? fields[3].toInt() : -1;
+            }
+            continue;
+        }
+        if (line.startsWith("a=control:")) {
+            QString control = QString::fromUtf8(line.mid(10).trimmed());
+            if (inVideo) {
+                m_mediaControl = control;
+            } else if (!videoFound) {
+                m_sessionControl = control == "*" ? QString() : resolveControl(control);
+            }
+            continue;
+        }
+        if (!inVideo) {
+            continue;
+        }
+        QByteArray prefix = "a=rtpmap:" + QByteArray::number(m_payloadType) + ' ';
+        if (line.startsWith(prefix)) {
+            // H264/90000
+            QList<QByteArray> encoding = line.mid(prefix.size()).split('/');
+            codecName = encoding.value(0).toUpper();
+            if (encoding.size() > 1 && encoding[1].toInt() > 0) {
+                m_clockRate = encoding[1].toInt();
+            }
+            continue;
+        }
+        prefix = "a=fmtp:" + QByteArray::number(m_payloadType) + ' ';
+        if (line.startsWith(prefix)) {
+            for (const QByteArray& parameter : line.mid(prefix.size()).split(';')) {
+                int separator = parameter.indexOf('=');
+                if (separator > 0) {
+                    format.insert(parameter.left(separator).trimmed().toLower(),
+                                  parameter.mid(separator + 1).trimmed());
+                }
+            }
+        }
+    }
+
+    if (!videoFound) {
+        failSession("no video track in SDP");
+        return false;
+    }
+
+    QByteArray extradata;
+    if (codecName == "H264") {
+        m_codec = Codec::H264;
+        appendParameterSets(extradata, format.value("sprop-parameter-sets"));
+        m_stream->setCodec(AV_CODEC_ID_H264, extradata);
+    } else if (codecName == "H265" || codecName == "HEVC") {
+        m_codec = Codec::H265;
+        appendParameterSets(extradata, format.value("sprop-vps"));
+        appendParameterSets(extradata, format.value("sprop-sps"));
+        appendParameterSets(extradata, format.value("sprop-pps"));
+        m_stream->setCodec(AV_CODEC_ID_HEVC, extradata);
+    } else {
+        failSession(QString("unsupported video codec %1").arg(QString::fromLatin1(codecName)));
+        return false;
+    }
+    return true;
+}
+
+QString RtspSession::resolveControl(const QString& control) const
+{
+    if (control.isEmpty() || control == "*") {
+        return m_contentBase;
+    }
+    if (control.contains("://")) {
+        return control;
+    }
+    return m_contentBase.endsWith('/') ? m_contentBase + control : m_contentBase + '/' + control;
+}
+
+void RtspSession::handleRtp(const uchar* data, int size, qint64 nowMs)
+{
+    // Заголовок RTP (RFC 3550): V=2, P, X, CC, M, PT, номер, метка времени, SSRC
+    if (size < 12 || (data[0] >> 6) != 2 || (data[1] & 0x7F) != m_payloadType) {
+        return;
+    }
+    bool padding = data[0] & 0x20;
+    bool extension = data[0] & 0x10;
+    bool marker = data[1] & 0x80;
+    quint16 sequence = static_cast<quint16>((data[2] << 8) | data[3]);
+    quint32 timestamp = readUint32(data + 4);
+
+    int offset = 12 + 4 * (data[0] & 0x0F);
+    if (extension) {
+        if (size < offset + 4) {
+            return;
+        }
+        offset += 4 + 4 * ((data[offset + 2] << 8) | data[offset + 3]);
+    }
+    int end = padding ? size - data[size - 1] : size;
+    if (offset >= end) {
+        return;
+    }
+
+    if (m_haveSequence) {
+        quint16 gap = static_cast<quint16>(sequence - static_cast<quint16>(m_lastSequence + 1));
+        if (gap >= 0x8000) {
+            return;     // Повтор или опоздавший пакет
+        }
+        if (gap != 0) {
+            m_stream->addPacketsLost(gap);
+            // Без середины фрагмента NAL не собрать
+            m_fragmentActive = false;
+        }
+        if (sequence < m_lastSequence) {
+            m_sequenceCycles += 0x10000;
+        }
+    } else {
+        m_baseSequence = sequence;
+    }
+    m_haveSequence = true;
+    m_lastSequence = sequence;
+    m_remoteSsrc = readUint32(data + 8);
+    m_packetsReceived++;
+
+    // Джиттер (RFC 3550, 6.4.1). Время прихода - момент чтения из сокета,
+    // общий для всей прочитанной пачки, поэтому оценка сверху
+    quint32 arrival = static_cast<quint32>(nowMs * m_clockRate / 1000);
+    qint32 transit = static_cast<qint32>(arrival - timestamp);
+    if (m_haveTransit) {
+        double delta = std::abs(static_cast<double>(transit) - m_lastTransit);
+        m_jitter += (delta - m_jitter) / 16.0;
+    }
+    m_haveTransit = true;
+    m_lastTransit = transit;
+
+    if (!m_haveTimestamp) {
+        m_haveTimestamp = true;
+        m_lastRtpTimestamp = timestamp;
+    } else if (timestamp != m_lastRtpTimestamp) {
+        // Новая метка времени - начался следующий кадр, даже если marker потерян
+        flushAccessUnit();
+        m_extendedTimestamp += static_cast<qint32>(timestamp - m_lastRtpTimestamp);
+        m_lastRtpTimestamp = timestamp;
+    }
+
+    if (m_codec == Codec::H264) {
+        depacketizeH264(data + offset, end - offset);
+    } else {
+        depacketizeH265(data + offset, end - offset);
+    }
+    if (marker) {
+        flushAccessUnit();
+    }
+}
+
+void RtspSession::handleRtcp(const uchar* data, int size, qint64 nowMs)
+{
+    // Составной пакет RTCP: нужен только отчёт отправителя (SR, тип 200) -
+    // его метка NTP возвращается в отчёте получателя для расчёта задержки
+    int position = 0;
+    while (position + 4 <= size) {
+        const uchar* packet = data + position;
+        int length = (((packet[2] << 8) | packet[3]) + 1) * 4;
+        if ((packet[0] >> 6) != 2 || position + length > size) {
+            return;
+        }
+        if (packet[1] == 200 && length >= 28) {
+            quint32 ntpSeconds = readUint32(packet + 8);
+            quint32 ntpFraction = readUint32(packet + 12);
+            m_lastSenderReport = (ntpSeconds << 16) | (ntpFraction >> 16);
+            m_lastSenderReportMs = nowMs;
+        }
+        position += length;
+    }
+}
+
+void RtspSession::sendReceiverReport(qint64 nowMs)
+{
+    // RR с одним блоком отчёта (пустой, пока нет RTP) и обязательный SDES CNAME
+    QByteArray report;
+    report.append(static_cast<char>(m_haveSequence ? 0x81 : 0x80));
+    report.append(static_cast<char>(201));
+    report.append('\0');
+    report.append(static_cast<char>(m_haveSequence ? 7 : 1));
+    appendUint32(report, m_localSsrc);
+    if (m_haveSequence) {
+        quint32 extendedMax = m_sequenceCycles + m_lastSequence;
+        quint64 expected = static_cast<quint64>(extendedMax) - m_baseSequence + 1;
+        qint64 lost = qBound<qint64>(0, static_cast<qint64>(expected) - static_cast<qint64>(m_packetsReceived),
+                                     0x7FFFFF);
+        qint64 expectedInterval = static_cast<qint64>(expected - m_expectedPrior);
+        qint64 lostInterval = expectedInterval - static_cast<qint64>(m_packetsReceived - m_receivedPrior);
+        quint32 fraction = expectedInterval > 0 && lostInterval > 0
+            ? static_cast<quint32>((lostInterval << 8) / expectedInterval) : 0;
+        m_expectedPrior = expected;
+        m_receivedPrior = m_packetsReceived;
+
+        appendUint32(report, m_remoteSsrc);
+        appendUint32(report, (qMin<quint32>(fraction, 255) << 24) | static_cast<quint32>(lost));
+        appendUint32(report, extendedMax);
+        appendUint32(report, static_cast<quint32>(m_jitter));
+        if (m_lastSenderReportMs >= 0) {
+            appendUint32(report, m_lastSenderReport);
+            appendUint32(report, static_cast<quint32>((nowMs - m_lastSenderReportMs) * 65536 / 1000));
+        } else {
+            appendUint32(report, 0);
+            appendUint32(report, 0);
+        }
+    }
+
+    const QByteArray cname = "IPCameraQualityAnalyzer";
+    QByteArray sdes;
+    appendUint32(sdes, m_localSsrc);
+    sdes.append('\1');
+    sdes.append(static_cast<char>(cname.size()));
+    sdes.append(cname);
+    // Конец списка элементов и выравнивание на 32 бита
+    do {
+        sdes.append('\0');
+    } while (sdes.size() % 4 != 0);
+    report.append(static_cast<char>(0x81));
+    report.append(static_cast<char>(202));
+    report.append('\0');
+    report.append(static_cast<char>(sdes.size() / 4));
+    report.append(sdes);
+
+    // Кадр interleaved канала 1 (RTCP), см. Transport в SETUP
+    QByteArray frame;
+    frame.append('$');
+    frame.append('\1');
+    frame.append(static_cast<char>(report.size() >> 8));
+    frame.append(static_cast<char>(report.size()));
+    frame.append(report);
+    m_output += frame;
+    flushOutput();
+}
+
+void RtspSession::depacketizeH264(const uchar* data, int size)
+{
+    int type = data[0] & 0x1F;
+    if (type >= 1 && type <= 23) {
+        appendNal(data, size);
+    } else if (type == 24) {
+        // STAP-A: [размер 16 бит][NAL]...
+        int position = 1;
+        while (position + 2 <= size) {
+            int length = (data[position] << 8) | data[position + 1];
+            position += 2;
+            if (length == 0 || position + length > size) {
+                break;
+            }
+            appendNal(data + position, length);
+            position += length;
+        }
+    } else if (type == 28 && size > 2) {
+        // FU-A: индикатор, заголовок фрагмента (S, E, тип), данные
+        uchar header = data[1];
+        if (header & 0x80) {
+            m_fragment.clear();
+            m_fragment.append(static_cast<char>((data[0] & 0xE0) | (header & 0x1F)));
+            m_fragmentActive = true;
+        }
+        if (!m_fragmentActive) {
+            return;
+        }
+        m_fragment.append(reinterpret_cast<const char*>(data + 2), size - 2);
+        if (header & 0x40) {
+            appendNal(reinterpret_cast<const uchar*>(m_fragment.constData()), m_fragment.size());
+            m_fragmentActive = false;
+        }
+    }
+}
+
+void RtspSession::depacketizeH265(const uchar* data, int size)
+{
+    if (size < 2) {
+        return;
+    }
+    int type = (data[0] >> 1) & 0x3F;
+    if (type < 48) {
+        appendNal(data, size);
+    } else if (type == 48) {
+        // AP: [размер 16 бит][NAL]... (без DONL)
+        int position = 2;
+        while (position + 2 <= size) {
+            int length = (data[position] << 8) | data[position + 1];
+            position += 2;
+            if (length == 0 || position + length > size) {
+                break;
+            }
+            appendNal(data + position, length);
+            position += length;
+        }
+    } else if (type == 49 && size > 3) {
+        // FU: заголовок NAL (2 байта), заголовок фрагмента (S, E, тип), данные
+        uchar header = data[2];
+        if (header & 0x80) {
+            m_fragment.clear();
+            m_fragment.append(static_cast<char>((data[0] & 0x81) | ((header & 0x3F) << 1)));
+            m_fragment.append(static_cast<char>(data[1]));
+            m_fragmentActive = true;
+        }
+        if (!m_fragmentActive) {
+            return;
+        }
+        m_fragment.append(reinterpret_cast<const char*>(data + 3), size - 3);
+        if (header & 0x40) {
+            appendNal(reinterpret_cast<const uchar*>(m_fragment.constData()), m_fragment.size());
+            m_fragmentActive = false;
+        }
+    }
+}
+
+void RtspSession::appendNal(const uchar* data, int size)
+{
+    if (size <= 0) {
+        return;
+    }
+    if (m_codec == Codec::H264) {
+        int type = data[0] & 0x1F;
+        m_accessUnitKeyframe |= type == 5                              // IDR
+            || (type == 6 && hasRecoveryPoint(data, size));            // SEI recovery point
+    } else {
+        int type = (data[0] >> 1) & 0x3F;
+        m_accessUnitKeyframe |= type >= 16 && type <= 21;             // BLA, IDR, CRA
+    }
+    m_accessUnit.append(START_CODE, sizeof(START_CODE));
+    m_accessUnit.append(reinterpret_cast<const char*>(data), size);
+}
+
+void RtspSession::flushAccessUnit()
+{
+    if (!m_accessUnit.isEmpty()) {
+        qint64 timestampUs = m_extendedTimestamp * 1000000 / m_clockRate;
+        m_stream->pushPacket(m_accessUnit, timestampUs, m_accessUnitKeyframe);
+    }
+    m_accessUnit.clear();
+    m_accessUnitKeyframe = false;
+}
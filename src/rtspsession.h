@@ -0,0 +1,170 @@
+#ifndef RTSPSESSION_H
+#define RTSPSESSION_H
+
+#include "ingestreactor.h"
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QUrl>
+#include <memory>
+#include <sys/socket.h>
+
+/**
+ * @class RtspSession
+ * @brief Неблокирующий клиент RTSP с RTP поверх TCP (interleaved) для IngestReactor
+ *
+ * Состояния: подключение -> OPTIONS -> DESCRIBE -> SETUP -> PLAY -> приём.
+ * На 401 запрос повторяется с авторизацией Basic или Digest (по вызову
+ * сервера). Сессия поддерживается запросами GET_PARAMETER (или OPTIONS)
+ * с периодом в половину таймаута сессии сервера, а по каналу RTCP
+ * (interleaved 1) раз в несколько секунд уходит отчёт получателя: потери,
+ * джиттер и задержка относительно последнего отчёта отправителя.
+ *
+ * RTP-пакеты видеодорожки разбираются прямо из буфера приёма:
+ * - H.264 (RFC 6184): одиночные NAL, STAP-A, FU-A;
+ * - H.265 (RFC 7798): одиночные NAL, AP, FU.
+ * Блоки NAL одного кадра собираются в Annex-B и передаются в IngestStream
+ * по биту marker или смене метки времени. Разрывы номеров RTP считаются
+ * потерянными пакетами; фрагмент NAL с потерянной частью отбрасывается.
+ * Ключевым считается кадр с IDR (H.264) или IRAP (H.265), а для H.264 ещё
+ * и кадр с SEI recovery point - камеры с intra refresh не шлют IDR вовсе.
+ *
+ * Поддерживается только транспорт TCP interleaved: через NAT и межсетевые
+ * экраны он проходит надёжнее UDP и даёт один сокет на камеру.
+ */
+class RtspSession : public IngestSession
+{
+public:
+    /**
+     * @param url URL потока (учётные данные берутся из него)
+     * @param address Уже разрешённый адрес сервера (см. resolve())
+     * @param timeoutMs Таймаут подключения и отсутствия данных
+     */
+    RtspSession(const QUrl& url, const sockaddr_storage& address, socklen_t addressLength,
+                std::shared_ptr<IngestStream> stream, int timeoutMs);
+    ~RtspSession();
+
+    bool start(qint64 nowMs) override;
+    int fd() const override;
+    bool wantsWrite() const override;
+    void onReadable(qint64 nowMs) override;
+    void onWritable(qint64 nowMs) override;
+    void onTimer(qint64 nowMs) override;
+    qint64 nextTimerMs() const override;
+    bool finished() const override;
+    void stop() override;
+
+    /**
+     * @brief Разрешает имя хоста (блокирующе; вызывается в потоке камеры)
+     */
+    static bool resolve(const QString& host, int port, sockaddr_storage& address,
+                        socklen_t& addressLength);
+
+private:
+    enum class State {
+        Connecting,
+        Options,
+        Describe,
+        Setup,
+        Play,
+        Playing,
+        Failed
+    };
+
+    enum class Codec {
+        H264,
+        H265
+    };
+
+    void sendRequest(const QByteArray& method, const QString& uri,
+                     const QByteArray& extraHeaders = QByteArray());
+    QByteArray authorizationHeader(const QByteArray& method, const QString& uri) const;
+    void flushOutput();
+    void processInput(qint64 nowMs);
+    bool parseResponse(qint64 nowMs);
+    void handleResponse(int status, const QMap<QByteArray, QByteArray>& headers,
+                        const QByteArray& body, qint64 nowMs);
+    bool parseSdp(const QByteArray& sdp);
+    QString resolveControl(const QString& control) const;
+    void failSession(const QString& reason);
+
+    void handleRtp(const uchar* data, int size, qint64 nowMs);
+    void handleRtcp(const uchar* data, int size, qint64 nowMs);
+    void sendReceiverReport(qint64 nowMs);
+    void depacketizeH264(const uchar* data, int size);
+    void depacketizeH265(const uchar* data, int size);
+    void appendNal(const uchar* data, int size);
+    void flushAccessUnit();
+
+    QUrl m_url;
+    QString m_requestUrl;           // URL без учётных данных
+    QString m_displayUrl;           // Для журнала
+    sockaddr_storage m_address;
+    socklen_t m_addressLength;
+    std::shared_ptr<IngestStream> m_stream;
+    const int TIMEOUT_MS;
+
+    int m_socket;
+    State m_state;
+    QByteArray m_output;
+    QByteArray m_input;
+
+    // Запросы
+    int m_cseq;
+    QByteArray m_pendingMethod;
+    QString m_pendingUri;
+    QByteArray m_pendingHeaders;
+    QByteArray m_sessionId;
+    int m_sessionTimeoutSec;
+    bool m_useGetParameter;
+    bool m_authRetried;
+    bool m_digestAuth;
+    QByteArray m_realm;
+    QByteArray m_nonce;
+    QByteArray m_qop;
+
+    // Описание потока
+    QString m_contentBase;
+    QString m_sessionControl;
+    QString m_mediaControl;
+    int m_payloadType;
+    int m_clockRate;
+    Codec m_codec;
+
+    // Таймеры (монотонные мс)
+    qint64 m_deadlineMs;            // Рукопожатие не завершено или данных нет - ошибка
+    qint64 m_keepaliveMs;
+    qint64 m_reportMs;              // Следующий отчёт получателя RTCP
+
+    // Статистика приёма для отчётов RTCP (RFC 3550, 6.4.1 и приложение A)
+    quint32 m_localSsrc;
+    quint32 m_remoteSsrc;
+    quint16 m_baseSequence;
+    quint32 m_sequenceCycles;       // Число переполнений номера, сдвинутое на 16 бит
+    quint64 m_packetsReceived;
+    quint64 m_expectedPrior;        // Ожидалось и принято к прошлому отчёту
+    quint64 m_receivedPrior;
+    double m_jitter;                // В единицах частоты RTP
+    bool m_haveTransit;
+    qint32 m_lastTransit;
+    quint32 m_lastSenderReport;     // Средние 32 бита NTP последнего SR
+    qint64 m_lastSenderReportMs;    // Время его приёма; -1 - SR ещё не было
+
+    // Сборка кадров
+    bool m_haveSequence;
+    quint16 m_lastSequence;
+    bool m_haveTimestamp;
+    quint32 m_lastRtpTimestamp;
+    qint64 m_extendedTimestamp;     // Без переполнения 32 бит
+    QByteArray m_accessUnit;
+    bool m_accessUnitKeyframe;
+    QByteArray m_fragment;
+    bool m_fragmentActive;
+
+    static constexpr int MAX_HEADER_BYTES = 64 * 1024;
+    static constexpr int MAX_READ_PER_EVENT = 1024 * 1024;   // Затем очередь других сессий
+    static constexpr int DEFAULT_SESSION_TIMEOUT_SEC = 60;
+    static constexpr int RTCP_REPORT_INTERVAL_MS = 5000;
+};
+
+#endif // RTSPSESSION_H
@@ -0,0 +1,90 @@
+#ifndef SEQLOCKVALUE_H
+#define SEQLOCKVALUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @class SeqlockValue
+ * @brief Значение с одним писателем и любым числом читателей без блокировок
+ *
+ * Писатель никогда не ждёт читателей (wait-free): он делает счётчик
+ * последовательности нечётным, записывает значение и снова делает его
+ * чётным. Читатель копирует значение и повторяет чтение, если запись
+ * пересеклась с копированием, поэтому чтение только lock-free: при
+ * непрерывной записи читатель может повторять копирование сколько угодно
+ * раз (при записи несколько раз в секунду на практике повторов нет).
+ *
+ * Значение хранится словами std::atomic<uint64_t>, поэтому одновременные
+ * чтение и запись не являются гонкой данных. T должен быть тривиально копируемым.
+ */
+template <typename T>
+class SeqlockValue
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqlockValue requires a trivially copyable type");
+
+public:
+    SeqlockValue()
+        : m_sequence(0)
+    {
+        store(T());
+    }
+
+    /**
+     * @brief Публикует новое значение (только один поток-писатель)
+     */
+    void store(const T& value)
+    {
+        uint64_t words[WORD_COUNT] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORD_COUNT; ++i) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Согласованная копия последнего опубликованного значения
+     */
+    T load() const
+    {
+        uint64_t words[WORD_COUNT];
+        uint64_t before;
+        uint64_t after;
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORD_COUNT; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Номер публикации; растёт на 1 при каждом store()
+     */
+    uint64_t version() const
+    {
+        return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> m_sequence;
+    std::atomic<uint64_t> m_words[WORD_COUNT];
+};
+
+#endif // SEQLOCKVALUE_H
@@ -0,0 +1,212 @@
+#include "shardcoordinator.h"
+#include <QDebug>
+
+ShardCoordinator::ShardCoordinator(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+    , m_heartbeatTimer(nullptr)
+{
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &ShardCoordinator::onNewConnection);
+
+    m_heartbeatTimer = new QTimer(this);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &ShardCoordinator::checkHeartbeats);
+    m_heartbeatTimer->start(ShardProtocol::HEARTBEAT_INTERVAL_MS);
+
+    m_clock.start();
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+}
+
+bool ShardCoordinator::listen(const QHostAddress& address, quint16 port)
+{
+    if (!m_server->listen(address, port)) {
+        qWarning() << "Coordinator cannot listen on" << address.toString() << port
+                   << m_server->errorString();
+        return false;
+    }
+    qInfo() << "Coordinator listening on" << address.toString() << m_server->serverPort();
+    return true;
+}
+
+quint16 ShardCoordinator::serverPort() const
+{
+    return m_server->serverPort();
+}
+
+void ShardCoordinator::addCamera(const QString& url)
+{
+    if (m_cameras.contains(url)) {
+        return;
+    }
+    m_cameras.append(url);
+    rebalance();
+}
+
+void ShardCoordinator::removeCamera(const QString& url)
+{
+    if (m_cameras.removeOne(url)) {
+        rebalance();
+    }
+}
+
+QStringList ShardCoordinator::workers() const
+{
+    return m_ring.nodes();
+}
+
+QString ShardCoordinator::workerFor(const QString& url) const
+{
+    return m_assignment.value(url);
+}
+
+void ShardCoordinator::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        WorkerConnection connection;
+        connection.lastSeenMs = m_clock.elapsed();
+        m_connections.insert(socket, connection);
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            auto it = m_connections.find(socket);
+            if (it == m_connections.end()) {
+                return;
+            }
+            it->reader.append(socket->readAll());
+            it->lastSeenMs = m_clock.elapsed();
+
+            ShardProtocol::Message message;
+            while (m_connections.contains(socket) && m_connections[socket].reader.next(message)) {
+                handleMessage(socket, message);
+            }
+            if (m_connections.contains(socket) && m_connections[socket].reader.hasError()) {
+                qWarning() << "Malformed data from worker" << m_connections[socket].name;
+                dropWorker(socket);
+            }
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            dropWorker(socket);
+        });
+    }
+}
+
+void ShardCoordinator::handleMessage(QTcpSocket* socket, const ShardProtocol::Message& message)
+{
+    WorkerConnection& connection = m_connections[socket];
+
+    switch (message.type) {
+    case ShardProtocol::Hello: {
+        if (!connection.name.isEmpty()) {
+            break;
+        }
+        // Обработчик другой версии разобрал бы результаты и назначения неверно
+        if (message.protocolVersion != ShardProtocol::PROTOCOL_VERSION) {
+            qWarning() << "Rejecting worker" << message.workerName << "with protocol version"
+                       << message.protocolVersion << "expected" << ShardProtocol::PROTOCOL_VERSION;
+            dropWorker(socket);
+            return;
+        }
+        // Имена обработчиков должны быть уникальны: они определяют точки на кольце
+        QString name = message.workerName.isEmpty() ? QString("worker") : message.workerName;
+        if (m_ring.nodes().contains(name)) {
+            name += QString("@%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        }
+        connection.name = name;
+        m_ring.addNode(name);
+        qInfo() << "Worker joined:" << name;
+        emit workerJoined(name);
+        rebalance();
+        break;
+    }
+    case ShardProtocol::Result:
+        // Результаты по камере, уже переданной другому обработчику, отбрасываются
+        if (!connection.name.isEmpty() && m_assignment.value(message.url) == connection.name) {
+            emit resultReceived(message.url, message.result);
+        }
+        break;
+    case ShardProtocol::Heartbeat:
+        // Время последнего сообщения уже обновлено в readyRead
+        break;
+    default:
+        break;
+    }
+}
+
+void ShardCoordinator::dropWorker(QTcpSocket* socket)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        return;
+    }
+
+    QString name = it->name;
+    m_connections.erase(it);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+
+    if (!name.isEmpty()) {
+        m_ring.removeNode(name);
+        qWarning() << "Worker left:" << name << "- rebalancing its cameras";
+        emit workerLeft(name);
+        rebalance();
+    }
+}
+
+void ShardCoordinator::checkHeartbeats()
+{
+    qint64 now = m_clock.elapsed();
+    QList<QTcpSocket*> expired;
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it) {
+        if (now - it->lastSeenMs > ShardProtocol::HEARTBEAT_TIMEOUT_MS) {
+            expired.append(it.key());
+        } else if (!it->name.isEmpty()) {
+            it.key()->write(ShardProtocol::encodeHeartbeat());
+        }
+    }
+    for (QTcpSocket* socket : expired) {
+        dropWorker(socket);
+    }
+}
+
+void ShardCoordinator::rebalance()
+{
+    QMap<QString, QStringList> plan;
+    for (const QString& url : m_cameras) {
+        QString worker = m_ring.nodeFor(url);
+        if (!worker.isEmpty()) {
+            plan[worker].append(url);
+        }
+    }
+
+    // Список отправляется обработчикам, у которых он изменился, и всегда -
+    // только что приславшим Hello: переподключившийся обработчик мог
+    // сохранить камеры прежнего подключения, и пустой план их останавливает
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it) {
+        if (it->name.isEmpty()) {
+            continue;
+        }
+        QStringList assigned = plan.value(it->name);
+        if (!it->assignmentSent || assigned != it->assigned) {
+            it->assigned = assigned;
+            it->assignmentSent = true;
+            it.key()->write(ShardProtocol::encodeAssign(assigned));
+        }
+    }
+
+    QMap<QString, QString> previous = m_assignment;
+    m_assignment.clear();
+    for (auto it = plan.begin(); it != plan.end(); ++it) {
+        for (const QString& url : it.value()) {
+            m_assignment[url] = it.key();
+        }
+    }
+
+    for (const QString& url : m_cameras) {
+        if (previous.value(url) != m_assignment.value(url)) {
+            emit assignmentChanged(url, m_assignment.value(url));
+        }
+    }
+}
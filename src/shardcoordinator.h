@@ -0,0 +1,87 @@
+#ifndef SHARDCOORDINATOR_H
+#define SHARDCOORDINATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "consistenthashring.h"
+#include "shardprotocol.h"
+#include "imagequalityanalyzer.h"
+
+/**
+ * @class ShardCoordinator
+ * @brief Координатор распределения камер между процессами-обработчиками
+ *
+ * Принимает подключения ShardWorker, распределяет URL камер между ними
+ * согласованным хэшированием и пересылает их результаты анализа в один
+ * поток сигналов resultReceived(). Обработчик считается выбывшим при
+ * закрытии соединения (падение процесса) или отсутствии heartbeat
+ * дольше HEARTBEAT_TIMEOUT_MS (зависание, потеря сети); его камеры
+ * переходят к оставшимся обработчикам. Координатор сам шлёт heartbeat,
+ * чтобы обработчики так же замечали его потерю и останавливали камеры.
+ */
+class ShardCoordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ShardCoordinator(QObject *parent = nullptr);
+    ~ShardCoordinator();
+
+    bool listen(const QHostAddress& address, quint16 port);
+
+    /**
+     * @brief Фактический порт (после listen() с портом 0)
+     */
+    quint16 serverPort() const;
+
+    void addCamera(const QString& url);
+    void removeCamera(const QString& url);
+
+    QStringList workers() const;
+
+    /**
+     * @brief Имя обработчика, которому назначена камера (пусто - не назначена)
+     */
+    QString workerFor(const QString& url) const;
+
+signals:
+    void resultReceived(const QString& url, const ImageQualityAnalyzer::QualityResult& result);
+    void assignmentChanged(const QString& url, const QString& workerName);
+    void workerJoined(const QString& workerName);
+    void workerLeft(const QString& workerName);
+
+private slots:
+    void onNewConnection();
+    void checkHeartbeats();
+
+private:
+    struct WorkerConnection {
+        QString name;                        // Пусто до получения Hello
+        ShardProtocol::MessageReader reader;
+        qint64 lastSeenMs;
+        QStringList assigned;
+        bool assignmentSent = false;         // Первый Assign после Hello отправляется всегда
+    };
+
+    void handleMessage(QTcpSocket* socket, const ShardProtocol::Message& message);
+    void dropWorker(QTcpSocket* socket);
+    void rebalance();
+
+    QTcpServer* m_server;
+    QTimer* m_heartbeatTimer;
+    QElapsedTimer m_clock;
+    QMap<QTcpSocket*, WorkerConnection> m_connections;
+    ConsistentHashRing m_ring;
+    QStringList m_cameras;
+    QMap<QString, QString> m_assignment;     // URL -> имя обработчика
+};
+
+#endif // SHARDCOORDINATOR_H
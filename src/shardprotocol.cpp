@@ -0,0 +1,167 @@
+#include "shardprotocol.h"
+#include <QIODevice>
+#include <QtEndian>
+
+namespace ShardProtocol {
+
+namespace {
+
+const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_12;
+
+QByteArray frameMessage(MessageType type, const QByteArray& body)
+{
+    QByteArray message;
+    message.reserve(5 + body.size());
+    quint32 length = static_cast<quint32>(1 + body.size());
+    uchar header[4];
+    qToBigEndian(length, header);
+    message.append(reinterpret_cast<const char*>(header), 4);
+    message.append(static_cast<char>(type));
+    message.append(body);
+    return message;
+}
+
+} // namespace
+
+QByteArray encodeHello(const QString& workerName, quint32 protocolVersion)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(STREAM_VERSION);
+    stream << protocolVersion << workerName;
+    return frameMessage(Hello, body);
+}
+
+QByteArray encodeAssign(const QStringList& urls)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(STREAM_VERSION);
+    stream << urls;
+    return frameMessage(Assign, body);
+}
+
+QByteArray encodeResult(const QString& url, const ImageQualityAnalyzer::QualityResult& result)
+{
+    QByteArray body;
+    QDataStream stream(&body, QIODevice::WriteOnly);
+    stream.setVersion(STREAM_VERSION);
+    stream << url << result;
+    return frameMessage(Result, body);
+}
+
+QByteArray encodeHeartbeat()
+{
+    return frameMessage(Heartbeat, QByteArray());
+}
+
+void MessageReader::append(const QByteArray& data)
+{
+    m_buffer.append(data);
+}
+
+bool MessageReader::next(Message& message)
+{
+    if (m_error || m_buffer.size() < 4) {
+        return false;
+    }
+
+    quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(m_buffer.constData()));
+    if (length == 0 || length > MAX_MESSAGE_SIZE) {
+        m_error = true;
+        return false;
+    }
+    if (static_cast<quint32>(m_buffer.size()) < 4 + length) {
+        return false;
+    }
+
+    QByteArray body = m_buffer.mid(5, static_cast<int>(length) - 1);
+    message = Message();
+    message.type = static_cast<MessageType>(static_cast<quint8>(m_buffer.at(4)));
+    m_buffer.remove(0, static_cast<int>(4 + length));
+
+    QDataStream stream(body);
+    stream.setVersion(STREAM_VERSION);
+    switch (message.type) {
+    case Hello:
+        stream >> message.protocolVersion >> message.workerName;
+        break;
+    case Assign:
+        stream >> message.urls;
+        break;
+    case Result:
+        stream >> message.url >> message.result;
+        break;
+    case Heartbeat:
+        break;
+    default:
+        m_error = true;
+        return false;
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        m_error = true;
+        return false;
+    }
+    return true;
+}
+
+bool MessageReader::hasError() const
+{
+    return m_error;
+}
+
+bool parseEndpoint(const QString& text, QString& host, quint16& port, quint16 defaultPort)
+{
+    int separator = text.lastIndexOf(':');
+    if (separator <= 0) {
+        host = text;
+        port = defaultPort;
+        return !host.isEmpty();
+    }
+
+    bool ok = false;
+    int value = text.mid(separator + 1).toInt(&ok);
+    if (!ok || value <= 0 || value > 65535) {
+        return false;
+    }
+    host = text.left(separator);
+    port = static_cast<quint16>(value);
+    return true;
+}
+
+} // namespace ShardProtocol
+
+QDataStream& operator<<(QDataStream& stream, const ImageQualityAnalyzer::QualityResult& result)
+{
+    stream << result.noiseScore << result.contrastScore << result.sharpnessScore
+           << result.overexposedPercent << result.underexposedPercent << result.dynamicRange
+           << result.blockinessScore << result.frequencyBlurScore
+           << result.isFrozen << static_cast<qint32>(result.frozenFrameCount)
+           << result.meanChroma << result.colorCast << result.whiteBalanceRed << result.whiteBalanceBlue
+           << result.saturationClippedPercent
+           << result.hasReference << result.psnr << result.ssim
+           << result.overallScore << result.status << result.isValid
+           << result.hasStreamStats << result.packetsReceived << result.packetsLost
+           << result.corruptFrames << result.decodeErrors << result.packetLossPercent
+           << result.keyframeMode;
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, ImageQualityAnalyzer::QualityResult& result)
+{
+    qint32 frozenFrameCount = 0;
+    stream >> result.noiseScore >> result.contrastScore >> result.sharpnessScore
+           >> result.overexposedPercent >> result.underexposedPercent >> result.dynamicRange
+           >> result.blockinessScore >> result.frequencyBlurScore
+           >> result.isFrozen >> frozenFrameCount
+           >> result.meanChroma >> result.colorCast >> result.whiteBalanceRed >> result.whiteBalanceBlue
+           >> result.saturationClippedPercent
+           >> result.hasReference >> result.psnr >> result.ssim
+           >> result.overallScore >> result.status >> result.isValid
+           >> result.hasStreamStats >> result.packetsReceived >> result.packetsLost
+           >> result.corruptFrames >> result.decodeErrors >> result.packetLossPercent
+           >> result.keyframeMode;
+    result.frozenFrameCount = frozenFrameCount;
+    return stream;
+}
@@ -0,0 +1,96 @@
+#ifndef SHARDPROTOCOL_H
+#define SHARDPROTOCOL_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+#include "imagequalityanalyzer.h"
+
+/**
+ * @brief Протокол обмена между координатором и процессами-обработчиками
+ *
+ * Сообщение: [quint32 длина][quint8 тип][тело в QDataStream].
+ *
+ * | Тип       | Направление            | Тело                          |
+ * |-----------|------------------------|-------------------------------|
+ * | Hello     | обработчик → коорд.    | версия протокола, имя         |
+ * | Assign    | коорд. → обработчик    | полный список URL камер       |
+ * | Result    | обработчик → коорд.    | URL, QualityResult            |
+ * | Heartbeat | в обе стороны          | -                             |
+ *
+ * QualityResult передаётся полем за полем, поэтому любое изменение его
+ * состава меняет PROTOCOL_VERSION. Координатор отклоняет обработчик
+ * с другой версией сразу после Hello.
+ */
+namespace ShardProtocol {
+
+enum MessageType : quint8 {
+    Hello = 1,
+    Assign = 2,
+    Result = 3,
+    Heartbeat = 4
+};
+
+const quint32 PROTOCOL_VERSION = 2;
+const quint16 DEFAULT_PORT = 7700;
+const int HEARTBEAT_INTERVAL_MS = 1000;
+const int HEARTBEAT_TIMEOUT_MS = 5000;
+
+/**
+ * @brief Разобранное сообщение протокола
+ */
+struct Message {
+    MessageType type;
+    quint32 protocolVersion;                         // Hello
+    QString workerName;                              // Hello
+    QStringList urls;                                // Assign
+    QString url;                                     // Result
+    ImageQualityAnalyzer::QualityResult result;      // Result
+
+    Message() : type(Heartbeat), protocolVersion(0) {}
+};
+
+QByteArray encodeHello(const QString& workerName, quint32 protocolVersion = PROTOCOL_VERSION);
+QByteArray encodeAssign(const QStringList& urls);
+QByteArray encodeResult(const QString& url, const ImageQualityAnalyzer::QualityResult& result);
+QByteArray encodeHeartbeat();
+
+/**
+ * @brief Собирает сообщения из потока байт TCP-соединения
+ */
+class MessageReader
+{
+public:
+    void append(const QByteArray& data);
+
+    /**
+     * @brief Извлекает следующее полное сообщение
+     * @return false, если полного сообщения пока нет
+     */
+    bool next(Message& message);
+
+    /**
+     * @brief Поток содержит некорректные данные; соединение следует закрыть
+     */
+    bool hasError() const;
+
+private:
+    QByteArray m_buffer;
+    bool m_error = false;
+
+    static constexpr quint32 MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+};
+
+/**
+ * @brief Разбирает адрес вида host:port
+ * @param defaultPort Порт, если он не указан
+ */
+bool parseEndpoint(const QString& text, QString& host, quint16& port, quint16 defaultPort = DEFAULT_PORT);
+
+} // namespace ShardProtocol
+
+QDataStream& operator<<(QDataStream& stream, const ImageQualityAnalyzer::QualityResult& result);
+QDataStream& operator>>(QDataStream& stream, ImageQualityAnalyzer::QualityResult& result);
+
+#endif // SHARDPROTOCOL_H
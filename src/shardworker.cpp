@@ -0,0 +1,184 @@
+#include "shardworker.h"
+#include <QDebug>
+#include <QSet>
+
+ShardWorker::ShardWorker(const QString& host, quint16 port, const QString& workerName,
+                         double cpuBudget, QObject *parent)
+    : QObject(parent)
+    , m_host(host)
+    , m_port(port)
+    , m_workerName(workerName)
+    , m_socket(nullptr)
+    , m_heartbeatTimer(nullptr)
+    , m_reconnectTimer(nullptr)
+    , m_scheduler(nullptr)
+{
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, &ShardWorker::onConnected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &ShardWorker::onReadyRead);
+    connect(m_socket, &QTcpSocket::disconnected, this, &ShardWorker::onDisconnected);
+
+    m_heartbeatTimer = new QTimer(this);
+    connect(m_heartbeatTimer, &QTimer::timeout, this, &ShardWorker::sendHeartbeat);
+
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &ShardWorker::connectToCoordinator);
+
+    if (cpuBudget > 0.0) {
+        m_scheduler = new AnalysisScheduler(cpuBudget, this);
+    }
+}
+
+ShardWorker::~ShardWorker()
+{
+    stopAllCameras();
+}
+
+void ShardWorker::start()
+{
+    qInfo() << "Shard worker" << m_workerName << "connecting to" << m_host << m_port;
+    connectToCoordinator();
+}
+
+QStringList ShardWorker::cameras() const
+{
+    return m_cameraWorkers.keys();
+}
+
+void ShardWorker::connectToCoordinator()
+{
+    // Таймер перезапускается при каждой попытке и останавливается только
+    // в onConnected(), поэтому неудачные попытки повторяются сами
+    m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        return;
+    }
+    m_reader = ShardProtocol::MessageReader();
+    m_socket->connectToHost(m_host, m_port);
+}
+
+void ShardWorker::onConnected()
+{
+    m_reconnectTimer->stop();
+    m_socket->write(ShardProtocol::encodeHello(m_workerName));
+    m_lastCoordinatorMessage.start();
+    m_heartbeatTimer->start(ShardProtocol::HEARTBEAT_INTERVAL_MS);
+    qInfo() << "Connected to coordinator" << m_host << m_port;
+}
+
+void ShardWorker::onDisconnected()
+{
+    m_heartbeatTimer->stop();
+    qWarning() << "Lost coordinator connection, stopping" << m_cameraWorkers.size() << "cameras; retrying";
+    stopAllCameras();
+    m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+}
+
+void ShardWorker::sendHeartbeat()
+{
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+    // Зависший координатор или потерянная сеть не закрывают соединение
+    if (m_lastCoordinatorMessage.elapsed() > ShardProtocol::HEARTBEAT_TIMEOUT_MS) {
+        qWarning() << "No heartbeat from coordinator for" << ShardProtocol::HEARTBEAT_TIMEOUT_MS << "ms";
+        m_socket->abort();
+        return;
+    }
+    m_socket->write(ShardProtocol::encodeHeartbeat());
+}
+
+void ShardWorker::onReadyRead()
+{
+    m_reader.append(m_socket->readAll());
+    m_lastCoordinatorMessage.restart();
+
+    ShardProtocol::Message message;
+    while (m_reader.next(message)) {
+        if (message.type == ShardProtocol::Assign) {
+            applyAssignment(message.urls);
+        }
+    }
+
+    if (m_reader.hasError()) {
+        qWarning() << "Malformed data from coordinator, reconnecting";
+        m_socket->abort();
+        m_reconnectTimer->start(RECONNECT_INTERVAL_MS);
+    }
+}
+
+void ShardWorker::applyAssignment(const QStringList& urls)
+{
+    // Конструктор QSet из диапазона есть только с Qt 5.14
+    QSet<QString> assigned;
+    for (const QString& url : urls) {
+        assigned.insert(url);
+    }
+
+    for (const QString& url : m_cameraWorkers.keys()) {
+        if (!assigned.contains(url)) {
+            stopCamera(url);
+        }
+    }
+    for (const QString& url : urls) {
+        if (!m_cameraWorkers.contains(url)) {
+            startCamera(url);
+        }
+    }
+
+    qInfo() << "Assignment updated:" << m_cameraWorkers.size() << "cameras";
+    emit assignmentReceived(urls);
+}
+
+void ShardWorker::startCamera(const QString& url)
+{
+    QThread* workerThread = new QThread(this);
+    CameraWorker* worker = new CameraWorker(url);
+    worker->setAnalysisScheduler(m_scheduler);
+    worker->moveToThread(workerThread);
+
+    connect(workerThread, &QThread::started, worker, &CameraWorker::startCapture);
+    connect(workerThread, &QThread::finished, worker, &CameraWorker::deleteLater);
+    connect(worker, &CameraWorker::qualityResultReady, this,
+        [this, url](const ImageQualityAnalyzer::QualityResult& result) {
+            if (m_socket->state() == QAbstractSocket::ConnectedState && m_cameraWorkers.contains(url)) {
+                m_socket->write(ShardProtocol::encodeResult(url, result));
+            }
+        }, Qt::QueuedConnection);
+
+    m_cameraWorkers[url] = worker;
+    m_cameraThreads[url] = workerThread;
+    workerThread->start();
+    qInfo() << "Started camera" << url;
+}
+
+void ShardWorker::stopCamera(const QString& url)
+{
+    CameraWorker* worker = m_cameraWorkers.take(url);
+    QThread* thread = m_cameraThreads.take(url);
+
+    if (thread) {
+        // Камера может ждать очереди на подключение и не обрабатывать события
+        thread->requestInterruption();
+    }
+    if (worker) {
+        QMetaObject::invokeMethod(worker, [worker]() { worker->stopCapture(); }, Qt::BlockingQueuedConnection);
+    }
+    if (thread) {
+        thread->quit();
+        if (!thread->wait(5000)) {
+            thread->terminate();
+            thread->wait();
+        }
+        delete thread;
+    }
+    qInfo() << "Stopped camera" << url;
+}
+
+void ShardWorker::stopAllCameras()
+{
+    for (const QString& url : m_cameraWorkers.keys()) {
+        stopCamera(url);
+    }
+}
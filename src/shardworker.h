@@ -0,0 +1,80 @@
+#ifndef SHARDWORKER_H
+#define SHARDWORKER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+#include "cameraworker.h"
+#include "shardprotocol.h"
+#include "analysisscheduler.h"
+
+/**
+ * @class ShardWorker
+ * @brief Процесс-обработчик в режиме шардирования (без GUI)
+ *
+ * Подключается к координатору, получает от него список назначенных камер,
+ * запускает для каждой CameraWorker в отдельном потоке (как MainWindow) и
+ * отправляет координатору результаты анализа. При потере координатора
+ * (разрыв или отсутствие его heartbeat дольше HEARTBEAT_TIMEOUT_MS) камеры
+ * останавливаются: координатор уже передал их другим обработчикам, и
+ * продолжение работы означало бы двойной анализ. Подключение повторяется;
+ * после переподключения координатор присылает актуальный список камер.
+ */
+class ShardWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ShardWorker(const QString& host, quint16 port, const QString& workerName,
+                double cpuBudget, QObject *parent = nullptr);
+    ~ShardWorker();
+
+    void start();
+
+    /**
+     * @brief URL запущенных камер
+     */
+    QStringList cameras() const;
+
+signals:
+    /**
+     * @brief Получен список камер от координатора
+     */
+    void assignmentReceived(const QStringList& urls);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void sendHeartbeat();
+    void connectToCoordinator();
+
+private:
+    void applyAssignment(const QStringList& urls);
+    void startCamera(const QString& url);
+    void stopCamera(const QString& url);
+    void stopAllCameras();
+
+    QString m_host;
+    quint16 m_port;
+    QString m_workerName;
+    QTcpSocket* m_socket;
+    QTimer* m_heartbeatTimer;
+    QTimer* m_reconnectTimer;
+    AnalysisScheduler* m_scheduler;
+    ShardProtocol::MessageReader m_reader;
+    QElapsedTimer m_lastCoordinatorMessage;
+
+    QMap<QString, CameraWorker*> m_cameraWorkers;
+    QMap<QString, QThread*> m_cameraThreads;
+
+    const int RECONNECT_INTERVAL_MS = 2000;
+};
+
+#endif // SHARDWORKER_H
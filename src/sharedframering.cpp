@@ -0,0 +1,384 @@
+#include "sharedframering.h"
+#include <QDebug>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t RING_MAGIC = 0x49514652;  // "IQFR"
+const uint32_t RING_VERSION = 1;
+const uint32_t STATE_ACTIVE = 1;
+const uint32_t STATE_CLOSED = 2;
+
+size_t alignTo64(size_t value)
+{
+    return (value + 63) & ~static_cast<size_t>(63);
+}
+
+} // namespace
+
+// Структуры лежат в разделяемой памяти: только POD и lock-free атомики
+struct alignas(64) SharedFrameRing::Header {
+    std::atomic<uint32_t> magic;        // Записывается последним при создании
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotBytes;
+    uint64_t slotStride;
+    std::atomic<uint64_t> epoch;        // Растёт при каждом запуске производителя
+    std::atomic<uint64_t> writeCount;   // Число опубликованных кадров
+    std::atomic<int64_t> heartbeatUs;
+    std::atomic<int32_t> producerPid;
+    std::atomic<uint32_t> state;
+};
+
+struct alignas(64) SharedFrameRing::SlotHeader {
+    std::atomic<uint64_t> sequence;     // seqlock: нечётное - идёт запись
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    int32_t reserved;
+    uint64_t step;
+    uint64_t frameIndex;
+    int64_t timestampUs;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "SharedFrameRing requires lock-free 64-bit atomics");
+
+SharedFrameRing::SharedFrameRing(const QString& name, bool producer)
+    : m_name(name)
+    , m_producer(producer)
+    , m_mapping(nullptr)
+    , m_mappingSize(0)
+    , m_header(nullptr)
+{
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+    if (m_producer) {
+        close();
+    }
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+}
+
+std::string SharedFrameRing::shmName(const QString& name)
+{
+    QString trimmed = name;
+    while (trimmed.startsWith('/')) {
+        trimmed.remove(0, 1);
+    }
+    return "/" + trimmed.toStdString();
+}
+
+bool SharedFrameRing::map(int fd, size_t size, bool writable)
+{
+    int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* mapping = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        qWarning() << "Failed to map shared frame ring" << m_name << ":" << strerror(errno);
+        return false;
+    }
+    m_mapping = mapping;
+    m_mappingSize = size;
+    m_header = static_cast<Header*>(mapping);
+    return true;
+}
+
+std::unique_ptr<SharedFrameRing> SharedFrameRing::create(const QString& name, int slotCount, size_t slotBytes)
+{
+    if (slotCount < 2 || slotBytes == 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedFrameRing> ring(new SharedFrameRing(name, true));
+    std::string path = shmName(name);
+    size_t slotStride = alignTo64(sizeof(SlotHeader)) + alignTo64(slotBytes);
+    size_t totalSize = alignTo64(sizeof(Header)) + static_cast<size_t>(slotCount) * slotStride;
+
+    // Объект от предыдущего запуска того же размера переиспользуется:
+    // подключённые потребители увидят новый epoch без переподключения
+    int fd = shm_open(path.c_str(), O_RDWR, 0600);
+    if (fd >= 0) {
+        struct stat info;
+        bool reusable = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == totalSize
+            && ring->map(fd, totalSize, true)
+            && ring->m_header->magic.load(std::memory_order_acquire) == RING_MAGIC
+            && ring->m_header->version == RING_VERSION
+            && ring->m_header->slotCount == static_cast<uint32_t>(slotCount)
+            && ring->m_header->slotBytes == slotBytes;
+
+        if (reusable) {
+            ::close(fd);
+            Header* header = ring->m_header;
+            // Слот, запись в который прервало падение, остаётся помеченным как записываемый
+            for (int i = 0; i < slotCount; ++i) {
+                SlotHeader* slot = ring->slotAt(i);
+                uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+                if (sequence & 1) {
+                    slot->sequence.store(sequence + 1, std::memory_order_release);
+                }
+            }
+            header->producerPid.store(getpid(), std::memory_order_relaxed);
+            header->heartbeatUs.store(monotonicUs(), std::memory_order_relaxed);
+            header->state.store(STATE_ACTIVE, std::memory_order_relaxed);
+            header->epoch.fetch_add(1, std::memory_order_release);
+            qInfo() << "Reusing shared frame ring" << name << "epoch" << header->epoch.load();
+            return ring;
+        }
+
+        // Другой размер: старые потребители увидят закрытие и переподключатся
+        if (ring->m_header && ring->m_mappingSize >= sizeof(Header)) {
+            ring->m_header->state.store(STATE_CLOSED, std::memory_order_release);
+        }
+        if (ring->m_mapping) {
+            munmap(ring->m_mapping, ring->m_mappingSize);
+            ring->m_mapping = nullptr;
+            ring->m_header = nullptr;
+        }
+        ::close(fd);
+        shm_unlink(path.c_str());
+    }
+
+    fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        qWarning() << "Failed to create shared frame ring" << name << ":" << strerror(errno);
+        return nullptr;
+    }
+    if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0 || !ring->map(fd, totalSize, true)) {
+        qWarning() << "Failed to size shared frame ring" << name << ":" << strerror(errno);
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return nullptr;
+    }
+    ::close(fd);
+
+    // ftruncate заполняет память нулями: счётчики и seqlock уже в исходном состоянии
+    Header* header = ring->m_header;
+    header->version = RING_VERSION;
+    header->slotCount = static_cast<uint32_t>(slotCount);
+    header->slotBytes = slotBytes;
+    header->slotStride = slotStride;
+    header->epoch.store(1, std::memory_order_relaxed);
+    header->producerPid.store(getpid(), std::memory_order_relaxed);
+    header->heartbeatUs.store(monotonicUs(), std::memory_order_relaxed);
+    header->state.store(STATE_ACTIVE, std::memory_order_relaxed);
+    header->magic.store(RING_MAGIC, std::memory_order_release);
+
+    qInfo() << "Created shared frame ring" << name << slotCount << "slots of" << slotBytes << "bytes";
+    return ring;
+}
+
+std::unique_ptr<SharedFrameRing> SharedFrameRing::attach(const QString& name)
+{
+    std::string path = shmName(name);
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedFrameRing> ring(new SharedFrameRing(name, false));
+    bool mapped = ring->map(fd, static_cast<size_t>(info.st_size), false);
+    ::close(fd);
+    if (!mapped) {
+        return nullptr;
+    }
+
+    // Производитель мог ещё не закончить инициализацию заголовка.
+    // Размеры проверяются делением, чтобы произведение не переполнилось
+    const Header* header = ring->m_header;
+    size_t slotsArea = ring->m_mappingSize - alignTo64(sizeof(Header));
+    if (header->magic.load(std::memory_order_acquire) != RING_MAGIC
+        || header->version != RING_VERSION || header->slotCount < 2
+        || ring->m_mappingSize < alignTo64(sizeof(Header))
+        || header->slotStride < alignTo64(sizeof(SlotHeader))
+        || header->slotBytes > header->slotStride - alignTo64(sizeof(SlotHeader))
+        || header->slotCount > slotsArea / header->slotStride) {
+        return nullptr;
+    }
+    return ring;
+}
+
+bool SharedFrameRing::isValidLayout(int rows, int cols, int type, quint64 step, quint64 slotBytes)
+{
+    if (rows <= 0 || cols <= 0 || (type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(type) != CV_8U) {
+        return false;
+    }
+    quint64 rowBytes = static_cast<quint64>(cols) * CV_ELEM_SIZE(type);
+    return step >= rowBytes && step <= slotBytes && static_cast<quint64>(rows) <= slotBytes / step;
+}
+
+SharedFrameRing::SlotHeader* SharedFrameRing::slotAt(int slot) const
+{
+    char* base = static_cast<char*>(m_mapping) + alignTo64(sizeof(Header));
+    return reinterpret_cast<SlotHeader*>(base + static_cast<size_t>(slot) * m_header->slotStride);
+}
+
+bool SharedFrameRing::publish(const cv::Mat& frame)
+{
+    if (!m_producer || !m_header || frame.empty()) {
+        return false;
+    }
+
+    size_t rowBytes = frame.cols * frame.elemSize();
+    if (rowBytes * frame.rows > m_header->slotBytes) {
+        return false;
+    }
+
+    uint64_t count = m_header->writeCount.load(std::memory_order_relaxed);
+    SlotHeader* slot = slotAt(static_cast<int>(count % m_header->slotCount));
+    uchar* data = reinterpret_cast<uchar*>(slot) + alignTo64(sizeof(SlotHeader));
+
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->rows = frame.rows;
+    slot->cols = frame.cols;
+    slot->type = frame.type();
+    slot->step = rowBytes;
+    slot->frameIndex = count;
+    slot->timestampUs = monotonicUs();
+    if (frame.isContinuous()) {
+        std::memcpy(data, frame.data, rowBytes * frame.rows);
+    } else {
+        for (int y = 0; y < frame.rows; ++y) {
+            std::memcpy(data + y * rowBytes, frame.ptr(y), rowBytes);
+        }
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    m_header->writeCount.store(count + 1, std::memory_order_release);
+    m_header->heartbeatUs.store(slot->timestampUs, std::memory_order_relaxed);
+    return true;
+}
+
+void SharedFrameRing::beatHeartbeat()
+{
+    if (m_producer && m_header) {
+        m_header->heartbeatUs.store(monotonicUs(), std::memory_order_relaxed);
+    }
+}
+
+void SharedFrameRing::close()
+{
+    if (!m_producer || !m_header) {
+        return;
+    }
+    m_header->state.store(STATE_CLOSED, std::memory_order_release);
+    shm_unlink(shmName(m_name).c_str());
+    m_producer = false;
+}
+
+bool SharedFrameRing::readLatest(quint64 lastWriteCount, FrameView& view) const
+{
+    if (!m_header) {
+        return false;
+    }
+
+    // Несколько попыток на случай, если слот перезаписывается прямо сейчас
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        uint64_t count = m_header->writeCount.load(std::memory_order_acquire);
+        if (count == 0 || count == lastWriteCount) {
+            return false;
+        }
+
+        int slotIndex = static_cast<int>((count - 1) % m_header->slotCount);
+        const SlotHeader* slot = slotAt(slotIndex);
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+
+        int rows = slot->rows;
+        int cols = slot->cols;
+        int type = slot->type;
+        uint64_t step = slot->step;
+        uint64_t frameIndex = slot->frameIndex;
+        int64_t timestampUs = slot->timestampUs;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+
+        // Заголовок слота пишет другой процесс: перед построением cv::Mat
+        // проверяются тип, шаг строки и то, что кадр целиком лежит в слоте
+        if (!isValidLayout(rows, cols, type, step, m_header->slotBytes)) {
+            return false;
+        }
+
+        const uchar* data = reinterpret_cast<const uchar*>(slot) + alignTo64(sizeof(SlotHeader));
+        view.frame = cv::Mat(rows, cols, type, const_cast<uchar*>(data), step);
+        view.frameIndex = frameIndex;
+        view.timestampUs = timestampUs;
+        view.writeCount = count;
+        view.slot = slotIndex;
+        view.sequence = sequence;
+        return true;
+    }
+    return false;
+}
+
+bool SharedFrameRing::isStillValid(const FrameView& view) const
+{
+    if (!m_header || view.frame.empty()) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotAt(view.slot)->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+quint64 SharedFrameRing::epoch() const
+{
+    return m_header ? m_header->epoch.load(std::memory_order_acquire) : 0;
+}
+
+quint64 SharedFrameRing::writeCount() const
+{
+    return m_header ? m_header->writeCount.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameRing::isClosed() const
+{
+    return !m_header || m_header->state.load(std::memory_order_acquire) == STATE_CLOSED;
+}
+
+qint64 SharedFrameRing::heartbeatAgeMs() const
+{
+    if (!m_header) {
+        return -1;
+    }
+    return (monotonicUs() - m_header->heartbeatUs.load(std::memory_order_relaxed)) / 1000;
+}
+
+size_t SharedFrameRing::slotBytes() const
+{
+    return m_header ? m_header->slotBytes : 0;
+}
+
+QString SharedFrameRing::name() const
+{
+    return m_name;
+}
+
+qint64 SharedFrameRing::monotonicUs()
+{
+    // CLOCK_MONOTONIC общий для всех процессов машины, в отличие от QElapsedTimer
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<qint64>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
@@ -0,0 +1,123 @@
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @class SharedFrameRing
+ * @brief Кольцевой буфер декодированных кадров в разделяемой памяти POSIX
+ *
+ * Один процесс захвата (производитель) публикует кадры, любое число
+ * процессов анализа (потребителей) читает их без копирования: кадр
+ * потребителя - это cv::Mat, указывающий прямо в отображённую память.
+ *
+ * Синхронизация без блокировок:
+ * - каждый слот защищён seqlock-счётчиком: нечётное значение - идёт запись;
+ * - потребитель запоминает счётчик слота и после обработки проверяет
+ *   isStillValid(): если производитель успел перезаписать слот, результат
+ *   обработки отбрасывается;
+ * - перезапуск производителя меняет epoch в заголовке, а его остановка или
+ *   падение видны по состоянию и устаревшему heartbeat.
+ *
+ * Потребитель отображает память только для чтения, поэтому не может
+ * повредить кадры других процессов.
+ */
+class SharedFrameRing
+{
+public:
+    /**
+     * @brief Кадр, прочитанный потребителем
+     */
+    struct FrameView {
+        cv::Mat frame;           // Указывает в разделяемую память, не изменять
+        quint64 frameIndex;      // Порядковый номер кадра у производителя
+        qint64 timestampUs;      // Время публикации (CLOCK_MONOTONIC), мкс
+        quint64 writeCount;      // Значение счётчика записей при чтении
+        int slot;
+        quint64 sequence;        // Значение seqlock-счётчика слота при чтении
+    };
+
+    ~SharedFrameRing();
+
+    /**
+     * @brief Создаёт кольцо производителя
+     * @param name Имя объекта разделяемой памяти (без начального '/')
+     * @param slotCount Число слотов
+     * @param slotBytes Максимальный размер кадра в байтах
+     *
+     * Существующий объект того же размера переиспользуется с новым epoch,
+     * чтобы подключённые потребители сразу увидели перезапуск.
+     */
+    static std::unique_ptr<SharedFrameRing> create(const QString& name, int slotCount, size_t slotBytes);
+
+    /**
+     * @brief Подключает потребителя к существующему кольцу
+     * @return nullptr, если кольцо ещё не создано или повреждено
+     */
+    static std::unique_ptr<SharedFrameRing> attach(const QString& name);
+
+    /**
+     * @brief Публикует кадр (только производитель)
+     * @return false, если кадр не помещается в слот
+     */
+    bool publish(const cv::Mat& frame);
+
+    /**
+     * @brief Обновляет heartbeat производителя без публикации кадра
+     */
+    void beatHeartbeat();
+
+    /**
+     * @brief Помечает кольцо закрытым; производитель удаляет объект из /dev/shm
+     */
+    void close();
+
+    /**
+     * @brief Читает последний опубликованный кадр (только потребитель)
+     * @return false, если новых кадров после lastWriteCount нет
+     */
+    bool readLatest(quint64 lastWriteCount, FrameView& view) const;
+
+    /**
+     * @brief Проверяет, что слот кадра не был перезаписан после чтения
+     */
+    bool isStillValid(const FrameView& view) const;
+
+    quint64 epoch() const;
+    quint64 writeCount() const;
+    bool isClosed() const;
+    qint64 heartbeatAgeMs() const;
+    size_t slotBytes() const;
+    QString name() const;
+
+    static qint64 monotonicUs();
+
+    /**
+     * @brief Проверяет заголовок слота: 8-битный тип, шаг строки не меньше
+     *        строки кадра и кадр rows x step целиком в slotBytes
+     */
+    static bool isValidLayout(int rows, int cols, int type, quint64 step, quint64 slotBytes);
+
+    static constexpr int DEFAULT_SLOT_COUNT = 4;
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    SharedFrameRing(const QString& name, bool producer);
+    bool map(int fd, size_t size, bool writable);
+    SlotHeader* slotAt(int slot) const;
+    static std::string shmName(const QString& name);
+
+    QString m_name;
+    bool m_producer;
+    void* m_mapping;
+    size_t m_mappingSize;
+    Header* m_header;
+};
+
+#endif // SHAREDFRAMERING_H
@@ -0,0 +1,104 @@
+#include "shmframesource.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+
+ShmFrameSource::ShmFrameSource(const QString& ringName)
+    : m_ringName(ringName)
+    , m_view()
+    , m_epoch(0)
+    , m_lastWriteCount(0)
+    , m_producerRestarts(0)
+{
+}
+
+bool ShmFrameSource::attachRing()
+{
+    m_view = SharedFrameRing::FrameView();
+    m_ring = SharedFrameRing::attach(m_ringName);
+    if (!m_ring || m_ring->isClosed()) {
+        m_ring.reset();
+        return false;
+    }
+
+    quint64 epoch = m_ring->epoch();
+    if (m_epoch != 0 && epoch != m_epoch) {
+        m_producerRestarts++;
+        qInfo() << "Capture process for" << m_ringName << "restarted, epoch" << epoch;
+    }
+    m_epoch = epoch;
+    // Новое кольцо после смены размера кадра начинает счёт записей с нуля
+    m_lastWriteCount = 0;
+    return true;
+}
+
+bool ShmFrameSource::open()
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!attachRing()) {
+        if (timer.elapsed() > OPEN_TIMEOUT_MS) {
+            qWarning() << "Shared frame ring" << m_ringName << "is not available";
+            return false;
+        }
+        QThread::msleep(20);
+    }
+    return true;
+}
+
+bool ShmFrameSource::read(cv::Mat& frame)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < FRAME_WAIT_TIMEOUT_MS) {
+        // Кольцо закрыто производителем (смена размера кадра или остановка):
+        // ждём, пока он создаст новое
+        if (!m_ring || m_ring->isClosed()) {
+            if (!attachRing()) {
+                QThread::msleep(20);
+                continue;
+            }
+        }
+
+        quint64 epoch = m_ring->epoch();
+        if (epoch != m_epoch) {
+            m_producerRestarts++;
+            m_epoch = epoch;
+            qInfo() << "Capture process for" << m_ringName << "restarted, epoch" << epoch;
+        }
+
+        if (m_ring->readLatest(m_lastWriteCount, m_view)) {
+            m_lastWriteCount = m_view.writeCount;
+            frame = m_view.frame;
+            return true;
+        }
+
+        if (m_ring->heartbeatAgeMs() > PRODUCER_TIMEOUT_MS) {
+            qWarning() << "Capture process for" << m_ringName << "stopped responding";
+            return false;
+        }
+        QThread::usleep(POLL_INTERVAL_US);
+    }
+    return false;
+}
+
+void ShmFrameSource::close()
+{
+    m_view = SharedFrameRing::FrameView();
+    m_ring.reset();
+}
+
+bool ShmFrameSource::isOpened() const
+{
+    return m_ring != nullptr;
+}
+
+bool ShmFrameSource::frameStillValid() const
+{
+    return m_ring && m_ring->isStillValid(m_view);
+}
+
+int ShmFrameSource::producerRestarts() const
+{
+    return m_producerRestarts;
+}
@@ -0,0 +1,51 @@
+#ifndef SHMFRAMESOURCE_H
+#define SHMFRAMESOURCE_H
+
+#include "framesource.h"
+#include "sharedframering.h"
+
+/**
+ * @class ShmFrameSource
+ * @brief Источник кадров из разделяемой памяти процесса захвата
+ *
+ * Формат URL: shm://<имя кольца>. Кадры публикует процесс, запущенный с
+ * --capture-publisher (см. CapturePublisher); read() возвращает последний
+ * опубликованный кадр без копирования.
+ *
+ * Перезапуск процесса захвата распознаётся по смене epoch кольца, а его
+ * падение - по heartbeat старше PRODUCER_TIMEOUT_MS: в этом случае read()
+ * возвращает ошибку, и CameraWorker переходит к переподключению.
+ */
+class ShmFrameSource : public FrameSource
+{
+public:
+    explicit ShmFrameSource(const QString& ringName);
+
+    bool open() override;
+    bool read(cv::Mat& frame) override;
+    void close() override;
+    bool isOpened() const override;
+    bool frameStillValid() const override;
+
+    /**
+     * @brief Число замеченных перезапусков процесса захвата
+     */
+    int producerRestarts() const;
+
+private:
+    bool attachRing();
+
+    QString m_ringName;
+    std::unique_ptr<SharedFrameRing> m_ring;
+    SharedFrameRing::FrameView m_view;
+    quint64 m_epoch;
+    quint64 m_lastWriteCount;
+    int m_producerRestarts;
+
+    static constexpr int OPEN_TIMEOUT_MS = 10000;       // Процесс захвата ещё подключается к камере
+    static constexpr int FRAME_WAIT_TIMEOUT_MS = 2000;
+    static constexpr int PRODUCER_TIMEOUT_MS = 3000;
+    static constexpr int POLL_INTERVAL_US = 1000;
+};
+
+#endif // SHMFRAMESOURCE_H
@@ -0,0 +1,287 @@
+#include "snapshotcache.h"
+#include <QBuffer>
+#include <QDateTime>
+#include <QDebug>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// QThreadPool::start(std::function) появился только в Qt 5.15
+class EncodeTask : public QRunnable
+{
+public:
+    explicit EncodeTask(std::function<void()> work) : m_work(std::move(work)) {}
+    void run() override { m_work(); }
+
+private:
+    std::function<void()> m_work;
+};
+
+} // namespace
+
+SnapshotCache::SnapshotCache(qint64 memoryLimitBytes)
+    : m_memoryLimit(memoryLimitBytes)
+    , m_memoryUsage(0)
+    , m_nextId(1)
+    , m_pendingEncodes(0)
+    , m_format("jpg")
+{
+    m_encoderPool.setMaxThreadCount(ENCODER_THREADS);
+}
+
+SnapshotCache::~SnapshotCache()
+{
+    m_encoderPool.waitForDone();
+}
+
+void SnapshotCache::offer(const QString& cameraKey, const QImage& image, double score)
+{
+    if (image.isNull()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    CameraState& state = m_cameras[cameraKey];
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    double previousScore = state.lastScore;
+    state.lastScore = score;
+
+    // Кандидаты из корзин, вышедших за окно, больше не экстремумы
+    qint64 bucket = now / EXTREMES_BUCKET_MS;
+    QVector<quint64> released;
+    expireLocked(state.worst, bucket, released);
+    expireLocked(state.best, bucket, released);
+    releaseLocked(state, released);
+    released.clear();
+
+    bool dropped = previousScore >= 0.0 && previousScore - score >= SCORE_DROP_THRESHOLD;
+    bool worst = qualifies(state.worst, bucket, score, true);
+    bool best = qualifies(state.best, bucket, score, false);
+    if (!dropped && !worst && !best) {
+        return;
+    }
+
+    if (m_pendingEncodes >= MAX_PENDING_ENCODES) {
+        qDebug() << "[SnapshotCache] Encoder queue full, snapshot skipped for" << cameraKey;
+        return;
+    }
+
+    SnapshotInfo info;
+    info.id = m_nextId++;
+    info.cameraKey = cameraKey;
+    info.timestampMs = now;
+    info.score = score;
+    info.previousScore = previousScore;
+    info.reason = dropped ? Reason::ScoreDrop : (worst ? Reason::Worst : Reason::Best);
+    info.format = m_format;
+    info.sizeBytes = 0;
+
+    // Вытесненные кандидаты больше не нужны, если не хранят падение оценки.
+    // Ещё не закодированные отбрасывает encode()
+    if (worst) {
+        pushExtreme(state.worst, Extreme{bucket, score, info.id}, true, released);
+    }
+    if (best) {
+        pushExtreme(state.best, Extreme{bucket, score, info.id}, false, released);
+    }
+    releaseLocked(state, released);
+
+    m_pendingEncodes++;
+    m_encoderPool.start(new EncodeTask([this, info, image]() { encode(info, image); }));
+}
+
+void SnapshotCache::encode(SnapshotInfo info, QImage image)
+{
+    if (image.width() > MAX_SNAPSHOT_WIDTH) {
+        image = image.scaledToWidth(MAX_SNAPSHOT_WIDTH, Qt::SmoothTransformation);
+    }
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, info.format);
+    writer.setQuality(JPEG_QUALITY);
+    bool written = writer.write(image);
+    if (!written) {
+        qWarning() << "Failed to encode snapshot for" << info.cameraKey << ":" << writer.errorString();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pendingEncodes--;
+    // Камеру могли удалить, пока кадр кодировался
+    auto stateIt = m_cameras.find(info.cameraKey);
+    if (!written || stateIt == m_cameras.end()) {
+        return;
+    }
+    // Пока кадр кодировался, его мог вытеснить более экстремальный
+    if (info.reason != Reason::ScoreDrop && !isCandidate(stateIt.value(), info.id)) {
+        return;
+    }
+    info.sizeBytes = data.size();
+    insertLocked(Entry{info, data});
+}
+
+bool SnapshotCache::beats(double score, double other, bool lowest)
+{
+    return lowest ? score < other : score > other;
+}
+
+bool SnapshotCache::qualifies(const std::deque<Extreme>& window, qint64 bucket, double score, bool lowest)
+{
+    // В корзине уже есть не менее экстремальный кадр
+    return window.empty() || window.back().bucket != bucket || beats(score, window.back().score, lowest);
+}
+
+void SnapshotCache::pushExtreme(std::deque<Extreme>& window, const Extreme& candidate, bool lowest,
+                                QVector<quint64>& released)
+{
+    // Более ранний и не более экстремальный кандидат уже не станет экстремумом окна
+    while (!window.empty() && !beats(window.back().score, candidate.score, lowest)) {
+        released.append(window.back().id);
+        window.pop_back();
+    }
+    window.push_back(candidate);
+}
+
+void SnapshotCache::expireLocked(std::deque<Extreme>& window, qint64 bucket, QVector<quint64>& released)
+{
+    qint64 bucketCount = EXTREMES_WINDOW_MS / EXTREMES_BUCKET_MS;
+    while (!window.empty() && window.front().bucket <= bucket - bucketCount) {
+        released.append(window.front().id);
+        window.pop_front();
+    }
+}
+
+bool SnapshotCache::isCandidate(const CameraState& state, quint64 id)
+{
+    auto hasId = [id](const Extreme& extreme) { return extreme.id == id; };
+    return std::any_of(state.worst.begin(), state.worst.end(), hasId)
+        || std::any_of(state.best.begin(), state.best.end(), hasId);
+}
+
+void SnapshotCache::releaseLocked(const CameraState& state, const QVector<quint64>& released)
+{
+    for (quint64 id : released) {
+        auto indexIt = m_index.find(id);
+        if (indexIt == m_index.end() || isCandidate(state, id)) {
+            continue;
+        }
+        if (indexIt.value()->info.reason != Reason::ScoreDrop) {
+            removeLocked(indexIt.value());
+        }
+    }
+}
+
+void SnapshotCache::insertLocked(Entry&& entry)
+{
+    quint64 id = entry.info.id;
+    m_memoryUsage += entry.data.size();
+    m_entries.push_back(std::move(entry));
+    m_index.insert(id, std::prev(m_entries.end()));
+    evictLocked();
+}
+
+void SnapshotCache::removeLocked(std::list<Entry>::iterator it)
+{
+    m_memoryUsage -= it->data.size();
+    m_index.remove(it->info.id);
+    m_entries.erase(it);
+}
+
+void SnapshotCache::evictLocked()
+{
+    while (m_memoryUsage > m_memoryLimit && !m_entries.empty()) {
+        qDebug() << "[SnapshotCache] Evicting snapshot" << m_entries.front().info.id
+                 << "of" << m_entries.front().info.cameraKey;
+        removeLocked(m_entries.begin());
+    }
+}
+
+QList<SnapshotCache::SnapshotInfo> SnapshotCache::snapshots(const QString& cameraKey) const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<SnapshotInfo> result;
+    for (const Entry& entry : m_entries) {
+        if (entry.info.cameraKey == cameraKey) {
+            result.append(entry.info);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const SnapshotInfo& a, const SnapshotInfo& b) {
+        return a.timestampMs < b.timestampMs;
+    });
+    return result;
+}
+
+QByteArray SnapshotCache::snapshotData(quint64 id)
+{
+    QMutexLocker locker(&m_mutex);
+    auto indexIt = m_index.find(id);
+    if (indexIt == m_index.end()) {
+        return QByteArray();
+    }
+    // Перенос в конец списка - снимок вытесняется последним
+    m_entries.splice(m_entries.end(), m_entries, indexIt.value());
+    return indexIt.value()->data;
+}
+
+void SnapshotCache::removeCamera(const QString& cameraKey)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cameras.remove(cameraKey);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        auto next = std::next(it);
+        if (it->info.cameraKey == cameraKey) {
+            removeLocked(it);
+        }
+        it = next;
+    }
+}
+
+void SnapshotCache::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryLimit = qMax<qint64>(0, bytes);
+    evictLocked();
+}
+
+qint64 SnapshotCache::memoryLimit() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memoryLimit;
+}
+
+qint64 SnapshotCache::memoryUsage() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_memoryUsage;
+}
+
+bool SnapshotCache::setFormat(const QByteArray& format)
+{
+    QByteArray normalized = format.toLower();
+    if (normalized == "jpeg") {
+        normalized = "jpg";
+    }
+    if (!QImageWriter::supportedImageFormats().contains(normalized)) {
+        qWarning() << "Snapshot format" << format << "is not supported by Qt image plugins, using JPEG";
+        return false;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_format = normalized;
+    return true;
+}
+
+QString SnapshotCache::reasonName(Reason reason)
+{
+    switch (reason) {
+    case Reason::ScoreDrop: return "drop";
+    case Reason::Worst:     return "worst";
+    case Reason::Best:      return "best";
+    }
+    return QString();
+}
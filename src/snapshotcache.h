@@ -0,0 +1,163 @@
+#ifndef SNAPSHOTCACHE_H
+#define SNAPSHOTCACHE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <deque>
+#include <list>
+
+/**
+ * @class SnapshotCache
+ * @brief Кэш сжатых снимков камер с общим ограничением памяти
+ *
+ * Обработчики камер предлагают кэшу каждый проанализированный кадр вместе
+ * с оценкой (offer()). Кэш сохраняет только значимые моменты:
+ * - резкое падение оценки относительно предыдущего анализа;
+ * - худший и лучший кадр камеры за скользящее окно EXTREMES_WINDOW_MS.
+ *
+ * Окно делится на корзины по EXTREMES_BUCKET_MS. Для худшего и лучшего
+ * кадра хранится монотонная очередь: по кандидату на корзину, и только те,
+ * что ещё могут стать экстремумом окна (более поздний и не менее
+ * экстремальный кадр вытесняет прежних). Экстремум окна - голова
+ * очереди; кандидаты из вышедших за окно корзин удаляются вместе со
+ * снимками. Точность окна - одна корзина.
+ *
+ * Кадр уменьшается до MAX_SNAPSHOT_WIDTH и сжимается (JPEG или WebP) в
+ * собственном пуле потоков, поэтому поток захвата не ждёт кодирования.
+ * При превышении лимита памяти вытесняются давно не запрашивавшиеся
+ * снимки (LRU по всем камерам).
+ *
+ * Методы потокобезопасны.
+ */
+class SnapshotCache
+{
+public:
+    /**
+     * @brief Причина сохранения снимка
+     */
+    enum class Reason {
+        ScoreDrop,      // Оценка упала не менее чем на SCORE_DROP_THRESHOLD
+        Worst,          // Худшая оценка камеры за окно
+        Best            // Лучшая оценка камеры за окно
+    };
+
+    /**
+     * @brief Описание снимка без данных изображения
+     */
+    struct SnapshotInfo {
+        quint64 id;
+        QString cameraKey;
+        qint64 timestampMs;       // Время кадра (мс с начала эпохи)
+        double score;             // Общая оценка кадра
+        double previousScore;     // Оценка предыдущего анализа (-1 = нет)
+        Reason reason;
+        QByteArray format;        // "jpg" или "webp"
+        int sizeBytes;
+    };
+
+    /**
+     * @param memoryLimitBytes Общий лимит памяти сжатых снимков
+     */
+    explicit SnapshotCache(qint64 memoryLimitBytes = DEFAULT_MEMORY_LIMIT);
+    ~SnapshotCache();
+
+    /**
+     * @brief Предлагает проанализированный кадр камеры
+     * @param cameraKey Ключ камеры (URL)
+     * @param image Кадр; копируется неявно (QImage разделяет данные)
+     * @param score Общая оценка качества кадра
+     *
+     * Вызывается из потока камеры. Если кадр не значим или очередь
+     * кодирования переполнена, он отбрасывается сразу.
+     */
+    void offer(const QString& cameraKey, const QImage& image, double score);
+
+    /**
+     * @brief Снимки камеры от старых к новым (порядок LRU не меняется)
+     */
+    QList<SnapshotInfo> snapshots(const QString& cameraKey) const;
+
+    /**
+     * @brief Сжатые данные снимка; отмечает снимок как использованный
+     * @return Пустой массив, если снимок уже вытеснен
+     */
+    QByteArray snapshotData(quint64 id);
+
+    /**
+     * @brief Удаляет снимки и состояние камеры
+     */
+    void removeCamera(const QString& cameraKey);
+
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const;
+    qint64 memoryUsage() const;
+
+    /**
+     * @brief Выбирает формат сжатия
+     * @return false, если Qt собран без поддержки WebP (остаётся JPEG)
+     */
+    bool setFormat(const QByteArray& format);
+
+    static QString reasonName(Reason reason);
+
+    static constexpr qint64 DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+private:
+    struct Entry {
+        SnapshotInfo info;
+        QByteArray data;
+    };
+
+    // Кандидат в худший или лучший кадр окна
+    struct Extreme {
+        qint64 bucket;
+        double score;
+        quint64 id;
+    };
+
+    struct CameraState {
+        double lastScore = -1.0;
+        std::deque<Extreme> worst;      // Оценки возрастают от головы к хвосту
+        std::deque<Extreme> best;       // Оценки убывают от головы к хвосту
+    };
+
+    static bool beats(double score, double other, bool lowest);
+    static bool qualifies(const std::deque<Extreme>& window, qint64 bucket, double score, bool lowest);
+    static void pushExtreme(std::deque<Extreme>& window, const Extreme& candidate, bool lowest,
+                            QVector<quint64>& released);
+    void expireLocked(std::deque<Extreme>& window, qint64 bucket, QVector<quint64>& released);
+    static bool isCandidate(const CameraState& state, quint64 id);
+    void releaseLocked(const CameraState& state, const QVector<quint64>& released);
+
+    void encode(SnapshotInfo info, QImage image);
+    void insertLocked(Entry&& entry);
+    void removeLocked(std::list<Entry>::iterator it);
+    void evictLocked();
+
+    mutable QMutex m_mutex;
+    std::list<Entry> m_entries;     // Начало - давно использованные
+    QMap<quint64, std::list<Entry>::iterator> m_index;
+    QMap<QString, CameraState> m_cameras;
+    qint64 m_memoryLimit;
+    qint64 m_memoryUsage;
+    quint64 m_nextId;
+    int m_pendingEncodes;
+    QByteArray m_format;
+    QThreadPool m_encoderPool;
+
+    const double SCORE_DROP_THRESHOLD = 15.0;
+    const qint64 EXTREMES_WINDOW_MS = 60 * 60 * 1000;   // Худший/лучший кадр за последний час
+    const qint64 EXTREMES_BUCKET_MS = 10 * 60 * 1000;   // Шаг скольжения окна
+    const int MAX_SNAPSHOT_WIDTH = 640;
+    const int JPEG_QUALITY = 80;
+    const int MAX_PENDING_ENCODES = 16;
+    const int ENCODER_THREADS = 2;
+};
+
+#endif // SNAPSHOTCACHE_H
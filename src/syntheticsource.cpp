@@ -0,0 +1,145 @@
+#include "syntheticsource.h"
+#include <QDebug>
+#include <QUrl>
+#include <QUrlQuery>
+#include <algorithm>
+
+SyntheticSource::SyntheticSource(const QString& url)
+    : m_width(1280)
+    , m_height(720)
+    , m_fps(25.0)
+    , m_seed(1)
+    , m_noise(0.0)
+    , m_blur(0.0)
+    , m_gain(1.0)
+    , m_freezeAt(-1)
+    , m_freezeFrames(0)
+    , m_disconnectAt(-1)
+    , m_failOpen(0)
+    , m_frameIndex(0)
+    , m_failedOpens(0)
+    , m_disconnected(false)
+    , m_opened(false)
+{
+    QUrlQuery query{QUrl(url)};
+    auto intValue = [&query](const char* key, qint64 fallback) {
+        bool ok = false;
+        qint64 value = query.queryItemValue(key).toLongLong(&ok);
+        return ok ? value : fallback;
+    };
+    auto doubleValue = [&query](const char* key, double fallback) {
+        bool ok = false;
+        double value = query.queryItemValue(key).toDouble(&ok);
+        return ok ? value : fallback;
+    };
+
+    m_width = std::max(16, static_cast<int>(intValue("width", m_width)));
+    m_height = std::max(16, static_cast<int>(intValue("height", m_height)));
+    m_fps = std::max(0.0, doubleValue("fps", m_fps));
+    m_seed = static_cast<quint64>(intValue("seed", static_cast<qint64>(m_seed)));
+    m_noise = doubleValue("noise", m_noise);
+    m_blur = doubleValue("blur", m_blur);
+    m_gain = doubleValue("gain", m_gain);
+    m_freezeAt = intValue("freezeAt", m_freezeAt);
+    m_freezeFrames = intValue("freezeFrames", m_freezeFrames);
+    m_disconnectAt = intValue("disconnectAt", m_disconnectAt);
+    m_failOpen = static_cast<int>(intValue("failOpen", m_failOpen));
+}
+
+bool SyntheticSource::open()
+{
+    // Имитация недоступной камеры: после разрыва первые failOpen попыток неудачны
+    if (m_disconnected && m_failedOpens < m_failOpen) {
+        m_failedOpens++;
+        qWarning() << "[SyntheticSource] Simulated open failure" << m_failedOpens << "of" << m_failOpen;
+        return false;
+    }
+
+    if (m_frames.empty()) {
+        renderFrames();
+    }
+    m_opened = true;
+    return true;
+}
+
+bool SyntheticSource::read(cv::Mat& frame)
+{
+    if (!m_opened) {
+        return false;
+    }
+
+    if (!m_disconnected && m_disconnectAt >= 0 && m_frameIndex >= m_disconnectAt) {
+        m_disconnected = true;
+        m_opened = false;
+        return false;
+    }
+
+    // При застывании повторяется кадр, предшествующий началу события
+    qint64 index = m_frameIndex;
+    if (m_freezeAt >= 0 && index >= m_freezeAt && index < m_freezeAt + m_freezeFrames) {
+        index = m_freezeAt;
+    }
+
+    frame = m_frames[static_cast<size_t>(index % PREGENERATED_FRAMES)];
+    m_frameIndex++;
+    return true;
+}
+
+void SyntheticSource::close()
+{
+    m_opened = false;
+}
+
+bool SyntheticSource::isOpened() const
+{
+    return m_opened;
+}
+
+double SyntheticSource::frameRate() const
+{
+    return m_fps;
+}
+
+void SyntheticSource::renderFrames()
+{
+    cv::RNG rng(m_seed);
+    m_frames.resize(PREGENERATED_FRAMES);
+
+    for (int k = 0; k < PREGENERATED_FRAMES; ++k) {
+        cv::Mat frame(m_height, m_width, CV_8UC3);
+
+        // Сцена: горизонтальный градиент, шахматное поле и движущаяся полоса,
+        // чтобы соседние кадры различались и детектор застывания не срабатывал
+        for (int y = 0; y < m_height; ++y) {
+            cv::Vec3b* row = frame.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < m_width; ++x) {
+                uchar base = static_cast<uchar>(40 + (x * 160) / m_width);
+                bool checker = ((x / 32) + (y / 32)) % 2 == 0;
+                uchar value = checker ? base : static_cast<uchar>(base / 2);
+                row[x] = cv::Vec3b(value, static_cast<uchar>(value * 0.9), static_cast<uchar>(value * 0.8));
+            }
+        }
+        int barX = (k * m_width) / PREGENERATED_FRAMES;
+        cv::rectangle(frame, cv::Rect(barX, 0, std::max(4, m_width / 40), m_height),
+                      cv::Scalar(230, 230, 230), cv::FILLED);
+        cv::circle(frame, cv::Point(m_width / 2, m_height / 2), m_height / 6,
+                   cv::Scalar(30, 120, 200), cv::FILLED);
+
+        if (m_blur > 0.0) {
+            cv::GaussianBlur(frame, frame, cv::Size(0, 0), m_blur);
+        }
+        if (m_gain != 1.0) {
+            frame.convertTo(frame, -1, m_gain, 0.0);
+        }
+        if (m_noise > 0.0) {
+            cv::Mat noise(frame.size(), CV_16SC3);
+            rng.fill(noise, cv::RNG::NORMAL, 0.0, m_noise);
+            cv::Mat noisy;
+            frame.convertTo(noisy, CV_16SC3);
+            noisy += noise;
+            noisy.convertTo(frame, CV_8UC3);
+        }
+
+        m_frames[static_cast<size_t>(k)] = frame;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SYNTHETICSOURCE_H
+#define SYNTHETICSOURCE_H
+
+#include "framesource.h"
+#include <vector>
+
+/**
+ * @class SyntheticSource
+ * @brief Детерминированный генератор кадров для тестов и нагрузочных замеров
+ *
+ * Формат URL: synthetic://<имя>?<параметры>
+ *
+ * | Параметр        | По умолчанию | Описание                                         |
+ * |-----------------|--------------|--------------------------------------------------|
+ * | width, height   | 1280, 720    | Размер кадра                                     |
+ * | fps             | 25           | Номинальная частота (0 - без ограничения)        |
+ * | seed            | 1            | Зерно генератора шума                            |
+ * | noise           | 0            | СКО гауссова шума, уровни яркости                |
+ * | blur            | 0            | Sigma гауссова размытия (расфокусировка)         |
+ * | gain            | 1.0          | Усиление яркости (>1 - пересвет)                 |
+ * | freezeAt        | -1           | Номер кадра, с которого поток застывает          |
+ * | freezeFrames    | 0            | Длительность застывания в кадрах                 |
+ * | disconnectAt    | -1           | Номер кадра, на котором read() вернёт ошибку     |
+ * | failOpen        | 0            | Число неудачных попыток open() после разрыва     |
+ *
+ * Все кадры рассчитываются заранее в open(), поэтому read() почти ничего
+ * не стоит и не искажает замеры производительности конвейера анализа.
+ */
+class SyntheticSource : public FrameSource
+{
+public:
+    explicit SyntheticSource(const QString& url);
+
+    bool open() override;
+    bool read(cv::Mat& frame) override;
+    void close() override;
+    bool isOpened() const override;
+    double frameRate() const override;
+
+private:
+    void renderFrames();
+
+    int m_width;
+    int m_height;
+    double m_fps;
+    quint64 m_seed;
+    double m_noise;
+    double m_blur;
+    double m_gain;
+    qint64 m_freezeAt;
+    qint64 m_freezeFrames;
+    qint64 m_disconnectAt;
+    int m_failOpen;
+
+    std::vector<cv::Mat> m_frames;
+    qint64 m_frameIndex;        // Номер следующего кадра с начала генерации
+    int m_failedOpens;
+    bool m_disconnected;        // Разрыв уже произошёл (случается один раз)
+    bool m_opened;
+
+    static constexpr int PREGENERATED_FRAMES = 16;
+};
+
+#endif // SYNTHETICSOURCE_H
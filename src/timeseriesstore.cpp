@@ -0,0 +1,612 @@
+#include "timeseriesstore.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QUrl>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t SEGMENT_MAGIC = 0x49515453;  // "IQTS"
+const uint32_t SEGMENT_VERSION = 1;
+const int TIER_COUNT = 4;
+const quint64 INITIAL_RECORDS = 256;
+
+// Заголовок файла-сегмента; лежит в отображённой памяти
+struct alignas(64) SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t tier;
+    int64_t segmentStartMs;
+    std::atomic<uint64_t> count;        // Увеличивается после записи новой записи
+};
+
+// Все записи начинаются с метки времени, что позволяет общий двоичный поиск
+struct RawRecord {
+    int64_t timestampMs;
+    float values[TimeSeriesStore::METRIC_COUNT];
+};
+
+struct RollupRecord {
+    int64_t startMs;
+    uint32_t count;
+    uint32_t reserved;
+    float min[TimeSeriesStore::METRIC_COUNT];
+    float max[TimeSeriesStore::METRIC_COUNT];
+    float mean[TimeSeriesStore::METRIC_COUNT];
+};
+
+struct TierSpec {
+    const char* name;
+    qint64 bucketMs;        // 0 - исходные результаты
+    qint64 segmentMs;       // Длительность одного файла
+    uint32_t recordSize;
+};
+
+const TierSpec TIERS[TIER_COUNT] = {
+    { "raw", 0,                      3600LL * 1000,            sizeof(RawRecord) },
+    { "1m",  60LL * 1000,            24LL * 3600 * 1000,       sizeof(RollupRecord) },
+    { "1h",  3600LL * 1000,          30LL * 24 * 3600 * 1000,  sizeof(RollupRecord) },
+    { "1d",  24LL * 3600 * 1000,     365LL * 24 * 3600 * 1000, sizeof(RollupRecord) },
+};
+
+// Типичная частота анализа ~2 Гц - оценка числа исходных точек в диапазоне
+const qint64 RAW_POINT_INTERVAL_MS = 500;
+
+qint64 floorDiv(qint64 value, qint64 divisor)
+{
+    qint64 quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+QString segmentFileName(int tier, qint64 segmentIndex)
+{
+    return QString("%1-%2.dat").arg(TIERS[tier].name).arg(segmentIndex);
+}
+
+} // namespace
+
+/**
+ * @brief Файл-сегмент ряда, отображённый в память
+ *
+ * Дескриптор закрывается сразу после mmap, поэтому тысячи открытых
+ * сегментов не упираются в лимит файловых дескрипторов.
+ */
+class TimeSeriesStore::Segment
+{
+public:
+    ~Segment()
+    {
+        if (m_mapping) {
+            munmap(m_mapping, m_size);
+        }
+    }
+
+    static std::unique_ptr<Segment> open(const QString& path, int tier, qint64 segmentStartMs, bool writable)
+    {
+        std::unique_ptr<Segment> segment(new Segment(path, TIERS[tier].recordSize, writable));
+        int fd = ::open(QFile::encodeName(path).constData(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        size_t size = static_cast<size_t>(info.st_size);
+        bool created = false;
+        if (size == 0 && writable) {
+            size = sizeof(SegmentHeader) + INITIAL_RECORDS * segment->m_recordSize;
+            if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                ::close(fd);
+                return nullptr;
+            }
+            created = true;
+        }
+        bool mapped = size >= sizeof(SegmentHeader) && segment->map(fd, size);
+        ::close(fd);
+        if (!mapped) {
+            return nullptr;
+        }
+
+        SegmentHeader* header = segment->header();
+        // Нулевой заголовок остаётся после падения между ftruncate и его
+        // заполнением: записей в таком сегменте ещё нет
+        if (!created && segment->headerIsZero()) {
+            if (!writable) {
+                return nullptr;
+            }
+            qWarning() << "Reinitializing unfinished time-series segment" << path;
+            created = true;
+        }
+        if (created) {
+            // ftruncate заполняет файл нулями, count уже 0
+            header->version = SEGMENT_VERSION;
+            header->recordSize = segment->m_recordSize;
+            header->tier = static_cast<uint32_t>(tier);
+            header->segmentStartMs = segmentStartMs;
+            header->magic = SEGMENT_MAGIC;
+        } else if (header->magic != SEGMENT_MAGIC || header->version != SEGMENT_VERSION
+                   || header->recordSize != segment->m_recordSize) {
+            qWarning() << "Corrupted time-series segment" << path;
+            return nullptr;
+        }
+        return segment;
+    }
+
+    bool headerIsZero() const
+    {
+        const char* bytes = static_cast<const char*>(m_mapping);
+        return std::all_of(bytes, bytes + sizeof(SegmentHeader), [](char byte) { return byte == 0; });
+    }
+
+    quint64 capacity() const
+    {
+        return (m_size - sizeof(SegmentHeader)) / m_recordSize;
+    }
+
+    quint64 count() const
+    {
+        // Файл мог вырасти в другом процессе после отображения
+        return std::min<quint64>(header()->count.load(std::memory_order_acquire), capacity());
+    }
+
+    char* record(quint64 index) const
+    {
+        return static_cast<char*>(m_mapping) + sizeof(SegmentHeader) + index * m_recordSize;
+    }
+
+    qint64 timestampAt(quint64 index) const
+    {
+        int64_t timestamp;
+        std::memcpy(&timestamp, record(index), sizeof(timestamp));
+        return timestamp;
+    }
+
+    quint64 lowerBound(qint64 timestampMs) const
+    {
+        quint64 low = 0;
+        quint64 high = count();
+        while (low < high) {
+            quint64 middle = low + (high - low) / 2;
+            if (timestampAt(middle) < timestampMs) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    /**
+     * @brief Место под новую запись; видна читателям после commit()
+     */
+    char* reserve()
+    {
+        if (count() == capacity() && !grow()) {
+            return nullptr;
+        }
+        return record(count());
+    }
+
+    void commit()
+    {
+        header()->count.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    Segment(const QString& path, uint32_t recordSize, bool writable)
+        : m_path(path), m_recordSize(recordSize), m_writable(writable), m_mapping(nullptr), m_size(0) {}
+
+    SegmentHeader* header() const
+    {
+        return static_cast<SegmentHeader*>(m_mapping);
+    }
+
+    bool map(int fd, size_t size)
+    {
+        int protection = m_writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        void* mapping = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        if (m_mapping) {
+            munmap(m_mapping, m_size);
+        }
+        m_mapping = mapping;
+        m_size = size;
+        return true;
+    }
+
+    bool grow()
+    {
+        size_t newSize = sizeof(SegmentHeader) + std::max<quint64>(capacity() * 2, INITIAL_RECORDS) * m_recordSize;
+        int fd = ::open(QFile::encodeName(m_path).constData(), O_RDWR);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = ftruncate(fd, static_cast<off_t>(newSize)) == 0 && map(fd, newSize);
+        ::close(fd);
+        if (!ok) {
+            qWarning() << "Failed to grow time-series segment" << m_path;
+        }
+        return ok;
+    }
+
+    QString m_path;
+    uint32_t m_recordSize;
+    bool m_writable;
+    void* m_mapping;
+    size_t m_size;
+};
+
+struct TimeSeriesStore::Series {
+    std::unique_ptr<Segment> segment;
+    qint64 segmentIndex = -1;
+};
+
+struct TimeSeriesStore::Camera {
+    QString directory;
+    Series series[TIER_COUNT];
+};
+
+TimeSeriesStore::TimeSeriesStore(const QString& directory)
+    : m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+}
+
+TimeSeriesStore::~TimeSeriesStore()
+{
+}
+
+bool TimeSeriesStore::append(const QString& cameraKey, qint64 timestampMs,
+                             const ImageQualityAnalyzer::QualityResult& result)
+{
+    float values[METRIC_COUNT];
+    values[Overall] = static_cast<float>(result.overallScore);
+    values[Noise] = static_cast<float>(result.noiseScore);
+    values[Contrast] = static_cast<float>(result.contrastScore);
+    values[Sharpness] = static_cast<float>(result.sharpnessScore);
+    values[Overexposed] = static_cast<float>(result.overexposedPercent);
+    values[Underexposed] = static_cast<float>(result.underexposedPercent);
+    values[Blockiness] = static_cast<float>(result.blockinessScore);
+    values[Focus] = static_cast<float>(result.frequencyBlurScore);
+    values[ColorCast] = static_cast<float>(result.colorCast);
+    values[PacketLoss] = static_cast<float>(result.packetLossPercent);
+
+    QMutexLocker locker(&m_mutex);
+    Camera* camera = cameraLocked(cameraKey);
+    if (!camera) {
+        return false;
+    }
+    bool ok = true;
+    for (int tier = 0; tier < TIER_COUNT; ++tier) {
+        ok = appendToSeries(*camera, tier, timestampMs, values) && ok;
+    }
+    return ok;
+}
+
+void TimeSeriesStore::releaseCamera(const QString& cameraKey)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cameras.remove(cameraKey);
+}
+
+TimeSeriesStore::Camera* TimeSeriesStore::cameraLocked(const QString& cameraKey)
+{
+    auto it = m_cameras.find(cameraKey);
+    if (it != m_cameras.end()) {
+        return it.value().get();
+    }
+
+    std::shared_ptr<Camera> camera = std::make_shared<Camera>();
+    camera->directory = cameraDirectory(cameraKey);
+    if (!QDir().mkpath(camera->directory)) {
+        qWarning() << "Cannot create history directory" << camera->directory;
+        return nullptr;
+    }
+    // Имя для списка камер; пароль из URL на диск не пишется
+    QFile nameFile(camera->directory + "/camera.txt");
+    if (!nameFile.exists() && nameFile.open(QIODevice::WriteOnly)) {
+        nameFile.write(QUrl(cameraKey).toString(QUrl::RemovePassword).toUtf8());
+    }
+    m_cameras.insert(cameraKey, camera);
+    return camera.get();
+}
+
+bool TimeSeriesStore::appendToSeries(Camera& camera, int tier, qint64 timestampMs, const float* values)
+{
+    const TierSpec& spec = TIERS[tier];
+    qint64 bucketStart = spec.bucketMs > 0 ? floorDiv(timestampMs, spec.bucketMs) * spec.bucketMs : timestampMs;
+
+    Segment* segment = writableSegment(camera, tier, bucketStart);
+    if (!segment) {
+        return false;
+    }
+
+    quint64 count = segment->count();
+    qint64 lastTimestamp = count > 0 ? segment->timestampAt(count - 1) : bucketStart;
+    if (lastTimestamp > bucketStart) {
+        qDebug() << "[TimeSeriesStore] Out-of-order result dropped for series" << spec.name;
+        return false;
+    }
+
+    if (spec.bucketMs == 0) {
+        RawRecord* record = reinterpret_cast<RawRecord*>(segment->reserve());
+        if (!record) {
+            return false;
+        }
+        record->timestampMs = timestampMs;
+        std::copy(values, values + METRIC_COUNT, record->values);
+        segment->commit();
+        return true;
+    }
+
+    // Текущий интервал - последняя запись ряда, она обновляется на месте
+    if (count > 0 && lastTimestamp == bucketStart) {
+        RollupRecord* record = reinterpret_cast<RollupRecord*>(segment->record(count - 1));
+        record->count++;
+        for (int metric = 0; metric < METRIC_COUNT; ++metric) {
+            record->min[metric] = std::min(record->min[metric], values[metric]);
+            record->max[metric] = std::max(record->max[metric], values[metric]);
+            record->mean[metric] += (values[metric] - record->mean[metric]) / record->count;
+        }
+        return true;
+    }
+
+    RollupRecord* record = reinterpret_cast<RollupRecord*>(segment->reserve());
+    if (!record) {
+        return false;
+    }
+    record->startMs = bucketStart;
+    record->count = 1;
+    record->reserved = 0;
+    std::copy(values, values + METRIC_COUNT, record->min);
+    std::copy(values, values + METRIC_COUNT, record->max);
+    std::copy(values, values + METRIC_COUNT, record->mean);
+    segment->commit();
+    return true;
+}
+
+TimeSeriesStore::Segment* TimeSeriesStore::writableSegment(Camera& camera, int tier, qint64 timestampMs)
+{
+    Series& series = camera.series[tier];
+    qint64 segmentIndex = floorDiv(timestampMs, TIERS[tier].segmentMs);
+    if (series.segment && series.segmentIndex == segmentIndex) {
+        return series.segment.get();
+    }
+    if (series.segment && segmentIndex < series.segmentIndex) {
+        return nullptr;  // Результат старше открытого сегмента
+    }
+
+    QString path = camera.directory + "/" + segmentFileName(tier, segmentIndex);
+    series.segment = Segment::open(path, tier, segmentIndex * TIERS[tier].segmentMs, true);
+    series.segmentIndex = series.segment ? segmentIndex : -1;
+    if (!series.segment) {
+        qWarning() << "Cannot open time-series segment" << path;
+        return nullptr;
+    }
+    // Новый сегмент открывается раз в период ряда - удобный момент для очистки
+    removeExpiredSegments(camera.directory, tier, timestampMs);
+    return series.segment.get();
+}
+
+void TimeSeriesStore::removeExpiredSegments(const QString& cameraDirectory, int tier, qint64 nowMs) const
+{
+    qint64 retention = retentionMs(tier);
+    if (retention <= 0) {
+        return;
+    }
+    const TierSpec& spec = TIERS[tier];
+    QDir directory(cameraDirectory);
+    const QStringList files = directory.entryList(QStringList() << QString("%1-*.dat").arg(spec.name), QDir::Files);
+    for (const QString& fileName : files) {
+        bool ok = false;
+        qint64 segmentIndex = fileName.mid(qstrlen(spec.name) + 1).chopped(4).toLongLong(&ok);
+        if (ok && (segmentIndex + 1) * spec.segmentMs < nowMs - retention) {
+            qDebug() << "[TimeSeriesStore] Removing expired segment" << directory.filePath(fileName);
+            directory.remove(fileName);
+        }
+    }
+}
+
+QVector<TimeSeriesStore::Point> TimeSeriesStore::query(const QString& camera, Resolution resolution,
+                                                       qint64 fromMs, qint64 toMs) const
+{
+    QVector<Point> points;
+    int tier = static_cast<int>(resolution);
+    const TierSpec& spec = TIERS[tier];
+    QDir directory(cameraDirectory(camera));
+    if (!directory.exists() || fromMs > toMs) {
+        return points;
+    }
+
+    // Файлы читаются через собственное отображение, поэтому запрос не
+    // блокирует запись и работает из другого процесса
+    QVector<qint64> segmentIndexes;
+    qint64 firstIndex = floorDiv(fromMs, spec.segmentMs);
+    qint64 lastIndex = floorDiv(toMs, spec.segmentMs);
+    const QStringList files = directory.entryList(QStringList() << QString("%1-*.dat").arg(spec.name), QDir::Files);
+    for (const QString& fileName : files) {
+        bool ok = false;
+        qint64 segmentIndex = fileName.mid(qstrlen(spec.name) + 1).chopped(4).toLongLong(&ok);
+        if (ok && segmentIndex >= firstIndex && segmentIndex <= lastIndex) {
+            segmentIndexes.append(segmentIndex);
+        }
+    }
+    std::sort(segmentIndexes.begin(), segmentIndexes.end());
+
+    for (qint64 segmentIndex : segmentIndexes) {
+        std::unique_ptr<Segment> segment = Segment::open(directory.filePath(segmentFileName(tier, segmentIndex)),
+                                                         tier, segmentIndex * spec.segmentMs, false);
+        if (!segment) {
+            continue;  // Удалён по сроку хранения во время запроса
+        }
+        quint64 count = segment->count();
+        for (quint64 index = segment->lowerBound(fromMs); index < count; ++index) {
+            Point point;
+            if (spec.bucketMs == 0) {
+                const RawRecord* record = reinterpret_cast<const RawRecord*>(segment->record(index));
+                point.timestampMs = record->timestampMs;
+                point.count = 1;
+                std::copy(record->values, record->values + METRIC_COUNT, point.min);
+                std::copy(record->values, record->values + METRIC_COUNT, point.max);
+                std::copy(record->values, record->values + METRIC_COUNT, point.mean);
+            } else {
+                const RollupRecord* record = reinterpret_cast<const RollupRecord*>(segment->record(index));
+                point.timestampMs = record->startMs;
+                point.count = record->count;
+                std::copy(record->min, record->min + METRIC_COUNT, point.min);
+                std::copy(record->max, record->max + METRIC_COUNT, point.max);
+                std::copy(record->mean, record->mean + METRIC_COUNT, point.mean);
+            }
+            if (point.timestampMs > toMs) {
+                break;
+            }
+            points.append(point);
+        }
+    }
+    return points;
+}
+
+QVector<TimeSeriesStore::CameraInfo> TimeSeriesStore::cameras() const
+{
+    QVector<CameraInfo> result;
+    QDir directory(m_directory);
+    const QStringList entries = directory.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString& entry : entries) {
+        QFile nameFile(directory.filePath(entry) + "/camera.txt");
+        if (!nameFile.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        CameraInfo info;
+        info.id = entry;
+        info.displayName = QString::fromUtf8(nameFile.readAll());
+        result.append(info);
+    }
+    return result;
+}
+
+void TimeSeriesStore::setRetention(const Retention& retention)
+{
+    QMutexLocker locker(&m_mutex);
+    m_retention = retention;
+}
+
+bool TimeSeriesStore::parseRetention(const QString& text, Retention& retention)
+{
+    // Пустые элементы пропускаются вручную: QString::SkipEmptyParts устарел в Qt 5.15,
+    // а Qt::SkipEmptyParts появился только в 5.14
+    const QStringList items = text.split(',');
+    for (const QString& item : items) {
+        if (item.trimmed().isEmpty()) {
+            continue;
+        }
+        QStringList parts = item.trimmed().split('=');
+        Resolution resolution;
+        if (parts.size() != 2 || !parseResolution(parts[0].trimmed(), resolution)) {
+            return false;
+        }
+
+        // 0 - бессрочно, иначе число с суффиксом h или d
+        QString value = parts[1].trimmed();
+        qint64 ms = 0;
+        if (value != "0") {
+            qint64 unitMs = value.endsWith('h') ? 3600LL * 1000 : value.endsWith('d') ? 24LL * 3600 * 1000 : 0;
+            bool ok = false;
+            qint64 amount = value.left(value.size() - 1).toLongLong(&ok);
+            if (unitMs == 0 || !ok || amount <= 0) {
+                return false;
+            }
+            ms = amount * unitMs;
+        }
+
+        switch (resolution) {
+        case Resolution::Raw: retention.rawMs = ms; break;
+        case Resolution::Minute: retention.minuteMs = ms; break;
+        case Resolution::Hour: retention.hourMs = ms; break;
+        case Resolution::Day: retention.dayMs = ms; break;
+        }
+    }
+    return true;
+}
+
+QString TimeSeriesStore::directory() const
+{
+    return m_directory;
+}
+
+TimeSeriesStore::Resolution TimeSeriesStore::resolutionFor(qint64 fromMs, qint64 toMs, int maxPoints) const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 span = qMax<qint64>(0, toMs - fromMs);
+    qint64 age = QDateTime::currentMSecsSinceEpoch() - fromMs;
+    for (int tier = 0; tier < TIER_COUNT - 1; ++tier) {
+        qint64 interval = TIERS[tier].bucketMs > 0 ? TIERS[tier].bucketMs : RAW_POINT_INTERVAL_MS;
+        qint64 retention = retentionMs(tier);
+        bool covered = retention <= 0 || age <= retention;
+        if (covered && span / interval <= maxPoints) {
+            return static_cast<Resolution>(tier);
+        }
+    }
+    return Resolution::Day;
+}
+
+QString TimeSeriesStore::cameraDirectory(const QString& camera) const
+{
+    // Уже готовый id из cameras() или ключ камеры (URL может содержать
+    // учётные данные, поэтому имя каталога - хэш)
+    if (camera.size() == 16 && QDir(m_directory).exists(camera)) {
+        return m_directory + "/" + camera;
+    }
+    QByteArray hash = QCryptographicHash::hash(camera.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return m_directory + "/" + QString::fromLatin1(hash);
+}
+
+qint64 TimeSeriesStore::retentionMs(int tier) const
+{
+    switch (tier) {
+    case 0: return m_retention.rawMs;
+    case 1: return m_retention.minuteMs;
+    case 2: return m_retention.hourMs;
+    default: return m_retention.dayMs;
+    }
+}
+
+QString TimeSeriesStore::metricName(int metric)
+{
+    static const char* const NAMES[METRIC_COUNT] = {
+        "overall", "noise", "contrast", "sharpness", "overexposed",
+        "underexposed", "blockiness", "focus", "color_cast", "packet_loss"
+    };
+    return (metric >= 0 && metric < METRIC_COUNT) ? QString(NAMES[metric]) : QString();
+}
+
+QString TimeSeriesStore::resolutionName(Resolution resolution)
+{
+    return QString(TIERS[static_cast<int>(resolution)].name);
+}
+
+bool TimeSeriesStore::parseResolution(const QString& name, Resolution& resolution)
+{
+    for (int tier = 0; tier < TIER_COUNT; ++tier) {
+        if (name == TIERS[tier].name) {
+            resolution = static_cast<Resolution>(tier);
+            return true;
+        }
+    }
+    return false;
+}
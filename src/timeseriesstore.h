@@ -0,0 +1,158 @@
+#ifndef TIMESERIESSTORE_H
+#define TIMESERIESSTORE_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "imagequalityanalyzer.h"
+
+/**
+ * @class TimeSeriesStore
+ * @brief Встроенное хранилище истории QualityResult с агрегатами
+ *
+ * Для каждой камеры ведутся четыре ряда:
+ * - Raw - исходные результаты анализа (короткое окно хранения);
+ * - Minute, Hour, Day - агрегаты min/max/mean по минутам, часам и суткам.
+ *
+ * Агрегаты обновляются при каждой записи: текущий интервал - это последняя
+ * запись ряда, которая изменяется на месте, пока не начнётся следующий
+ * интервал. Поэтому незавершённые агрегаты не теряются при падении процесса.
+ *
+ * Ряд разбит на файлы-сегменты фиксированной длительности
+ * (<каталог>/<хэш камеры>/<ряд>-<номер сегмента>.dat), только дозапись.
+ * Сегменты отображаются в память (mmap), записи в них упорядочены по
+ * времени, поэтому выборка диапазона - двоичный поиск без чтения файла
+ * целиком. Сегменты старше срока хранения ряда удаляются.
+ *
+ * Методы потокобезопасны, но append() пишет в отображённую память и может
+ * ждать диска, поэтому приложение вызывает его из HistoryWriter, а не из
+ * потока интерфейса. Запросы из другого процесса (CLI) читают файлы
+ * напрямую и могут не увидеть последнюю, ещё изменяющуюся запись.
+ */
+class TimeSeriesStore
+{
+public:
+    enum class Resolution {
+        Raw,
+        Minute,
+        Hour,
+        Day
+    };
+
+    /**
+     * @brief Сохраняемые метрики QualityResult
+     */
+    enum Metric {
+        Overall,
+        Noise,
+        Contrast,
+        Sharpness,
+        Overexposed,
+        Underexposed,
+        Blockiness,
+        Focus,
+        ColorCast,
+        PacketLoss,
+        METRIC_COUNT
+    };
+
+    /**
+     * @brief Точка ряда; для Raw count = 1 и min = max = mean
+     */
+    struct Point {
+        qint64 timestampMs;       // Время результата или начало интервала агрегата
+        quint32 count;            // Число результатов в интервале
+        float min[METRIC_COUNT];
+        float max[METRIC_COUNT];
+        float mean[METRIC_COUNT];
+    };
+
+    /**
+     * @brief Срок хранения рядов, мс; 0 - бессрочно
+     */
+    struct Retention {
+        qint64 rawMs = 24LL * 3600 * 1000;
+        qint64 minuteMs = 31LL * 24 * 3600 * 1000;
+        qint64 hourMs = 400LL * 24 * 3600 * 1000;
+        qint64 dayMs = 0;
+    };
+
+    /**
+     * @brief Камера, найденная в каталоге хранилища
+     */
+    struct CameraInfo {
+        QString id;               // Имя каталога (хэш ключа)
+        QString displayName;      // Ключ камеры без пароля
+    };
+
+    explicit TimeSeriesStore(const QString& directory);
+    ~TimeSeriesStore();
+
+    /**
+     * @brief Записывает результат анализа во все ряды камеры
+     * @param cameraKey Ключ камеры (URL)
+     * @return false при ошибке записи или если результат старше последнего
+     */
+    bool append(const QString& cameraKey, qint64 timestampMs,
+                const ImageQualityAnalyzer::QualityResult& result);
+
+    /**
+     * @brief Точки ряда в диапазоне [fromMs, toMs]
+     * @param camera Ключ камеры или id из cameras()
+     */
+    QVector<Point> query(const QString& camera, Resolution resolution,
+                         qint64 fromMs, qint64 toMs) const;
+
+    /**
+     * @brief Камеры, у которых есть история
+     */
+    QVector<CameraInfo> cameras() const;
+
+    /**
+     * @brief Закрывает отображённые сегменты камеры; история на диске остаётся
+     */
+    void releaseCamera(const QString& cameraKey);
+
+    void setRetention(const Retention& retention);
+
+    /**
+     * @brief Разбирает сроки хранения вида "raw=24h,1m=31d,1h=400d,1d=0"
+     *
+     * Срок - число с суффиксом h или d, 0 - бессрочно. Неуказанные ряды
+     * сохраняют значения из retention.
+     */
+    static bool parseRetention(const QString& text, Retention& retention);
+    QString directory() const;
+
+    /**
+     * @brief Самое подробное разрешение, дающее не больше maxPoints точек
+     *
+     * Ряды, срок хранения которых не покрывает начало диапазона, пропускаются.
+     */
+    Resolution resolutionFor(qint64 fromMs, qint64 toMs, int maxPoints) const;
+
+    static QString metricName(int metric);
+    static QString resolutionName(Resolution resolution);
+    static bool parseResolution(const QString& name, Resolution& resolution);
+
+private:
+    class Segment;
+    struct Series;
+    struct Camera;
+
+    Camera* cameraLocked(const QString& cameraKey);
+    bool appendToSeries(Camera& camera, int tier, qint64 timestampMs, const float* values);
+    Segment* writableSegment(Camera& camera, int tier, qint64 timestampMs);
+    void removeExpiredSegments(const QString& cameraDirectory, int tier, qint64 nowMs) const;
+    QString cameraDirectory(const QString& camera) const;
+    qint64 retentionMs(int tier) const;
+
+    QString m_directory;
+    Retention m_retention;
+    mutable QMutex m_mutex;
+    QMap<QString, std::shared_ptr<Camera>> m_cameras;
+};
+
+#endif // TIMESERIESSTORE_H
@@ -0,0 +1,116 @@
+/**
+ * Правила оповещений на заданном времени: tick() вместо ожидания таймера.
+ */
+
+#include <QtTest>
+#include <QTemporaryFile>
+
+#include "alertengine.h"
+
+namespace {
+
+const QString CAMERA_KEY = "rtsp://10.0.0.7/stream";
+const qint64 START_MS = 1000000;
+
+ImageQualityAnalyzer::QualityResult resultWithSharpness(double sharpness)
+{
+    ImageQualityAnalyzer::QualityResult result;
+    result.sharpnessScore = sharpness;
+    result.overallScore = 80.0;
+    result.isValid = true;
+    return result;
+}
+
+AlertEngine::Rule parsed(const QString& line)
+{
+    AlertEngine::Rule rule;
+    bool ok = AlertEngine::parseRule(line, rule);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+    return rule;
+}
+
+} // namespace
+
+class TestAlertEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false\n*.warning=false");
+    }
+
+    void pendingRuleFiresOnTickWithoutNewResults()
+    {
+        AlertEngine engine;
+        engine.addRule(parsed("sharpness < 30 for=10"));
+        QSignalSpy raised(&engine, &AlertEngine::alertRaised);
+
+        engine.evaluate(CAMERA_KEY, START_MS, resultWithSharpness(10));
+        engine.tick(START_MS + 5000);
+        QCOMPARE(raised.count(), 0);
+        engine.tick(START_MS + 10000);
+        QCOMPARE(raised.count(), 1);
+        QCOMPARE(engine.activeAlertCount(CAMERA_KEY), 1);
+        engine.tick(START_MS + 20000);
+        QCOMPARE(raised.count(), 1);
+    }
+
+    void silentCameraRaisesStale()
+    {
+        AlertEngine engine;
+        engine.addRule(parsed("stale > 30"));
+        QSignalSpy raised(&engine, &AlertEngine::alertRaised);
+        QSignalSpy cleared(&engine, &AlertEngine::alertCleared);
+
+        // Камера не прислала ни одного результата
+        engine.addCamera(CAMERA_KEY, START_MS);
+        engine.tick(START_MS + 30000);
+        QCOMPARE(raised.count(), 0);
+        engine.tick(START_MS + 31000);
+        QCOMPARE(raised.count(), 1);
+        QCOMPARE(engine.activeAlertCount(CAMERA_KEY), 1);
+
+        // Результаты вернулись: оповещение снимается через clear_for
+        engine.evaluate(CAMERA_KEY, START_MS + 32000, resultWithSharpness(80));
+        engine.tick(START_MS + 42000);
+        QCOMPARE(cleared.count(), 1);
+        QCOMPARE(engine.activeAlertCount(CAMERA_KEY), 0);
+    }
+
+    void activeCountsFollowCameras()
+    {
+        AlertEngine engine;
+        engine.addRule(parsed("sharpness < 30"));
+        engine.addRule(parsed("overall < 90"));
+        engine.evaluate(CAMERA_KEY, START_MS, resultWithSharpness(10));
+        engine.evaluate("rtsp://10.0.0.8/stream", START_MS, resultWithSharpness(80));
+        QCOMPARE(engine.activeAlertCount(CAMERA_KEY), 2);
+        QCOMPARE(engine.activeAlertCount("rtsp://10.0.0.8/stream"), 1);
+        QCOMPARE(engine.activeAlerts().size(), 3);
+
+        engine.removeCamera(CAMERA_KEY);
+        QCOMPARE(engine.activeAlertCount(CAMERA_KEY), 0);
+        engine.clearRules();
+        QCOMPARE(engine.activeAlertCount("rtsp://10.0.0.8/stream"), 0);
+        QVERIFY(engine.activeAlerts().isEmpty());
+    }
+
+    void fileWithoutRulesIsAnError()
+    {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write("# только комментарий\nsharpness 30\n");
+        file.close();
+
+        AlertEngine engine;
+        QString errorText;
+        QCOMPARE(engine.loadRules(file.fileName(), &errorText), 0);
+        QVERIFY(!errorText.isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestAlertEngine)
+#include "tst_alertengine.moc"
@@ -0,0 +1,328 @@
+/**
+ * Сессии бэкенда ingest в настоящем IngestReactor.
+ *
+ * RtspSession подключается к серверу RTSP, которого играет сам тест:
+ * рукопожатие, RTP interleaved с одиночными NAL, FU-A и STAP-A, потеря
+ * пакета, отбрасывание кадров до первого ключевого, поддержание сессии и
+ * отчёты RTCP. FileIngestSession проверяется через IngestSource на файле
+ * MJPEG, собранном из кадров OpenCV.
+ */
+
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <memory>
+#include <opencv2/imgcodecs.hpp>
+
+#include "ingestsource.h"
+#include "rtspsession.h"
+
+namespace {
+
+const quint32 CAMERA_SSRC = 0x11223344;
+const int SESSION_TIMEOUT_SEC = 2;
+
+QByteArray rtpPacket(quint16 sequence, quint32 timestamp, bool marker, const QByteArray& payload)
+{
+    QByteArray packet;
+    packet.append(static_cast<char>(0x80));
+    packet.append(static_cast<char>((marker ? 0x80 : 0x00) | 96));
+    packet.append(static_cast<char>(sequence >> 8));
+    packet.append(static_cast<char>(sequence));
+    for (quint32 value : { timestamp, CAMERA_SSRC }) {
+        packet.append(static_cast<char>(value >> 24));
+        packet.append(static_cast<char>(value >> 16));
+        packet.append(static_cast<char>(value >> 8));
+        packet.append(static_cast<char>(value));
+    }
+    packet.append(payload);
+    return packet;
+}
+
+QByteArray interleaved(int channel, const QByteArray& data)
+{
+    QByteArray frame;
+    frame.append('$');
+    frame.append(static_cast<char>(channel));
+    frame.append(static_cast<char>(data.size() >> 8));
+    frame.append(static_cast<char>(data.size()));
+    frame.append(data);
+    return frame;
+}
+
+QByteArray nal(uchar header, int size)
+{
+    return QByteArray(1, static_cast<char>(header)) + QByteArray(size - 1, '\x2A');
+}
+
+/**
+ * @brief Сервер RTSP на одну сессию: отвечает на запросы по сценарию теста
+ */
+class FakeRtspServer
+{
+public:
+    bool listen() { return m_server.listen(QHostAddress::LocalHost, 0); }
+    quint16 port() const { return m_server.serverPort(); }
+
+    bool accept()
+    {
+        if (!m_server.waitForNewConnection(5000)) {
+            return false;
+        }
+        m_client = m_server.nextPendingConnection();
+        return m_client != nullptr;
+    }
+
+    /**
+     * @brief Ждёт запрос с методом method и отвечает 200 OK
+     */
+    bool respond(const QByteArray& method, const QByteArray& headers, const QByteArray& body = QByteArray())
+    {
+        while (!m_received.contains("\r\n\r\n")) {
+            if (!m_client->waitForReadyRead(5000)) {
+                return false;
+            }
+            m_received += m_client->readAll();
+        }
+        int end = m_received.indexOf("\r\n\r\n") + 4;
+        QByteArray request = m_received.left(end);
+        m_received.remove(0, end);
+        if (!request.startsWith(method + ' ')) {
+            qWarning() << "unexpected request" << request;
+            return false;
+        }
+
+        int cseqStart = request.indexOf("CSeq: ") + 6;
+        QByteArray cseq = request.mid(cseqStart, request.indexOf("\r\n", cseqStart) - cseqStart);
+        QByteArray response = "RTSP/1.0 200 OK\r\nCSeq: " + cseq + "\r\n" + headers;
+        if (!body.isEmpty()) {
+            response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        }
+        response += "\r\n" + body;
+        return send(response);
+    }
+
+    bool handshake()
+    {
+        QByteArray sdp = "v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=test\r\nt=0 0\r\n"
+                         "m=video 0 RTP/AVP 96\r\na=rtpmap:96 H264/90000\r\na=control:track1\r\n";
+        QByteArray base = "rtsp://127.0.0.1:" + QByteArray::number(port()) + "/stream/";
+        return respond("OPTIONS", "Public: OPTIONS, DESCRIBE, SETUP, PLAY, GET_PARAMETER, TEARDOWN\r\n")
+            && respond("DESCRIBE", "Content-Base: " + base + "\r\nContent-Type: application/sdp\r\n", sdp)
+            && respond("SETUP", "Session: 12345678;timeout=" + QByteArray::number(SESSION_TIMEOUT_SEC)
+                                    + "\r\nTransport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n")
+            && respond("PLAY", "Session: 12345678\r\n");
+    }
+
+    bool send(const QByteArray& data)
+    {
+        m_client->write(data);
+        return m_client->waitForBytesWritten(5000);
+    }
+
+    /**
+     * @brief Всё, что клиент прислал после рукопожатия
+     */
+    QByteArray received()
+    {
+        m_client->waitForReadyRead(100);
+        m_received += m_client->readAll();
+        return m_received;
+    }
+
+private:
+    QTcpServer m_server;
+    QTcpSocket* m_client = nullptr;
+    QByteArray m_received;
+};
+
+/**
+ * @brief Сессия RtspSession в реакторе, подключённая к FakeRtspServer
+ */
+struct ClientSession {
+    std::shared_ptr<IngestStream> stream;
+    std::shared_ptr<PacketRing> ring;
+    quint64 sessionId = 0;
+
+    bool start(quint16 port)
+    {
+        sockaddr_storage address;
+        socklen_t addressLength = 0;
+        if (!RtspSession::resolve("127.0.0.1", port, address, addressLength)) {
+            return false;
+        }
+        IngestReactor& reactor = IngestReactor::instance();
+        stream = reactor.createStream();
+        ring = std::make_shared<PacketRing>(10000, 1024 * 1024);
+        stream->setPacketRing(ring);
+        QUrl url(QString("rtsp://127.0.0.1:%1/stream").arg(port));
+        sessionId = reactor.addSession(std::unique_ptr<IngestSession>(
+            new RtspSession(url, address, addressLength, stream, 5000)));
+        return true;
+    }
+
+    ~ClientSession()
+    {
+        if (stream) {
+            IngestReactor::instance().removeSession(sessionId);
+            stream->close();
+        }
+    }
+};
+
+} // namespace
+
+class TestIngestSession : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false\n*.warning=false");
+    }
+
+    void rtspDepacketizesAndWaitsForKeyframe()
+    {
+        FakeRtspServer server;
+        QVERIFY(server.listen());
+        ClientSession client;
+        QVERIFY(client.start(server.port()));
+        QVERIFY(server.accept());
+        QVERIFY(server.handshake());
+
+        // P-кадр до первого IDR отбрасывается до декодера (и не попадает в кольцо)
+        QVERIFY(server.send(interleaved(0, rtpPacket(1, 0, true, nal(0x41, 50)))));
+        // IDR тремя фрагментами FU-A
+        QByteArray idrPart(100, '\x2B');
+        QVERIFY(server.send(interleaved(0, rtpPacket(2, 3000, false, QByteArray("\x7C\x85") + idrPart))));
+        QVERIFY(server.send(interleaved(0, rtpPacket(3, 3000, false, QByteArray("\x7C\x05") + idrPart))));
+        QVERIFY(server.send(interleaved(0, rtpPacket(4, 3000, true, QByteArray("\x7C\x45") + idrPart))));
+        // STAP-A с двумя NAL
+        QByteArray stap("\x78", 1);
+        for (int size : { 20, 30 }) {
+            stap.append('\0');
+            stap.append(static_cast<char>(size));
+            stap.append(nal(0x41, size));
+        }
+        QVERIFY(server.send(interleaved(0, rtpPacket(5, 6000, true, stap))));
+        // Пакет 6 потерян
+        QVERIFY(server.send(interleaved(0, rtpPacket(7, 9000, true, nal(0x41, 40)))));
+
+        QTRY_COMPARE_WITH_TIMEOUT(client.stream->stats().packetsReceived, quint64(4), 5000);
+        FrameSource::StreamStats stats = client.stream->stats();
+        QCOMPARE(stats.packetsSkipped, quint64(1));
+        QCOMPARE(stats.packetsLost, quint64(1));
+        // Annex-B: стартовый код перед каждым NAL, заголовок IDR восстановлен из FU-A
+        QCOMPARE(client.ring->memoryUsage(), qint64((4 + 1 + 300) + (4 + 20 + 4 + 30) + (4 + 40)));
+    }
+
+    void recoveryPointSeiOpensStream()
+    {
+        FakeRtspServer server;
+        QVERIFY(server.listen());
+        ClientSession client;
+        QVERIFY(client.start(server.port()));
+        QVERIFY(server.accept());
+        QVERIFY(server.handshake());
+
+        // Камера с intra refresh: IDR нет, вход в поток отмечен SEI recovery point
+        QByteArray sei("\x06\x06\x01\x84\x80", 5);
+        QVERIFY(server.send(interleaved(0, rtpPacket(1, 0, false, sei))));
+        QVERIFY(server.send(interleaved(0, rtpPacket(2, 0, true, nal(0x41, 60)))));
+        // SEI другого типа (user data unregistered) ключевым кадр не делает
+        QByteArray userData("\x06\x05\x01\x00\x80", 5);
+        QVERIFY(server.send(interleaved(0, rtpPacket(3, 3000, false, userData))));
+        QVERIFY(server.send(interleaved(0, rtpPacket(4, 3000, true, nal(0x41, 60)))));
+
+        QTRY_COMPARE_WITH_TIMEOUT(client.stream->stats().packetsReceived, quint64(2), 5000);
+        QCOMPARE(client.stream->stats().packetsSkipped, quint64(0));
+        QCOMPARE(client.ring->memoryUsage(), qint64(2 * (4 + 5 + 4 + 60)));
+
+        FakeRtspServer other;
+        QVERIFY(other.listen());
+        ClientSession gated;
+        QVERIFY(gated.start(other.port()));
+        QVERIFY(other.accept());
+        QVERIFY(other.handshake());
+        QVERIFY(other.send(interleaved(0, rtpPacket(1, 0, false, userData))));
+        QVERIFY(other.send(interleaved(0, rtpPacket(2, 0, true, nal(0x41, 60)))));
+        QTRY_COMPARE_WITH_TIMEOUT(gated.stream->stats().packetsSkipped, quint64(1), 5000);
+    }
+
+    void playingSessionSendsKeepaliveAndReceiverReports()
+    {
+        FakeRtspServer server;
+        QVERIFY(server.listen());
+        ClientSession client;
+        QVERIFY(client.start(server.port()));
+        QVERIFY(server.accept());
+        QVERIFY(server.handshake());
+
+        // Отчёт отправителя: RR должен вернуть средние 32 бита его метки NTP
+        QByteArray senderReport("\x80\xC8\x00\x06\x11\x22\x33\x44"
+                                "\xAA\xBB\xCC\xDD\xEE\xFF\x00\x11"
+                                "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 28);
+        QVERIFY(server.send(interleaved(1, senderReport)));
+
+        // Поток идёт непрерывно, чтобы не истёк таймаут отсутствия данных
+        QByteArray received;
+        int reportOffset = -1;
+        QElapsedTimer timer;
+        timer.start();
+        quint16 sequence = 1;
+        while (timer.elapsed() < 8000 && reportOffset < 0) {
+            QVERIFY(server.send(interleaved(0, rtpPacket(sequence, sequence * 3000u, true,
+                                                         nal(sequence == 1 ? 0x65 : 0x41, 30)))));
+            ++sequence;
+            received = server.received();
+            reportOffset = received.indexOf(QByteArray("$\x01", 2));
+            QTest::qWait(40);
+        }
+
+        // Поддержание сессии - через половину таймаута, задолго до первого отчёта
+        QVERIFY(received.contains("GET_PARAMETER rtsp://127.0.0.1:"));
+        QVERIFY(reportOffset >= 0);
+        const uchar* report = reinterpret_cast<const uchar*>(received.constData()) + reportOffset + 4;
+        QVERIFY(received.size() >= reportOffset + 4 + 32);
+        QCOMPARE(int(report[0]), 0x81);
+        QCOMPARE(int(report[1]), 201);
+        QCOMPARE(qFromBigEndian<quint32>(report + 8), CAMERA_SSRC);
+        QCOMPARE(qFromBigEndian<quint32>(report + 12) & 0xFFFFFF, quint32(0));
+        quint32 highestSequence = qFromBigEndian<quint32>(report + 16);
+        QVERIFY(highestSequence >= 1 && highestSequence < sequence);
+        QCOMPARE(qFromBigEndian<quint32>(report + 24), quint32(0xCCDDEEFF));
+    }
+
+    void fileSessionDeliversFrames()
+    {
+        QTemporaryDir directory;
+        QString path = directory.path() + "/clip.mjpeg";
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for (int i = 0; i < 10; ++i) {
+            cv::Mat image(120, 160, CV_8UC3, cv::Scalar(20 * i, 128, 255 - 20 * i));
+            std::vector<uchar> jpeg;
+            QVERIFY(cv::imencode(".jpg", image, jpeg));
+            file.write(reinterpret_cast<const char*>(jpeg.data()), static_cast<qint64>(jpeg.size()));
+        }
+        file.close();
+
+        // Открытие подтверждается первым декодированным кадром
+        IngestSource source(path, false);
+        QVERIFY(source.open());
+        cv::Mat frame;
+        QVERIFY(source.read(frame));
+        QCOMPARE(frame.cols, 160);
+        QCOMPARE(frame.rows, 120);
+        QVERIFY(source.streamStats().packetsReceived >= 1);
+        QCOMPARE(source.streamStats().packetsSkipped, quint64(0));
+        source.close();
+    }
+};
+
+QTEST_GUILESS_MAIN(TestIngestSession)
+#include "tst_ingestsession.moc"
@@ -0,0 +1,152 @@
+/**
+ * Кольцо предыстории на синтетических пакетах.
+ *
+ * Пакеты подаются так же, как их подаёт бэкенд ingest: данные, время
+ * показа в микросекундах и признак ключевого кадра. Проверяются
+ * выравнивание по GOP, окно по времени, предел памяти и запись файла
+ * с B-кадрами.
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <memory>
+
+#include "packetring.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+
+const qint64 MS = 1000;     // Метки времени - микросекунды
+
+std::unique_ptr<PacketRing> createRing(int durationMs, qint64 maxBytes)
+{
+    std::unique_ptr<PacketRing> ring(new PacketRing(durationMs, maxBytes));
+    ring->setStream(AV_CODEC_ID_MJPEG, QByteArray(), 1, 1000000);
+    ring->setFrameSize(160, 120);
+    return ring;
+}
+
+void push(PacketRing& ring, int size, qint64 timestampMs, bool keyframe)
+{
+    ring.push(QByteArray(size, keyframe ? 'K' : 'P'), timestampMs * MS, keyframe);
+}
+
+} // namespace
+
+class TestPacketRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+    }
+
+    void ringStartsAtKeyframe()
+    {
+        std::unique_ptr<PacketRing> ring = createRing(10000, 1024 * 1024);
+        push(*ring, 100, 0, false);
+        QCOMPARE(ring->memoryUsage(), qint64(0));
+        push(*ring, 200, 40, true);
+        push(*ring, 100, 80, false);
+        QCOMPARE(ring->memoryUsage(), qint64(300));
+    }
+
+    void windowDropsWholeGops()
+    {
+        // GOP по 500 мс: ключевой кадр 1000 байт и четыре кадра по 100
+        std::unique_ptr<PacketRing> ring = createRing(1000, 1024 * 1024);
+        for (int ms = 0; ms < 3000; ms += 100) {
+            bool keyframe = ms % 500 == 0;
+            push(*ring, keyframe ? 1000 : 100, ms, keyframe);
+        }
+        // Последний кадр - 2900 мс: окно в 1 с покрывают GOP с 1500, 2000 и 2500 мс
+        QCOMPARE(ring->memoryUsage(), qint64(3 * 1400));
+    }
+
+    void byteCapKeepsCurrentGop()
+    {
+        std::unique_ptr<PacketRing> ring = createRing(60000, 1000);
+        push(*ring, 600, 0, true);
+        push(*ring, 600, 40, false);
+        // Один GOP больше предела остаётся целиком
+        QCOMPARE(ring->memoryUsage(), qint64(1200));
+        push(*ring, 600, 80, true);
+        QCOMPARE(ring->memoryUsage(), qint64(600));
+        push(*ring, 300, 120, false);
+        QCOMPARE(ring->memoryUsage(), qint64(900));
+    }
+
+    void earlierKeyframeStartsOver()
+    {
+        std::unique_ptr<PacketRing> ring = createRing(10000, 1024 * 1024);
+        push(*ring, 500, 5000, true);
+        push(*ring, 100, 5040, false);
+        // Переподключение: отсчёт времени камеры начался заново
+        push(*ring, 200, 1000, true);
+        QCOMPARE(ring->memoryUsage(), qint64(200));
+    }
+
+    void suspendedRingDropsAndRestartsAtKeyframe()
+    {
+        std::unique_ptr<PacketRing> ring = createRing(10000, 1024 * 1024);
+        push(*ring, 500, 0, true);
+        push(*ring, 100, 40, false);
+        // Предел памяти: кольцо очищается и пакетов не принимает
+        ring->setSuspended(true);
+        QCOMPARE(ring->memoryUsage(), qint64(0));
+        push(*ring, 500, 80, true);
+        QCOMPARE(ring->memoryUsage(), qint64(0));
+
+        ring->setSuspended(false);
+        push(*ring, 100, 120, false);
+        QCOMPARE(ring->memoryUsage(), qint64(0));
+        push(*ring, 500, 160, true);
+        QCOMPARE(ring->memoryUsage(), qint64(500));
+    }
+
+    void bFramesAreKeptAndSavedInDecodeOrder()
+    {
+        // Порядок декодирования I P B B P B B: время показа идёт назад
+        std::unique_ptr<PacketRing> ring = createRing(10000, 1024 * 1024);
+        const qint64 presentationMs[] = { 0, 120, 40, 80, 240, 160, 200 };
+        for (int i = 0; i < 7; ++i) {
+            push(*ring, 100, presentationMs[i], i == 0);
+        }
+        QCOMPARE(ring->memoryUsage(), qint64(700));
+
+        QTemporaryDir directory;
+        QString path = directory.path() + "/event.mp4";
+        QVERIFY(ring->save(path));
+        QTRY_VERIFY_WITH_TIMEOUT(QFile::exists(path), 5000);
+
+        AVFormatContext* input = nullptr;
+        QCOMPARE(avformat_open_input(&input, QFile::encodeName(path).constData(), nullptr, nullptr), 0);
+        AVPacket* packet = av_packet_alloc();
+        int count = 0;
+        int64_t lastDts = AV_NOPTS_VALUE;
+        bool monotonic = true;
+        bool presentationAfterDecode = true;
+        while (av_read_frame(input, packet) >= 0) {
+            monotonic = monotonic && (lastDts == AV_NOPTS_VALUE || packet->dts > lastDts);
+            presentationAfterDecode = presentationAfterDecode && packet->pts >= packet->dts;
+            lastDts = packet->dts;
+            ++count;
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+        avformat_close_input(&input);
+
+        QCOMPARE(count, 7);
+        QVERIFY(monotonic);
+        QVERIFY(presentationAfterDecode);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestPacketRing)
+#include "tst_packetring.moc"
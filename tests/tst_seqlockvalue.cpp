@@ -0,0 +1,112 @@
+/**
+ * SeqlockValue под одновременной записью и чтением.
+ *
+ * Писатель публикует значения, все слова которых равны номеру публикации;
+ * читатели проверяют, что ни одна копия не смешивает две публикации и что
+ * номера не убывают.
+ */
+
+#include <QtTest>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "seqlockvalue.h"
+
+namespace {
+
+// Несколько слов и хвост меньше слова: разрыв копии заметен в любом поле
+struct Payload {
+    uint64_t words[7];
+    uint32_t tail;
+};
+
+Payload payloadFor(uint64_t number)
+{
+    Payload payload;
+    for (uint64_t& word : payload.words) {
+        word = number;
+    }
+    payload.tail = static_cast<uint32_t>(number);
+    return payload;
+}
+
+bool isConsistent(const Payload& payload)
+{
+    for (uint64_t word : payload.words) {
+        if (word != payload.words[0]) {
+            return false;
+        }
+    }
+    return payload.tail == static_cast<uint32_t>(payload.words[0]);
+}
+
+} // namespace
+
+class TestSeqlockValue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void storeAndLoad()
+    {
+        SeqlockValue<Payload> value;
+        QCOMPARE(value.version(), uint64_t(0));
+        QCOMPARE(value.load().words[0], uint64_t(0));
+        value.store(payloadFor(42));
+        QCOMPARE(value.version(), uint64_t(1));
+        QVERIFY(isConsistent(value.load()));
+        QCOMPARE(value.load().words[0], uint64_t(42));
+    }
+
+    void concurrentReadersSeeWholeValues()
+    {
+        const uint64_t PUBLICATIONS = 200000;
+        const int READERS = 3;
+
+        SeqlockValue<Payload> value;
+        std::atomic<bool> done(false);
+        std::atomic<int> torn(0);
+        std::atomic<int> backwards(0);
+        std::atomic<uint64_t> reads(0);
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < READERS; ++i) {
+            readers.emplace_back([&]() {
+                uint64_t last = 0;
+                while (!done.load(std::memory_order_acquire)) {
+                    Payload payload = value.load();
+                    if (!isConsistent(payload)) {
+                        torn++;
+                    }
+                    if (payload.words[0] < last) {
+                        backwards++;
+                    }
+                    last = payload.words[0];
+                    reads.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        // Запись начинается, когда читатели уже крутятся в цикле
+        while (reads.load(std::memory_order_relaxed) < static_cast<uint64_t>(READERS)) {
+            std::this_thread::yield();
+        }
+        for (uint64_t number = 1; number <= PUBLICATIONS; ++number) {
+            value.store(payloadFor(number));
+        }
+        done.store(true, std::memory_order_release);
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+
+        QCOMPARE(torn.load(), 0);
+        QCOMPARE(backwards.load(), 0);
+        QVERIFY(reads.load() > 0);
+        QCOMPARE(value.version(), PUBLICATIONS);
+        QCOMPARE(value.load().words[0], PUBLICATIONS);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSeqlockValue)
+#include "tst_seqlockvalue.moc"
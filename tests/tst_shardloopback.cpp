@@ -0,0 +1,138 @@
+/**
+ * Координатор и обработчик в одном процессе через loopback-соединение.
+ *
+ * Обработчик запускает настоящие CameraWorker на синтетических камерах,
+ * поэтому проверяется весь путь: Hello, Assign, захват, Result.
+ */
+
+#include <QtTest>
+#include <QTcpSocket>
+#include <memory>
+
+#include "shardcoordinator.h"
+#include "shardworker.h"
+
+Q_DECLARE_METATYPE(ImageQualityAnalyzer::QualityResult)
+
+namespace {
+
+const char* const CAMERA_URL = "synthetic://shard?seed=3&width=160&height=120&fps=25";
+
+} // namespace
+
+class TestShardLoopback : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+        qRegisterMetaType<ImageQualityAnalyzer::QualityResult>("ImageQualityAnalyzer::QualityResult");
+    }
+
+    void emptyPlanIsStillAssigned()
+    {
+        // Без камер план обработчика пуст, но Assign после Hello приходит всегда
+        ShardCoordinator coordinator;
+        QVERIFY(coordinator.listen(QHostAddress::LocalHost, 0));
+
+        ShardWorker worker("127.0.0.1", coordinator.serverPort(), "empty", 0.0);
+        QSignalSpy assignments(&worker, &ShardWorker::assignmentReceived);
+        worker.start();
+
+        QVERIFY(assignments.wait(5000));
+        QVERIFY(assignments.first().first().toStringList().isEmpty());
+        QCOMPARE(coordinator.workers(), QStringList() << "empty");
+    }
+
+    void mismatchedProtocolVersionIsRejected()
+    {
+        ShardCoordinator coordinator;
+        QVERIFY(coordinator.listen(QHostAddress::LocalHost, 0));
+        QSignalSpy joined(&coordinator, &ShardCoordinator::workerJoined);
+
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, coordinator.serverPort());
+        QVERIFY(socket.waitForConnected(5000));
+        socket.write(ShardProtocol::encodeHello("stale", ShardProtocol::PROTOCOL_VERSION - 1));
+        QVERIFY(socket.waitForBytesWritten(5000));
+
+        QTRY_COMPARE_WITH_TIMEOUT(socket.state(), QAbstractSocket::UnconnectedState, 5000);
+        QCOMPARE(joined.count(), 0);
+        QVERIFY(coordinator.workers().isEmpty());
+    }
+
+    void resultsFlowBackToCoordinator()
+    {
+        ShardCoordinator coordinator;
+        QVERIFY(coordinator.listen(QHostAddress::LocalHost, 0));
+        QSignalSpy joined(&coordinator, &ShardCoordinator::workerJoined);
+        QSignalSpy results(&coordinator, &ShardCoordinator::resultReceived);
+
+        ShardWorker worker("127.0.0.1", coordinator.serverPort(), "node-a", 0.0);
+        worker.start();
+        QVERIFY(joined.wait(5000));
+
+        coordinator.addCamera(CAMERA_URL);
+        QCOMPARE(coordinator.workerFor(CAMERA_URL), QString("node-a"));
+        QTRY_COMPARE_WITH_TIMEOUT(worker.cameras(), QStringList() << CAMERA_URL, 5000);
+
+        QVERIFY(results.wait(10000));
+        QCOMPARE(results.first().at(0).toString(), QString(CAMERA_URL));
+        ImageQualityAnalyzer::QualityResult result =
+            results.first().at(1).value<ImageQualityAnalyzer::QualityResult>();
+        QVERIFY(result.isValid);
+
+        coordinator.removeCamera(CAMERA_URL);
+        QTRY_VERIFY_WITH_TIMEOUT(worker.cameras().isEmpty(), 5000);
+    }
+
+    void workerStopsCamerasWhenCoordinatorIsLost()
+    {
+        std::unique_ptr<ShardCoordinator> coordinator(new ShardCoordinator());
+        QVERIFY(coordinator->listen(QHostAddress::LocalHost, 0));
+        QSignalSpy joined(coordinator.get(), &ShardCoordinator::workerJoined);
+
+        ShardWorker worker("127.0.0.1", coordinator->serverPort(), "node-b", 0.0);
+        worker.start();
+        QVERIFY(joined.wait(5000));
+
+        coordinator->addCamera(CAMERA_URL);
+        QTRY_COMPARE_WITH_TIMEOUT(worker.cameras(), QStringList() << CAMERA_URL, 5000);
+
+        // Координатор передал бы камеру другому узлу: обработчик её останавливает
+        coordinator.reset();
+        QTRY_VERIFY_WITH_TIMEOUT(worker.cameras().isEmpty(), 5000);
+    }
+
+    void camerasMoveWhenWorkerLeaves()
+    {
+        ShardCoordinator coordinator;
+        QVERIFY(coordinator.listen(QHostAddress::LocalHost, 0));
+        QSignalSpy joined(&coordinator, &ShardCoordinator::workerJoined);
+
+        std::unique_ptr<ShardWorker> first(new ShardWorker("127.0.0.1", coordinator.serverPort(), "first", 0.0));
+        std::unique_ptr<ShardWorker> second(new ShardWorker("127.0.0.1", coordinator.serverPort(), "second", 0.0));
+        first->start();
+        second->start();
+        QTRY_COMPARE_WITH_TIMEOUT(joined.count(), 2, 5000);
+
+        coordinator.addCamera(CAMERA_URL);
+        QString owner = coordinator.workerFor(CAMERA_URL);
+        QVERIFY(owner == "first" || owner == "second");
+        std::unique_ptr<ShardWorker>& leaving = owner == "first" ? first : second;
+        std::unique_ptr<ShardWorker>& remaining = owner == "first" ? second : first;
+        QTRY_COMPARE_WITH_TIMEOUT(leaving->cameras(), QStringList() << CAMERA_URL, 5000);
+        QVERIFY(remaining->cameras().isEmpty());
+
+        // Выбывает владелец камеры - камера переходит к оставшемуся обработчику
+        leaving.reset();
+        QTRY_COMPARE_WITH_TIMEOUT(coordinator.workerFor(CAMERA_URL), owner == "first" ? QString("second")
+                                                                                     : QString("first"), 5000);
+        QTRY_COMPARE_WITH_TIMEOUT(remaining->cameras(), QStringList() << CAMERA_URL, 5000);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestShardLoopback)
+#include "tst_shardloopback.moc"
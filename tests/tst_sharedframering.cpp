@@ -0,0 +1,58 @@
+/**
+ * Кольцо кадров в разделяемой памяти: публикация, чтение и проверка
+ * заголовков слотов, которые пишет другой процесс.
+ */
+
+#include <QtTest>
+#include <unistd.h>
+
+#include "sharedframering.h"
+
+class TestSharedFrameRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void publishedFrameIsReadBack()
+    {
+        QString name = QString("iqa-test-ring-%1").arg(getpid());
+        cv::Mat frame(48, 64, CV_8UC3, cv::Scalar(10, 20, 30));
+        std::unique_ptr<SharedFrameRing> producer =
+            SharedFrameRing::create(name, SharedFrameRing::DEFAULT_SLOT_COUNT, frame.total() * frame.elemSize());
+        QVERIFY(producer);
+        QVERIFY(producer->publish(frame));
+
+        std::unique_ptr<SharedFrameRing> consumer = SharedFrameRing::attach(name);
+        QVERIFY(consumer);
+        SharedFrameRing::FrameView view;
+        QVERIFY(consumer->readLatest(0, view));
+        QCOMPARE(view.frame.rows, frame.rows);
+        QCOMPARE(view.frame.cols, frame.cols);
+        QCOMPARE(view.frame.type(), frame.type());
+        QCOMPARE(cv::norm(view.frame, frame, cv::NORM_INF), 0.0);
+        QVERIFY(consumer->isStillValid(view));
+        QVERIFY(!consumer->readLatest(view.writeCount, view));
+
+        // Кадр больше слота не публикуется
+        cv::Mat large(96, 64, CV_8UC3);
+        QVERIFY(!producer->publish(large));
+    }
+
+    void slotLayoutIsValidated()
+    {
+        const quint64 slotBytes = 64 * 48 * 3;
+        QVERIFY(SharedFrameRing::isValidLayout(48, 64, CV_8UC3, 64 * 3, slotBytes));
+        QVERIFY(SharedFrameRing::isValidLayout(48, 64, CV_8UC1, 64, slotBytes));
+
+        QVERIFY(!SharedFrameRing::isValidLayout(0, 64, CV_8UC3, 64 * 3, slotBytes));
+        QVERIFY(!SharedFrameRing::isValidLayout(48, -1, CV_8UC3, 64 * 3, slotBytes));
+        QVERIFY(!SharedFrameRing::isValidLayout(49, 64, CV_8UC3, 64 * 3, slotBytes));    // Выходит за слот
+        QVERIFY(!SharedFrameRing::isValidLayout(48, 64, CV_8UC3, 64 * 2, slotBytes));    // Шаг меньше строки
+        QVERIFY(!SharedFrameRing::isValidLayout(48, 64, CV_32FC1, 64 * 4, slotBytes));   // Не 8 бит
+        QVERIFY(!SharedFrameRing::isValidLayout(48, 64, 0x7fff0000, 64, slotBytes));     // Мусор в типе
+        QVERIFY(!SharedFrameRing::isValidLayout(2, 64, CV_8UC1, quint64(1) << 63, slotBytes)); // Переполнение
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSharedFrameRing)
+#include "tst_sharedframering.moc"
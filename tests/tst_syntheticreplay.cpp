@@ -0,0 +1,244 @@
+/**
+ * Воспроизведение синтетических последовательностей через ImageQualityAnalyzer.
+ *
+ * Синтетический источник детерминирован, поэтому тест проверяет и
+ * повторяемость оценок, и их реакцию на заданные искажения (шум,
+ * расфокусировка, пересвет, застывание, разрыв). Разрыв проверяется и на
+ * уровне CameraWorker: обработчик сообщает о потере связи, переподключается
+ * и снова выдаёт результаты.
+ */
+
+#include <QtTest>
+#include <memory>
+#include <vector>
+
+#include "cameraworker.h"
+#include "framesource.h"
+#include "imagequalityanalyzer.h"
+
+Q_DECLARE_METATYPE(ImageQualityAnalyzer::QualityResult)
+
+namespace {
+
+const char* const CLEAN_URL = "synthetic://replay?seed=7&width=320&height=180";
+
+std::vector<ImageQualityAnalyzer::QualityResult> replay(const QString& url, int frameCount)
+{
+    std::vector<ImageQualityAnalyzer::QualityResult> results;
+    std::unique_ptr<FrameSource> source = FrameSource::create(url);
+    if (!source || !source->open()) {
+        return results;
+    }
+
+    ImageQualityAnalyzer analyzer;
+    cv::Mat frame;
+    for (int i = 0; i < frameCount && source->read(frame); ++i) {
+        results.push_back(analyzer.analyze(frame));
+    }
+    return results;
+}
+
+double meanOf(const std::vector<ImageQualityAnalyzer::QualityResult>& results,
+              double ImageQualityAnalyzer::QualityValues::*field)
+{
+    double sum = 0.0;
+    for (const ImageQualityAnalyzer::QualityResult& result : results) {
+        sum += result.*field;
+    }
+    return results.empty() ? 0.0 : sum / results.size();
+}
+
+} // namespace
+
+class TestSyntheticReplay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QLoggingCategory::setFilterRules("*.debug=false");
+        qRegisterMetaType<ImageQualityAnalyzer::QualityResult>("ImageQualityAnalyzer::QualityResult");
+    }
+
+    void cleanSequenceIsValidAndRepeatable()
+    {
+        std::vector<ImageQualityAnalyzer::QualityResult> first = replay(CLEAN_URL, 16);
+        std::vector<ImageQualityAnalyzer::QualityResult> second = replay(CLEAN_URL, 16);
+        QCOMPARE(first.size(), size_t(16));
+        QCOMPARE(second.size(), first.size());
+
+        for (size_t i = 0; i < first.size(); ++i) {
+            QVERIFY(first[i].isValid);
+            QVERIFY(!first[i].isFrozen);
+            QCOMPARE(first[i].frozenFrameCount, 0);
+            QVERIFY(first[i].overallScore > 0.0);
+            QCOMPARE(first[i].overallScore, second[i].overallScore);
+            QCOMPARE(first[i].noiseScore, second[i].noiseScore);
+            QCOMPARE(first[i].sharpnessScore, second[i].sharpnessScore);
+            QCOMPARE(first[i].contrastScore, second[i].contrastScore);
+        }
+    }
+
+    void noiseLowersNoiseScore()
+    {
+        std::vector<ImageQualityAnalyzer::QualityResult> clean = replay(CLEAN_URL, 8);
+        std::vector<ImageQualityAnalyzer::QualityResult> noisy =
+            replay("synthetic://replay?seed=7&width=320&height=180&noise=20", 8);
+        QCOMPARE(noisy.size(), clean.size());
+        QVERIFY(meanOf(noisy, &ImageQualityAnalyzer::QualityValues::noiseScore) + 5.0 <
+                meanOf(clean, &ImageQualityAnalyzer::QualityValues::noiseScore));
+    }
+
+    void blurLowersSharpnessScore()
+    {
+        std::vector<ImageQualityAnalyzer::QualityResult> clean = replay(CLEAN_URL, 8);
+        std::vector<ImageQualityAnalyzer::QualityResult> blurred =
+            replay("synthetic://replay?seed=7&width=320&height=180&blur=3", 8);
+        QCOMPARE(blurred.size(), clean.size());
+        QVERIFY(meanOf(blurred, &ImageQualityAnalyzer::QualityValues::sharpnessScore) <
+                meanOf(clean, &ImageQualityAnalyzer::QualityValues::sharpnessScore));
+    }
+
+    void gainRaisesOverexposure()
+    {
+        std::vector<ImageQualityAnalyzer::QualityResult> clean = replay(CLEAN_URL, 4);
+        std::vector<ImageQualityAnalyzer::QualityResult> bright =
+            replay("synthetic://replay?seed=7&width=320&height=180&gain=2.5", 4);
+        QCOMPARE(bright.size(), clean.size());
+        QVERIFY(meanOf(bright, &ImageQualityAnalyzer::QualityValues::overexposedPercent) >
+                meanOf(clean, &ImageQualityAnalyzer::QualityValues::overexposedPercent) + 10.0);
+    }
+
+    void freezeIsDetectedAndCleared()
+    {
+        // Кадры 4..9 повторяют кадр 4: совпадения с предыдущим начинаются с кадра 5
+        std::vector<ImageQualityAnalyzer::QualityResult> results =
+            replay("synthetic://replay?seed=7&width=320&height=180&freezeAt=4&freezeFrames=6", 12);
+        QCOMPARE(results.size(), size_t(12));
+
+        for (int i = 0; i <= 4; ++i) {
+            QVERIFY2(!results[i].isFrozen, qPrintable(QString("frame %1").arg(i)));
+        }
+        for (int i = 5; i <= 9; ++i) {
+            QVERIFY2(results[i].isFrozen, qPrintable(QString("frame %1").arg(i)));
+            QCOMPARE(results[i].frozenFrameCount, i - 4);
+        }
+        // Поток признаётся застывшим с третьего совпадения подряд
+        QVERIFY(results[6].overallScore > 0.0);
+        QCOMPARE(results[7].overallScore, 0.0);
+        QCOMPARE(results[7].status, QString("Видеопоток застыл"));
+        QVERIFY(!results[10].isFrozen);
+        QVERIFY(results[10].overallScore > 0.0);
+    }
+
+    void lowMemoryModeMatchesFullFrameScores()
+    {
+        // 180 строк - две полные полосы по 64 и неполная последняя
+        const char* const urls[] = {
+            CLEAN_URL,
+            "synthetic://replay?seed=7&width=320&height=180&noise=20",
+            "synthetic://replay?seed=7&width=320&height=180&blur=3"
+        };
+        for (const char* url : urls) {
+            std::unique_ptr<FrameSource> source = FrameSource::create(url);
+            QVERIFY(source && source->open());
+            ImageQualityAnalyzer full;
+            ImageQualityAnalyzer strips;
+            strips.setLowMemoryMode(true);
+
+            cv::Mat frame;
+            for (int i = 0; i < 4 && source->read(frame); ++i) {
+                ImageQualityAnalyzer::QualityResult expected = full.analyze(frame);
+                ImageQualityAnalyzer::QualityResult actual = strips.analyze(frame);
+                QVERIFY2(qAbs(actual.noiseScore - expected.noiseScore) < 1e-6, url);
+                QVERIFY2(qAbs(actual.sharpnessScore - expected.sharpnessScore) < 1e-6, url);
+                QVERIFY2(qAbs(actual.overallScore - expected.overallScore) < 1e-6, url);
+            }
+        }
+    }
+
+    void batchMatchesSequentialAnalysis()
+    {
+        // Кадры разного размера и с разными искажениями в одном пакете
+        const char* const urls[] = {
+            CLEAN_URL,
+            "synthetic://replay?seed=11&width=160&height=120&noise=20",
+            "synthetic://replay?seed=5&width=256&height=144&blur=3"
+        };
+        std::vector<cv::Mat> frames;
+        for (const char* url : urls) {
+            std::unique_ptr<FrameSource> source = FrameSource::create(url);
+            QVERIFY(source && source->open());
+            cv::Mat frame;
+            for (int i = 0; i < 5 && source->read(frame); ++i) {
+                frames.push_back(frame.clone());
+            }
+        }
+        QCOMPARE(frames.size(), size_t(15));
+
+        ImageQualityAnalyzer batchAnalyzer;
+        std::vector<ImageQualityAnalyzer::QualityResult> batch = batchAnalyzer.analyzeBatch(frames);
+        QCOMPARE(batch.size(), frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            // Отдельный анализатор на кадр: пакет не оценивает застывание
+            ImageQualityAnalyzer single;
+            ImageQualityAnalyzer::QualityResult expected = single.analyze(frames[i]);
+            QVERIFY(batch[i].isValid);
+            QCOMPARE(batch[i].noiseScore, expected.noiseScore);
+            QCOMPARE(batch[i].contrastScore, expected.contrastScore);
+            QCOMPARE(batch[i].sharpnessScore, expected.sharpnessScore);
+            QCOMPARE(batch[i].overexposedPercent, expected.overexposedPercent);
+            QCOMPARE(batch[i].blockinessScore, expected.blockinessScore);
+            QCOMPARE(batch[i].colorCast, expected.colorCast);
+            QCOMPARE(batch[i].overallScore, expected.overallScore);
+            QCOMPARE(batch[i].status, expected.status);
+        }
+    }
+
+    void disconnectEndsReplay()
+    {
+        std::vector<ImageQualityAnalyzer::QualityResult> results =
+            replay("synthetic://replay?seed=7&width=320&height=180&disconnectAt=5", 10);
+        QCOMPARE(results.size(), size_t(5));
+    }
+
+    void workerReconnectsAfterDisconnect()
+    {
+        // Разрыв на 15-м кадре, первая попытка открыть поток заново неудачна.
+        // Без планировщика анализируется каждый 10-й кадр
+        CameraWorker worker("synthetic://worker?seed=7&width=160&height=120&fps=50&disconnectAt=15&failOpen=1");
+        QSignalSpy status(&worker, &CameraWorker::connectionStatusChanged);
+        QSignalSpy results(&worker, &CameraWorker::qualityResultReady);
+        int resultsAtDisconnect = -1;
+        connect(&worker, &CameraWorker::connectionStatusChanged, this,
+                [&resultsAtDisconnect, &results](bool connected) {
+            if (!connected && resultsAtDisconnect < 0) {
+                resultsAtDisconnect = results.count();
+            }
+        });
+
+        worker.startCapture();
+        QVERIFY(worker.isConnected());
+        QCOMPARE(status.count(), 1);
+        QVERIFY(status.first().at(0).toBool());
+
+        // Попытки переподключения ждут 1 и 2 с
+        QTRY_COMPARE_WITH_TIMEOUT(status.count(), 3, 15000);
+        QVERIFY(!status.at(1).at(0).toBool());
+        QVERIFY(status.at(2).at(0).toBool());
+        QCOMPARE(resultsAtDisconnect, 1);
+        QVERIFY(worker.isConnected());
+        QCOMPARE(worker.getPipelineStats().readFailures, quint64(2));
+
+        // После переподключения кадры читаются дальше и анализ возобновляется
+        QTRY_VERIFY_WITH_TIMEOUT(results.count() > resultsAtDisconnect, 5000);
+        ImageQualityAnalyzer::QualityResult result =
+            results.last().at(0).value<ImageQualityAnalyzer::QualityResult>();
+        QVERIFY(result.isValid);
+        QVERIFY(worker.getPipelineStats().framesCaptured > 15);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyntheticReplay)
+#include "tst_syntheticreplay.moc"